@@ -171,10 +171,13 @@ void run_tests(uint32 n)
 void print_mmu_stats()
 {
 	uint32 hits,misses,pgfaults;
+	uint32 prefetched,flushes,fault_us;
 	
 	reconos_mmu_stats(&hits,&misses,&pgfaults);
+	reconos_mmu_fault_stats(&prefetched,&flushes,&fault_us);
 	
 	printf("MMU stats: TLB hits: %d    TLB misses: %d    page faults: %d\n",hits,misses,pgfaults);
+	printf("           prefetched pages: %d    cache flushes: %d    fault time: %d us\n",prefetched,flushes,fault_us);
 }
 
 int main(int argc, char ** argv)
@@ -0,0 +1,58 @@
+#include "reconos.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// Samples the per slot MMU counters of a running ReconOS application and
+// prints their rates, similar to top. The counters are cleared on every read.
+// The application itself must not read the MMU statistics meanwhile, since
+// both would share the request FSL of proc_control.
+
+#define DEFAULT_FSL_B    15
+#define DEFAULT_SLOTS    8
+#define DEFAULT_INTERVAL 1
+
+int main(int argc, char ** argv)
+{
+	struct reconos_mmu_slot_stats stats;
+	int fsl_b = DEFAULT_FSL_B;
+	int slots = DEFAULT_SLOTS;
+	int interval = DEFAULT_INTERVAL;
+	int i;
+
+	if(argc > 4){
+		fprintf(stderr,"Usage: %s [proc_control_fsl_b [slots [interval_s]]]\n",argv[0]);
+		exit(1);
+	}
+	if(argc > 1) fsl_b = atoi(argv[1]);
+	if(argc > 2) slots = atoi(argv[2]);
+	if(argc > 3) interval = atoi(argv[3]);
+	if(slots < 1 || slots > 16 || interval < 1){
+		fprintf(stderr,"slots must be in 1..16 and interval at least 1s\n");
+		exit(1);
+	}
+
+	reconos_monitor_init(fsl_b - 1,fsl_b);
+
+	// discard whatever was counted before we started
+	for(i = 0; i < slots; i++){
+		reconos_mmu_stats_slot(i,&stats,1);
+	}
+
+	while(1){
+		sleep(interval);
+		printf("slot     hits/s   misses/s  walk cyc/s  faults/s  stall cyc/s\n");
+		for(i = 0; i < slots; i++){
+			reconos_mmu_stats_slot(i,&stats,1);
+			printf("%4d %10u %10u %11u %9u %12u\n", i,
+				stats.tlb_hits/interval, stats.tlb_misses/interval,
+				stats.walk_cycles/interval, stats.page_faults/interval,
+				stats.stall_cycles/interval);
+		}
+		printf("\n");
+		fflush(stdout);
+	}
+
+	return 0;
+}
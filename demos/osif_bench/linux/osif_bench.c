@@ -0,0 +1,221 @@
+#include "reconos.h"
+#include "fsl_emu.h"
+#include "osif_emu.h"
+#include "mbox.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
+
+// Measures the latency of the commands served by the delegate thread (or the
+// dispatcher) without ReconOS hardware. A software thread on the emulated fsl
+// links of slot 0 issues every command with the osif_* calls of osif_emu.h,
+// the way a hardware thread would, and the average time per command is
+// printed. Only the software side of libreconos is measured: the words pass
+// through in-process rings instead of the fsl driver.
+//
+// Usage: osif_bench [iterations [dispatched]]
+
+#define DEFAULT_ITERATIONS 100000
+#define FAULT_PAGES        256
+#define PAGE_SIZE          4096
+#define MAX_STATE_SIZE     65536
+#define DELAY_ITERATIONS   20
+
+#define RES_SEM    0
+#define RES_MUTEX  1
+#define RES_MBOX_A 2 // main -> thread
+#define RES_MBOX_B 3 // thread -> main
+
+struct reconos_resource res[4];
+struct reconos_hwt hwt;
+
+sem_t sem;
+pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+struct mbox mb_a, mb_b;
+
+int iterations = DEFAULT_ITERATIONS;
+
+// target of the emulated page faults, the control thread writes to each page
+// local memory of the emulated hardware thread, saved and restored as its state
+uint32 state_ram[MAX_STATE_SIZE/sizeof(uint32)];
+
+uint32 fault_buf[FAULT_PAGES*PAGE_SIZE/sizeof(uint32)] __attribute__((aligned(PAGE_SIZE)));
+
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return ts.tv_sec*1e9 + ts.tv_nsec;
+}
+
+static void report(const char * name, double t_start, double t_stop, int count)
+{
+	printf("%-22s %9.0f ns\n", name, (t_stop - t_start)/count);
+}
+
+// saves and restores 'size' bytes of state_ram the way a hardware thread
+// does with memif_write and memif_read around the fsl handshake
+static void state_roundtrip(uint32 size)
+{
+	uint32 addr;
+
+	addr = osif_thread_store_state(0, size);
+	memcpy(fsl_word_ptr(addr), state_ram, size);
+	osif_thread_state_done(0, size);
+
+	addr = osif_thread_load_state(0, size);
+	memcpy(state_ram, fsl_word_ptr(addr), size);
+	osif_thread_state_done(0, size);
+}
+
+// stands in for the hardware thread in slot 0
+static void * swhwt_entry(void * arg)
+{
+	uint32 word;
+	uint32 size;
+	char name[32];
+	double t;
+	int i;
+
+	t = now_ns();
+	for(i = 0; i < iterations; i++){
+		osif_get_init_data(0);
+	}
+	report("THREAD_GET_INIT_DATA", t, now_ns(), iterations);
+
+	t = now_ns();
+	for(i = 0; i < iterations; i++){
+		osif_sem_post(0, RES_SEM);
+	}
+	report("SEM_POST", t, now_ns(), iterations);
+
+	t = now_ns();
+	for(i = 0; i < iterations; i++){
+		osif_mutex_lock(0, RES_MUTEX);
+		osif_mutex_unlock(0, RES_MUTEX);
+	}
+	report("MUTEX_LOCK/UNLOCK", t, now_ns(), 2*iterations);
+
+	t = now_ns();
+	for(i = 0; i < iterations; i++){
+		osif_mbox_tryget(0, RES_MBOX_B, &word);
+	}
+	report("MBOX_TRYGET (empty)", t, now_ns(), iterations);
+
+	// nothing to switch to, the thread keeps its slot
+	t = now_ns();
+	for(i = 0; i < iterations; i++){
+		osif_thread_yield(0);
+	}
+	report("THREAD_YIELD (kept)", t, now_ns(), iterations);
+
+	// served by the timer wheel, the time includes the delay itself
+	for(size = 1000; size <= 16000; size *= 4){
+		t = now_ns();
+		for(i = 0; i < DELAY_ITERATIONS; i++){
+			osif_thread_delay(0, size);
+		}
+		snprintf(name, sizeof(name), "THREAD_DELAY %u us", size);
+		report(name, t, now_ns(), DELAY_ITERATIONS);
+	}
+
+	// save and restore cost by state size
+	for(size = 256; size <= MAX_STATE_SIZE; size *= 4){
+		t = now_ns();
+		for(i = 0; i < iterations/10 + 1; i++){
+			state_roundtrip(size);
+		}
+		snprintf(name, sizeof(name), "STORE+LOAD_STATE %uK", size/1024);
+		if(size < 1024) snprintf(name, sizeof(name), "STORE+LOAD_STATE %u", size);
+		report(name, t, now_ns(), iterations/10 + 1);
+	}
+
+	// ping-pong with the main thread: one MBOX_GET and one MBOX_PUT each
+	t = now_ns();
+	for(i = 0; i < iterations; i++){
+		word = osif_mbox_get(0, RES_MBOX_A);
+		osif_mbox_put(0, RES_MBOX_B, word + 1);
+	}
+	report("MBOX_GET+PUT roundtrip", t, now_ns(), iterations);
+
+	// page faults are reported on proc_control and served by the control thread
+	t = now_ns();
+	for(i = 0; i < FAULT_PAGES; i++){
+		fsl_emu_page_fault(0, &fault_buf[i*PAGE_SIZE/sizeof(uint32)]);
+	}
+	report("page fault", t, now_ns(), FAULT_PAGES);
+
+	osif_thread_exit(0);
+
+	return NULL;
+}
+
+int main(int argc, char ** argv)
+{
+	pthread_t swhwt;
+	int dispatched = 0;
+	int i;
+
+	if(argc > 3){
+		fprintf(stderr,"Usage: %s [iterations [dispatched]]\n",argv[0]);
+		exit(1);
+	}
+	if(argc > 1) iterations = atoi(argv[1]);
+	if(argc > 2) dispatched = atoi(argv[2]);
+	if(iterations < 1){
+		fprintf(stderr,"iterations must be at least 1\n");
+		exit(1);
+	}
+
+	sem_init(&sem,0,0);
+	mbox_init(&mb_a,16);
+	mbox_init(&mb_b,16);
+
+	res[RES_SEM].type = RECONOS_TYPE_SEM;
+	res[RES_SEM].ptr  = &sem;
+	res[RES_MUTEX].type = RECONOS_TYPE_MUTEX;
+	res[RES_MUTEX].ptr  = &mutex;
+	res[RES_MBOX_A].type = RECONOS_TYPE_MBOX;
+	res[RES_MBOX_A].ptr  = &mb_a;
+	res[RES_MBOX_B].type = RECONOS_TYPE_MBOX;
+	res[RES_MBOX_B].ptr  = &mb_b;
+
+	fsl_emu_init();
+	reconos_init_autodetect();
+	proc_control_selftest();
+
+	reconos_hwt_init(&hwt);
+	reconos_hwt_setresources(&hwt,res,4);
+	reconos_hwt_setinitdata(&hwt,NULL);
+	if(dispatched){
+		reconos_hwt_create_dispatched(&hwt,0,NULL);
+	} else {
+		reconos_hwt_create(&hwt,0,NULL);
+	}
+
+	printf("%s delegate, %d iterations\n", dispatched ? "dispatched" : "per slot", iterations);
+	pthread_create(&swhwt,NULL,swhwt_entry,NULL);
+
+	for(i = 0; i < iterations; i++){
+		mbox_put(&mb_a,i);
+		if(mbox_get(&mb_b) != i + 1){
+			fprintf(stderr,"mbox roundtrip %d returned a wrong value\n",i);
+			exit(1);
+		}
+	}
+
+	reconos_hwt_join(&hwt);
+	pthread_join(swhwt,NULL);
+
+	// the same calls as seen by libreconos: time blocked in the OS call
+	// versus time spent on the fsl
+	reconos_cmd_stats_print(0);
+	reconos_state_stats_print(0);
+	reconos_hwt_destroy(&hwt);
+
+	return 0;
+}
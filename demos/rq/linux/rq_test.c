@@ -12,8 +12,10 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
+#include <sys/time.h>
 
 #define MAX_MSG_NUM 512 //12
+#define NUM_MSGS 100
 #define TRUE  1
 #define FALSE 0
 
@@ -31,12 +33,14 @@ int main(int argc, char ** argv)
 	int test_failed = FALSE;
 	int result = 1;
 	uint msg_size, msg_size_rec = MAX_MSG_NUM*sizeof(uint32);
+	struct timeval t_start, t_stop, t_diff;
+	unsigned long us, bytes = 0;
 	assert(argc == 1);
 	srandom( 123456 );
 
 
-	rq_init(&rq_1,10);
-	rq_init(&rq_2,10);
+	rq_init_slab(&rq_1,10,MAX_MSG_NUM*sizeof(uint32));
+	rq_init_slab(&rq_2,10,MAX_MSG_NUM*sizeof(uint32));
 
 	
 	res[0].type = RECONOS_TYPE_RQ;
@@ -52,7 +56,8 @@ int main(int argc, char ** argv)
 	msg2 = malloc(msg_size_rec);
 	
 	
-	for(i=0; i<100; i++)
+	gettimeofday(&t_start, NULL);
+	for(i=0; i<NUM_MSGS; i++)
 	{
 		// create msg1, msg2
 		msg_size = (sizeof(uint32)*( uint32 ) ((random(  ) % MAX_MSG_NUM)+1));
@@ -68,6 +73,7 @@ int main(int argc, char ** argv)
 		}
 		//printf("\n");
 		rq_send (&rq_1, msg1, msg_size);
+		bytes += msg_size;
 		printf("%03d: sent message ... ", i+1);
 		result = rq_receive (&rq_2, msg2, msg_size_rec);
 		printf("received message (%04d bytes): ", result);
@@ -100,6 +106,12 @@ int main(int argc, char ** argv)
 			printf("success\n");
 		free(msg1);
 	}
+	gettimeofday(&t_stop, NULL);
+
+	timersub(&t_stop, &t_start, &t_diff);
+	us = t_diff.tv_sec*1000000 + t_diff.tv_usec;
+	printf("%d messages (%lu bytes) in %lu us: %lu messages/s\n",
+		NUM_MSGS, bytes, us, us ? (unsigned long)((unsigned long long)NUM_MSGS*1000000/us) : 0);
 
 	
 	rq_send (&rq_1, msg2, 0);
@@ -100,10 +100,13 @@ void *sort_thread(void* data)
 void print_mmu_stats()
 {
 	uint32 hits,misses,pgfaults;
+	uint32 prefetched,flushes,fault_us;
 
 	reconos_mmu_stats(&hits,&misses,&pgfaults);
+	reconos_mmu_fault_stats(&prefetched,&flushes,&fault_us);
 
 	printf("MMU stats: TLB hits: %d    TLB misses: %d    page faults: %d\n",hits,misses,pgfaults);
+	printf("           prefetched pages: %d    cache flushes: %d    fault time: %d us\n",prefetched,flushes,fault_us);
 }
 
 
@@ -131,13 +134,15 @@ int main(int argc, char ** argv)
 	int running_threads;
 	int buffer_size;
 	int slice_size;
-	unsigned int *data, *copy;
+	int huge;
+	unsigned int *data, *copy, *jobs;
 
 	timing_t t_start, t_stop;
 	ms_t t_generate;
 	ms_t t_sort;
 	ms_t t_merge;
 	ms_t t_check;
+	uint32 pgfaults_start, pgfaults_sort;
 
 	if ((argc < 4) || (argc > 4))
 	{
@@ -157,8 +162,8 @@ int main(int argc, char ** argv)
 	//int gettimeofday(struct timeval *tv, struct timezone *tz);
 
 	// init mailboxes
-	mbox_init(&mb_start,TO_BLOCKS(buffer_size));
-        mbox_init(&mb_stop ,TO_BLOCKS(buffer_size));
+	mbox_init_mode(&mb_start,TO_BLOCKS(buffer_size),MBOX_MODE_MPMC);
+        mbox_init_mode(&mb_stop ,TO_BLOCKS(buffer_size),MBOX_MODE_MPMC);
 
 	// init reconos and communication resources
 	reconos_init(14,15);
@@ -196,8 +201,10 @@ int main(int argc, char ** argv)
 	t_start = gettime();
 
 	printf("malloc page aligned ...\n");
-	data = malloc_page_aligned(TO_PAGES(buffer_size));
+	data = reconos_buffer_alloc_huge(buffer_size,&huge);
+	printf("data buffer uses %s pages\n", huge ? "4 MB huge" : "4 kB");
 	copy = malloc_page_aligned(TO_PAGES(buffer_size));
+	jobs = malloc(TO_BLOCKS(buffer_size)*sizeof(unsigned int));
 	printf("generate data ...\n");
 	generate_data( data, TO_WORDS(buffer_size));
 	memcpy(copy,data,TO_WORDS(buffer_size)*4);
@@ -211,29 +218,27 @@ int main(int argc, char ** argv)
 
 
 	// Start sort threads
+	reconos_mmu_stats(NULL,NULL,&pgfaults_start);
 	t_start = gettime();
 
-	printf("Putting %i blocks into job queue: ", TO_BLOCKS(buffer_size));
-	fflush(stdout);
+	printf("Putting %i blocks into job queue\n", TO_BLOCKS(buffer_size));
 	for (i=0; i<TO_BLOCKS(buffer_size); i++)
 	{
-	  printf(" %i",i);fflush(stdout);
-	  mbox_put(&mb_start,(unsigned int)data+(i*BLOCK_SIZE));
+	  jobs[i] = (unsigned int)data+(i*BLOCK_SIZE);
 	}
-	printf("\n");
+	mbox_put_many(&mb_start, jobs, TO_BLOCKS(buffer_size));
 
 	// Wait for results
-	printf("Waiting for %i acknowledgements: ", TO_BLOCKS(buffer_size));
-	fflush(stdout);
-	for (i=0; i<TO_BLOCKS(buffer_size); i++)
+	printf("Waiting for %i acknowledgements\n", TO_BLOCKS(buffer_size));
+	for (i=0; i<TO_BLOCKS(buffer_size); )
 	{
-	  printf(" %i",i);fflush(stdout);
-	  ret = mbox_get(&mb_stop);
-	}  
-	printf("\n");
+	  i += mbox_get_many(&mb_stop, jobs, TO_BLOCKS(buffer_size) - i);
+	}
 
 	t_stop = gettime();
 	t_sort = calc_timediff_ms(t_start,t_stop);
+	reconos_mmu_stats(NULL,NULL,&pgfaults_sort);
+	pgfaults_sort -= pgfaults_start;
 
 
 	// merge data
@@ -303,6 +308,7 @@ int main(int argc, char ** argv)
 
 	printf("\n");
 	print_mmu_stats();
+	printf("Page faults while sorting: %d (data buffer is pre-faulted, expected 0)\n",pgfaults_sort);
 	printf( "Running times (size: %d words, %d hw-threads, %d sw-threads):\n"
             "\tGenerate data: %lu ms\n"
             "\tSort data    : %lu ms\n"
@@ -102,10 +102,10 @@ void * ethernet_function(void * data)
 	while (42)
 	{
 		read_frame();
-		cache_flush();
+		cache_flush_range(framebuffer, SIZE_X*SIZE_Y*sizeof(unsigned int));
 		mbox_put( &mb_start_filter_1, ( uint32 ) framebuffer );
 		ret = mbox_get( &mb_done_filtering);
-		cache_flush();
+		cache_flush_range(framebuffer, SIZE_X*SIZE_Y*sizeof(unsigned int));
 		write_frame();
 	}
 	return NULL;
@@ -138,9 +138,9 @@ int main(int argc, char *argv[])
 		result = establish_connection(6666, &image_params);
 	}
 	
-	mbox_init(&mb_start_filter_1,3);
-	mbox_init(&mb_start_filter_2,3);
-	mbox_init(&mb_done_filtering,3);
+	mbox_init_mode(&mb_start_filter_1,3,MBOX_MODE_SPSC);
+	mbox_init_mode(&mb_start_filter_2,3,MBOX_MODE_SPSC);
+	mbox_init_mode(&mb_done_filtering,3,MBOX_MODE_SPSC);
 
 	
 	// create filter sw thread no. 1
@@ -0,0 +1,319 @@
+--------------------------------------------------------------------------------
+-- Measures the sustained read bandwidth of memif_read.
+--
+-- A hardware thread process copies C_LEN bytes from the memory into a local
+-- ram with memif_read, keeping C_OUTSTANDING block requests in flight. The
+-- memory model accepts further requests while earlier ones are still waiting
+-- for their data, answers every read request C_MEM_LATENCY cycles after it has
+-- been received, and returns the data in request order at one word per cycle.
+-- The copied data is checked against the initial contents of memory.vhd, and
+-- the local ram around the copy is checked to be left untouched.
+--
+-- Compare, e.g.:
+--   ghdl -r tb_memif -gC_OUTSTANDING=1
+--   ghdl -r tb_memif -gC_OUTSTANDING=4
+--
+-- Copies not aligned to a block and shorter than a block:
+--   ghdl -r tb_memif -gC_OUTSTANDING=1 -gC_SRC_OFFSET=12 -gC_DST_OFFSET=40 -gC_LEN=8180
+--   ghdl -r tb_memif -gC_OUTSTANDING=4 -gC_SRC_OFFSET=12 -gC_DST_OFFSET=40 -gC_LEN=8180
+--   ghdl -r tb_memif -gC_OUTSTANDING=1 -gC_SRC_OFFSET=12 -gC_LEN=20
+--   ghdl -r tb_memif -gC_OUTSTANDING=4 -gC_SRC_OFFSET=12 -gC_LEN=20
+--   ghdl -r tb_memif -gC_OUTSTANDING=4 -gC_LEN=4
+--------------------------------------------------------------------------------
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.std_logic_arith.all;
+use ieee.std_logic_unsigned.all;
+
+library reconos_v3_00_a;
+use reconos_v3_00_a.reconos_pkg.all;
+
+LIBRARY fifo32_v1_00_a;
+USE fifo32_v1_00_a.ALL;
+
+entity tb_memif is
+	generic (
+		C_MEM_LATENCY : integer := 32;   -- cycles from receiving a read request until its first word
+		C_OUTSTANDING : integer := C_MEMIF_MAX_OUTSTANDING;
+		C_SRC_OFFSET  : integer := 0;    -- bytes, multiple of 4
+		C_DST_OFFSET  : integer := 0;    -- bytes, multiple of 4
+		C_LEN         : integer := 8192  -- bytes, multiple of 4; offset plus length at most the 16 KB of memory.vhd
+	);
+end tb_memif;
+
+architecture behavior of tb_memif is
+
+	constant clk_period : time := 10 ns;
+	constant C_MEM_SIZE : integer := 4*1024; -- words, see memory.vhd
+
+	-- HWT2MEM FIFO32
+	signal FIFO32_M_Data : std_logic_vector(31 downto 0);
+	signal FIFO32_M_Rem  : std_logic_vector(15 downto 0);
+	signal FIFO32_M_Wr   : std_logic;
+
+	-- MEM2HWT FIFO32
+	signal FIFO32_S_Data : std_logic_vector(31 downto 0);
+	signal FIFO32_S_Fill : std_logic_vector(15 downto 0);
+	signal FIFO32_S_Rd   : std_logic;
+
+	signal FIFO32_S_Clk : std_logic;
+	signal FIFO32_M_Clk : std_logic;
+
+	-- Memory
+	signal MEM_M_Data : std_logic_vector(31 downto 0);
+	signal MEM_M_Rem  : std_logic_vector(15 downto 0);
+	signal MEM_M_Wr   : std_logic;
+
+	signal MEM_S_Data : std_logic_vector(31 downto 0);
+	signal MEM_S_Fill : std_logic_vector(15 downto 0);
+	signal MEM_S_Rd   : std_logic;
+
+	signal clk : std_logic := '0';
+	signal rst : std_logic := '0';
+
+	signal ram_addr : std_logic_vector(31 downto 0);
+	signal ram_di   : std_logic_vector(31 downto 0);
+	signal ram_do   : std_logic_vector(31 downto 0);
+
+	-- read requests waiting for their data
+	constant C_QUEUE_SIZE : integer := 16;
+	type QUEUE_T is array (0 to C_QUEUE_SIZE-1) of std_logic_vector(31 downto 0);
+	type READY_T is array (0 to C_QUEUE_SIZE-1) of natural;
+	signal q_addr  : QUEUE_T;
+	signal q_len   : QUEUE_T;
+	signal q_ready : READY_T;
+	signal q_head  : integer range 0 to C_QUEUE_SIZE-1;
+	signal q_tail  : integer range 0 to C_QUEUE_SIZE-1;
+
+	type MEMSTATE_T is (MEMSTATE_IDLE, MEMSTATE_READ_CMD, MEMSTATE_READ_ADDR);
+	signal memstate : MEMSTATE_T;
+	signal cmd      : std_logic_vector(31 downto 0);
+
+	signal streaming  : std_logic;
+	signal stream_len : std_logic_vector(21 downto 0);
+
+	-- hardware thread
+	signal i_memif : i_memif_t;
+	signal o_memif : o_memif_t;
+	signal i_ram   : i_ram_t;
+	signal o_ram   : o_ram_t;
+
+	signal local_addr : std_logic_vector(31 downto 0);
+	signal local_di   : std_logic_vector(31 downto 0);
+	signal local_do   : std_logic_vector(31 downto 0);
+	signal local_we   : std_logic;
+
+	type LOCAL_RAM_T is array (0 to C_MEM_SIZE-1) of std_logic_vector(31 downto 0);
+	signal local_ram : LOCAL_RAM_T := (others => (others => '0'));
+
+	type HWTSTATE_T is (HWTSTATE_READ, HWTSTATE_DONE);
+	signal hwtstate : HWTSTATE_T;
+
+	signal cycle : natural;
+	signal stop  : natural;
+
+begin
+
+	fifo32_a : entity fifo32_v1_00_a.fifo32
+	generic map (
+		C_FIFO32_DEPTH => 1024
+	)
+	port map (
+		Rst => Rst,
+		FIFO32_S_Clk => clk,
+		FIFO32_S_Data => MEM_S_Data,
+		FIFO32_S_Rd => MEM_S_Rd,
+		FIFO32_S_Fill => MEM_S_Fill,
+		FIFO32_M_Clk => clk,
+		FIFO32_M_Data => FIFO32_M_Data,
+		FIFO32_M_Wr => FIFO32_M_Wr,
+		FIFO32_M_Rem => FIFO32_M_Rem
+	);
+
+	fifo32_b : entity fifo32_v1_00_a.fifo32
+	generic map (
+		C_FIFO32_DEPTH => 1024
+	)
+	port map (
+		Rst => Rst,
+		FIFO32_S_Clk => clk,
+		FIFO32_S_Data => FIFO32_S_Data,
+		FIFO32_S_Rd => FIFO32_S_Rd,
+		FIFO32_S_Fill => FIFO32_S_Fill,
+		FIFO32_M_Clk => clk,
+		FIFO32_M_Data => MEM_M_Data,
+		FIFO32_M_Wr => MEM_M_Wr,
+		FIFO32_M_Rem => MEM_M_Rem
+	);
+
+	mem_i : entity work.memory
+	port map (
+		clk  => clk,
+		rst  => rst,
+		addr => ram_addr,
+		di   => ram_di,
+		do   => ram_do,
+		we   => '0'
+	);
+
+	ram_di <= (others => '0');
+
+	-- split-transaction memory: the request decoder queues read requests,
+	-- the data of the oldest one is returned once its latency has passed.
+	memfifo_proc : process(clk,rst)
+	begin
+		if rst = '1' then
+			memstate  <= MEMSTATE_IDLE;
+			q_head    <= 0;
+			q_tail    <= 0;
+			streaming <= '0';
+			ram_addr  <= (others => '0');
+			MEM_S_Rd  <= '0';
+			MEM_M_Wr  <= '0';
+		elsif rising_edge(clk) then
+			MEM_S_Rd <= '0';
+			MEM_M_Wr <= '0';
+
+			case memstate is
+				when MEMSTATE_IDLE =>
+					if 1 < MEM_S_Fill then
+						MEM_S_Rd <= '1';
+						memstate <= MEMSTATE_READ_CMD;
+					end if;
+
+				when MEMSTATE_READ_CMD =>
+					cmd <= MEM_S_Data;
+					MEM_S_Rd <= '1';
+					memstate <= MEMSTATE_READ_ADDR;
+
+				when MEMSTATE_READ_ADDR =>
+					assert cmd(31) = '0' report "tb_memif only serves reads" severity failure;
+					q_addr(q_tail)  <= "00" & MEM_S_Data(31 downto 2);
+					q_len(q_tail)   <= "0000000000" & cmd(23 downto 2);
+					q_ready(q_tail) <= cycle + C_MEM_LATENCY;
+					q_tail <= (q_tail + 1) mod C_QUEUE_SIZE;
+					memstate <= MEMSTATE_IDLE;
+			end case;
+
+			if streaming = '0' then
+				if q_head /= q_tail and cycle >= q_ready(q_head) then
+					ram_addr   <= q_addr(q_head);
+					stream_len <= q_len(q_head)(21 downto 0);
+					streaming  <= '1';
+				end if;
+			elsif MEM_M_Rem > 0 then
+				MEM_M_Wr   <= '1';
+				MEM_M_Data <= ram_do;
+				ram_addr   <= ram_addr + 1;
+				stream_len <= stream_len - 1;
+				if stream_len = 1 then
+					q_head    <= (q_head + 1) mod C_QUEUE_SIZE;
+					streaming <= '0';
+				end if;
+			end if;
+		end if;
+	end process;
+
+	memif_setup(
+		i_memif,
+		o_memif,
+		clk,
+		FIFO32_S_Clk,
+		FIFO32_S_Data,
+		FIFO32_S_Fill,
+		FIFO32_S_Rd,
+		FIFO32_M_Clk,
+		FIFO32_M_Data,
+		FIFO32_M_Rem,
+		FIFO32_M_Wr
+	);
+
+	ram_setup(
+		i_ram,
+		o_ram,
+		local_addr,
+		local_di,
+		local_do,
+		local_we
+	);
+
+	local_ram_proc : process(clk)
+	begin
+		if rising_edge(clk) then
+			if local_we = '1' then
+				local_ram(CONV_INTEGER(local_addr(11 downto 0))) <= local_di;
+			end if;
+			local_do <= local_ram(CONV_INTEGER(local_addr(11 downto 0)));
+		end if;
+	end process;
+
+	hwt_proc : process(clk,rst)
+		variable done : boolean;
+	begin
+		if rst = '1' then
+			memif_reset(o_memif);
+			ram_reset(o_ram);
+			hwtstate <= HWTSTATE_READ;
+			done := False;
+		elsif rising_edge(clk) then
+			case hwtstate is
+				when HWTSTATE_READ =>
+					memif_read(i_ram,o_ram,i_memif,o_memif,
+					           CONV_STD_LOGIC_VECTOR(C_SRC_OFFSET,32),CONV_STD_LOGIC_VECTOR(C_DST_OFFSET,32),
+					           CONV_STD_LOGIC_VECTOR(C_LEN,24),done,C_OUTSTANDING);
+					if done then
+						stop <= cycle;
+						hwtstate <= HWTSTATE_DONE;
+					end if;
+
+				when HWTSTATE_DONE =>
+					null;
+			end case;
+		end if;
+	end process;
+
+	cycle_proc : process(clk,rst)
+	begin
+		if rst = '1' then
+			cycle <= 0;
+		elsif rising_edge(clk) then
+			cycle <= cycle + 1;
+		end if;
+	end process;
+
+	clk <= not clk after clk_period/2 when hwtstate /= HWTSTATE_DONE else '0';
+
+	stim_proc : process
+		variable errors  : natural;
+		variable overrun : natural;
+		variable bpc     : natural;
+	begin
+		rst <= '1';
+		wait for 105 ns;
+		rst <= '0';
+
+		wait until hwtstate = HWTSTATE_DONE;
+
+		errors := 0;
+		overrun := 0;
+		for i in 0 to C_MEM_SIZE-1 loop
+			if i < C_DST_OFFSET/4 or i >= (C_DST_OFFSET + C_LEN)/4 then
+				if local_ram(i) /= x"00000000" then
+					overrun := overrun + 1;
+				end if;
+			elsif local_ram(i) /= x"DA" & CONV_STD_LOGIC_VECTOR(C_MEM_SIZE-1 - (i + (C_SRC_OFFSET - C_DST_OFFSET)/4),24) then
+				errors := errors + 1;
+			end if;
+		end loop;
+		assert errors = 0 report integer'image(errors) & " words copied wrong" severity error;
+		assert overrun = 0 report integer'image(overrun) & " words written outside of the copy" severity error;
+
+		bpc := (C_LEN*100)/stop;
+		report integer'image(C_OUTSTANDING) & " outstanding, latency " & integer'image(C_MEM_LATENCY)
+			& ": " & integer'image(C_LEN) & " bytes in " & integer'image(stop) & " cycles, "
+			& integer'image(bpc/100) & "." & integer'image((bpc mod 100)/10) & integer'image(bpc mod 10)
+			& " bytes per cycle";
+		wait;
+	end process;
+
+end behavior;
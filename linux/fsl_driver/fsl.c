@@ -30,6 +30,13 @@
 #include <linux/cdev.h>
 #include <linux/module.h>
 #include <linux/ioctl.h>
+#include <linux/poll.h>
+#include <linux/spinlock.h>
+#include <linux/timer.h>
+#include <linux/mm.h>
+#include <linux/kfifo.h>
+#include <linux/device.h>
+#include <asm/io.h>
 #include <asm/uaccess.h>
 
 #include <linux/of_device.h>
@@ -45,6 +52,11 @@ static int fsl_interrupts[16] = { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
 module_param_array(fsl_interrupts, int, NULL, S_IRUGO | S_IWUSR);
 MODULE_PARM_DESC(fsl_interrupts, "Array of all FSL interrupts in use (FSL0 to FSL15). Set to -1 for unused FSLs.");
 
+static int fsl_rx_fifo_words = 256;
+
+module_param(fsl_rx_fifo_words, int, S_IRUGO);
+MODULE_PARM_DESC(fsl_rx_fifo_words, "Size of the receive buffer of each FSL in words (rounded up to a power of two).");
+
 /* Write a single word to FSL interface (non-blocking):                                                 *
  *                                                                                                      *
  *     id : FSL id, there are up to 16 FSLs on the microblaze, each with a master and a slave interface *
@@ -107,6 +119,9 @@ static int ngetfsl(int id, int *val){
 }
 
 #define FSL_MAX 16
+#define FSL_BURST_WORDS 32   // words per copy_to_user/copy_from_user chunk
+#define FSL_SPIN_MIN 16      // bounds of the adaptive spin budget of fsl_put_spin
+#define FSL_SPIN_MAX 1024
 
 int fsl_major = 0;
 int fsl_minor = 0;
@@ -115,6 +130,23 @@ int fsl_count = FSL_MAX;
 #define FSL_IOC_MAGIC 'k'
 #define FSL_IOCWRITE _IOW(FSL_IOC_MAGIC,0xF0,int)
 #define FSL_IOCREAD  _IOR(FSL_IOC_MAGIC,0xF1,int)
+#define FSL_IOCWAIT  _IO(FSL_IOC_MAGIC,0xF2)      // wait until the rx ring is not empty
+
+#define FSL_RING_ORDER 1                          // header page + data page
+#define FSL_RING_WORDS (PAGE_SIZE/4)
+
+// Receive ring that can be mapped into userspace. The first page holds this
+// header, the second page the data words. The driver fills the ring from the
+// interrupt handler and advances head, the reader consumes the words in place
+// and advances tail. Ring mode is entered with the first mmap of the device.
+// Userspace can write the whole header, so the driver keeps its own head and
+// only publishes a copy here; the only field it reads back is tail, see
+// fsl_ring_tail.
+struct fsl_ring {
+	volatile u32 head;                      // copy of fsl_dev.ring_head
+	volatile u32 tail;                      // next word to be read by userspace
+	u32 size;                               // FSL_RING_WORDS, for userspace
+};
 
 
 struct fsl_dev {
@@ -125,12 +157,189 @@ struct fsl_dev {
 	int irq_enabled;
 	//struct semaphore sem;                 // mutual exclusion semaphore
 	wait_queue_head_t read_queue;           // queue for blocking reads
-	volatile unsigned short irq_count;      // number of occurred interrupts, should never exceed 1!
+	wait_queue_head_t write_queue;          // queue for writers waiting for the tx stash to drain
+	spinlock_t lock;                        // protects everything below, the FIFO accesses and irq_enabled
+	unsigned long irq_count;                // number of occurred interrupts
+	struct kfifo rx_fifo;                   // words drained from the FIFO by the interrupt handler
+	unsigned int rx_max_depth;              // highest fill level of rx_fifo in words
+	unsigned long rx_overflows;             // number of times rx_fifo was full and the IRQ had to be masked
+	int tx_stash;                           // word that did not fit into the FIFO
+	int tx_pending;
+	struct timer_list tx_timer;             // retries tx_stash, there is no "FIFO has space" IRQ
+	struct fasync_struct *async_queue;      // processes that want SIGIO
+	int spin_limit;                         // current spin budget for writes to a full FIFO
+	struct fsl_ring *ring;                  // rx ring, see struct fsl_ring
+	u32 *ring_data;
+	u32 ring_head;                          // next word to be written into the ring
+	int ring_active;                        // set once the ring has been mapped
 	struct cdev cdev;                       // characted device structure
 };
 
 struct fsl_dev dev_array[FSL_MAX];
 
+static struct class *fsl_class;
+
+
+// Returns the tail written by userspace, clamped to the words that can
+// actually be in the ring: a tail beyond head reads as an empty ring, one more
+// than FSL_RING_WORDS behind head as a full one.
+static u32 fsl_ring_tail(struct fsl_dev *dev)
+{
+	u32 tail = dev->ring->tail;
+	
+	if((s32)(dev->ring_head - tail) < 0) return dev->ring_head;
+	if(dev->ring_head - tail > FSL_RING_WORDS) return dev->ring_head - FSL_RING_WORDS;
+	return tail;
+}
+
+// Move words from the hardware FIFO into the rx ring. Words that were
+// buffered in rx_fifo before the ring was mapped go first.
+// Must be called with dev->lock held.
+// returns 1 if the ring is full, i.e. the FIFO may still hold data
+static int fsl_ring_fill(struct fsl_dev *dev)
+{
+	u32 tail = fsl_ring_tail(dev);
+	int val;
+	
+	while(dev->ring_head - tail < FSL_RING_WORDS){
+		if(kfifo_out(&dev->rx_fifo, &val, 4) != 4 && ngetfsl(dev->fsl_num, &val)) return 0;
+		dev->ring_data[dev->ring_head & (FSL_RING_WORDS - 1)] = val;
+		smp_wmb();
+		dev->ring->head = ++dev->ring_head;
+	}
+	
+	return 1;
+}
+
+// Move words from the hardware FIFO into rx_fifo. Must be called with dev->lock held.
+// returns 1 if rx_fifo is full, i.e. the FIFO may still hold data
+static int fsl_fifo_fill(struct fsl_dev *dev)
+{
+	int val;
+	
+	while(kfifo_avail(&dev->rx_fifo) >= 4){
+		if(ngetfsl(dev->fsl_num, &val)) return 0;
+		kfifo_in(&dev->rx_fifo, &val, 4);
+		dev->rx_max_depth = MAX(dev->rx_max_depth, kfifo_len(&dev->rx_fifo)/4);
+	}
+	
+	return 1;
+}
+
+// Drain the hardware FIFO into the software buffer (ring or rx_fifo). If the
+// FIFO has been emptied, the active high interrupt line is low again and the
+// IRQ is unmasked. Must be called with dev->lock held.
+// returns 1 if the software buffer is full
+static int fsl_rx_drain(struct fsl_dev *dev)
+{
+	int full;
+	
+	full = dev->ring_active ? fsl_ring_fill(dev) : fsl_fifo_fill(dev);
+	if(!full && !dev->irq_enabled){
+		dev->irq_enabled = 1;
+		enable_irq(dev->irq);
+	}
+	
+	return full;
+}
+
+// returns 1 if data is available in the software buffer
+static int fsl_rx_ready(struct fsl_dev *dev)
+{
+	if(dev->ring_active){
+		return dev->ring_head != fsl_ring_tail(dev);
+	}
+	return !kfifo_is_empty(&dev->rx_fifo);
+}
+
+// Get up to 'count' words from the software buffer.
+// returns the number of words copied to buf
+static int fsl_rx_get(struct fsl_dev *dev, int *buf, int count)
+{
+	unsigned long flags;
+	u32 tail;
+	int n = 0;
+	
+	spin_lock_irqsave(&dev->lock, flags);
+	if(!fsl_rx_ready(dev)) fsl_rx_drain(dev);
+	if(dev->ring_active){
+		smp_rmb();
+		tail = fsl_ring_tail(dev);
+		while(n < count && dev->ring_head != tail){
+			buf[n++] = dev->ring_data[tail & (FSL_RING_WORDS - 1)];
+			tail++;
+		}
+		dev->ring->tail = tail;
+	} else {
+		n = kfifo_out(&dev->rx_fifo, buf, 4*count)/4;
+	}
+	// make room for words still waiting in the hardware FIFO
+	if(n > 0) fsl_rx_drain(dev);
+	spin_unlock_irqrestore(&dev->lock, flags);
+	
+	return n;
+}
+
+// Try to move the stashed word into the FIFO. Must be called with dev->lock held.
+// returns 1 if the word is still pending
+static int fsl_tx_flush(struct fsl_dev *dev)
+{
+	if(dev->tx_pending && !nputfsl(dev->fsl_num, dev->tx_stash)){
+		dev->tx_pending = 0;
+	}
+	return dev->tx_pending;
+}
+
+// Write a word to the FSL. The tx stash is written first to keep the word order.
+// If the FIFO is full, retry for up to spin_limit iterations before giving up.
+// The budget grows when spinning paid off and shrinks when it did not, so that
+// a hardware thread that drains its FIFO quickly is not put to sleep while
+// a stalled one does not waste CPU time.
+// returns 0 if ok, 1 when the FIFO is still full
+static int fsl_put_spin(struct fsl_dev *dev, int val)
+{
+	unsigned long flags;
+	int invalid = 1;
+	int k;
+	
+	for(k = 0; k <= dev->spin_limit; k++){
+		spin_lock_irqsave(&dev->lock, flags);
+		invalid = fsl_tx_flush(dev) || nputfsl(dev->fsl_num, val);
+		spin_unlock_irqrestore(&dev->lock, flags);
+		if(!invalid) break;
+		cpu_relax();
+	}
+	
+	if(invalid){
+		dev->spin_limit = MAX(dev->spin_limit/2, FSL_SPIN_MIN);
+	} else if(k > 0){
+		dev->spin_limit = MIN(dev->spin_limit*2, FSL_SPIN_MAX);
+	}
+	
+	return invalid;
+}
+
+// Polls the FIFO every jiffy while a word is stashed and wakes up
+// writers and pollers once it has been written.
+static void fsl_tx_timer(unsigned long data)
+{
+	struct fsl_dev *dev = (struct fsl_dev *)data;
+	unsigned long flags;
+	int pending;
+	
+	spin_lock_irqsave(&dev->lock, flags);
+	pending = fsl_tx_flush(dev);
+	spin_unlock_irqrestore(&dev->lock, flags);
+	
+	if(pending){
+		mod_timer(&dev->tx_timer, jiffies + 1);
+		return;
+	}
+	
+	wake_up_interruptible(&dev->write_queue);
+	kill_fasync(&dev->async_queue, SIGIO, POLL_OUT);
+}
+
 
 ///
 /// Open FSL device.
@@ -147,9 +356,9 @@ int fsl_open(struct inode *inode, struct file *filp)
 	
 	PDEBUG("opening FSL %d\n", dev->fsl_num);
 	
-	// report any unhandled IRQs in the meantime
-	if (dev->irq_count > 0) {
-		PDEBUG("osif: there have been %d unhandled IRQs\n", dev->irq_count);
+	// report any data received in the meantime
+	if (!kfifo_is_empty(&dev->rx_fifo)) {
+		PDEBUG("osif: there are %d unread words\n", kfifo_len(&dev->rx_fifo)/4);
 	}
 	
 	// TODO: Reset OSIF and hardware thread?
@@ -158,20 +367,30 @@ int fsl_open(struct inode *inode, struct file *filp)
 	return 0;          // success
 }
 
+/// Register for SIGIO.
+static int fsl_fasync(int fd, struct file *filp, int mode)
+{
+	struct fsl_dev *dev = filp->private_data;
+	
+	return fasync_helper(fd, filp, mode, &dev->async_queue);
+}
+
 /// Close FSL device.
 int fsl_release(struct inode *inode, struct file *filp) {
 	
 	PDEBUG("closing FSL %d\n", ((struct fsl_dev*)(filp->private_data))->fsl_num);
+	fsl_fasync(-1, filp, 0);
 	return 0;
 }
 
 // This function performs a read on an FSL slave interface.
+// Words are taken from the software buffer the interrupt handler drains the
+// FIFO into, and copied to user space in chunks of up to FSL_BURST_WORDS words.
 ssize_t fsl_read(struct file *filp, char __user *buf, size_t count, loff_t *f_pos) {
 	struct fsl_dev *dev = filp->private_data;
+	int kbuf[FSL_BURST_WORDS];
 	int num_words;
-	int i;
-	int invalid;
-	int data;
+	int i, n;
 	
 	if(count % 4 != 0){
 		PDEBUG("ERROR trying to read %d bytes from FSL%d\n: access must be word aligned",count,dev->fsl_num);
@@ -181,35 +400,30 @@ ssize_t fsl_read(struct file *filp, char __user *buf, size_t count, loff_t *f_po
 		PDEBUG("trying to read %d words from FSL%d\n",num_words,dev->fsl_num);
 	}
 	
-	for(i = 0; i < num_words; i++){
-
-		invalid = ngetfsl(dev->fsl_num,&data);
+	i = 0; // words already copied to user space
+	while(i < num_words){
 		
-		// no data available:
-		if(invalid){
-			dev->irq_count = 0; // FIXME: this is not thread save
-			// handle non-blocking read
-			if(filp->f_flags & O_NONBLOCK) { 
-				return i*4;
-			}
-			
-			if(!dev->irq_enabled){
-				dev->irq_enabled = 1;
-				enable_irq(dev->irq);
-			}
-			
-			// handle blocking read
-			if (wait_event_interruptible(dev->read_queue, (dev->irq_count > 0))){
-				return -ERESTARTSYS;
+		n = fsl_rx_get(dev, kbuf, MIN(num_words - i, FSL_BURST_WORDS));
+		
+		if(n > 0){
+			if(copy_to_user(buf + 4*i, kbuf, 4*n)){
+				return -EFAULT;
 			}
-			
-			// repeat this loop iteration:
-			i--;
+			i += n;
 			continue;
 		}
 		
-		if(copy_to_user(buf + 4*i, &data, 4)){
-			return -EFAULT;
+		// no data available:
+		
+		// handle non-blocking read
+		if(filp->f_flags & O_NONBLOCK) { 
+			return i > 0 ? i*4 : -EAGAIN;
+		}
+		
+		// handle blocking read
+		if (wait_event_interruptible(dev->read_queue, fsl_rx_ready(dev))){
+			// words already consumed from the FIFO must not get lost
+			return i > 0 ? i*4 : -ERESTARTSYS;
 		}
 	}
 	
@@ -217,13 +431,18 @@ ssize_t fsl_read(struct file *filp, char __user *buf, size_t count, loff_t *f_po
 }
 
 // Write to FSL
-// currently this never blocks
+// If the FIFO stays full after spinning, the word is kept in the tx stash and
+// written by the tx timer as soon as there is space. Blocking writers sleep
+// until the stash has drained and then continue, so all words are written.
+// Non-blocking writers return after the stashed word; if the stash is still
+// occupied by an earlier word, they get -EAGAIN.
 ssize_t fsl_write(struct file *filp, const char __user *buf, size_t count, loff_t *f_pos) {
 	struct fsl_dev *dev = filp->private_data;
-	int data;
-	int invalid;
+	int kbuf[FSL_BURST_WORDS];
+	unsigned long flags;
+	int stashed;
 	int num_words;
-	int i;
+	int i, j, n;
 	
 	if(count % 4 != 0){
 		PDEBUG("ERROR trying to write %d bytes to FSL%d\n: access must be word aligned",count,dev->fsl_num);
@@ -236,28 +455,80 @@ ssize_t fsl_write(struct file *filp, const char __user *buf, size_t count, loff_
 	
 	if(num_words == 0) return 0;
 	
-	
-	for(i = 0; i < num_words; i++){
-		if (copy_from_user(&data, buf + 4*i, 4)){
-			return -EFAULT;
+	for(i = 0; i < num_words; i += n){
+		n = MIN(num_words - i, FSL_BURST_WORDS);
+		if (copy_from_user(kbuf, buf + 4*i, 4*n)){
+			return i > 0 ? 4*i : -EFAULT;
 		}
 		
-		invalid = nputfsl(dev->fsl_num,data);
-		
-		// no space available:
-		if(invalid){
-			printk( KERN_WARNING "fsl.ko: WARNING: No space left in FSL%d\n",dev->fsl_num);
-			// handle blocking and non-blocking write:
-			return 4*i;
+		for(j = 0; j < n; j++){
+			if(!fsl_put_spin(dev, kbuf[j])) continue;
+			
+			// no space available: hand the word over to the tx timer
+			spin_lock_irqsave(&dev->lock, flags);
+			stashed = !dev->tx_pending;
+			if(stashed){
+				dev->tx_stash = kbuf[j];
+				dev->tx_pending = 1;
+			}
+			spin_unlock_irqrestore(&dev->lock, flags);
+			mod_timer(&dev->tx_timer, jiffies + 1);
+			
+			// handle non-blocking write
+			if(filp->f_flags & O_NONBLOCK){
+				if(stashed) return 4*(i + j + 1);
+				return i + j > 0 ? 4*(i + j) : -EAGAIN;
+			}
+			
+			// handle blocking write
+			if(wait_event_interruptible(dev->write_queue, !dev->tx_pending)){
+				if(stashed) return 4*(i + j + 1);
+				return i + j > 0 ? 4*(i + j) : -ERESTARTSYS;
+			}
+			
+			// the stash was occupied by an earlier word, retry this one
+			if(!stashed) j--;
 		}
 	}
 	
 	return count;
 }
 
+// Poll FSL
+// The slave interface is readable if the software buffer holds data. The
+// FIFO is drained first, which also unmasks the IRQ to wake up the poller. The master interface is writable
+// as long as the tx stash is empty.
+unsigned int fsl_poll(struct file *filp, poll_table *wait)
+{
+	struct fsl_dev *dev = filp->private_data;
+	unsigned int mask = 0;
+	unsigned long flags;
+	int tx_pending;
+	
+	poll_wait(filp, &dev->read_queue, wait);
+	poll_wait(filp, &dev->write_queue, wait);
+	
+	spin_lock_irqsave(&dev->lock, flags);
+	fsl_rx_drain(dev);
+	if(fsl_rx_ready(dev)){
+		mask |= POLLIN | POLLRDNORM;
+	}
+	tx_pending = fsl_tx_flush(dev);
+	spin_unlock_irqrestore(&dev->lock, flags);
+	
+	if(tx_pending){
+		mod_timer(&dev->tx_timer, jiffies + 1);
+	} else {
+		mask |= POLLOUT | POLLWRNORM;
+	}
+	
+	return mask;
+}
+
 long fsl_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 {
 	int result = 0;
+	unsigned long flags;
 	struct fsl_dev *dev = filp->private_data;
 	switch(cmd){
 		case FSL_IOCWRITE:
@@ -266,28 +537,69 @@ long fsl_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 		case FSL_IOCREAD:
 			ngetfsl(dev->fsl_num,&result);
 			return result;
+		case FSL_IOCWAIT:
+			if(!dev->ring_active) return -EINVAL;
+			spin_lock_irqsave(&dev->lock, flags);
+			fsl_rx_drain(dev);
+			spin_unlock_irqrestore(&dev->lock, flags);
+			if(wait_event_interruptible(dev->read_queue, fsl_rx_ready(dev))){
+				return -ERESTARTSYS;
+			}
+			return 0;
 	}
 	return -ENOTTY;
 }
 
+// Map the rx ring into userspace
+static int fsl_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	struct fsl_dev *dev = filp->private_data;
+	unsigned long size = vma->vm_end - vma->vm_start;
+	unsigned long flags;
+	
+	if(vma->vm_pgoff != 0 || size > (PAGE_SIZE << FSL_RING_ORDER)){
+		return -EINVAL;
+	}
+	
+	if(remap_pfn_range(vma, vma->vm_start, virt_to_phys(dev->ring) >> PAGE_SHIFT,
+			size, vma->vm_page_prot)){
+		return -EAGAIN;
+	}
+	
+	spin_lock_irqsave(&dev->lock, flags);
+	if(!dev->ring_active){
+		// fsl_ring_fill moves the words buffered in rx_fifo over first
+		dev->ring_active = 1;
+		fsl_rx_drain(dev);
+	}
+	spin_unlock_irqrestore(&dev->lock, flags);
+	
+	return 0;
+}
+
 // Interrupt handler
 irqreturn_t fsl_interrupt(int irq, void *dev_id)
 {	
 	struct fsl_dev *dev = dev_id;
 	
-	// increment IRQ counter
-	dev->irq_count++;
-	
-	// TODO: handle concurrency!
-	
 	PDEBUG("IRQ:%d\n",irq);
 	
+	// move the data out of the FIFO right away, so that the hardware thread
+	// does not stall while the reader is not scheduled. once the FIFO is
+	// empty, the interrupt line is low again and the IRQ can stay enabled.
+	spin_lock(&dev->lock);
+	dev->irq_count++;
+	if(fsl_rx_drain(dev)){
+		// since interrupt is active high, we must suppress it until there is room again
+		dev->rx_overflows++;
+		disable_irq_nosync(irq);
+		dev->irq_enabled = 0;
+	}
+	spin_unlock(&dev->lock);
+	
 	// wake up blocking processes
 	wake_up_interruptible(&dev->read_queue);
-	
-	disable_irq_nosync(irq); // since interrupt is active high, we must suppress it until all data is read
-	dev->irq_enabled = 0;
-	
+	kill_fasync(&dev->async_queue, SIGIO, POLL_IN);
 	
 	return IRQ_HANDLED;
 }
@@ -298,23 +610,117 @@ static struct file_operations fsl_fops = {
 	.unlocked_ioctl  = fsl_ioctl,
 	.read = fsl_read,
 	.write = fsl_write,
+	.poll = fsl_poll,
+	.fasync = fsl_fasync,
+	.mmap = fsl_mmap,
 	.open = fsl_open,
 	.release = fsl_release
 };
 
 
+/// Free the rx ring
+static void fsl_free_ring(struct fsl_dev *dev)
+{
+	int i;
+	
+	for (i = 0; i < (1 << FSL_RING_ORDER); i++) {
+		ClearPageReserved(virt_to_page((char *)dev->ring + i*PAGE_SIZE));
+	}
+	free_pages((unsigned long)dev->ring, FSL_RING_ORDER);
+	dev->ring = NULL;
+}
+
+// sysfs attributes, /sys/class/fsl/fslN/...
+static ssize_t fsl_show_rx_fifo_size(struct device *d, struct device_attribute *attr, char *buf)
+{
+	struct fsl_dev *dev = dev_get_drvdata(d);
+	return sprintf(buf, "%u\n", kfifo_size(&dev->rx_fifo)/4);
+}
+
+static ssize_t fsl_show_rx_depth(struct device *d, struct device_attribute *attr, char *buf)
+{
+	struct fsl_dev *dev = dev_get_drvdata(d);
+	if(dev->ring_active){
+		return sprintf(buf, "%u\n", dev->ring_head - fsl_ring_tail(dev));
+	}
+	return sprintf(buf, "%u\n", kfifo_len(&dev->rx_fifo)/4);
+}
+
+static ssize_t fsl_show_rx_max_depth(struct device *d, struct device_attribute *attr, char *buf)
+{
+	struct fsl_dev *dev = dev_get_drvdata(d);
+	return sprintf(buf, "%u\n", dev->rx_max_depth);
+}
+
+static ssize_t fsl_show_rx_overflows(struct device *d, struct device_attribute *attr, char *buf)
+{
+	struct fsl_dev *dev = dev_get_drvdata(d);
+	return sprintf(buf, "%lu\n", dev->rx_overflows);
+}
+
+static ssize_t fsl_show_irq_count(struct device *d, struct device_attribute *attr, char *buf)
+{
+	struct fsl_dev *dev = dev_get_drvdata(d);
+	return sprintf(buf, "%lu\n", dev->irq_count);
+}
+
+static struct device_attribute fsl_attrs[] = {
+	__ATTR(rx_fifo_size, S_IRUGO, fsl_show_rx_fifo_size, NULL),
+	__ATTR(rx_depth, S_IRUGO, fsl_show_rx_depth, NULL),
+	__ATTR(rx_max_depth, S_IRUGO, fsl_show_rx_max_depth, NULL),
+	__ATTR(rx_overflows, S_IRUGO, fsl_show_rx_overflows, NULL),
+	__ATTR(irq_count, S_IRUGO, fsl_show_irq_count, NULL),
+};
+
 /// Set up device
 static void fsl_setup_dev(struct fsl_dev *dev, int index)
 {
-	int err, devno;
+	struct device *sysdev;
+	int err, devno, i;
 	
 	dev->irq = fsl_interrupts[index];
 	
 	if(dev->irq == -1) return;
 	
+	dev->fsl_num = index;
+	init_waitqueue_head(&dev->read_queue);
+	init_waitqueue_head(&dev->write_queue);
+	spin_lock_init(&dev->lock);
+	setup_timer(&dev->tx_timer, fsl_tx_timer, (unsigned long)dev);
+	dev->irq_count = 0;
+	dev->rx_max_depth = 0;
+	dev->rx_overflows = 0;
+	dev->tx_pending = 0;
+	dev->async_queue = NULL;
+	dev->spin_limit = FSL_SPIN_MIN;
+	dev->irq_enabled = 1;
+	
+	if (kfifo_alloc(&dev->rx_fifo, 4*fsl_rx_fifo_words, GFP_KERNEL)) {
+		printk(KERN_WARNING "fsl: can't allocate rx buffer for fsl%d\n", index);
+		dev->irq = -1;
+		return;
+	}
+	
+	dev->ring_active = 0;
+	dev->ring = (struct fsl_ring *)__get_free_pages(GFP_KERNEL | __GFP_ZERO, FSL_RING_ORDER);
+	if (!dev->ring) {
+		printk(KERN_WARNING "fsl: can't allocate rx ring for fsl%d\n", index);
+		kfifo_free(&dev->rx_fifo);
+		dev->irq = -1;
+		return;
+	}
+	dev->ring->size = FSL_RING_WORDS;
+	dev->ring_head = 0;
+	dev->ring_data = (u32 *)((char *)dev->ring + PAGE_SIZE);
+	for (i = 0; i < (1 << FSL_RING_ORDER); i++) {
+		SetPageReserved(virt_to_page((char *)dev->ring + i*PAGE_SIZE));
+	}
+	
 	err = request_irq(dev->irq, fsl_interrupt, 0, "fsl", dev);
 	if (err) {
 		printk(KERN_WARNING "fsl: can't get assigned IRQ %lu\n", (unsigned long)0);
+		fsl_free_ring(dev);
+		kfifo_free(&dev->rx_fifo);
 		dev->irq = -1;
 		return;
 	}
@@ -324,20 +730,30 @@ static void fsl_setup_dev(struct fsl_dev *dev, int index)
 	cdev_init(&dev->cdev, &fsl_fops);
 	dev->cdev.owner = THIS_MODULE;
 	dev->cdev.ops = &fsl_fops;
-	dev->fsl_num = index;
 	err = cdev_add(&dev->cdev, devno, 1);
 	
 	/* Fail gracefully if need be */
 	if (err) {
 		printk(KERN_NOTICE "Error %d adding fsl%d", err, index);
+		free_irq(dev->irq, dev);
+		fsl_free_ring(dev);
+		kfifo_free(&dev->rx_fifo);
 		dev->irq = -1;
 		return;
 	}
 	
-	init_waitqueue_head(&dev->read_queue);
-	dev->irq_enabled = 1;
+	// statistics are optional, the device works without them
+	sysdev = device_create(fsl_class, NULL, devno, dev, "fsl%d", index);
+	if (IS_ERR(sysdev)) {
+		printk(KERN_WARNING "fsl: can't create sysfs entries for fsl%d\n", index);
+	} else {
+		for (i = 0; i < ARRAY_SIZE(fsl_attrs); i++) {
+			device_create_file(sysdev, &fsl_attrs[i]);
+		}
+	}
 	
-	printk(KERN_INFO "fsl: registered fsl%d irq %d\n", index, dev->irq);
+	printk(KERN_INFO "fsl: registered fsl%d irq %d, rx buffer %d words\n", index, dev->irq,
+			kfifo_size(&dev->rx_fifo)/4);
 }
 
 /// Remove device
@@ -345,8 +761,12 @@ static void fsl_remove_dev(struct fsl_dev *dev, int index)
 {
 	if(dev->irq == -1) return;
 	
+	device_destroy(fsl_class, MKDEV(fsl_major, fsl_minor + index));
+	del_timer_sync(&dev->tx_timer);
 	free_irq(dev->irq, dev);
 	cdev_del(&dev->cdev);
+	fsl_free_ring(dev);
+	kfifo_free(&dev->rx_fifo);
 }
 
 int __init fsl_init(void) {
@@ -370,6 +790,12 @@ int __init fsl_init(void) {
 
 	PDEBUG("registered %d char devices with major %d\n", fsl_count, fsl_major);
 	
+	fsl_class = class_create(THIS_MODULE, "fsl");
+	if (IS_ERR(fsl_class)) {
+		unregister_chrdev_region(dev, fsl_count);
+		return PTR_ERR(fsl_class);
+	}
+	
 	// initialize all devices
 	for(i = 0; i < FSL_MAX; i++){
 		fsl_setup_dev(dev_array + i, i);
@@ -388,6 +814,7 @@ void __exit fsl_cleanup(void) {
 	for(i = 0; i < FSL_MAX; i++){
 		fsl_remove_dev(dev_array + i, i);
 	}
+	class_destroy(fsl_class);
 	
 	PDEBUG("unregistered all char devices\n");
 }
@@ -4,6 +4,8 @@
 #include <linux/errno.h>
 #include <linux/cdev.h>
 #include <linux/sched.h>
+#include <linux/mm.h>
+#include <linux/ioctl.h>
 #include <asm/uaccess.h>
 #include <asm/page.h>
 #include <asm/pgtable.h>
@@ -12,6 +14,19 @@ MODULE_LICENSE("Dual BSD/GPL");
 
 #define GETPGD_NAME "getpgd"
 
+#define DCACHE_SIZE (64*1024)
+#define DCACHE_LINE (4*4)
+
+// argument of the range ioctls: the user virtual address range [vaddr, vaddr + len)
+struct getpgd_range {
+	unsigned long vaddr;
+	unsigned long len;
+};
+
+#define GETPGD_IOC_MAGIC 'g'
+#define GETPGD_IOCFLUSH      _IOW(GETPGD_IOC_MAGIC,0x01,struct getpgd_range) // write back and invalidate
+#define GETPGD_IOCINVALIDATE _IOW(GETPGD_IOC_MAGIC,0x02,struct getpgd_range) // invalidate only
+
 static dev_t getpgd_dev;
 static struct cdev getpgd_cdev;
 
@@ -22,13 +37,121 @@ void flush_dcache(void)
 	int baseaddr, bytesize,linelen;
 
 	baseaddr = 0;
-	bytesize = 64*1024;
-	linelen  = 4*4;
+	bytesize = DCACHE_SIZE;
+	linelen  = DCACHE_LINE;
 
 	//for (i = 0; i < bytesize; i += linelen) __asm__ __volatile__ ("wdc.flush        %0, r0;" : : "r" (i));
 	for (i = 0; i < bytesize; i += linelen) asm volatile ("wdc.flush %0, %1;" :: "d" (baseaddr), "d" (i));
 }
 
+static void flush_dcache_line(unsigned long paddr)
+{
+	asm volatile ("wdc.flush %0, r0;" :: "d" (paddr));
+}
+
+static void invalidate_dcache_line(unsigned long paddr)
+{
+	asm volatile ("wdc.clear %0, r0;" :: "d" (paddr));
+}
+
+// flushes or invalidates the lines of [start, stop), which is mapped to the
+// physical addresses [start + offset, stop + offset). When invalidating, lines
+// that only partly lie in the range are written back instead, so that the
+// bytes outside of the range are kept.
+static void flush_dcache_lines(unsigned long offset, unsigned long start, unsigned long stop, int invalidate)
+{
+	unsigned long line;
+
+	for(line = start & ~(DCACHE_LINE - 1); line < stop; line += DCACHE_LINE){
+		if(invalidate && line >= start && line + DCACHE_LINE <= stop){
+			invalidate_dcache_line(offset + line);
+		} else {
+			flush_dcache_line(offset + line);
+		}
+	}
+}
+
+// returns 1 if [vaddr, end) is covered by private writable mappings, the only
+// ones whose dirty lines the process may discard. Called with mmap_sem held.
+static int range_invalidatable(struct mm_struct *mm, unsigned long vaddr, unsigned long end)
+{
+	struct vm_area_struct *vma;
+	unsigned long addr = vaddr;
+
+	while(addr < end){
+		vma = find_vma(mm, addr);
+		if(!vma || vma->vm_start > addr) return 0;
+		if(!(vma->vm_flags & VM_WRITE) || (vma->vm_flags & VM_SHARED)) return 0;
+		addr = vma->vm_end;
+	}
+
+	return 1;
+}
+
+// Flushes or invalidates the data cache lines of a user address range. The
+// range is translated page by page with the page tables of the current process,
+// because the cache is indexed with physical addresses. The lines holding the
+// page directory and page table entries of the range are always written back,
+// so that the hardware MMU sees up to date translations. Invalidating requires
+// the range to be mapped private and writable, otherwise -EFAULT is returned.
+static int flush_dcache_range_user(unsigned long vaddr, unsigned long len, int invalidate)
+{
+	struct mm_struct *mm = current->mm;
+	unsigned long addr, next, end, paddr;
+	pgd_t *pgd;
+	pud_t *pud;
+	pmd_t *pmd;
+	pte_t *pte;
+
+	end = vaddr + len;
+	if(end < vaddr) return -EINVAL;
+
+	// walking the range would take longer than flushing the whole cache
+	if(!invalidate && len >= DCACHE_SIZE){
+		flush_dcache();
+		return 0;
+	}
+
+	down_read(&mm->mmap_sem);
+
+	if(invalidate && !range_invalidatable(mm, vaddr, end)){
+		up_read(&mm->mmap_sem);
+		return -EFAULT;
+	}
+
+	for(addr = vaddr & PAGE_MASK; addr < end; addr = next){
+		next = addr + PAGE_SIZE;
+
+		pgd = pgd_offset(mm,addr);
+		flush_dcache_line(__pa(pgd));
+		if(pgd_none(*pgd)) continue;
+
+		pud = pud_offset(pgd,addr);
+		pmd = pmd_offset(pud,addr);
+		if(pmd_none(*pmd)) continue;
+
+		// large page: the entry maps the section directly
+		if(pmd_val(*pmd) & _PMD_SIZE){
+			unsigned long size = (pmd_val(*pmd) & _PMD_SIZE) == _PMD_SIZE_16M ? 16 << 20 : 4 << 20;
+			next  = (addr & ~(size - 1)) + size;
+			paddr = (pmd_val(*pmd) & ~(size - 1)) - (addr & ~(size - 1));
+			flush_dcache_lines(paddr, max(addr,vaddr), min(next,end), invalidate);
+			continue;
+		}
+
+		pte = pte_offset_kernel(pmd,addr);
+		flush_dcache_line(__pa(pte));
+		if(!pte_present(*pte)) continue;
+
+		paddr = (pte_pfn(*pte) << PAGE_SHIFT) - addr;
+		flush_dcache_lines(paddr, max(addr,vaddr), min(next,end), invalidate);
+	}
+
+	up_read(&mm->mmap_sem);
+
+	return 0;
+}
+
 static ssize_t getpgd_read(struct file *filp, char __user *buf, size_t len, loff_t *ignore)
 {
 	unsigned long res;
@@ -54,6 +177,21 @@ static ssize_t getpgd_write(struct file *filp, const char __user *buf, size_t le
 	return len;
 }
 
+static long getpgd_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
+{
+	struct getpgd_range range;
+
+	switch(cmd){
+		case GETPGD_IOCFLUSH:
+		case GETPGD_IOCINVALIDATE:
+			if(copy_from_user(&range, (void __user *)arg, sizeof range)){
+				return -EFAULT;
+			}
+			return flush_dcache_range_user(range.vaddr, range.len, cmd == GETPGD_IOCINVALIDATE);
+	}
+	return -ENOTTY;
+}
+
 static int getpgd_open(struct inode *inode, struct file *filp)
 {
 #if 0
@@ -106,6 +244,7 @@ static struct file_operations getpgd_fops = {
 	.owner = THIS_MODULE,
 	.read  = getpgd_read,
 	.write = getpgd_write,
+	.unlocked_ioctl = getpgd_ioctl,
 	.open  = getpgd_open
 };
 
@@ -0,0 +1,704 @@
+#include "delegate.h"
+#include "scheduler.h"
+#include "timer_wheel.h"
+#include "fsl.h"
+#include "mbox.h"
+#include "rq.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/time.h>
+
+#if 0
+#define RECONOS_DEBUG(...) fprintf(stderr,__VA_ARGS__);
+#else
+#define RECONOS_DEBUG(...)
+#endif
+
+#define RECONOS_ERROR(...) fprintf(stderr,"ERROR:" __VA_ARGS__);
+
+#define DELEGATE_MAX_ARGS 2
+
+// the command currently served by a delegate thread
+struct delegate_call {
+	struct reconos_hwt * hwt;
+	uint32 req[1 + DELEGATE_MAX_ARGS];  // command word and arguments
+	uint32 * args;                      // = req + 1
+	void * res[DELEGATE_MAX_ARGS];    // resources of the arguments that are handles
+	unsigned long start;              // time the command word has been received
+	unsigned long fsl_us;             // time spent in fsl transfers so far
+	int exit;                         // set by THREAD_EXIT
+	int deferred;                     // the reply is sent by the timer wheel
+};
+
+// THREAD_DELAY pending in a slot. The hardware thread waits for the reply,
+// so there is at most one per slot.
+struct delegate_delay {
+	struct timer_entry timer;
+	struct reconos_hwt * hwt;
+	unsigned long start;
+};
+
+struct delegate_cmd {
+	uint32 cmd;
+	const char * name;
+	int num_args;                     // words following the command word
+	uint32 types[DELEGATE_MAX_ARGS];  // resource type of each argument, 0 = plain word
+	void (*exec)(struct delegate_call * c);
+};
+
+unsigned long delegate_time_us(void)
+{
+	struct timeval t;
+	gettimeofday(&t,NULL);
+	return t.tv_sec*1000000 + t.tv_usec;
+}
+
+// fsl transfers of the handlers, timed separately from the OS call
+
+static void delegate_read(struct delegate_call * c, uint32 * buf, int count)
+{
+	unsigned long t = delegate_time_us();
+	fsl_read_n(c->hwt->slot, buf, count);
+	c->fsl_us += delegate_time_us() - t;
+}
+
+static void delegate_write(struct delegate_call * c, const uint32 * buf, int count)
+{
+	unsigned long t = delegate_time_us();
+	fsl_write_n(c->hwt->slot, buf, count);
+	c->fsl_us += delegate_time_us() - t;
+}
+
+static void delegate_reply(struct delegate_call * c, uint32 result)
+{
+	delegate_write(c, &result, 1);
+}
+
+static void cmd_mbox_get(struct delegate_call * c)
+{
+	delegate_reply(c, mbox_get(c->res[0]));
+}
+
+static void cmd_mbox_put(struct delegate_call * c)
+{
+	mbox_put(c->res[0], c->args[1]);
+	delegate_reply(c, 0);
+}
+
+static void cmd_mbox_tryget(struct delegate_call * c)
+{
+	uint32 reply[2];
+
+	// reply is a status word followed by the data word (0 if the mbox was empty)
+	reply[1] = 0;
+	if(mbox_tryget(c->res[0], &reply[1]) == 0){
+		reply[0] = RECONOS_SUCCESS;
+	} else {
+		reply[0] = RECONOS_FAILURE;
+	}
+	delegate_write(c, reply, 2);
+}
+
+static void cmd_mbox_tryput(struct delegate_call * c)
+{
+	if(mbox_tryput(c->res[0], c->args[1]) == 0){
+		delegate_reply(c, RECONOS_SUCCESS);
+	} else {
+		delegate_reply(c, RECONOS_FAILURE);
+	}
+}
+
+static void cmd_sem_wait(struct delegate_call * c)
+{
+	delegate_reply(c, sem_wait(c->res[0]));
+}
+
+static void cmd_sem_post(struct delegate_call * c)
+{
+	sem_post(c->res[0]);
+	delegate_reply(c, 0);
+}
+
+static void cmd_mutex_lock(struct delegate_call * c)
+{
+	delegate_reply(c, pthread_mutex_lock(c->res[0]));
+}
+
+static void cmd_mutex_unlock(struct delegate_call * c)
+{
+	pthread_mutex_unlock(c->res[0]);
+	delegate_reply(c, 0);
+}
+
+static void cmd_mutex_trylock(struct delegate_call * c)
+{
+	delegate_reply(c, pthread_mutex_trylock(c->res[0]));
+}
+
+static void cmd_cond_wait(struct delegate_call * c)
+{
+	delegate_reply(c, pthread_cond_wait(c->res[0], c->res[1]));
+}
+
+static void cmd_cond_signal(struct delegate_call * c)
+{
+	pthread_cond_signal(c->res[0]);
+	delegate_reply(c, 0);
+}
+
+static void cmd_cond_broadcast(struct delegate_call * c)
+{
+	pthread_cond_broadcast(c->res[0]);
+	delegate_reply(c, 0);
+}
+
+static void cmd_rq_receive(struct delegate_call * c)
+{
+	rqueue * rq = c->res[0];
+	uint32 msg_size = c->args[1];
+	uint32 result;
+	uint32 * msg;
+	int res;
+
+	if(rq->slab){
+		// the slot already holds the size word in front of the
+		// payload, so it can be handed to the hw thread in place
+		msg = rq_peek(rq, &result);
+		if(result == 0 || result > msg_size){
+			if(result > msg_size){
+				RECONOS_ERROR("slot %d: The received message size for rq (0x%08X) is bigger than expecetd (received %d > expected %d bytes) \n",
+					c->hwt->slot, c->args[0], (int)result, (int)msg_size);
+			}
+			delegate_reply(c, 0);
+		} else {
+			delegate_write(c, msg - 1, 1 + result/sizeof(uint32));
+		}
+		rq_release(rq, msg);
+		return;
+	}
+
+	// msg[0] holds the result word, the payload follows, so that
+	// both can be handed to the hw thread in a single fsl transfer
+	msg = malloc(msg_size + sizeof(uint32));
+	res = rq_receive(rq, msg + 1, msg_size);
+	if(res <= 0){
+		// error code, if there is an error or if the message exceeds the expected size
+		RECONOS_DEBUG("slot %d: rq_receive (0x%08X) receives error\n", c->hwt->slot, c->args[0]);
+		delegate_reply(c, 0);
+	} else {
+		msg[0] = res;
+		delegate_write(c, msg, 1 + res/sizeof(uint32));
+	}
+	free(msg);
+}
+
+static void cmd_rq_send(struct delegate_call * c)
+{
+	rqueue * rq = c->res[0];
+	uint32 msg_size = c->args[1];
+	uint32 * msg;
+
+	if(rq->slab && msg_size <= rq->slot_size){
+		// read message directly into a free slot
+		msg = rq_reserve(rq);
+		delegate_read(c, msg, msg_size/sizeof(uint32));
+		rq_commit(rq, msg, msg_size);
+		delegate_reply(c, 0);
+		return;
+	}
+
+	msg = malloc(msg_size);
+	delegate_read(c, msg, msg_size/sizeof(uint32));
+	if(rq_send(rq, msg, msg_size) < 0){
+		RECONOS_ERROR("slot %d: message of %d bytes does not fit into a slot of rq (0x%08X)\n",
+			c->hwt->slot, (int)msg_size, c->args[0]);
+	}
+	delegate_reply(c, 0);
+	free(msg);
+}
+
+static void cmd_get_init_data(struct delegate_call * c)
+{
+	delegate_reply(c, fsl_ptr_word(c->hwt->init_data));
+}
+
+static void cmd_thread_exit(struct delegate_call * c)
+{
+	c->exit = 1;
+}
+
+// the slot is handed over to a queued thread only if the hwt is shared,
+// otherwise it keeps running
+static void cmd_thread_yield(struct delegate_call * c)
+{
+	struct reconos_hwt * next = NULL;
+
+	if(c->hwt->shared) next = scheduler_yield(c->hwt);
+
+	if(next){
+		RECONOS_DEBUG("slot %d: yields to thread %p\n", c->hwt->slot, next);
+		delegate_reply(c, RECONOS_SUCCESS);
+		c->hwt = next;
+	} else {
+		delegate_reply(c, RECONOS_FAILURE);
+	}
+}
+
+static void cmd_thread_resume(struct delegate_call * c)
+{
+	delegate_reply(c, fsl_ptr_word(c->hwt->init_data));
+}
+
+static struct delegate_delay delays[MAX_SLOTS];
+
+static void delay_expired(struct timer_entry * t)
+{
+	struct delegate_delay * d = t->arg;
+	int slot = d->hwt->slot;
+	unsigned long start = d->start;
+
+	// after the reply, the hardware thread may issue the next delay, which
+	// overwrites d
+	fsl_write(slot, 0);
+	delegate_stats_record(slot, RECONOS_CMD_THREAD_DELAY, delegate_time_us() - start, 0);
+}
+
+void delegate_cancel_delay(int slot)
+{
+	if(timer_wheel_cancel(&delays[slot].timer)){
+		RECONOS_DEBUG("slot %d: pending THREAD_DELAY cancelled\n", slot);
+	}
+}
+
+// the delegate goes on reading the fsl of the slot while the delay is pending,
+// the reply is sent by the timer wheel
+static void cmd_thread_delay(struct delegate_call * c)
+{
+	struct delegate_delay * d = &delays[c->hwt->slot];
+
+	if(c->args[0] == 0){
+		delegate_reply(c, 0);
+		return;
+	}
+
+	d->hwt = c->hwt;
+	d->start = c->start;
+	d->timer.expire = delay_expired;
+	d->timer.arg = d;
+	if(timer_wheel_add(&d->timer, c->args[0])){
+		// the hardware thread has not waited for its previous delay
+		delegate_reply(c, 0);
+		return;
+	}
+	c->deferred = 1;
+}
+
+static void cmd_thread_state(struct delegate_call * c)
+{
+	delegate_state_transfer(c->hwt, c->req[0], c->args[0]);
+}
+
+static const struct delegate_cmd delegate_cmds[] = {
+	{RECONOS_CMD_THREAD_GET_INIT_DATA, "THREAD_GET_INIT_DATA", 0, {0, 0}, cmd_get_init_data},
+	{RECONOS_CMD_THREAD_DELAY,         "THREAD_DELAY",         1, {0, 0}, cmd_thread_delay},
+	{RECONOS_CMD_THREAD_EXIT,          "THREAD_EXIT",          0, {0, 0}, cmd_thread_exit},
+	{RECONOS_CMD_THREAD_YIELD,         "THREAD_YIELD",         0, {0, 0}, cmd_thread_yield},
+	{RECONOS_CMD_THREAD_RESUME,        "THREAD_RESUME",        0, {0, 0}, cmd_thread_resume},
+	{RECONOS_CMD_THREAD_LOAD_STATE,    "THREAD_LOAD_STATE",    1, {0, 0}, cmd_thread_state},
+	{RECONOS_CMD_THREAD_STORE_STATE,   "THREAD_STORE_STATE",   1, {0, 0}, cmd_thread_state},
+	{RECONOS_CMD_SEM_POST,       "SEM_POST",       1, {RECONOS_TYPE_SEM, 0},   cmd_sem_post},
+	{RECONOS_CMD_SEM_WAIT,       "SEM_WAIT",       1, {RECONOS_TYPE_SEM, 0},   cmd_sem_wait},
+	{RECONOS_CMD_MUTEX_LOCK,     "MUTEX_LOCK",     1, {RECONOS_TYPE_MUTEX, 0}, cmd_mutex_lock},
+	{RECONOS_CMD_MUTEX_UNLOCK,   "MUTEX_UNLOCK",   1, {RECONOS_TYPE_MUTEX, 0}, cmd_mutex_unlock},
+	{RECONOS_CMD_MUTEX_TRYLOCK,  "MUTEX_TRYLOCK",  1, {RECONOS_TYPE_MUTEX, 0}, cmd_mutex_trylock},
+	{RECONOS_CMD_COND_WAIT,      "COND_WAIT",      2, {RECONOS_TYPE_COND, RECONOS_TYPE_MUTEX}, cmd_cond_wait},
+	{RECONOS_CMD_COND_SIGNAL,    "COND_SIGNAL",    1, {RECONOS_TYPE_COND, 0},  cmd_cond_signal},
+	{RECONOS_CMD_COND_BROADCAST, "COND_BROADCAST", 1, {RECONOS_TYPE_COND, 0},  cmd_cond_broadcast},
+	{RECONOS_CMD_RQ_RECEIVE,     "RQ_RECEIVE",     2, {RECONOS_TYPE_RQ, 0},    cmd_rq_receive},
+	{RECONOS_CMD_RQ_SEND,        "RQ_SEND",        2, {RECONOS_TYPE_RQ, 0},    cmd_rq_send},
+	{RECONOS_CMD_MBOX_GET,       "MBOX_GET",       1, {RECONOS_TYPE_MBOX, 0},  cmd_mbox_get},
+	{RECONOS_CMD_MBOX_PUT,       "MBOX_PUT",       2, {RECONOS_TYPE_MBOX, 0},  cmd_mbox_put},
+	{RECONOS_CMD_MBOX_TRYGET,    "MBOX_TRYGET",    1, {RECONOS_TYPE_MBOX, 0},  cmd_mbox_tryget},
+	{RECONOS_CMD_MBOX_TRYPUT,    "MBOX_TRYPUT",    2, {RECONOS_TYPE_MBOX, 0},  cmd_mbox_tryput},
+};
+
+#define DELEGATE_NUM_CMDS ((int)(sizeof(delegate_cmds)/sizeof(delegate_cmds[0])))
+
+// command codes fit into 8 bits. cmd_index maps a code to its entry + 1, 0 = unknown
+static uint8 cmd_index[256];
+static pthread_once_t cmd_index_once = PTHREAD_ONCE_INIT;
+
+// cmd_stats is written by the delegates, the dispatcher and the timer wheel
+static struct reconos_cmd_stats cmd_stats[MAX_SLOTS][DELEGATE_NUM_CMDS];
+static pthread_mutex_t cmd_stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct reconos_state_stats state_stats[MAX_SLOTS];
+
+static void cmd_index_init(void)
+{
+	int i;
+
+	for(i = 0; i < DELEGATE_NUM_CMDS; i++){
+		cmd_index[delegate_cmds[i].cmd] = i + 1;
+	}
+}
+
+// returns the position of cmd in delegate_cmds, -1 if unknown
+static int cmd_lookup(uint32 cmd)
+{
+	pthread_once(&cmd_index_once, cmd_index_init);
+
+	if(cmd > 0xFF) return -1;
+	return cmd_index[cmd] - 1;
+}
+
+int delegate_cmd_args(uint32 cmd)
+{
+	int i = cmd_lookup(cmd);
+
+	return i < 0 ? -1 : delegate_cmds[i].num_args;
+}
+
+// bucket 0 counts times below 1 us, bucket i times of [2^(i-1), 2^i) us
+static int stats_bucket(unsigned long us)
+{
+	int i = 0;
+
+	while(us > 0 && i < RECONOS_STATS_BUCKETS - 1){
+		us >>= 1;
+		i++;
+	}
+
+	return i;
+}
+
+void delegate_stats_record(int slot, uint32 cmd, unsigned long os_us, unsigned long fsl_us)
+{
+	struct reconos_cmd_stats * s;
+	int i = cmd_lookup(cmd);
+
+	if(i < 0 || slot < 0 || slot >= MAX_SLOTS) return;
+
+	pthread_mutex_lock(&cmd_stats_mutex);
+	s = &cmd_stats[slot][i];
+	s->calls++;
+	s->os_us += os_us;
+	s->fsl_us += fsl_us;
+	s->os_hist[stats_bucket(os_us)]++;
+	s->fsl_hist[stats_bucket(fsl_us)]++;
+	pthread_mutex_unlock(&cmd_stats_mutex);
+}
+
+int reconos_cmd_stats(int slot, struct reconos_cmd_stats * stats, int max)
+{
+	int i, n = 0;
+
+	if(slot < 0 || slot >= MAX_SLOTS) return 0;
+
+	pthread_mutex_lock(&cmd_stats_mutex);
+	for(i = 0; i < DELEGATE_NUM_CMDS && n < max; i++){
+		if(cmd_stats[slot][i].calls == 0) continue;
+		stats[n] = cmd_stats[slot][i];
+		stats[n].cmd = delegate_cmds[i].cmd;
+		stats[n].name = delegate_cmds[i].name;
+		n++;
+	}
+	pthread_mutex_unlock(&cmd_stats_mutex);
+
+	return n;
+}
+
+void reconos_cmd_stats_reset(int slot)
+{
+	if(slot < 0 || slot >= MAX_SLOTS) return;
+
+	pthread_mutex_lock(&cmd_stats_mutex);
+	memset(cmd_stats[slot], 0, sizeof(cmd_stats[slot]));
+	pthread_mutex_unlock(&cmd_stats_mutex);
+}
+
+void reconos_cmd_stats_print(int slot)
+{
+	struct reconos_cmd_stats stats[DELEGATE_NUM_CMDS];
+	int i, j, n;
+
+	n = reconos_cmd_stats(slot, stats, DELEGATE_NUM_CMDS);
+
+	fprintf(stderr, "slot %d: command               calls     os us/call  fsl us/call\n", slot);
+	for(i = 0; i < n; i++){
+		fprintf(stderr, "slot %d: %-20s %10u %12llu %12llu\n", slot, stats[i].name, stats[i].calls,
+			stats[i].os_us/stats[i].calls, stats[i].fsl_us/stats[i].calls);
+		fprintf(stderr, "slot %d:   os  histogram (<1us, <2us, <4us, ...):", slot);
+		for(j = 0; j < RECONOS_STATS_BUCKETS; j++) fprintf(stderr, " %u", stats[i].os_hist[j]);
+		fprintf(stderr, "\nslot %d:   fsl histogram (<1us, <2us, <4us, ...):", slot);
+		for(j = 0; j < RECONOS_STATS_BUCKETS; j++) fprintf(stderr, " %u", stats[i].fsl_hist[j]);
+		fprintf(stderr, "\n");
+	}
+}
+
+// state buffers cover whole pages, so that the cache lines of a state written
+// by the hardware thread can be invalidated without touching other data
+#define DELEGATE_STATE_ALIGN 4096
+
+// bucket 0 counts states below 256 bytes, bucket i states of [2^(i+7), 2^(i+8)) bytes
+static int state_bucket(uint32 size)
+{
+	int i = 0;
+
+	size >>= 7;
+	while(size > 1 && i < RECONOS_STATE_BUCKETS - 1){
+		size >>= 1;
+		i++;
+	}
+
+	return i;
+}
+
+// length of the buffer holding a state of 'size' bytes
+static uint32 state_len(uint32 size)
+{
+	return (size + DELEGATE_STATE_ALIGN - 1) & ~(DELEGATE_STATE_ALIGN - 1);
+}
+
+// makes the state buffer of hwt hold 'size' bytes, its contents are invalid afterwards
+static void * state_buffer(struct reconos_hwt * hwt, uint32 size)
+{
+	uint32 len = state_len(size);
+
+	hwt->state_valid = 0;
+	if(hwt->state && len == state_len(hwt->state_size)){
+		hwt->state_size = size;
+		return hwt->state;
+	}
+
+	if(hwt->state) reconos_buffer_free(hwt->state, state_len(hwt->state_size));
+	hwt->state = NULL;
+	hwt->state_size = 0;
+	if(size == 0) return NULL;
+
+	hwt->state = reconos_buffer_alloc(len);
+	if(hwt->state) hwt->state_size = size;
+
+	return hwt->state;
+}
+
+void delegate_state_transfer(struct reconos_hwt * hwt, uint32 cmd, uint32 size)
+{
+	struct reconos_state_stats * s = &state_stats[hwt->slot];
+	void * buf = NULL;
+	unsigned long t;
+	uint32 done;
+	int b;
+
+	if(cmd == RECONOS_CMD_THREAD_STORE_STATE){
+		if(size > 0) buf = state_buffer(hwt, size);
+	} else if(hwt->state_valid && hwt->state_size == size){
+		buf = hwt->state;
+	}
+
+	RECONOS_DEBUG("slot %d: state buffer of %d bytes at %p\n", hwt->slot, (int)size, buf);
+	fsl_write(hwt->slot, fsl_ptr_word(buf));
+	if(!buf) return;
+
+	// the hardware thread transfers the state with memif and reports the bytes transferred
+	t = delegate_time_us();
+	done = fsl_read(hwt->slot);
+	t = delegate_time_us() - t;
+
+	b = state_bucket(size);
+	if(cmd == RECONOS_CMD_THREAD_STORE_STATE){
+		if(done == size){
+			hwt->state_valid = 1;
+		} else {
+			RECONOS_ERROR("slot %d: %d bytes of state stored, expected %d\n", hwt->slot, (int)done, (int)size);
+		}
+		s->stores[b]++;
+		s->store_bytes[b] += done;
+		s->store_us[b] += t;
+	} else {
+		s->loads[b]++;
+		s->load_bytes[b] += done;
+		s->load_us[b] += t;
+	}
+
+	fsl_write(hwt->slot, RECONOS_SUCCESS);
+}
+
+void reconos_state_stats(int slot, struct reconos_state_stats * stats)
+{
+	if(slot < 0 || slot >= MAX_SLOTS){
+		memset(stats, 0, sizeof(*stats));
+		return;
+	}
+
+	*stats = state_stats[slot];
+}
+
+void reconos_state_stats_print(int slot)
+{
+	struct reconos_state_stats stats;
+	int i;
+
+	reconos_state_stats(slot, &stats);
+
+	fprintf(stderr, "slot %d: state size      stores  us/store  MB/s     loads   us/load   MB/s\n", slot);
+	for(i = 0; i < RECONOS_STATE_BUCKETS; i++){
+		if(stats.stores[i] == 0 && stats.loads[i] == 0) continue;
+
+		if(i == RECONOS_STATE_BUCKETS - 1){
+			fprintf(stderr, "slot %d: >= %8u", slot, 1 << (i + 7));
+		} else {
+			fprintf(stderr, "slot %d: <  %8u", slot, 1 << (i + 8));
+		}
+		fprintf(stderr, " %10u %9llu %6.1f %9u %9llu %6.1f\n",
+			stats.stores[i], stats.stores[i] ? stats.store_us[i]/stats.stores[i] : 0,
+			stats.store_us[i] ? (double)stats.store_bytes[i]/stats.store_us[i] : 0.0,
+			stats.loads[i], stats.loads[i] ? stats.load_us[i]/stats.loads[i] : 0,
+			stats.load_us[i] ? (double)stats.load_bytes[i]/stats.load_us[i] : 0.0);
+	}
+}
+
+void * reconos_hwt_getstate(struct reconos_hwt * hwt, uint32 * size)
+{
+	if(!hwt->state_valid) return NULL;
+
+	// written by the hardware thread, past the data cache
+	cache_invalidate_range(hwt->state, state_len(hwt->state_size));
+	if(size) *size = hwt->state_size;
+
+	return hwt->state;
+}
+
+int reconos_hwt_setstate(struct reconos_hwt * hwt, const void * state, uint32 size)
+{
+	void * buf;
+
+	if(state == hwt->state && hwt->state_valid && size == hwt->state_size) return 0;
+
+	buf = state_buffer(hwt, size);
+	if(size == 0) return 0;
+	if(!buf) return -1;
+
+	memcpy(buf, state, size);
+	cache_flush_range(buf, size);
+	hwt->state_valid = 1;
+
+	return 0;
+}
+
+void delegate_quarantine(struct reconos_hwt * hwt, int error, uint32 cmd, uint32 arg)
+{
+	struct reconos_slot_status * status = &reconos_proc.slot_status[hwt->slot];
+	uint32 reply;
+
+	RECONOS_ERROR("slot %d: quarantined after command 0x%08X\n", hwt->slot, cmd);
+
+	status->cmd = cmd;
+	status->arg = arg;
+	status->error = error;
+
+	// the slot is held in reset right after, so a full fsl must not block
+	reply = RECONOS_ERROR_REPLY;
+	fsl_trywrite_n(hwt->slot, &reply, 1);
+	reconos_slot_reset(hwt->slot, 1);
+}
+
+int delegate_check(struct reconos_hwt * hwt, const uint32 * req)
+{
+	const struct delegate_cmd * d;
+	uint32 handle;
+	int i;
+
+	i = cmd_lookup(req[0]);
+	if(i < 0){
+		RECONOS_ERROR("slot %d: unknown command 0x%08X\n", hwt->slot, req[0]);
+		delegate_quarantine(hwt, RECONOS_SLOT_ERR_COMMAND, req[0], 0);
+		return -1;
+	}
+	d = &delegate_cmds[i];
+
+	for(i = 0; i < d->num_args; i++){
+		if(!d->types[i]) continue;
+		handle = req[1 + i];
+
+		if(handle >= hwt->num_resources){
+			RECONOS_ERROR("slot %d: resource id %d (argument %d) out of range, must be lesser than %d\n",
+				hwt->slot, handle, i + 1, hwt->num_resources);
+			delegate_quarantine(hwt, RECONOS_SLOT_ERR_HANDLE, req[0], handle);
+			return -1;
+		}
+
+		if(hwt->resources[handle].type != d->types[i]){
+			RECONOS_ERROR("slot %d: resource type 0x%08X expected for argument %d, found 0x%08X\n",
+				hwt->slot, d->types[i], i + 1, hwt->resources[handle].type);
+			delegate_quarantine(hwt, RECONOS_SLOT_ERR_TYPE, req[0], handle);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+struct reconos_hwt * delegate_serve(struct reconos_hwt * hwt)
+{
+	struct delegate_call c;
+	const struct delegate_cmd * d;
+	uint32 cmd;
+	int i;
+
+	c.hwt = hwt;
+	c.args = c.req + 1;
+	c.exit = 0;
+
+	RECONOS_DEBUG("slot %d: starting delegate thread\n", c.hwt->slot);
+
+	while(!c.exit){
+		// waiting for the command word is time the hardware thread computes
+		cmd = fsl_read(c.hwt->slot);
+		c.start = delegate_time_us();
+		c.fsl_us = 0;
+		c.deferred = 0;
+
+		RECONOS_DEBUG("slot %d: received command 0x%08X\n", c.hwt->slot, cmd);
+
+		c.req[0] = cmd;
+		i = cmd_lookup(cmd);
+		if(i < 0){
+			delegate_check(c.hwt, c.req);
+			break;
+		}
+		d = &delegate_cmds[i];
+		RECONOS_DEBUG("slot %d: command is %s\n", c.hwt->slot, d->name);
+
+		if(d->num_args > 0) delegate_read(&c, c.args, d->num_args);
+		if(delegate_check(c.hwt, c.req)) break;
+		for(i = 0; i < d->num_args; i++){
+			RECONOS_DEBUG("slot %d: argument %d is 0x%08X\n", c.hwt->slot, i + 1, c.args[i]);
+			if(d->types[i]){
+				c.res[i] = c.hwt->resources[c.args[i]].ptr;
+			}
+		}
+
+		d->exec(&c);
+
+		if(!c.deferred){
+			delegate_stats_record(c.hwt->slot, cmd, delegate_time_us() - c.start - c.fsl_us, c.fsl_us);
+		}
+	}
+
+	RECONOS_DEBUG("slot %d: hardware thread has finished\n", c.hwt->slot);
+
+	return c.hwt;
+}
+
+void * delegate_thread_entry(void * arg)
+{
+	delegate_serve((struct reconos_hwt *)arg);
+
+	RECONOS_DEBUG("delegate thread exits\n");
+
+	return NULL;
+}
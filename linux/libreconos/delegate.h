@@ -0,0 +1,51 @@
+#ifndef DELEGATE_H
+#define DELEGATE_H
+
+/* Delegate threads serve the OS calls of one hardware thread each.
+   The commands are described by a table keyed by command code, which
+   gives the number of argument words and the resource type expected for
+   each argument. Arguments are read and validated in one place before the
+   handler of the command runs; every call is counted per slot, separately
+   for the time blocked in the OS call and the time spent on the FSL. */
+
+#include "reconos.h"
+
+// thread entry of the delegate of the hardware thread passed as arg
+void * delegate_thread_entry(void * arg);
+
+// serves the hardware thread in hwt->slot until it exits or is quarantined.
+// Returns the thread served last, which is another one than hwt if a shared
+// thread has handed the slot over at THREAD_YIELD.
+struct reconos_hwt * delegate_serve(struct reconos_hwt * hwt);
+
+// number of argument words following the command word, -1 if unknown
+int delegate_cmd_args(uint32 cmd);
+
+// checks the command word req[0] and the resources passed in its arguments
+// req[1..]. On error, the slot is quarantined (see delegate_quarantine) and
+// -1 is returned; 0 otherwise.
+int delegate_check(struct reconos_hwt * hwt, const uint32 * req);
+
+// replies RECONOS_ERROR_REPLY, holds the slot in reset and records the error
+// for reconos_slot_status. The caller stops serving the slot.
+void delegate_quarantine(struct reconos_hwt * hwt, int error, uint32 cmd, uint32 arg);
+
+// serves THREAD_LOAD_STATE or THREAD_STORE_STATE (cmd) of 'size' bytes once
+// the command and its argument have been received: replies the address of
+// the state buffer of hwt, waits for the hardware thread to report the
+// transfer as complete and acknowledges it.
+void delegate_state_transfer(struct reconos_hwt * hwt, uint32 cmd, uint32 size);
+
+// drops the reply to a THREAD_DELAY pending in 'slot', so that it does not
+// reach the next hardware thread in the slot. Returns once the reply can no
+// longer be sent.
+void delegate_cancel_delay(int slot);
+
+// adds a call of cmd issued by 'slot' to the statistics, e.g. for calls
+// served by the dispatcher
+void delegate_stats_record(int slot, uint32 cmd, unsigned long os_us, unsigned long fsl_us);
+
+// current time in microseconds, the time base of the statistics
+unsigned long delegate_time_us(void);
+
+#endif
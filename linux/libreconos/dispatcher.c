@@ -0,0 +1,601 @@
+#include "dispatcher.h"
+#include "delegate.h"
+#include "timer_wheel.h"
+#include "fsl.h"
+#include "mbox.h"
+#include "rq.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#if 0
+#define RECONOS_DEBUG(...) fprintf(stderr,__VA_ARGS__);
+#else
+#define RECONOS_DEBUG(...)
+#endif
+
+#define RECONOS_ERROR(...) fprintf(stderr,"ERROR:" __VA_ARGS__);
+
+#define SLOT_STATE_FREE    0 // no hardware thread registered
+#define SLOT_STATE_IDLE    1 // waiting for the next command
+#define SLOT_STATE_READING 2 // command received, waiting for arguments or payload
+#define SLOT_STATE_PARKED  3 // request complete, but the OS call would block
+#define SLOT_STATE_HELPER  4 // request is served by the helper thread of the slot
+#define SLOT_STATE_TIMER   5 // THREAD_DELAY is pending in the timer wheel
+#define SLOT_STATE_DONE    6 // helper or timer has finished, the reply is in 'result'
+#define SLOT_STATE_EXITED  7 // hardware thread has exited
+
+struct dispatcher_slot {
+	struct reconos_hwt * hwt;
+	int state;
+	uint32 req[3];          // command word and up to two arguments
+	int req_len;            // words of the request received so far
+	int req_need;           // words the request consists of
+	uint32 * payload;       // RQ_SEND message or RQ_RECEIVE buffer
+	int payload_len;        // words of payload received so far
+	int payload_need;       // words of payload expected
+	unsigned long start_us; // time the request has been complete, for the statistics
+	uint32 result;          // reply of a request served by the helper or the timer
+	uint32 * out;           // reply words the fsl has not accepted yet
+	int out_len;
+	int out_size;
+	int helper_started;
+	pthread_t helper;
+	pthread_cond_t helper_cond; // a request has been handed to the helper
+	struct timer_entry delay;   // THREAD_DELAY
+};
+
+// indexed by slot number. all fields are protected by dispatcher_mutex,
+// which the dispatcher thread only releases while it waits in poll()
+static struct dispatcher_slot slots[MAX_SLOTS];
+static pthread_mutex_t dispatcher_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t dispatcher_exit_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t dispatcher_thread;
+static int dispatcher_running = 0;
+static int wake_pipe[2];
+static volatile int wake_pending = 0;
+
+// interrupts the poll() of the dispatcher thread. Wake-ups that arrive
+// before the dispatcher has taken the previous one are merged.
+static void dispatcher_wake(void)
+{
+	char c = 0;
+
+	if(__sync_lock_test_and_set(&wake_pending, 1)) return;
+	write(wake_pipe[1],&c,1);
+}
+
+// installed as notify hook of the mboxes and rqs of dispatched threads,
+// so that parked requests are retried as soon as they may complete
+static void dispatcher_notify(struct mbox * mb)
+{
+	dispatcher_wake();
+}
+
+static void request_reset(struct dispatcher_slot * s)
+{
+	free(s->payload);
+	s->payload = NULL;
+	s->payload_len = 0;
+	s->payload_need = 0;
+	s->req_len = 0;
+	s->req_need = 1;
+	s->state = SLOT_STATE_IDLE;
+}
+
+// the request has been validated by delegate_check
+static void * get_resource(struct reconos_hwt * hwt, uint32 handle, uint32 type)
+{
+	return hwt->resources[handle].ptr;
+}
+
+// sends a reply without blocking. Words the fsl does not accept are queued
+// and sent by dispatcher_flush once poll() reports room.
+static void dispatcher_reply(struct dispatcher_slot * s, const uint32 * buf, int count)
+{
+	int n = 0;
+
+	if(s->out_len == 0) n = fsl_trywrite_n(s->hwt->slot, buf, count);
+	if(n == count) return;
+
+	if(s->out_len + count - n > s->out_size){
+		s->out_size = s->out_len + count - n;
+		s->out = realloc(s->out, s->out_size*sizeof(uint32));
+	}
+	memcpy(s->out + s->out_len, buf + n, (count - n)*sizeof(uint32));
+	s->out_len += count - n;
+}
+
+static void dispatcher_reply_word(struct dispatcher_slot * s, uint32 word)
+{
+	dispatcher_reply(s, &word, 1);
+}
+
+static void dispatcher_flush(struct dispatcher_slot * s)
+{
+	int n;
+
+	n = fsl_trywrite_n(s->hwt->slot, s->out, s->out_len);
+	memmove(s->out, s->out + n, (s->out_len - n)*sizeof(uint32));
+	s->out_len -= n;
+}
+
+// stops serving a slot that has been quarantined by delegate_check
+static void dispatcher_quarantined(struct dispatcher_slot * s)
+{
+	s->out_len = 0;
+	s->state = SLOT_STATE_EXITED;
+	pthread_cond_broadcast(&dispatcher_exit_cond);
+}
+
+// Mutex, semaphore and condition variable calls cannot be turned into
+// non-blocking calls that are retried, so they are executed by a helper
+// thread of the slot, one request at a time. All mutexes of a hardware
+// thread are thus locked and unlocked by the same thread, as with a delegate.
+// For LOAD_STATE and STORE_STATE, the hardware thread transfers the state
+// with memif between two fsl words; the helper sends both replies itself.
+static uint32 helper_exec(struct reconos_hwt * hwt, const uint32 * req)
+{
+	switch(req[0]){
+		case RECONOS_CMD_SEM_WAIT:
+			return sem_wait(get_resource(hwt, req[1], RECONOS_TYPE_SEM));
+
+		case RECONOS_CMD_MUTEX_LOCK:
+			return pthread_mutex_lock(get_resource(hwt, req[1], RECONOS_TYPE_MUTEX));
+
+		case RECONOS_CMD_MUTEX_UNLOCK:
+			pthread_mutex_unlock(get_resource(hwt, req[1], RECONOS_TYPE_MUTEX));
+			return 0;
+
+		case RECONOS_CMD_MUTEX_TRYLOCK:
+			return pthread_mutex_trylock(get_resource(hwt, req[1], RECONOS_TYPE_MUTEX));
+
+		case RECONOS_CMD_COND_WAIT:
+			return pthread_cond_wait(get_resource(hwt, req[1], RECONOS_TYPE_COND),
+				get_resource(hwt, req[2], RECONOS_TYPE_MUTEX));
+
+		case RECONOS_CMD_THREAD_LOAD_STATE:
+		case RECONOS_CMD_THREAD_STORE_STATE:
+			delegate_state_transfer(hwt, req[0], req[1]);
+			return 0;
+	}
+
+	return 0;
+}
+
+static void * helper_entry(void * arg)
+{
+	struct dispatcher_slot * s = arg;
+	struct reconos_hwt * hwt;
+	uint32 result;
+
+	pthread_mutex_lock(&dispatcher_mutex);
+	while(1){
+		while(s->state != SLOT_STATE_HELPER){
+			pthread_cond_wait(&s->helper_cond, &dispatcher_mutex);
+		}
+		hwt = s->hwt;
+		pthread_mutex_unlock(&dispatcher_mutex);
+
+		// the dispatcher does not touch the request while it is handed over
+		result = helper_exec(hwt, s->req);
+		RECONOS_DEBUG("slot %d: helper returns 0x%08X\n", hwt->slot, result);
+
+		pthread_mutex_lock(&dispatcher_mutex);
+		s->result = result;
+		s->state = SLOT_STATE_DONE;
+		dispatcher_wake();
+	}
+
+	return NULL;
+}
+
+static void helper_start(struct dispatcher_slot * s)
+{
+	if(s->helper_started) return;
+
+	pthread_cond_init(&s->helper_cond, NULL);
+	if(pthread_create(&s->helper, NULL, helper_entry, s)){
+		perror("pthread_create: dispatcher helper");
+		exit(1);
+	}
+	s->helper_started = 1;
+}
+
+static void delay_expired(struct timer_entry * t)
+{
+	struct dispatcher_slot * s = t->arg;
+
+	pthread_mutex_lock(&dispatcher_mutex);
+	// a slot is only registered again once its thread has exited, so the
+	// timer belongs to the current request
+	if(s->state == SLOT_STATE_TIMER){
+		s->result = 0;
+		s->state = SLOT_STATE_DONE;
+	}
+	pthread_mutex_unlock(&dispatcher_mutex);
+	dispatcher_wake();
+}
+
+#define EXEC_DONE   0 // reply has been sent or queued
+#define EXEC_PARKED 1 // call would block, retry once the mbox or rq has changed
+#define EXEC_HELPER 2 // call has to be handed to the helper thread
+#define EXEC_TIMER  3 // reply is sent when the timer expires
+
+// executes a complete request
+static int dispatcher_exec(struct dispatcher_slot * s)
+{
+	struct reconos_hwt * hwt = s->hwt;
+	uint32 reply[2];
+	uint32 result;
+	uint32 msg_size;
+	uint32 * msg;
+	rqueue * rq;
+	int res;
+
+	switch(s->req[0]){
+		case RECONOS_CMD_MBOX_GET:
+			if(mbox_tryget(get_resource(hwt, s->req[1], RECONOS_TYPE_MBOX), &result)) return EXEC_PARKED;
+			dispatcher_reply_word(s, result);
+			return EXEC_DONE;
+
+		case RECONOS_CMD_MBOX_PUT:
+			if(mbox_tryput(get_resource(hwt, s->req[1], RECONOS_TYPE_MBOX), s->req[2])) return EXEC_PARKED;
+			dispatcher_reply_word(s, 0);
+			return EXEC_DONE;
+
+		case RECONOS_CMD_MBOX_TRYGET:
+			reply[1] = 0;
+			if(mbox_tryget(get_resource(hwt, s->req[1], RECONOS_TYPE_MBOX), &reply[1]) == 0){
+				reply[0] = RECONOS_SUCCESS;
+			} else {
+				reply[0] = RECONOS_FAILURE;
+			}
+			dispatcher_reply(s, reply, 2);
+			return EXEC_DONE;
+
+		case RECONOS_CMD_MBOX_TRYPUT:
+			if(mbox_tryput(get_resource(hwt, s->req[1], RECONOS_TYPE_MBOX), s->req[2]) == 0){
+				dispatcher_reply_word(s, RECONOS_SUCCESS);
+			} else {
+				dispatcher_reply_word(s, RECONOS_FAILURE);
+			}
+			return EXEC_DONE;
+
+		case RECONOS_CMD_SEM_POST:
+			sem_post(get_resource(hwt, s->req[1], RECONOS_TYPE_SEM));
+			dispatcher_reply_word(s, 0);
+			return EXEC_DONE;
+
+		case RECONOS_CMD_SEM_WAIT:
+		case RECONOS_CMD_MUTEX_LOCK:
+		case RECONOS_CMD_MUTEX_UNLOCK:
+		case RECONOS_CMD_MUTEX_TRYLOCK:
+		case RECONOS_CMD_COND_WAIT:
+		case RECONOS_CMD_THREAD_LOAD_STATE:
+		case RECONOS_CMD_THREAD_STORE_STATE:
+			return EXEC_HELPER;
+
+		case RECONOS_CMD_COND_SIGNAL:
+			pthread_cond_signal(get_resource(hwt, s->req[1], RECONOS_TYPE_COND));
+			dispatcher_reply_word(s, 0);
+			return EXEC_DONE;
+
+		case RECONOS_CMD_COND_BROADCAST:
+			pthread_cond_broadcast(get_resource(hwt, s->req[1], RECONOS_TYPE_COND));
+			dispatcher_reply_word(s, 0);
+			return EXEC_DONE;
+
+		case RECONOS_CMD_RQ_RECEIVE:
+			rq = get_resource(hwt, s->req[1], RECONOS_TYPE_RQ);
+			msg_size = s->req[2];
+			if(rq->slab){
+				msg = rq_trypeek(rq, &result);
+				if(!msg) return EXEC_PARKED;
+				if(result == 0 || result > msg_size){
+					if(result > msg_size){
+						RECONOS_ERROR("slot %d: The received message size for rq (0x%08X) is bigger than expecetd (received %d > expected %d bytes) \n",
+							hwt->slot, s->req[1], (int)result, (int)msg_size);
+					}
+					dispatcher_reply_word(s, 0);
+				} else {
+					// words the fsl does not take right away are copied
+					// before the slot goes back to the slab
+					dispatcher_reply(s, msg - 1, 1 + result/sizeof(uint32));
+				}
+				rq_release(rq, msg);
+				return EXEC_DONE;
+			}
+
+			// payload[0] holds the result word, see delegate_thread_entry
+			if(!s->payload) s->payload = malloc(msg_size + sizeof(uint32));
+			res = rq_tryreceive(rq, s->payload + 1, msg_size);
+			if(res == -2) return EXEC_PARKED;
+			if(res <= 0){
+				dispatcher_reply_word(s, 0);
+			} else {
+				s->payload[0] = res;
+				dispatcher_reply(s, s->payload, 1 + res/sizeof(uint32));
+			}
+			return EXEC_DONE;
+
+		case RECONOS_CMD_RQ_SEND:
+			rq = get_resource(hwt, s->req[1], RECONOS_TYPE_RQ);
+			res = rq_trysend(rq, s->payload, s->req[2]);
+			if(res == -2) return EXEC_PARKED;
+			if(res < 0){
+				RECONOS_ERROR("slot %d: message of %d bytes does not fit into a slot of rq (0x%08X)\n",
+					hwt->slot, (int)s->req[2], s->req[1]);
+			}
+			dispatcher_reply_word(s, 0);
+			return EXEC_DONE;
+
+		case RECONOS_CMD_THREAD_GET_INIT_DATA:
+			dispatcher_reply_word(s, fsl_ptr_word(hwt->init_data));
+			return EXEC_DONE;
+
+		case RECONOS_CMD_THREAD_DELAY:
+			if(s->req[1] == 0){
+				dispatcher_reply_word(s, 0);
+				return EXEC_DONE;
+			}
+			s->delay.expire = delay_expired;
+			s->delay.arg = s;
+			if(timer_wheel_add(&s->delay, s->req[1])){
+				dispatcher_reply_word(s, 0);
+				return EXEC_DONE;
+			}
+			return EXEC_TIMER;
+
+		case RECONOS_CMD_THREAD_YIELD:
+			// dispatched threads own their slot
+			dispatcher_reply_word(s, RECONOS_FAILURE);
+			return EXEC_DONE;
+
+		case RECONOS_CMD_THREAD_RESUME:
+			dispatcher_reply_word(s, fsl_ptr_word(hwt->init_data));
+			return EXEC_DONE;
+
+		case RECONOS_CMD_THREAD_EXIT:
+			RECONOS_DEBUG("slot %d: command is THREAD_EXIT\n", hwt->slot);
+			s->state = SLOT_STATE_EXITED;
+			pthread_cond_broadcast(&dispatcher_exit_cond);
+			return EXEC_DONE;
+	}
+
+	return EXEC_DONE;
+}
+
+static void dispatcher_run(struct dispatcher_slot * s)
+{
+	RECONOS_DEBUG("slot %d: executing command 0x%08X\n", s->hwt->slot, s->req[0]);
+
+	switch(dispatcher_exec(s)){
+		case EXEC_DONE:
+			delegate_stats_record(s->hwt->slot, s->req[0], delegate_time_us() - s->start_us, 0);
+			if(s->state != SLOT_STATE_EXITED) request_reset(s);
+			break;
+		case EXEC_PARKED:
+			s->state = SLOT_STATE_PARKED;
+			break;
+		case EXEC_HELPER:
+			helper_start(s);
+			s->state = SLOT_STATE_HELPER;
+			pthread_cond_signal(&s->helper_cond);
+			break;
+		case EXEC_TIMER:
+			s->state = SLOT_STATE_TIMER;
+			break;
+	}
+}
+
+// replies to a request the helper or the timer wheel has finished
+static void dispatcher_complete(struct dispatcher_slot * s)
+{
+	if(s->req[0] != RECONOS_CMD_THREAD_LOAD_STATE && s->req[0] != RECONOS_CMD_THREAD_STORE_STATE){
+		dispatcher_reply_word(s, s->result);
+	}
+	delegate_stats_record(s->hwt->slot, s->req[0], delegate_time_us() - s->start_us, 0);
+	request_reset(s);
+}
+
+// Collects the words of the current request without blocking.
+// Returns 1 if a request has been completed and executed, 0 if the FSL ran dry.
+static int dispatcher_read(struct dispatcher_slot * s)
+{
+	int slot = s->hwt->slot;
+	int n;
+
+	s->state = SLOT_STATE_READING;
+
+	// command word and arguments. req_need is 1 until the command is known,
+	// so that no word of the following request can be consumed.
+	while(s->req_len < s->req_need){
+		n = fsl_tryread_n(slot, s->req + s->req_len, s->req_need - s->req_len);
+		if(n == 0) return 0;
+		if(s->req_len == 0){
+			s->req_need = 1 + delegate_cmd_args(s->req[0]);
+			if(s->req_need == 0){
+				delegate_check(s->hwt, s->req);
+				dispatcher_quarantined(s);
+				return 0;
+			}
+		}
+		s->req_len += n;
+	}
+	if(!s->payload && delegate_check(s->hwt, s->req)){
+		dispatcher_quarantined(s);
+		return 0;
+	}
+
+	// RQ_SEND is followed by the message
+	if(s->req[0] == RECONOS_CMD_RQ_SEND && !s->payload){
+		s->payload = malloc(s->req[2] + sizeof(uint32));
+		s->payload_len = 0;
+		s->payload_need = s->req[2]/sizeof(uint32);
+	}
+	while(s->payload_len < s->payload_need){
+		n = fsl_tryread_n(slot, s->payload + s->payload_len, s->payload_need - s->payload_len);
+		if(n == 0) return 0;
+		s->payload_len += n;
+	}
+
+	s->start_us = delegate_time_us();
+	dispatcher_run(s);
+
+	return 1;
+}
+
+// serves back-to-back requests of one slot
+static void dispatcher_serve(struct dispatcher_slot * s)
+{
+	while(s->state == SLOT_STATE_IDLE || s->state == SLOT_STATE_READING){
+		if(!dispatcher_read(s)) break;
+	}
+}
+
+static void * dispatcher_thread_entry(void * arg)
+{
+	struct pollfd fds[MAX_SLOTS + 1];
+	struct dispatcher_slot * polled[MAX_SLOTS + 1];
+	struct dispatcher_slot * s;
+	char buf[16];
+	short events;
+	int i, n;
+
+	pthread_mutex_lock(&dispatcher_mutex);
+	while(1){
+		// reply to requests finished by the helpers and the timer wheel,
+		// retry parked requests
+		for(i = 0; i < MAX_SLOTS; i++){
+			s = &slots[i];
+			if(s->state == SLOT_STATE_DONE){
+				dispatcher_complete(s);
+			} else if(s->state == SLOT_STATE_PARKED){
+				dispatcher_run(s);
+			} else {
+				continue;
+			}
+			dispatcher_serve(s);
+		}
+
+		// wait for commands on all slots that are ready to receive one
+		// and for room on the fsls of queued replies
+		fds[0].fd = wake_pipe[0];
+		fds[0].events = POLLIN;
+		n = 1;
+		for(i = 0; i < MAX_SLOTS; i++){
+			s = &slots[i];
+			events = 0;
+			if(s->state == SLOT_STATE_IDLE || s->state == SLOT_STATE_READING) events = POLLIN;
+			if(s->out_len > 0) events |= fsl_poll_out(i);
+			if(!events) continue;
+			fds[n].fd = fsl_poll_fd(i);
+			fds[n].events = events;
+			polled[n] = s;
+			n++;
+		}
+
+		pthread_mutex_unlock(&dispatcher_mutex);
+		if(poll(fds, n, -1) < 0 && errno != EINTR){
+			perror("poll");
+			exit(1);
+		}
+		pthread_mutex_lock(&dispatcher_mutex);
+
+		// wake-ups after this point write to the pipe again
+		if(fds[0].revents & POLLIN){
+			while(read(wake_pipe[0], buf, sizeof(buf)) > 0);
+			__sync_lock_release(&wake_pending);
+		}
+
+		for(i = 1; i < n; i++){
+			if(!fds[i].revents) continue;
+			s = polled[i];
+			if(s->out_len > 0) dispatcher_flush(s);
+			dispatcher_serve(s);
+		}
+	}
+
+	return NULL;
+}
+
+// the notify hooks of the mboxes and rqs of hwt wake up the dispatcher
+static void dispatcher_notify_resources(struct reconos_hwt * hwt)
+{
+	rqueue * rq;
+	int i;
+
+	for(i = 0; i < hwt->num_resources; i++){
+		switch(hwt->resources[i].type){
+			case RECONOS_TYPE_MBOX:
+				((struct mbox *)hwt->resources[i].ptr)->notify = dispatcher_notify;
+				break;
+			case RECONOS_TYPE_RQ:
+				rq = hwt->resources[i].ptr;
+				rq->mb.notify = dispatcher_notify;
+				rq->free.notify = dispatcher_notify;
+				break;
+		}
+	}
+}
+
+int dispatcher_add(struct reconos_hwt * hwt)
+{
+	struct dispatcher_slot * s;
+
+	if(hwt->slot < 0 || hwt->slot >= MAX_SLOTS){
+		RECONOS_ERROR("slot %d: slot number out of range, must be lesser than %d\n",
+			hwt->slot, MAX_SLOTS);
+		return -1;
+	}
+
+	pthread_mutex_lock(&dispatcher_mutex);
+
+	s = &slots[hwt->slot];
+	if(s->state != SLOT_STATE_FREE && s->state != SLOT_STATE_EXITED){
+		pthread_mutex_unlock(&dispatcher_mutex);
+		RECONOS_ERROR("slot %d: already served by the dispatcher\n", hwt->slot);
+		return -1;
+	}
+	s->hwt = hwt;
+	s->out_len = 0;
+	request_reset(s);
+	fsl_poll_fd(hwt->slot);
+
+	if(!dispatcher_running){
+		if(pipe(wake_pipe)){
+			perror("pipe");
+			exit(1);
+		}
+		fcntl(wake_pipe[0], F_SETFL, O_NONBLOCK);
+		fcntl(wake_pipe[1], F_SETFL, O_NONBLOCK);
+		pthread_create(&dispatcher_thread, NULL, dispatcher_thread_entry, NULL);
+		dispatcher_running = 1;
+	}
+	dispatcher_notify_resources(hwt);
+
+	pthread_mutex_unlock(&dispatcher_mutex);
+
+	dispatcher_wake();
+
+	return 0;
+}
+
+void dispatcher_join(struct reconos_hwt * hwt)
+{
+	struct dispatcher_slot * s = &slots[hwt->slot];
+
+	pthread_mutex_lock(&dispatcher_mutex);
+	while(s->hwt == hwt && s->state != SLOT_STATE_EXITED){
+		pthread_cond_wait(&dispatcher_exit_cond, &dispatcher_mutex);
+	}
+	pthread_mutex_unlock(&dispatcher_mutex);
+}
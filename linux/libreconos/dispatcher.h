@@ -0,0 +1,22 @@
+#ifndef DISPATCHER_H
+#define DISPATCHER_H
+
+/* Single-threaded alternative to one delegate thread per slot.
+   The dispatcher waits on the FSLs of all registered hardware threads with
+   poll() and serves their OS requests from one event loop. Replies are
+   written without blocking; words a full fsl does not accept are queued per
+   slot and sent once poll() reports room. Mbox and rq requests that cannot
+   complete right away are parked and retried when the mbox or rq changes.
+   Mutex, semaphore and condition variable calls are handed to a helper
+   thread of the slot, so that a blocked hardware thread never stalls the
+   other slots. */
+
+#include "reconos.h"
+
+// registers a hardware thread with the dispatcher, starting it if necessary.
+int dispatcher_add(struct reconos_hwt * hwt);
+
+// blocks until the hardware thread has issued THREAD_EXIT.
+void dispatcher_join(struct reconos_hwt * hwt);
+
+#endif
@@ -7,28 +7,86 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
 
 #define MAX_FSL_DEVICES 16
 #define FSL_PATH_LEN 256
 
+// rx ring of the fsl driver, see struct fsl_ring in fsl_driver/fsl.c
+#define FSL_IOC_MAGIC 'k'
+#define FSL_IOCWAIT _IO(FSL_IOC_MAGIC,0xF2)
+#define FSL_RING_PAGE 4096
+#define FSL_RING_LEN (2*FSL_RING_PAGE)
+
+struct fsl_ring {
+	volatile uint32 head;
+	volatile uint32 tail;
+	uint32 size;
+};
+
 //#define FSL_DEBUG(...) fprintf(stderr,__VA_ARGS__);
 #define FSL_DEBUG(...)
 
 static int fsl_fd[MAX_FSL_DEVICES] = {-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1};
 
-static void fsl_open(int n)
+// mapped rx rings, NULL if the driver does not support them
+static struct fsl_ring * fsl_ring[MAX_FSL_DEVICES];
+
+// second set of descriptors opened with O_NONBLOCK, used by fsl_tryread_n and poll()
+static int fsl_fd_nb[MAX_FSL_DEVICES] = {-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1};
+
+static int fsl_open_flags(int n, int flags)
 {
 	char s[FSL_PATH_LEN];
-	vsnprintf(s, FSL_PATH_LEN, "/dev/fsl%d", &n);
+	int fd;
+	
+	snprintf(s, FSL_PATH_LEN, "/dev/fsl%d", n);
 	
 	s[FSL_PATH_LEN-1] = '\0';
 	
-	fsl_fd[n] = open(s,O_RDWR);
-	if(fsl_fd[n] < 0){
+	fd = open(s,flags);
+	if(fd < 0){
 		fprintf(stderr,"Error opening /dev/fsl%d\n",n);
 		perror("open");
 		exit(1);
 	}
+	
+	return fd;
+}
+
+static void fsl_open(int n)
+{
+	void * ring;
+	
+	fsl_fd[n] = fsl_open_flags(n,O_RDWR);
+	
+	// with the rx ring mapped, incoming words are read from memory instead of
+	// with a system call per transfer
+	ring = mmap(NULL, FSL_RING_LEN, PROT_READ | PROT_WRITE, MAP_SHARED, fsl_fd[n], 0);
+	fsl_ring[n] = (ring == MAP_FAILED) ? NULL : ring;
+}
+
+// copies up to 'count' words out of the rx ring. returns the number of words copied.
+static int fsl_ring_get(struct fsl_ring * ring, uint32 * buf, int count)
+{
+	uint32 * data = (uint32*)((char*)ring + FSL_RING_PAGE);
+	uint32 tail = ring->tail;
+	int i, avail;
+	
+	avail = ring->head - tail;
+	if(avail > count) avail = count;
+	
+	__sync_synchronize();
+	for(i = 0; i < avail; i++){
+		buf[i] = data[(tail + i) & (ring->size - 1)];
+	}
+	__sync_synchronize();
+	ring->tail = tail + avail;
+	
+	return avail;
 }
 /*
 static void fsl_closeall()
@@ -39,30 +97,252 @@ static void fsl_closeall()
 	}
 }
 */
+static int fsl_dev_write_n(int n, const uint32 * buf, int count);
+static int fsl_dev_read_n(int n, uint32 * buf, int count);
+static int fsl_dev_poll_fd(int n);
+static int fsl_dev_tryread_n(int n, uint32 * buf, int count);
+static int fsl_dev_trywrite_n(int n, const uint32 * buf, int count);
+static short fsl_dev_poll_out(int n);
+static int fsl_dev_numfsl(void);
+static uint32 fsl_dev_ptr_word(const void * ptr);
+static void * fsl_dev_word_ptr(uint32 word);
+
+const struct fsl_ops fsl_dev_ops = {
+	fsl_dev_write_n,
+	fsl_dev_read_n,
+	fsl_dev_poll_fd,
+	fsl_dev_tryread_n,
+	fsl_dev_trywrite_n,
+	fsl_dev_poll_out,
+	fsl_dev_numfsl,
+	fsl_dev_ptr_word,
+	fsl_dev_word_ptr
+};
+
+static const struct fsl_ops * fsl_ops = &fsl_dev_ops;
+
+void fsl_set_ops(const struct fsl_ops * ops)
+{
+	fsl_ops = ops;
+}
+
+const struct fsl_ops * fsl_get_ops(void)
+{
+	return fsl_ops;
+}
+
+// a lost word would corrupt the protocol with the hardware thread, so
+// failing single word transfers are fatal
 void fsl_write(int n, uint32 value)
 {	
+	if(fsl_write_n(n,&value,1) != 1){
+		fprintf(stderr,"Error writing to /dev/fsl%d\n",n);
+		exit(1);
+	}
+}
+
+uint32 fsl_read(int n)
+{
+	uint32 value;
+	
+	if(fsl_read_n(n,&value,1) != 1){
+		fprintf(stderr,"Error reading from /dev/fsl%d\n",n);
+		exit(1);
+	}
+	
+	return value;
+}
+
+int fsl_write_n(int n, const uint32 * buf, int count)
+{
+	return fsl_ops->write_n(n,buf,count);
+}
+
+int fsl_read_n(int n, uint32 * buf, int count)
+{
+	return fsl_ops->read_n(n,buf,count);
+}
+
+int fsl_poll_fd(int n)
+{
+	return fsl_ops->poll_fd(n);
+}
+
+int fsl_tryread_n(int n, uint32 * buf, int count)
+{
+	return fsl_ops->tryread_n(n,buf,count);
+}
+
+int fsl_trywrite_n(int n, const uint32 * buf, int count)
+{
+	return fsl_ops->trywrite_n(n,buf,count);
+}
+
+short fsl_poll_out(int n)
+{
+	return fsl_ops->poll_out(n);
+}
+
+int fsl_numfsl(void)
+{
+	return fsl_ops->numfsl();
+}
+
+uint32 fsl_ptr_word(const void * ptr)
+{
+	return fsl_ops->ptr_word(ptr);
+}
+
+void * fsl_word_ptr(uint32 word)
+{
+	return fsl_ops->word_ptr(word);
+}
+
+static int fsl_dev_write_n(int n, const uint32 * buf, int count)
+{
+	int res, done = 0;
+	
 	assert(n >= 0);
 	assert(n < MAX_FSL_DEVICES);
 	
 	if(fsl_fd[n] == -1) fsl_open(n);
 	
-	write(fsl_fd[n],&value,4);
-	FSL_DEBUG("wrote 0x%08X to fsl%d...\n",value,n);
+	while(done < count){
+		res = write(fsl_fd[n],buf + done,4*(count - done));
+		if(res < 0){
+			if(errno == EINTR) continue;
+			perror("fsl_write_n");
+			return done;
+		}
+		done += res/4;
+	}
+	FSL_DEBUG("wrote %d words (first 0x%08X) to fsl%d...\n",count,buf[0],n);
+	
+	return done;
 }
 
-uint32 fsl_read(int n)
+static int fsl_dev_read_n(int n, uint32 * buf, int count)
 {
-	uint32 value;
+	int res, done = 0;
 	
 	assert(n >= 0);
 	assert(n < MAX_FSL_DEVICES);	
 	
 	if(fsl_fd[n] == -1) fsl_open(n);
 	
-	read(fsl_fd[n],&value,4);
-	FSL_DEBUG("read 0x%08X from fsl%d...\n",value,n);
+	if(fsl_ring[n]){
+		while(done < count){
+			res = fsl_ring_get(fsl_ring[n],buf + done,count - done);
+			done += res;
+			if(res == 0 && ioctl(fsl_fd[n],FSL_IOCWAIT) < 0 && errno != EINTR){
+				perror("fsl_read_n");
+				return done;
+			}
+		}
+		FSL_DEBUG("read %d words (first 0x%08X) from ring of fsl%d...\n",count,buf[0],n);
+		return done;
+	}
 	
-	return value;
+	while(done < count){
+		res = read(fsl_fd[n],buf + done,4*(count - done));
+		if(res < 0){
+			if(errno == EINTR) continue;
+			perror("fsl_read_n");
+			return done;
+		}
+		done += res/4;
+	}
+	FSL_DEBUG("read %d words (first 0x%08X) from fsl%d...\n",count,buf[0],n);
+	
+	return done;
+}
+
+static int fsl_dev_poll_fd(int n)
+{
+	assert(n >= 0);
+	assert(n < MAX_FSL_DEVICES);
+	
+	if(fsl_fd_nb[n] == -1) fsl_fd_nb[n] = fsl_open_flags(n,O_RDWR | O_NONBLOCK);
+	
+	return fsl_fd_nb[n];
+}
+
+static int fsl_dev_tryread_n(int n, uint32 * buf, int count)
+{
+	int res;
+	
+	assert(n >= 0);
+	assert(n < MAX_FSL_DEVICES);
+	
+	if(fsl_fd[n] == -1) fsl_open(n);
+	if(fsl_ring[n]){
+		// the ring is filled by the interrupt handler, so poll() on the
+		// descriptor still reports new data
+		return fsl_ring_get(fsl_ring[n],buf,count);
+	}
+	
+	res = read(fsl_dev_poll_fd(n),buf,4*count);
+	if(res < 0){
+		if(errno != EAGAIN) perror("fsl_tryread_n");
+		return 0;
+	}
+	FSL_DEBUG("read %d of %d words from fsl%d without blocking\n",res/4,count,n);
+	
+	return res/4;
+}
+
+// the driver stashes one word if the FIFO is full and returns -EAGAIN
+// only if the stash is occupied as well
+static int fsl_dev_trywrite_n(int n, const uint32 * buf, int count)
+{
+	int res;
+	
+	assert(n >= 0);
+	assert(n < MAX_FSL_DEVICES);
+	
+	res = write(fsl_dev_poll_fd(n),buf,4*count);
+	if(res < 0){
+		if(errno != EAGAIN && errno != EINTR) perror("fsl_trywrite_n");
+		return 0;
+	}
+	FSL_DEBUG("wrote %d of %d words to fsl%d without blocking\n",res/4,count,n);
+	
+	return res/4;
+}
+
+// the driver reports POLLOUT once the stash has drained
+static short fsl_dev_poll_out(int n)
+{
+	return POLLOUT;
 }
 
+// number of fsl links of the MicroBlaze, from its processor version register.
+// Elsewhere, the /dev/fslN devices present are counted.
+static int fsl_dev_numfsl(void)
+{
+#ifdef __microblaze__
+	unsigned int pvr3;
+	asm volatile ("mfs %0,rPVR3" : "=d" (pvr3));
+	return 0x0000001F & (pvr3 >> 7);
+#else
+	char s[FSL_PATH_LEN];
+	int n;
 
+	for(n = 0; n < MAX_FSL_DEVICES; n++){
+		snprintf(s, FSL_PATH_LEN, "/dev/fsl%d", n);
+		if(access(s,F_OK)) break;
+	}
+	return n;
+#endif
+}
+
+// the hardware shares the 32 bit address space of the MicroBlaze
+static uint32 fsl_dev_ptr_word(const void * ptr)
+{
+	return (uint32)(unsigned long)ptr;
+}
+
+static void * fsl_dev_word_ptr(uint32 word)
+{
+	return (void *)(unsigned long)word;
+}
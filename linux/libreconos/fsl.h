@@ -7,4 +7,54 @@
 void fsl_write(int n, uint32 value);
 uint32 fsl_read(int n);
 
+// transfer 'count' words in a single call. blocks until all words have been
+// transferred and returns the number of words transferred, which is lower
+// than 'count' only on error.
+int fsl_write_n(int n, const uint32 * buf, int count);
+int fsl_read_n(int n, uint32 * buf, int count);
+
+// returns a non-blocking descriptor for fsl n that can be passed to poll().
+int fsl_poll_fd(int n);
+
+// reads up to 'count' words without blocking. returns the number of words read.
+int fsl_tryread_n(int n, uint32 * buf, int count);
+
+// writes up to 'count' words without blocking. returns the number of words written.
+int fsl_trywrite_n(int n, const uint32 * buf, int count);
+
+// poll() events to wait for on fsl_poll_fd(n) until fsl_trywrite_n can write
+// again. Has to be called anew before each poll().
+short fsl_poll_out(int n);
+
+// number of fsl links available.
+int fsl_numfsl(void);
+
+// hardware threads address memory with 32 bit words. fsl_ptr_word converts a
+// pointer into the word passed to a hardware thread (init data, state
+// buffers), fsl_word_ptr converts an address received from the hardware
+// (page faults) back into a pointer.
+uint32 fsl_ptr_word(const void * ptr);
+void * fsl_word_ptr(uint32 word);
+
+// transport behind the functions above. By default the words are transferred
+// through the character devices /dev/fslN of the fsl driver; fsl_emu.h
+// provides an in-process replacement for running without hardware.
+struct fsl_ops {
+	int (*write_n)(int n, const uint32 * buf, int count);
+	int (*read_n)(int n, uint32 * buf, int count);
+	int (*poll_fd)(int n);
+	int (*tryread_n)(int n, uint32 * buf, int count);
+	int (*trywrite_n)(int n, const uint32 * buf, int count);
+	short (*poll_out)(int n);
+	int (*numfsl)(void);
+	uint32 (*ptr_word)(const void * ptr);
+	void * (*word_ptr)(uint32 word);
+};
+
+extern const struct fsl_ops fsl_dev_ops;
+
+// must be called before the first transfer
+void fsl_set_ops(const struct fsl_ops * ops);
+const struct fsl_ops * fsl_get_ops(void);
+
 #endif
@@ -0,0 +1,473 @@
+#include "fsl_emu.h"
+#include "fsl.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#define RECONOS_ERROR(...) fprintf(stderr,"ERROR:" __VA_ARGS__);
+
+#define FSL_EMU_RING_SIZE 4096 // words, power of two
+#define FSL_EMU_SPIN      2000 // polls of an empty ring before sleeping
+
+// host addresses are split into windows of 2^FSL_EMU_WINDOW_SHIFT bytes, see fsl_emu_ptr_word
+#define FSL_EMU_WINDOW_SHIFT 26
+#define FSL_EMU_WINDOWS      (1 << (32 - FSL_EMU_WINDOW_SHIFT))
+#define FSL_EMU_WINDOW_MASK  ((1UL << FSL_EMU_WINDOW_SHIFT) - 1)
+
+#define FSL_EMU_FSL_A (FSL_EMU_NUMFSL - 2)
+#define FSL_EMU_FSL_B (FSL_EMU_NUMFSL - 1)
+
+// The producer only writes head, the consumer only writes tail. A consumer
+// that runs out of words spins for a while and then sleeps on the eventfd,
+// which the producer only signals if 'sleeping' is set or the consumer uses
+// poll(). Both sides issue a full barrier between publishing their own flag
+// or index and reading the other one, so no wake-up is lost. Likewise, a
+// producer that found the ring full and waits in poll() sets 'space_wanted',
+// and the consumer signals 'space_efd' once it has made room.
+struct fsl_emu_ring {
+	volatile uint32 head;
+	volatile uint32 tail;
+	volatile int sleeping;
+	volatile int polled;
+	volatile int space_wanted;
+	int efd;
+	int space_efd;
+	uint32 data[FSL_EMU_RING_SIZE];
+};
+
+// per link: to_hw is written by libreconos, to_sw by the hardware side
+static struct fsl_emu_ring to_hw[FSL_EMU_NUMFSL];
+static struct fsl_emu_ring to_sw[FSL_EMU_NUMFSL];
+
+// serializes the writers of the hardware side of proc_control fsl a
+static pthread_mutex_t fsl_emu_a_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// base address of each window in use. Window 0 is the lowest one, so that
+// NULL and small addresses are passed unchanged. Entries are only appended,
+// under fsl_emu_window_lock, and published by incrementing fsl_emu_num_windows.
+static unsigned long fsl_emu_window[FSL_EMU_WINDOWS];
+static volatile int fsl_emu_num_windows = 1;
+static pthread_mutex_t fsl_emu_window_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_t fsl_emu_proc_control_thread;
+static volatile uint32 fsl_emu_reset;
+static volatile uint32 fsl_emu_pgd_value;
+
+static void ring_init(struct fsl_emu_ring * ring)
+{
+	ring->head = 0;
+	ring->tail = 0;
+	ring->sleeping = 0;
+	ring->polled = 0;
+	ring->space_wanted = 0;
+	ring->efd = eventfd(0,EFD_NONBLOCK);
+	if(ring->efd < 0){
+		perror("eventfd");
+		exit(1);
+	}
+	ring->space_efd = -1;
+}
+
+static void efd_signal(int efd)
+{
+	uint64_t one = 1;
+	write(efd,&one,sizeof(one));
+}
+
+static void ring_signal(struct fsl_emu_ring * ring)
+{
+	efd_signal(ring->efd);
+}
+
+static void ring_drain(struct fsl_emu_ring * ring)
+{
+	uint64_t count;
+	read(ring->efd,&count,sizeof(count));
+}
+
+// copies up to 'count' words into the ring. returns the number of words copied.
+static int ring_tryput(struct fsl_emu_ring * ring, const uint32 * buf, int count)
+{
+	uint32 head = ring->head;
+	int i, space;
+
+	space = FSL_EMU_RING_SIZE - (head - ring->tail);
+	if(space == 0) return 0;
+	if(space > count) space = count;
+
+	for(i = 0; i < space; i++){
+		ring->data[(head + i) & (FSL_EMU_RING_SIZE - 1)] = buf[i];
+	}
+	__sync_synchronize();
+	ring->head = head + space;
+	__sync_synchronize();
+	if(ring->sleeping || ring->polled) ring_signal(ring);
+
+	return space;
+}
+
+static void ring_put(struct fsl_emu_ring * ring, const uint32 * buf, int count)
+{
+	int done;
+
+	while(count > 0){
+		done = ring_tryput(ring,buf,count);
+		if(done == 0) sched_yield();
+		buf += done;
+		count -= done;
+	}
+}
+
+// copies up to 'count' words out of the ring. returns the number of words copied.
+static int ring_get(struct fsl_emu_ring * ring, uint32 * buf, int count)
+{
+	uint32 tail = ring->tail;
+	int i, avail;
+
+	avail = ring->head - tail;
+	if(avail > count) avail = count;
+
+	__sync_synchronize();
+	for(i = 0; i < avail; i++){
+		buf[i] = ring->data[(tail + i) & (FSL_EMU_RING_SIZE - 1)];
+	}
+	__sync_synchronize();
+	ring->tail = tail + avail;
+	__sync_synchronize();
+	if(avail > 0 && ring->space_wanted){
+		ring->space_wanted = 0;
+		efd_signal(ring->space_efd);
+	}
+
+	return avail;
+}
+
+// waits until the ring holds at least one word
+static void ring_wait(struct fsl_emu_ring * ring)
+{
+	struct pollfd fd;
+	int i;
+
+	for(i = 0; i < FSL_EMU_SPIN; i++){
+		if(ring->head != ring->tail) return;
+	}
+
+	ring->sleeping = 1;
+	__sync_synchronize();
+	while(ring->head == ring->tail){
+		fd.fd = ring->efd;
+		fd.events = POLLIN;
+		if(poll(&fd,1,-1) < 0 && errno != EINTR){
+			perror("poll");
+			exit(1);
+		}
+		ring_drain(ring);
+	}
+	ring->sleeping = 0;
+}
+
+static void ring_read(struct fsl_emu_ring * ring, uint32 * buf, int count)
+{
+	int done = 0;
+
+	while(done < count){
+		done += ring_get(ring,buf + done,count - done);
+		if(done < count) ring_wait(ring);
+	}
+}
+
+// software side, see struct fsl_ops
+
+static int fsl_emu_write_n(int n, const uint32 * buf, int count)
+{
+	assert(n >= 0);
+	assert(n < FSL_EMU_NUMFSL);
+
+	ring_put(&to_hw[n],buf,count);
+
+	return count;
+}
+
+static int fsl_emu_read_n(int n, uint32 * buf, int count)
+{
+	assert(n >= 0);
+	assert(n < FSL_EMU_NUMFSL);
+
+	ring_read(&to_sw[n],buf,count);
+
+	return count;
+}
+
+static int fsl_emu_poll_fd(int n)
+{
+	struct fsl_emu_ring * ring;
+
+	assert(n >= 0);
+	assert(n < FSL_EMU_NUMFSL);
+
+	// words that arrived before the producer saw 'polled' have not been signaled
+	ring = &to_sw[n];
+	ring->polled = 1;
+	__sync_synchronize();
+	if(ring->head != ring->tail) ring_signal(ring);
+
+	return ring->efd;
+}
+
+static int fsl_emu_tryread_n(int n, uint32 * buf, int count)
+{
+	struct fsl_emu_ring * ring;
+	int res;
+
+	assert(n >= 0);
+	assert(n < FSL_EMU_NUMFSL);
+
+	ring = &to_sw[n];
+	res = ring_get(ring,buf,count);
+	if(res == 0 && ring->polled){
+		// clear the eventfd so that poll() blocks again. A word published
+		// in between is either found below or signals the eventfd anew.
+		ring_drain(ring);
+		res = ring_get(ring,buf,count);
+	}
+
+	return res;
+}
+
+static int fsl_emu_trywrite_n(int n, const uint32 * buf, int count)
+{
+	assert(n >= 0);
+	assert(n < FSL_EMU_NUMFSL);
+
+	return ring_tryput(&to_hw[n],buf,count);
+}
+
+// the eventfd returned by fsl_emu_poll_fd also signals room in to_hw[n], so
+// the caller waits for POLLIN. Stale signals are cleared first.
+static short fsl_emu_poll_out(int n)
+{
+	struct fsl_emu_ring * ring;
+
+	assert(n >= 0);
+	assert(n < FSL_EMU_NUMFSL);
+
+	ring_drain(&to_sw[n]);
+	if(to_sw[n].head != to_sw[n].tail) ring_signal(&to_sw[n]);
+
+	ring = &to_hw[n];
+	ring->space_wanted = 1;
+	__sync_synchronize();
+	if(ring->head - ring->tail < FSL_EMU_RING_SIZE) ring_signal(&to_sw[n]);
+
+	return POLLIN;
+}
+
+static int fsl_emu_numfsl(void)
+{
+	return FSL_EMU_NUMFSL;
+}
+
+static int window_find(unsigned long base)
+{
+	int i, n = fsl_emu_num_windows;
+
+	__sync_synchronize();
+	for(i = 0; i < n; i++){
+		if(fsl_emu_window[i] == base) return i;
+	}
+
+	return -1;
+}
+
+// Host pointers may be wider than the 32 bit words of the fsl. A word holds
+// the index of the window of the pointer in its upper bits and the offset
+// into the window in the lower ones, so addresses the hardware side computes
+// from a word (buffer + offset) map back as well. Each new window is added
+// along with the one following it, for buffers that cross a window boundary.
+// Buffers larger than a window are not supported.
+static uint32 fsl_emu_ptr_word(const void * ptr)
+{
+	unsigned long addr = (unsigned long)ptr;
+	unsigned long base = addr & ~FSL_EMU_WINDOW_MASK;
+	int i;
+
+	if(sizeof(void *) == sizeof(uint32)) return addr;
+
+	i = window_find(base);
+	if(i < 0){
+		pthread_mutex_lock(&fsl_emu_window_lock);
+		i = window_find(base);
+		if(i < 0){
+			i = fsl_emu_num_windows;
+			if(i + 2 > FSL_EMU_WINDOWS){
+				RECONOS_ERROR("fsl emulation: no window left for address %p\n",ptr);
+				exit(1);
+			}
+			fsl_emu_window[i] = base;
+			fsl_emu_window[i + 1] = base + FSL_EMU_WINDOW_MASK + 1;
+			__sync_synchronize();
+			fsl_emu_num_windows = i + 2;
+		}
+		pthread_mutex_unlock(&fsl_emu_window_lock);
+	}
+
+	return (i << FSL_EMU_WINDOW_SHIFT) | (addr & FSL_EMU_WINDOW_MASK);
+}
+
+static void * fsl_emu_word_ptr(uint32 word)
+{
+	int i = word >> FSL_EMU_WINDOW_SHIFT;
+
+	if(sizeof(void *) == sizeof(uint32)) return (void *)(unsigned long)word;
+
+	if(i >= fsl_emu_num_windows){
+		RECONOS_ERROR("fsl emulation: 0x%08X is not an address passed to the hardware side\n",word);
+		exit(1);
+	}
+	__sync_synchronize();
+
+	return (void *)(fsl_emu_window[i] + (word & FSL_EMU_WINDOW_MASK));
+}
+
+static const struct fsl_ops fsl_emu_ops = {
+	fsl_emu_write_n,
+	fsl_emu_read_n,
+	fsl_emu_poll_fd,
+	fsl_emu_tryread_n,
+	fsl_emu_trywrite_n,
+	fsl_emu_poll_out,
+	fsl_emu_numfsl,
+	fsl_emu_ptr_word,
+	fsl_emu_word_ptr
+};
+
+// hardware side
+
+void fsl_emu_hw_write_n(int n, const uint32 * buf, int count)
+{
+	assert(n >= 0);
+	assert(n < FSL_EMU_NUMFSL);
+
+	ring_put(&to_sw[n],buf,count);
+}
+
+void fsl_emu_hw_read_n(int n, uint32 * buf, int count)
+{
+	assert(n >= 0);
+	assert(n < FSL_EMU_NUMFSL);
+
+	ring_read(&to_hw[n],buf,count);
+}
+
+int fsl_emu_page_fault(int slot, const void * addr)
+{
+	uint32 req[2];
+	uint32 reply;
+
+	req[0] = slot < 0 ? 0x00000001 : 0x00001001 | (slot << 8);
+	req[1] = fsl_ptr_word(addr);
+
+	pthread_mutex_lock(&fsl_emu_a_lock);
+	fsl_emu_hw_write_n(FSL_EMU_FSL_A,req,2);
+	fsl_emu_hw_read_n(FSL_EMU_FSL_A,&reply,1);
+	pthread_mutex_unlock(&fsl_emu_a_lock);
+
+	if((reply >> 24) != 0x03){
+		RECONOS_ERROR("proc_control emulation: 0x%08X instead of page ready\n",reply);
+		exit(1);
+	}
+
+	return reply & 0x00000001;
+}
+
+uint32 fsl_emu_reset_mask(void)
+{
+	return fsl_emu_reset;
+}
+
+uint32 fsl_emu_pgd(void)
+{
+	return fsl_emu_pgd_value;
+}
+
+// serves the requests libreconos sends on proc_control fsl b, see
+// proc_control.vhd. The emulation has no MMU, so all its counters read 0.
+static void * fsl_emu_proc_control_entry(void * arg)
+{
+	uint32 cmd, word;
+	uint32 zero[5] = {0,0,0,0,0};
+
+	while(1){
+		fsl_emu_hw_read_n(FSL_EMU_FSL_B,&cmd,1);
+
+		switch(cmd >> 24){
+			case 0x01: // slot reset mask
+				fsl_emu_reset = cmd & 0x0000FFFF;
+				break;
+
+			case 0x02: // page directory
+				fsl_emu_hw_read_n(FSL_EMU_FSL_B,&word,1);
+				fsl_emu_pgd_value = word;
+				break;
+
+			case 0x04: // reset of all slots and the MMU
+				fsl_emu_reset = 0x0000FFFF;
+				fsl_emu_pgd_value = 0;
+				break;
+
+			case 0x05: // TLB hits and misses
+				fsl_emu_hw_write_n(FSL_EMU_FSL_B,zero,2);
+				break;
+
+			case 0x06: // selftest, answered on both links
+				word = 0x5E1F7E57;
+				fsl_emu_hw_write_n(FSL_EMU_FSL_B,&word,1);
+				word = 0x00000002;
+				pthread_mutex_lock(&fsl_emu_a_lock);
+				fsl_emu_hw_write_n(FSL_EMU_FSL_A,&word,1);
+				pthread_mutex_unlock(&fsl_emu_a_lock);
+				break;
+
+			case 0x07: // per slot MMU counters
+				fsl_emu_hw_write_n(FSL_EMU_FSL_B,zero,5);
+				break;
+
+			case 0x08: // arbiter configuration, ignored without an arbiter
+				fsl_emu_hw_read_n(FSL_EMU_FSL_B,&word,1);
+				fsl_emu_hw_write_n(FSL_EMU_FSL_B,zero,1);
+				break;
+
+			default:
+				RECONOS_ERROR("proc_control emulation: unknown command 0x%08X\n",cmd);
+				exit(1);
+		}
+	}
+
+	return NULL;
+}
+
+void fsl_emu_init(void)
+{
+	int i;
+
+	for(i = 0; i < FSL_EMU_NUMFSL; i++){
+		ring_init(&to_hw[i]);
+		ring_init(&to_sw[i]);
+		to_hw[i].space_efd = to_sw[i].efd;
+	}
+
+	fsl_set_ops(&fsl_emu_ops);
+
+	if(pthread_create(&fsl_emu_proc_control_thread,NULL,fsl_emu_proc_control_entry,NULL)){
+		perror("pthread_create: proc_control emulation");
+		exit(1);
+	}
+}
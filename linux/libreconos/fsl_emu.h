@@ -0,0 +1,42 @@
+#ifndef FSL_EMU_H
+#define FSL_EMU_H
+
+#include "config.h"
+#include "fsl.h"
+
+// In-process fsl transport for running libreconos without ReconOS hardware,
+// e.g. on a x86 Linux box. Every fsl link is a pair of lock-free single
+// producer, single consumer word rings, one towards the hardware side and
+// one back. The hardware side of a slot is driven by a software thread using
+// the osif_* calls of osif_emu.h; the two links following the slots are
+// served by a stand-in for proc_control.
+//
+// Words that carry pointers (init data, state buffers, page fault addresses)
+// are converted with fsl_ptr_word and fsl_word_ptr of fsl.h, which map host
+// pointers of any width to 32 bit words. The hardware side uses the same
+// functions, so the emulation also runs natively on 64 bit hosts.
+
+// MAX_SLOTS slots followed by proc_control fsl a and b, as on the hardware
+#define FSL_EMU_NUMFSL (MAX_SLOTS + 2)
+
+// switches libreconos to the emulated transport and starts the proc_control
+// stand-in. Must be called before reconos_init or reconos_init_autodetect.
+void fsl_emu_init(void);
+
+// hardware side of link n: blocking transfers of 'count' words
+void fsl_emu_hw_write_n(int n, const uint32 * buf, int count);
+void fsl_emu_hw_read_n(int n, uint32 * buf, int count);
+
+// reports a page fault of the hardware thread in 'slot' at addr to the control
+// thread of libreconos, like the MMU does, and returns once the page ready reply
+// has arrived. slot is -1 for a proc_control that does not know the slot
+// (C_FAULT_SLOT = 0), in which case a fault at an invalid address ends the
+// process. Returns 1 if the request has been aborted because the slot has been
+// quarantined, 0 otherwise.
+int fsl_emu_page_fault(int slot, const void * addr);
+
+// state the proc_control stand-in has been given
+uint32 fsl_emu_reset_mask(void);
+uint32 fsl_emu_pgd(void);
+
+#endif
@@ -3,14 +3,21 @@
 #include "fsl.h"
 #include "mbox.h"
 #include "rq.h"
+#include "dispatcher.h"
+#include "delegate.h"
+#include "scheduler.h"
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <pthread.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <sys/time.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
 
 #if 0
 #define RECONOS_DEBUG(...) fprintf(stderr,__VA_ARGS__);
@@ -22,15 +29,36 @@
 
 #define FSL_PATH_LEN 256
 
+#define RECONOS_PAGE_SIZE 4096
+#define RECONOS_HUGE_PAGE_SIZE (4*1024*1024)
+
+// see getpgd.c
+struct getpgd_range {
+	unsigned long vaddr;
+	unsigned long len;
+};
+
+#define GETPGD_IOC_MAGIC 'g'
+#define GETPGD_IOCFLUSH      _IOW(GETPGD_IOC_MAGIC,0x01,struct getpgd_range)
+#define GETPGD_IOCINVALIDATE _IOW(GETPGD_IOC_MAGIC,0x02,struct getpgd_range)
+
 struct reconos_process reconos_proc;
 
+// with the emulated fsl links of fsl_emu.h there is no getpgd module and no
+// hardware sharing the data cache
+static int reconos_emulated(void)
+{
+	return fsl_get_ops() != &fsl_dev_ops;
+}
 
-static void slot_reset(int num, int reset){
+void reconos_slot_reset(int num, int reset){
 	uint32 cmd;
 	uint32 mask = 0;
 	int i;
 	
 	if (reset) {
+		// the thread is restarted or quarantined and waits for no delay anymore
+		delegate_cancel_delay(num);
 		reconos_proc.slot_flags[num] |= SLOT_FLAG_RESET;
 	} else {
 		reconos_proc.slot_flags[num] &= ~SLOT_FLAG_RESET;
@@ -45,7 +73,30 @@ static void slot_reset(int num, int reset){
 	
 	cmd = mask | 0x01000000;
 	
+	pthread_mutex_lock(&reconos_proc.proc_control_lock);
 	fsl_write(reconos_proc.proc_control_fsl_b,cmd);
+	pthread_mutex_unlock(&reconos_proc.proc_control_lock);
+}
+
+int reconos_slot_status(int slot, struct reconos_slot_status * status)
+{
+	if(slot < 0 || slot >= MAX_SLOTS) return RECONOS_SLOT_OK;
+
+	if(status) *status = reconos_proc.slot_status[slot];
+
+	return reconos_proc.slot_status[slot].error;
+}
+
+void reconos_slot_restart(int slot)
+{
+	uint32 buf[16];
+
+	reconos_slot_reset(slot,1);
+	if(reconos_proc.slot_status[slot].error != RECONOS_SLOT_OK){
+		while(fsl_tryread_n(slot,buf,16) > 0);
+		reconos_proc.slot_status[slot].error = RECONOS_SLOT_OK;
+	}
+	reconos_slot_reset(slot,0);
 }
 
 uint32 getpgd()
@@ -53,6 +104,8 @@ uint32 getpgd()
 	int res,fd;
 	uint32 pgd;
 
+	if(reconos_emulated()) return 0;
+
 	fd = open("/dev/getpgd",O_RDONLY);
 	if(fd == -1){
 		perror("open /dev/getpgd");
@@ -76,20 +129,63 @@ void reconos_mmu_stats(uint32 * tlb_hits, uint32 * tlb_misses, uint32 * page_fau
 {
 	uint32 hits,misses;
 	
+	pthread_mutex_lock(&reconos_proc.proc_control_lock);
 	fsl_write(reconos_proc.proc_control_fsl_b,0x05000000);
 	hits = fsl_read(reconos_proc.proc_control_fsl_b);
 	misses = fsl_read(reconos_proc.proc_control_fsl_b);
+	pthread_mutex_unlock(&reconos_proc.proc_control_lock);
 	
 	if(page_faults) *page_faults = reconos_proc.page_faults;
 	if(tlb_misses) *tlb_misses = misses;
 	if(tlb_hits) *tlb_hits = hits;
 }
 
+void reconos_mmu_stats_slot(int slot, struct reconos_mmu_slot_stats * stats, int reset)
+{
+	uint32 cmd;
+
+	// the counters are returned in the order of struct reconos_mmu_slot_stats
+	cmd = 0x07000000 | (slot & 0x0F);
+	if(reset) cmd |= 0x00000100;
+
+	pthread_mutex_lock(&reconos_proc.proc_control_lock);
+	fsl_write(reconos_proc.proc_control_fsl_b,cmd);
+	stats->tlb_hits = fsl_read(reconos_proc.proc_control_fsl_b);
+	stats->tlb_misses = fsl_read(reconos_proc.proc_control_fsl_b);
+	stats->walk_cycles = fsl_read(reconos_proc.proc_control_fsl_b);
+	stats->page_faults = fsl_read(reconos_proc.proc_control_fsl_b);
+	stats->stall_cycles = fsl_read(reconos_proc.proc_control_fsl_b);
+	pthread_mutex_unlock(&reconos_proc.proc_control_lock);
+}
+
+int reconos_arbiter_set(int port, int weight, int prio, int cap)
+{
+	uint32 config;
+	uint32 active;
+
+	config = (weight & 0x0F) | ((prio & 0x03) << 8) | ((cap & 0xFF) << 16);
+
+	pthread_mutex_lock(&reconos_proc.proc_control_lock);
+	fsl_write(reconos_proc.proc_control_fsl_b,0x08000000 | (port & 0x0F));
+	fsl_write(reconos_proc.proc_control_fsl_b,config);
+	active = fsl_read(reconos_proc.proc_control_fsl_b);
+	pthread_mutex_unlock(&reconos_proc.proc_control_lock);
+
+	if(!active){
+		RECONOS_ERROR("arbiter configuration of port %d ignored: round robin arbiter or arb_active not connected\n", port);
+		return -1;
+	}
+
+	return 0;
+}
+
 void proc_control_selftest()
 {
 	uint32 result;
+	pthread_mutex_lock(&reconos_proc.proc_control_lock);
 	fsl_write(reconos_proc.proc_control_fsl_b,0x06000000);
 	result = fsl_read(reconos_proc.proc_control_fsl_b);
+	pthread_mutex_unlock(&reconos_proc.proc_control_lock);
 	if(result == 0x5E1F7E57){
 		fprintf(stderr,"PROC_CONTROL selftest part 1 success\n");
 	} else {
@@ -101,36 +197,285 @@ void proc_control_selftest()
 void cache_flush(void)
 {
 	int foo = 1;
+	if(reconos_emulated()) return;
 	write(reconos_proc.fd_cache,&foo,(sizeof(foo)));
 }
 
+void cache_flush_range(void * ptr, size_t len)
+{
+	struct getpgd_range range;
+
+	if(reconos_emulated()) return;
+
+	range.vaddr = (unsigned long)ptr;
+	range.len   = len;
+
+	// fall back to a full flush if the getpgd module has no range support
+	if(ioctl(reconos_proc.fd_cache,GETPGD_IOCFLUSH,&range) < 0){
+		cache_flush();
+	}
+}
+
+void cache_invalidate_range(void * ptr, size_t len)
+{
+	struct getpgd_range range;
+
+	if(reconos_emulated()) return;
+
+	range.vaddr = (unsigned long)ptr;
+	range.len   = len;
+
+	if(ioctl(reconos_proc.fd_cache,GETPGD_IOCINVALIDATE,&range) < 0){
+		perror("ioctl GETPGD_IOCINVALIDATE");
+		exit(1);
+	}
+}
+
+
+// returns the end of the writable mapping that contains addr, or 0 if there is none.
+// The last writable mapping found is cached, so that /proc/self/maps is only
+// read again for a fault outside of it or once part of it has been unmapped.
+// A mapping that is made read-only with mprotect is not noticed.
+static unsigned long fault_vma_end(unsigned long addr)
+{
+	FILE * maps;
+	unsigned long start, end;
+	char perms[5];
+	unsigned long res = 0;
+
+	start = addr & ~(RECONOS_PAGE_SIZE - 1);
+	if(addr >= reconos_proc.fault_vma_start && addr < reconos_proc.fault_vma_end){
+		// fails with ENOMEM if the range is no longer mapped as a whole
+		if(msync((void*)start,reconos_proc.fault_vma_end - start,MS_ASYNC) == 0){
+			return reconos_proc.fault_vma_end;
+		}
+	}
+	reconos_proc.fault_vma_start = 0;
+	reconos_proc.fault_vma_end = 0;
+
+	maps = fopen("/proc/self/maps","r");
+	if(!maps){
+		perror("open /proc/self/maps");
+		return 0;
+	}
+
+	while(fscanf(maps,"%lx-%lx %4s%*[^\n]",&start,&end,perms) == 3){
+		if(addr >= start && addr < end){
+			if(perms[1] == 'w'){
+				reconos_proc.fault_vma_start = start;
+				reconos_proc.fault_vma_end = end;
+				res = end;
+			}
+			break;
+		}
+	}
+
+	fclose(maps);
+
+	return res;
+}
+
+// writes 0 to the faulting word through the kernel, which fails with EFAULT
+// instead of killing the process if addr is not mapped writable.
+// Returns -1 in that case.
+static int fault_probe(uint32 * addr)
+{
+	if(read(reconos_proc.fd_zero,addr,sizeof(uint32)) != sizeof(uint32)) return -1;
+
+	return 0;
+}
+
+// holds 'slot' in reset after a page fault outside of any writable mapping,
+// like delegate_quarantine does for invalid commands
+static void fault_quarantine(int slot, uint32 cmd, uint32 addr)
+{
+	struct reconos_slot_status * status = &reconos_proc.slot_status[slot];
+
+	// the remaining bursts of the request fault as well
+	if(status->error != RECONOS_SLOT_OK) return;
+
+	RECONOS_ERROR("slot %d: quarantined after page fault @ 0x%08X\n", slot, addr);
+
+	status->cmd = cmd;
+	status->arg = addr;
+	status->error = RECONOS_SLOT_ERR_FAULT;
+
+	reconos_slot_reset(slot, 1);
+}
+
+// touches up to reconos_proc.fault_around pages following the faulting page
+// and returns the number of pages touched.
+// The pages are only touched if they belong to the same writable mapping.
+// The atomic or keeps their contents, since they might already be in use.
+static int fault_around(unsigned long addr)
+{
+	unsigned long end, page;
+	int i;
+
+	end = fault_vma_end(addr);
+	page = (addr & ~(RECONOS_PAGE_SIZE - 1)) + RECONOS_PAGE_SIZE;
+
+	for(i = 0; i < reconos_proc.fault_around && page < end; i++){
+		__sync_fetch_and_or((uint32*)page,0);
+		page += RECONOS_PAGE_SIZE;
+	}
+
+	reconos_proc.prefetched_pages += i;
+
+	return i;
+}
+
+void reconos_mmu_fault_around(int pages)
+{
+	reconos_proc.fault_around = pages < 0 ? 0 : pages;
+}
+
+void reconos_mmu_fault_stats(uint32 * prefetched_pages, uint32 * flushes, uint32 * fault_time_us)
+{
+	if(prefetched_pages) *prefetched_pages = reconos_proc.prefetched_pages;
+	if(flushes) *flushes = reconos_proc.fault_flushes;
+	if(fault_time_us) *fault_time_us = reconos_proc.fault_time_us;
+}
+
+int reconos_buffer_prepare(void * ptr, size_t len)
+{
+	unsigned long page, end;
+	int res = 0;
+
+	page = (unsigned long)ptr & ~(RECONOS_PAGE_SIZE - 1);
+	end  = (unsigned long)ptr + len;
+
+	// make every page present and writable without changing its contents
+	for(; page < end; page += RECONOS_PAGE_SIZE){
+		__sync_fetch_and_or((uint32*)page,0);
+	}
+
+	// keep the pages from being swapped out or migrated while hardware uses them
+	if(mlock(ptr,len) == -1){
+		perror("mlock");
+		res = -1;
+	}
+
+	cache_flush_range(ptr,len);
+
+	return res;
+}
+
+void * reconos_buffer_alloc(size_t len)
+{
+	void * ptr;
+
+	if(posix_memalign(&ptr,RECONOS_PAGE_SIZE,len)){
+		RECONOS_ERROR("could not allocate %u byte buffer\n",(unsigned int)len);
+		return NULL;
+	}
+
+	reconos_buffer_prepare(ptr,len);
+
+	return ptr;
+}
+
+void reconos_buffer_free(void * ptr, size_t len)
+{
+	munlock(ptr,len);
+	free(ptr);
+}
+
+void * reconos_buffer_alloc_huge(size_t len, int * huge)
+{
+	void * ptr = MAP_FAILED;
+
+	len = (len + RECONOS_HUGE_PAGE_SIZE - 1) & ~(RECONOS_HUGE_PAGE_SIZE - 1);
+
+#ifdef MAP_HUGETLB
+	ptr = mmap(NULL,len,PROT_READ | PROT_WRITE,MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,-1,0);
+#endif
+	if(huge) *huge = (ptr != MAP_FAILED);
+	if(ptr == MAP_FAILED){
+		// no huge pages available (no hugetlb in the kernel, e.g. on
+		// MicroBlaze), use normal pages instead
+		RECONOS_DEBUG("no huge pages, buffer uses 4 kB pages\n");
+		ptr = mmap(NULL,len,PROT_READ | PROT_WRITE,MAP_PRIVATE | MAP_ANONYMOUS,-1,0);
+		if(ptr == MAP_FAILED){
+			perror("mmap");
+			return NULL;
+		}
+	}
+
+	reconos_buffer_prepare(ptr,len);
+
+	return ptr;
+}
+
+void reconos_buffer_free_huge(void * ptr, size_t len)
+{
+	len = (len + RECONOS_HUGE_PAGE_SIZE - 1) & ~(RECONOS_HUGE_PAGE_SIZE - 1);
+
+	munlock(ptr,len);
+	munmap(ptr,len);
+}
 
 void * control_thread_entry(void * arg)
 {
+	uint32 * bad_addr = NULL;
+
 	RECONOS_DEBUG("control thread listening on fsl %d\n",reconos_proc.proc_control_fsl_a);
 	while(1){
 		uint32 cmd;
 		uint32 ret;
+		uint32 word;
 		uint32 *addr;
+		int slot;
+		int pages;
+		struct timeval t_start, t_stop;
 	
 
 		/* receive page fault address */
 		cmd = fsl_read(reconos_proc.proc_control_fsl_a);
 		RECONOS_DEBUG("control thread received 0x%08X\n", cmd);
 		
-		if(cmd == 0x00000001){	
-			addr = (uint32*)fsl_read(reconos_proc.proc_control_fsl_a);
+		/* bit 12 is set if bits 11..8 hold the faulting slot, see proc_control.vhd */
+		if((cmd & 0x000000FF) == 0x00000001){
+			word = fsl_read(reconos_proc.proc_control_fsl_a);
+			addr = fsl_word_ptr(word);
+			slot = (cmd & 0x00001000) ? (cmd >> 8) & 0x0000000F : -1;
+			gettimeofday(&t_start,NULL);
 			reconos_proc.page_faults++;
-			RECONOS_DEBUG("control thread received page fault @ 0x%08X\n",(uint32)addr);
+			RECONOS_DEBUG("control thread received page fault @ %p, slot %d\n",addr,slot);
 		
-			*addr = 0;   /* this page has not been touched yet. we can safely write 0 to the page */
-			cache_flush();
-			ret = *addr;
-	
-			ret = ret & 0x00FFFFFF; /* clear upper 8 bits */
-			ret = ret | 0x03000000; /* set page ready command */
+			/* this page has not been touched yet. we can safely write 0 to the page */
+			if(fault_probe(addr) < 0){
+				if(addr != bad_addr){
+					RECONOS_ERROR("page fault @ %p outside of any writable mapping\n",addr);
+					bad_addr = addr;
+				}
+				reconos_proc.bad_faults++;
+				if(slot < 0){
+					/* without the slot there is nothing to quarantine, and a
+					   page ready reply would only let the request fault again
+					   forever. */
+					RECONOS_ERROR("the faulting slot is unknown, proc_control needs C_FAULT_SLOT = 1\n");
+					exit(1);
+				}
+				/* the MMU drops the request while the slot is held in reset */
+				fault_quarantine(slot,cmd,word);
+				ret = 0x03000001;
+			} else {
+				pages = 1;
+				if(reconos_proc.fault_around > 0){
+					pages += fault_around((unsigned long)addr);
+				}
+				/* one flush for the whole batch, including its page table entries */
+				cache_flush_range((void*)((unsigned long)addr & ~(RECONOS_PAGE_SIZE - 1)),pages*RECONOS_PAGE_SIZE);
+				reconos_proc.fault_flushes++;
+				ret = 0x03000000; /* page ready */
+			}
+
+			fsl_write(reconos_proc.proc_control_fsl_a,ret); /* Note: the lower 24 bits of ret are ignored by the HW, except for bit 0 (abort). */
 
-			fsl_write(reconos_proc.proc_control_fsl_a,ret); /* Note: the lower 24 bits of ret are ignored by the HW. */
+			gettimeofday(&t_stop,NULL);
+			reconos_proc.fault_time_us += (t_stop.tv_sec - t_start.tv_sec)*1000000
+			                            + (t_stop.tv_usec - t_start.tv_usec);
 		}
 		if(cmd == 0x00000002){
 			fprintf(stderr,"PROC_CONTROL selftest part 2 success\n");
@@ -140,10 +485,8 @@ void * control_thread_entry(void * arg)
 
 int get_numfsl()
 {
-	unsigned int pvr3;
-	asm volatile ("mfs %0,rPVR3" : "=d" (pvr3));
-	return 0x0000001F & (pvr3 >> 7);
-}	
+	return fsl_numfsl();
+}
 
 int reconos_init(int proc_control_fsl_a, int proc_control_fsl_b)
 {
@@ -153,8 +496,19 @@ int reconos_init(int proc_control_fsl_a, int proc_control_fsl_b)
 
 	reconos_proc.proc_control_fsl_a = proc_control_fsl_a;
 	reconos_proc.proc_control_fsl_b = proc_control_fsl_b;
+	pthread_mutex_init(&reconos_proc.proc_control_lock,NULL);
 
 	reconos_proc.page_faults = 0;
+	reconos_proc.prefetched_pages = 0;
+	reconos_proc.fault_flushes = 0;
+	reconos_proc.fault_time_us = 0;
+	reconos_proc.fault_around = 0;
+	reconos_proc.fault_vma_start = 0;
+	reconos_proc.fault_vma_end = 0;
+	reconos_proc.bad_faults = 0;
+	if(getenv("RECONOS_FAULT_AROUND")){
+		reconos_mmu_fault_around(atoi(getenv("RECONOS_FAULT_AROUND")));
+	}
 	for(i = 0; i < MAX_SLOTS; i++){
 		reconos_proc.slot_flags[i] |= SLOT_FLAG_RESET;
 	}
@@ -166,6 +520,12 @@ int reconos_init(int proc_control_fsl_a, int proc_control_fsl_b)
 	fsl_write(proc_control_fsl_b,0x02000000);
 	fsl_write(proc_control_fsl_b,pgd);
 
+	reconos_proc.fd_zero = open("/dev/zero", O_RDONLY);
+	if(reconos_proc.fd_zero < 0){
+		perror("open /dev/zero");
+		exit(1);
+	}
+
 	pthread_attr_init(&attr);	
 	pthread_create(&reconos_proc.proc_control_thread, NULL, control_thread_entry,NULL);
 
@@ -175,6 +535,13 @@ int reconos_init(int proc_control_fsl_a, int proc_control_fsl_b)
 	return 0;
 }
 
+void reconos_monitor_init(int proc_control_fsl_a, int proc_control_fsl_b)
+{
+	reconos_proc.proc_control_fsl_a = proc_control_fsl_a;
+	reconos_proc.proc_control_fsl_b = proc_control_fsl_b;
+	pthread_mutex_init(&reconos_proc.proc_control_lock,NULL);
+}
+
 int reconos_init_autodetect()
 {
 	int n;
@@ -184,420 +551,75 @@ int reconos_init_autodetect()
 }
 
 
-void * delegate_thread_entry(void * arg);
-
 int reconos_hwt_create(
 		struct reconos_hwt * hwt,
 		int slot,
 		void * arg)
 {
 	hwt->slot = slot;
+	hwt->dispatched = 0;
+	hwt->shared = 0;
+	
+	reconos_slot_restart(hwt->slot);
+	
 	return pthread_create(&hwt->delegate,NULL,delegate_thread_entry,hwt);
 }
 
-void reconos_hwt_setresources(struct reconos_hwt * hwt, struct reconos_resource * res, int num_resources)
+int reconos_hwt_create_dispatched(
+		struct reconos_hwt * hwt,
+		int slot,
+		void * arg)
 {
-	hwt->resources = res;
-	hwt->num_resources = num_resources;
+	hwt->slot = slot;
+	hwt->dispatched = 1;
+	hwt->shared = 0;
+	
+	reconos_slot_restart(hwt->slot);
+	
+	return dispatcher_add(hwt);
 }
 
-void reconos_hwt_setinitdata(struct reconos_hwt * hwt, void * init_data)
+int reconos_hwt_create_shared(
+		struct reconos_hwt * hwt,
+		uint32 slot_mask,
+		void * arg)
 {
-	hwt->init_data = init_data;
+	hwt->slot = -1;
+	hwt->dispatched = 0;
+	hwt->shared = 1;
+	hwt->slot_mask = slot_mask;
+	
+	return scheduler_add(hwt);
 }
 
-
-void * delegate_thread_entry(void * arg)
+void reconos_hwt_join(struct reconos_hwt * hwt)
 {
-	struct reconos_hwt * hwt;
-	
-	hwt = (struct reconos_hwt *)arg;
-
-	RECONOS_DEBUG("slot %d: starting delegate thread\n", hwt->slot);
-	
-	slot_reset(hwt->slot,1);
-	slot_reset(hwt->slot,0);
-	
-	while(1){
-		uint32 cmd;
-		uint32 handle;
-		uint32 handle2;
-		uint32 arg0;
-		uint32 result;
-		uint32 msg_size;
-		uint32* msg;
-		int i;
-		
-		cmd = fsl_read(hwt->slot);
-		
-		RECONOS_DEBUG("slot %d: received command 0x%08X\n", hwt->slot, cmd);
-		
-		switch(cmd){
-			case RECONOS_CMD_MBOX_GET:
-				RECONOS_DEBUG("slot %d: command is MBOX_GET\n", hwt->slot);
-				handle = fsl_read(hwt->slot);
-				RECONOS_DEBUG("slot %d: resource id is 0x%08X\n", hwt->slot, handle);
-			
-				if(handle >= hwt->num_resources){
-					RECONOS_ERROR("slot %d: resource id %d out of range, must be lesser than %d\n",
-						hwt->slot, handle, hwt->num_resources);
-					exit(1);
-				}
-				
-				if(hwt->resources[handle].type != RECONOS_TYPE_MBOX){
-					RECONOS_ERROR("slot %d: resource type 0x%08X expected, found 0x%08X\n",
-						hwt->slot, RECONOS_TYPE_MBOX, hwt->resources[handle].type);
-					exit(1);
-				}
-				
-			
-				result = mbox_get(hwt->resources[handle].ptr);
-				RECONOS_DEBUG("slot %d: mbox_get returns 0x%08X\n", hwt->slot, result);
-				
-				fsl_write(hwt->slot, result);
-				break;	
-			
-			case RECONOS_CMD_MBOX_PUT:
-				RECONOS_DEBUG("slot %d: command is MBOX_PUT\n", hwt->slot);
-				handle = fsl_read(hwt->slot);
-				RECONOS_DEBUG("slot %d: resource id is 0x%08X\n", hwt->slot, handle);
-				arg0 = fsl_read(hwt->slot);
-				RECONOS_DEBUG("slot %d: data is 0x%08X\n", hwt->slot, arg0);
-				
-				if(handle >= hwt->num_resources){
-					RECONOS_ERROR("slot %d: resource id %d out of range, must be lesser than %d\n",
-						hwt->slot, handle, hwt->num_resources);
-					exit(1);
-				}
-				
-				if(hwt->resources[handle].type != RECONOS_TYPE_MBOX){
-					RECONOS_ERROR("slot %d: resource type 0x%08X expected, found 0x%08X\n",
-						hwt->slot, RECONOS_TYPE_MBOX, hwt->resources[handle].type);
-					exit(1);
-				}
-				
-				mbox_put(hwt->resources[handle].ptr, arg0);
-				RECONOS_DEBUG("slot %d: mbox_put returns void\n", hwt->slot);
-				
-				fsl_write(hwt->slot, 0);
-				break;
-
-			case RECONOS_CMD_SEM_WAIT:
-				RECONOS_DEBUG("slot %d: command is SEM_WAIT\n", hwt->slot);
-				handle = fsl_read(hwt->slot);
-				RECONOS_DEBUG("slot %d: resource id is 0x%08X\n", hwt->slot, handle);
-			
-				if(handle >= hwt->num_resources){
-					RECONOS_ERROR("slot %d: resource id %d out of range, must be lesser than %d\n",
-						hwt->slot, handle, hwt->num_resources);
-					exit(1);
-				}
-				
-				if(hwt->resources[handle].type != RECONOS_TYPE_SEM){
-					RECONOS_ERROR("slot %d: resource type 0x%08X expected, found 0x%08X\n",
-						hwt->slot, RECONOS_TYPE_SEM, hwt->resources[handle].type);
-					exit(1);
-				}
-				
-			
-				result = sem_wait(hwt->resources[handle].ptr);
-				RECONOS_DEBUG("slot %d: sem_wait returns 0x%08X\n", hwt->slot, result);
-				
-				fsl_write(hwt->slot, result);
-				break;	
-			
-			case RECONOS_CMD_SEM_POST:
-				RECONOS_DEBUG("slot %d: command is SEM_POST\n", hwt->slot);
-				handle = fsl_read(hwt->slot);
-				RECONOS_DEBUG("slot %d: resource id is 0x%08X\n", hwt->slot, handle);
-				
-				if(handle >= hwt->num_resources){
-					RECONOS_ERROR("slot %d: resource id %d out of range, must be lesser than %d\n",
-						hwt->slot, handle, hwt->num_resources);
-					exit(1);
-				}
-				
-				if(hwt->resources[handle].type != RECONOS_TYPE_SEM){
-					RECONOS_ERROR("slot %d: resource type 0x%08X expected, found 0x%08X\n",
-						hwt->slot, RECONOS_TYPE_SEM, hwt->resources[handle].type);
-					exit(1);
-				}
-				
-				result = sem_post(hwt->resources[handle].ptr);
-				RECONOS_DEBUG("slot %d: sem_post returns 0x%08X\n", hwt->slot, result);
-				
-				fsl_write(hwt->slot, 0);
-				break;
-
-			case RECONOS_CMD_MUTEX_LOCK:
-				RECONOS_DEBUG("slot %d: command is MUTEX_LOCK\n", hwt->slot);
-				handle = fsl_read(hwt->slot);
-				RECONOS_DEBUG("slot %d: resource id is 0x%08X\n", hwt->slot, handle);
-			
-				if(handle >= hwt->num_resources){
-					RECONOS_ERROR("slot %d: resource id %d out of range, must be lesser than %d\n",
-						hwt->slot, handle, hwt->num_resources);
-					exit(1);
-				}
-				
-				if(hwt->resources[handle].type != RECONOS_TYPE_MUTEX){
-					RECONOS_ERROR("slot %d: resource type 0x%08X expected, found 0x%08X\n",
-						hwt->slot, RECONOS_TYPE_MUTEX, hwt->resources[handle].type);
-					exit(1);
-				}
-				
-			
-				result = pthread_mutex_lock(hwt->resources[handle].ptr);
-				RECONOS_DEBUG("slot %d: mutex_lock returns 0x%08X\n", hwt->slot, result);
-				
-				fsl_write(hwt->slot, result);
-				break;	
-
-			case RECONOS_CMD_MUTEX_UNLOCK:
-				RECONOS_DEBUG("slot %d: command is MUTEX_UNLOCK\n", hwt->slot);
-				handle = fsl_read(hwt->slot);
-				RECONOS_DEBUG("slot %d: resource id is 0x%08X\n", hwt->slot, handle);
-				
-				if(handle >= hwt->num_resources){
-					RECONOS_ERROR("slot %d: resource id %d out of range, must be lesser than %d\n",
-						hwt->slot, handle, hwt->num_resources);
-					exit(1);
-				}
-				
-				if(hwt->resources[handle].type != RECONOS_TYPE_MUTEX){
-					RECONOS_ERROR("slot %d: resource type 0x%08X expected, found 0x%08X\n",
-						hwt->slot, RECONOS_TYPE_MUTEX, hwt->resources[handle].type);
-					exit(1);
-				}
-				
-				result = pthread_mutex_unlock(hwt->resources[handle].ptr);
-				RECONOS_DEBUG("slot %d: mutex_unlock returns 0x%08X\n", hwt->slot, result);
-				
-				fsl_write(hwt->slot, 0);
-				break;
-
-			case RECONOS_CMD_MUTEX_TRYLOCK:
-				RECONOS_DEBUG("slot %d: command is MUTEX_TRYLOCK\n", hwt->slot);
-				handle = fsl_read(hwt->slot);
-				RECONOS_DEBUG("slot %d: resource id is 0x%08X\n", hwt->slot, handle);
-			
-				if(handle >= hwt->num_resources){
-					RECONOS_ERROR("slot %d: resource id %d out of range, must be lesser than %d\n",
-						hwt->slot, handle, hwt->num_resources);
-					exit(1);
-				}
-				
-				if(hwt->resources[handle].type != RECONOS_TYPE_MUTEX){
-					RECONOS_ERROR("slot %d: resource type 0x%08X expected, found 0x%08X\n",
-						hwt->slot, RECONOS_TYPE_MUTEX, hwt->resources[handle].type);
-					exit(1);
-				}
-				
-			
-				result = pthread_mutex_trylock(hwt->resources[handle].ptr);
-				RECONOS_DEBUG("slot %d: mutex_trylock returns 0x%08X\n", hwt->slot, result);
-				
-				fsl_write(hwt->slot, result);
-				break;
-
-			case RECONOS_CMD_COND_WAIT:
-				RECONOS_DEBUG("slot %d: command is COND_WAIT\n", hwt->slot);
-				handle = fsl_read(hwt->slot);
-				RECONOS_DEBUG("slot %d: resource id is 0x%08X\n", hwt->slot, handle);
-				handle2 = fsl_read(hwt->slot);
-				RECONOS_DEBUG("slot %d: resource id is 0x%08X\n", hwt->slot, handle2);
-			
-				if(handle >= hwt->num_resources){
-					RECONOS_ERROR("slot %d: 1st resource id %d out of range, must be lesser than %d\n",
-						hwt->slot, handle, hwt->num_resources);
-					exit(1);
-				}
-
-				if(handle2 >= hwt->num_resources){
-					RECONOS_ERROR("slot %d: 2nd resource id %d out of range, must be lesser than %d\n",
-						hwt->slot, handle2, hwt->num_resources);
-					exit(1);
-				}
-				
-				if(hwt->resources[handle].type != RECONOS_TYPE_COND){
-					RECONOS_ERROR("slot %d: 1st resource type 0x%08X expected, found 0x%08X\n",
-						hwt->slot, RECONOS_TYPE_COND, hwt->resources[handle].type);
-					exit(1);
-				}
-				
-				if(hwt->resources[handle2].type != RECONOS_TYPE_MUTEX){
-					RECONOS_ERROR("slot %d: 2nd resource type 0x%08X expected, found 0x%08X\n",
-						hwt->slot, RECONOS_TYPE_MUTEX, hwt->resources[handle2].type);
-					exit(1);
-				}				
-			
-				result = pthread_cond_wait(hwt->resources[handle].ptr, hwt->resources[handle2].ptr);
-				RECONOS_DEBUG("slot %d: cond_wait returns 0x%08X\n", hwt->slot, result);
-				
-				fsl_write(hwt->slot, result);
-				break;
-
-			case RECONOS_CMD_COND_SIGNAL:
-				RECONOS_DEBUG("slot %d: command is COND_SIGNAL\n", hwt->slot);
-				handle = fsl_read(hwt->slot);
-				RECONOS_DEBUG("slot %d: resource id is 0x%08X\n", hwt->slot, handle);
-				
-				if(handle >= hwt->num_resources){
-					RECONOS_ERROR("slot %d: resource id %d out of range, must be lesser than %d\n",
-						hwt->slot, handle, hwt->num_resources);
-					exit(1);
-				}
-				
-				if(hwt->resources[handle].type != RECONOS_TYPE_COND){
-					RECONOS_ERROR("slot %d: resource type 0x%08X expected, found 0x%08X\n",
-						hwt->slot, RECONOS_TYPE_COND, hwt->resources[handle].type);
-					exit(1);
-				}
-				
-				result = pthread_cond_signal(hwt->resources[handle].ptr);
-				RECONOS_DEBUG("slot %d: cond_signal returns 0x%08X\n", hwt->slot, result);
-				
-				fsl_write(hwt->slot, 0);
-				break;
-
-			case RECONOS_CMD_COND_BROADCAST:
-				RECONOS_DEBUG("slot %d: command is COND_BROADCAST\n", hwt->slot);
-				handle = fsl_read(hwt->slot);
-				RECONOS_DEBUG("slot %d: resource id is 0x%08X\n", hwt->slot, handle);
-				
-				if(handle >= hwt->num_resources){
-					RECONOS_ERROR("slot %d: resource id %d out of range, must be lesser than %d\n",
-						hwt->slot, handle, hwt->num_resources);
-					exit(1);
-				}
-				
-				if(hwt->resources[handle].type != RECONOS_TYPE_COND){
-					RECONOS_ERROR("slot %d: resource type 0x%08X expected, found 0x%08X\n",
-						hwt->slot, RECONOS_TYPE_COND, hwt->resources[handle].type);
-					exit(1);
-				}
-				
-				result = pthread_cond_broadcast(hwt->resources[handle].ptr);
-				RECONOS_DEBUG("slot %d: cond_broadcast returns 0x%08X\n", hwt->slot, result);
-				
-				fsl_write(hwt->slot, 0);
-				break;
-
-			case RECONOS_CMD_RQ_RECEIVE:
-				RECONOS_DEBUG("slot %d: command is RQ_RECEIVE\n", hwt->slot);
-				handle = fsl_read(hwt->slot);
-				RECONOS_DEBUG("slot %d: resource id is 0x%08X\n", hwt->slot, handle);
-				arg0 = fsl_read(hwt->slot);
-				RECONOS_DEBUG("slot %d: msg_size is 0x%08X\n", hwt->slot, arg0);
-
-				if(handle >= hwt->num_resources){
-					RECONOS_ERROR("slot %d: resource id %d out of range, must be lesser than %d\n",
-						hwt->slot, handle, hwt->num_resources);
-					exit(1);
-				}
-				
-				if(hwt->resources[handle].type != RECONOS_TYPE_RQ){
-					RECONOS_ERROR("slot %d: resource type 0x%08X expected, found 0x%08X\n",
-						hwt->slot, RECONOS_TYPE_RQ, hwt->resources[handle].type);
-					exit(1);
-				}
-				msg_size   = arg0;                                
-				msg        = (uint32*) malloc(msg_size); 			
-				if ((result = rq_receive (hwt->resources[handle].ptr, msg, msg_size)) < 0)
-		  		{
-		    			RECONOS_DEBUG ("slot %d: rq_receive (0x%08X) receives error\n", 
-						hwt->slot, handle);
-		    			result = 0;	// signal error
-		  		}
-				RECONOS_DEBUG("slot %d: rq_receive returns 0x%08X\n", hwt->slot, result);
-				// restore old queue attributes			
-				if (result == 0 || result > msg_size)
-				{			
-					// error code, if there is an error or if the message exceeds the expected size
-					if (result>msg_size && ((int)result)!=-1)
-					{
-						RECONOS_ERROR("slot %d: The received message size for rq (0x%08X) is bigger than expecetd (received %d > expected %d bytes) \n", 
-						hwt->slot, handle, (int)result, (int)msg_size);
-					}
-					fsl_write(hwt->slot, 0);
-				}
-				else
-				{
-					fsl_write(hwt->slot, result);
-					// write data to hw thread
-					for(i=0; i<(result/sizeof(uint32));i++)
-					{
-						fsl_write(hwt->slot, msg[i]);
-					}
-				}
-				free (msg);
-				break;
-
-
-
-			case RECONOS_CMD_RQ_SEND:
-				RECONOS_DEBUG("slot %d: command is RQ_SEND\n", hwt->slot);
-				handle = fsl_read(hwt->slot);
-				RECONOS_DEBUG("slot %d: resource id is 0x%08X\n", hwt->slot, handle);
-				arg0 = fsl_read(hwt->slot);
-				RECONOS_DEBUG("slot %d: msg_size is 0x%08X\n", hwt->slot, arg0);
-
-				if(handle >= hwt->num_resources){
-					RECONOS_ERROR("slot %d: resource id %d out of range, must be lesser than %d\n",
-						hwt->slot, handle, hwt->num_resources);
-					exit(1);
-				}
-				
-				if(hwt->resources[handle].type != RECONOS_TYPE_RQ){
-					RECONOS_ERROR("slot %d: resource type 0x%08X expected, found 0x%08X\n",
-						hwt->slot, RECONOS_TYPE_RQ, hwt->resources[handle].type);
-					exit(1);
-				}
-
-				msg_size   = arg0; 
-				msg        = (uint32*) malloc(msg_size); 
-
-				/*if (msg_size > (12*sizeof(uint32)))
-				{
-					RECONOS_ERROR("slot %d: the message size for rq (0x%08X) is to big for the fsl_links: %d > %d \n", 
-						hwt->slot, (int)handle, (int)msg_size, (int)(12*sizeof(uint32)));
-					result = 1;
-					fsl_write(hwt->slot, result);
-					break;
-				}*/
-
-				// read message
-				for(i=0; i<(msg_size/sizeof(uint32));i++)
-				{
-					msg[i] = fsl_read(hwt->slot);
-				}
-				rq_send(hwt->resources[handle].ptr, msg, msg_size);
-				fsl_write(hwt->slot, 0);
-				free(msg);
-				break;
-
-
-			case RECONOS_CMD_THREAD_GET_INIT_DATA:
-				RECONOS_DEBUG("slot %d: command is GET_INIT_DATA\n", hwt->slot);
-							
-				result = (uint32)hwt->init_data;
-				RECONOS_DEBUG("slot %d: init_data is 0x%08X\n", hwt->slot, result);
-				
-				fsl_write(hwt->slot, result);
-				break;
-
-			case RECONOS_CMD_THREAD_EXIT:
-				RECONOS_DEBUG("slot %d: command is THREAD_EXIT\n", hwt->slot);
-				return NULL;
-			
-			default:
-				RECONOS_ERROR("slot %d: unknown command 0x%08X\n", hwt->slot, cmd);
-				exit(1);
-		}
+	if(hwt->shared){
+		scheduler_join(hwt);
+	} else if(hwt->dispatched){
+		dispatcher_join(hwt);
+	} else {
+		pthread_join(hwt->delegate,NULL);
 	}
-		
-	return NULL;
 }
 
+void reconos_hwt_init(struct reconos_hwt * hwt)
+{
+	memset(hwt, 0, sizeof(*hwt));
+}
 
+void reconos_hwt_destroy(struct reconos_hwt * hwt)
+{
+	reconos_hwt_setstate(hwt, NULL, 0);
+}
 
+void reconos_hwt_setresources(struct reconos_hwt * hwt, struct reconos_resource * res, int num_resources)
+{
+	hwt->resources = res;
+	hwt->num_resources = num_resources;
+}
+
+void reconos_hwt_setinitdata(struct reconos_hwt * hwt, void * init_data)
+{
+	hwt->init_data = init_data;
+}
@@ -2,8 +2,13 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <assert.h>
+#include <limits.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 
-int mbox_init(struct mbox * mb, int size)
+static int mbox_init_locked(struct mbox * mb, int size)
 {
 	int error;
 	
@@ -41,10 +46,63 @@ int mbox_init(struct mbox * mb, int size)
 	return 0;
 }
 
+static int mbox_init_ring(struct mbox * mb, int size)
+{
+	uint32 i;
+	
+	// round up to the next power of two, so that index wrap-around is a mask
+	mb->size = 1;
+	while(mb->size < size) mb->size <<= 1;
+	mb->mask = mb->size - 1;
+	
+	mb->head = 0;
+	mb->tail = 0;
+	mb->put_count = 0;
+	mb->get_count = 0;
+	mb->put_waiters = 0;
+	mb->get_waiters = 0;
+	
+	mb->messages = malloc(mb->size*sizeof*mb->messages);
+	assert(mb->messages);
+	
+	mb->seq = NULL;
+	if(mb->mode == MBOX_MODE_MPMC){
+		mb->seq = malloc(mb->size*sizeof*mb->seq);
+		assert(mb->seq);
+		for(i = 0; i < mb->size; i++) mb->seq[i] = i;
+	}
+	
+	return 0;
+}
+
+int mbox_init_mode(struct mbox * mb, int size, int mode)
+{
+	mb->mode = mode;
+	mb->notify = NULL;
+	switch(mode){
+		case MBOX_MODE_LOCKED:
+			return mbox_init_locked(mb, size);
+		case MBOX_MODE_SPSC:
+		case MBOX_MODE_MPMC:
+			return mbox_init_ring(mb, size);
+	}
+	fprintf(stderr,"mbox_init: unknown mode %d\n",mode);
+	return -1;
+}
+
+int mbox_init(struct mbox * mb, int size)
+{
+	return mbox_init_mode(mb, size, MBOX_MODE_LOCKED);
+}
+
 
 void mbox_destroy(struct mbox * mb)
 {
 	free(mb->messages);
+	if(mb->mode != MBOX_MODE_LOCKED){
+		free(mb->seq);
+		return;
+	}
 	sem_destroy(&mb->sem_write);
 	sem_destroy(&mb->sem_read);
 	pthread_mutex_destroy(&mb->mutex_read);
@@ -54,8 +112,239 @@ void mbox_destroy(struct mbox * mb)
 //#define SEM_DEBUG(where) do{int a,b; sem_getvalue(&mb->sem_read,&a); sem_getvalue(&mb->sem_write,&b); fprintf(stderr,where "R %d W %d\n",a,b); }while(0)
 #define SEM_DEBUG(where)
 
+static void mbox_changed(struct mbox * mb)
+{
+	if(mb->notify) mb->notify(mb);
+}
+
+// lock-free ring implementation
+
+// Waits until *addr no longer contains val. If abstime is not NULL, the
+// wait ends at the given CLOCK_REALTIME deadline (same clock as
+// sem_timedwait). Returns -1 if the deadline has passed, 0 otherwise.
+static int futex_wait(volatile int * addr, int val, const struct timespec * abstime)
+{
+	int res;
+	
+	res = syscall(SYS_futex, addr, FUTEX_WAIT_BITSET | FUTEX_CLOCK_REALTIME,
+			val, abstime, NULL, FUTEX_BITSET_MATCH_ANY);
+	if(res < 0 && errno == ETIMEDOUT) return -1;
+	return 0;
+}
+
+static void futex_wake(volatile int * addr)
+{
+	syscall(SYS_futex, addr, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+// returns true if the slot at write position 'pos' is not free yet
+static int ring_full(struct mbox * mb, uint32 pos)
+{
+	if(mb->mode == MBOX_MODE_SPSC) return pos - mb->tail == mb->size;
+	return (int)(mb->seq[pos & mb->mask] - pos) < 0;
+}
+
+// returns true if the slot at read position 'pos' does not hold a message yet
+static int ring_empty(struct mbox * mb, uint32 pos)
+{
+	if(mb->mode == MBOX_MODE_SPSC) return mb->head == pos;
+	return (int)(mb->seq[pos & mb->mask] - (pos + 1)) < 0;
+}
+
+// Blocks until 'count' changes, unless the condition that made the caller
+// wait has already been resolved. The waiter is registered before the
+// condition is re-checked, and the other side increments 'count' before it
+// looks for waiters, so that no wake-up can be lost.
+// Returns -1 on timeout.
+static int ring_wait(struct mbox * mb, volatile int * count, volatile int * waiters,
+		int (*blocked)(struct mbox *, uint32), uint32 pos, const struct timespec * abstime)
+{
+	int c = *count;
+	int res = 0;
+	
+	__sync_fetch_and_add(waiters, 1);
+	if(blocked(mb, pos)) res = futex_wait(count, c, abstime);
+	__sync_fetch_and_sub(waiters, 1);
+	
+	return res;
+}
+
+static void ring_signal(volatile int * count, volatile int * waiters)
+{
+	__sync_fetch_and_add(count, 1);
+	if(*waiters) futex_wake(count);
+}
+
+// block == 0: fail immediately if the mbox is full
+// block != 0: wait, until abstime if not NULL
+static int ring_put(struct mbox * mb, uint32 msg, int block, const struct timespec * abstime)
+{
+	uint32 pos;
+	
+	if(mb->mode == MBOX_MODE_SPSC){
+		pos = mb->head;
+		while(ring_full(mb, pos)){
+			if(!block) return -1;
+			if(ring_wait(mb, &mb->get_count, &mb->put_waiters, ring_full, pos, abstime) < 0) return -1;
+		}
+		mb->messages[pos & mb->mask] = msg;
+		__sync_synchronize();
+		mb->head = pos + 1;
+	} else {
+		while(1){
+			pos = mb->head;
+			if(ring_full(mb, pos)){
+				if(!block) return -1;
+				if(ring_wait(mb, &mb->get_count, &mb->put_waiters, ring_full, pos, abstime) < 0) return -1;
+			} else if(!ring_empty(mb, pos)){
+				// another producer filled this slot in the meantime, retry
+			} else if(__sync_bool_compare_and_swap(&mb->head, pos, pos + 1)){
+				break;
+			}
+		}
+		mb->messages[pos & mb->mask] = msg;
+		__sync_synchronize();
+		mb->seq[pos & mb->mask] = pos + 1;
+	}
+	
+	mbox_changed(mb);
+	ring_signal(&mb->put_count, &mb->get_waiters);
+	
+	return 0;
+}
+
+// block == 0: fail immediately if the mbox is empty
+// block != 0: wait, until abstime if not NULL
+static int ring_get(struct mbox * mb, uint32 * msg, int block, const struct timespec * abstime)
+{
+	uint32 pos;
+	
+	if(mb->mode == MBOX_MODE_SPSC){
+		pos = mb->tail;
+		while(ring_empty(mb, pos)){
+			if(!block) return -1;
+			if(ring_wait(mb, &mb->put_count, &mb->get_waiters, ring_empty, pos, abstime) < 0) return -1;
+		}
+		__sync_synchronize();
+		*msg = mb->messages[pos & mb->mask];
+		__sync_synchronize();
+		mb->tail = pos + 1;
+	} else {
+		while(1){
+			pos = mb->tail;
+			if(ring_empty(mb, pos)){
+				if(!block) return -1;
+				if(ring_wait(mb, &mb->put_count, &mb->get_waiters, ring_empty, pos, abstime) < 0) return -1;
+			} else if(__sync_bool_compare_and_swap(&mb->tail, pos, pos + 1)){
+				break;
+			}
+		}
+		__sync_synchronize();
+		*msg = mb->messages[pos & mb->mask];
+		__sync_synchronize();
+		mb->seq[pos & mb->mask] = pos + mb->size;
+	}
+	
+	mbox_changed(mb);
+	ring_signal(&mb->get_count, &mb->put_waiters);
+	
+	return 0;
+}
+
+// Stores up to count messages with a single update of the head position.
+// Returns the number of messages stored, blocks only if none could be stored.
+static int ring_put_batch(struct mbox * mb, const uint32 * msgs, int count)
+{
+	uint32 pos;
+	int i, k;
+	
+	while(1){
+		pos = mb->head;
+		if(ring_full(mb, pos)){
+			ring_wait(mb, &mb->get_count, &mb->put_waiters, ring_full, pos, NULL);
+			continue;
+		}
+		if(mb->mode == MBOX_MODE_SPSC){
+			k = mb->size - (pos - mb->tail);
+			if(k > count) k = count;
+			break;
+		}
+		// claim the run of free slots starting at pos
+		for(k = 0; k < count && k < mb->size; k++){
+			if(mb->seq[(pos + k) & mb->mask] != pos + k) break;
+		}
+		if(k > 0 && __sync_bool_compare_and_swap(&mb->head, pos, pos + k)) break;
+	}
+	
+	for(i = 0; i < k; i++){
+		mb->messages[(pos + i) & mb->mask] = msgs[i];
+	}
+	__sync_synchronize();
+	if(mb->mode == MBOX_MODE_SPSC){
+		mb->head = pos + k;
+	} else {
+		for(i = 0; i < k; i++){
+			mb->seq[(pos + i) & mb->mask] = pos + i + 1;
+		}
+	}
+	
+	mbox_changed(mb);
+	ring_signal(&mb->put_count, &mb->get_waiters);
+	
+	return k;
+}
+
+// Reads up to count messages with a single update of the tail position.
+// Returns the number of messages read, blocks only if none are available.
+static int ring_get_batch(struct mbox * mb, uint32 * msgs, int count)
+{
+	uint32 pos;
+	int i, k;
+	
+	while(1){
+		pos = mb->tail;
+		if(ring_empty(mb, pos)){
+			ring_wait(mb, &mb->put_count, &mb->get_waiters, ring_empty, pos, NULL);
+			continue;
+		}
+		if(mb->mode == MBOX_MODE_SPSC){
+			k = mb->head - pos;
+			if(k > count) k = count;
+			break;
+		}
+		// claim the run of filled slots starting at pos
+		for(k = 0; k < count && k < mb->size; k++){
+			if(mb->seq[(pos + k) & mb->mask] != pos + k + 1) break;
+		}
+		if(k > 0 && __sync_bool_compare_and_swap(&mb->tail, pos, pos + k)) break;
+	}
+	
+	__sync_synchronize();
+	for(i = 0; i < k; i++){
+		msgs[i] = mb->messages[(pos + i) & mb->mask];
+	}
+	__sync_synchronize();
+	if(mb->mode == MBOX_MODE_SPSC){
+		mb->tail = pos + k;
+	} else {
+		for(i = 0; i < k; i++){
+			mb->seq[(pos + i) & mb->mask] = pos + i + mb->size;
+		}
+	}
+	
+	mbox_changed(mb);
+	ring_signal(&mb->get_count, &mb->put_waiters);
+	
+	return k;
+}
+
 void mbox_put(struct mbox * mb, uint32 msg)
 {
+	if(mb->mode != MBOX_MODE_LOCKED){
+		ring_put(mb, msg, 1, NULL);
+		return;
+	}
+	
 	pthread_mutex_lock(&mb->mutex_write);
 
 	SEM_DEBUG("put entry");
@@ -63,6 +352,7 @@ void mbox_put(struct mbox * mb, uint32 msg)
 	mb->messages[mb->write_idx] = msg;
 	mb->write_idx = (mb->write_idx + 1) % mb->size;
 	sem_post(&mb->sem_read);
+	mbox_changed(mb);
 	SEM_DEBUG("put exit");
 	pthread_mutex_unlock(&mb->mutex_write);
 }
@@ -71,15 +361,162 @@ uint32 mbox_get(struct mbox * mb)
 {
 	uint32 msg;
 	
+	if(mb->mode != MBOX_MODE_LOCKED){
+		ring_get(mb, &msg, 1, NULL);
+		return msg;
+	}
+	
 	pthread_mutex_lock(&mb->mutex_read);
 	SEM_DEBUG("get entry");
 	sem_wait(&mb->sem_read);
 	msg = mb->messages[mb->read_idx];
 	mb->read_idx = (mb->read_idx + 1) % mb->size;
 	sem_post(&mb->sem_write);
+	mbox_changed(mb);
 	SEM_DEBUG("get exit");
 	pthread_mutex_unlock(&mb->mutex_read);
 	
 	return msg;
 }
 
+int mbox_tryput(struct mbox * mb, uint32 msg)
+{
+	if(mb->mode != MBOX_MODE_LOCKED){
+		return ring_put(mb, msg, 0, NULL);
+	}
+	
+	if(pthread_mutex_trylock(&mb->mutex_write)){
+		return -1;
+	}
+	if(sem_trywait(&mb->sem_write)){
+		pthread_mutex_unlock(&mb->mutex_write);
+		return -1;
+	}
+	mb->messages[mb->write_idx] = msg;
+	mb->write_idx = (mb->write_idx + 1) % mb->size;
+	sem_post(&mb->sem_read);
+	mbox_changed(mb);
+	pthread_mutex_unlock(&mb->mutex_write);
+	
+	return 0;
+}
+
+int mbox_tryget(struct mbox * mb, uint32 * msg)
+{
+	if(mb->mode != MBOX_MODE_LOCKED){
+		return ring_get(mb, msg, 0, NULL);
+	}
+	
+	if(pthread_mutex_trylock(&mb->mutex_read)){
+		return -1;
+	}
+	if(sem_trywait(&mb->sem_read)){
+		pthread_mutex_unlock(&mb->mutex_read);
+		return -1;
+	}
+	*msg = mb->messages[mb->read_idx];
+	mb->read_idx = (mb->read_idx + 1) % mb->size;
+	sem_post(&mb->sem_write);
+	mbox_changed(mb);
+	pthread_mutex_unlock(&mb->mutex_read);
+	
+	return 0;
+}
+
+int mbox_timedput(struct mbox * mb, uint32 msg, const struct timespec * abstime)
+{
+	if(mb->mode != MBOX_MODE_LOCKED){
+		return ring_put(mb, msg, 1, abstime);
+	}
+	
+	if(pthread_mutex_timedlock(&mb->mutex_write, abstime)){
+		return -1;
+	}
+	while(sem_timedwait(&mb->sem_write, abstime)){
+		if(errno != EINTR){
+			pthread_mutex_unlock(&mb->mutex_write);
+			return -1;
+		}
+	}
+	mb->messages[mb->write_idx] = msg;
+	mb->write_idx = (mb->write_idx + 1) % mb->size;
+	sem_post(&mb->sem_read);
+	mbox_changed(mb);
+	pthread_mutex_unlock(&mb->mutex_write);
+	
+	return 0;
+}
+
+int mbox_timedget(struct mbox * mb, uint32 * msg, const struct timespec * abstime)
+{
+	if(mb->mode != MBOX_MODE_LOCKED){
+		return ring_get(mb, msg, 1, abstime);
+	}
+	
+	if(pthread_mutex_timedlock(&mb->mutex_read, abstime)){
+		return -1;
+	}
+	while(sem_timedwait(&mb->sem_read, abstime)){
+		if(errno != EINTR){
+			pthread_mutex_unlock(&mb->mutex_read);
+			return -1;
+		}
+	}
+	*msg = mb->messages[mb->read_idx];
+	mb->read_idx = (mb->read_idx + 1) % mb->size;
+	sem_post(&mb->sem_write);
+	mbox_changed(mb);
+	pthread_mutex_unlock(&mb->mutex_read);
+	
+	return 0;
+}
+
+void mbox_put_many(struct mbox * mb, const uint32 * msgs, int count)
+{
+	int i;
+	
+	if(mb->mode != MBOX_MODE_LOCKED){
+		while(count > 0){
+			i = ring_put_batch(mb, msgs, count);
+			msgs += i;
+			count -= i;
+		}
+		return;
+	}
+	
+	// the semaphores still count single messages, but the batch is
+	// written without interleaving with other producers
+	pthread_mutex_lock(&mb->mutex_write);
+	for(i = 0; i < count; i++){
+		sem_wait(&mb->sem_write);
+		mb->messages[mb->write_idx] = msgs[i];
+		mb->write_idx = (mb->write_idx + 1) % mb->size;
+		sem_post(&mb->sem_read);
+		mbox_changed(mb);
+	}
+	pthread_mutex_unlock(&mb->mutex_write);
+}
+
+int mbox_get_many(struct mbox * mb, uint32 * msgs, int count)
+{
+	int i;
+	
+	if(count <= 0) return 0;
+	
+	if(mb->mode != MBOX_MODE_LOCKED){
+		return ring_get_batch(mb, msgs, count);
+	}
+	
+	pthread_mutex_lock(&mb->mutex_read);
+	sem_wait(&mb->sem_read);
+	i = 0;
+	do {
+		msgs[i++] = mb->messages[mb->read_idx];
+		mb->read_idx = (mb->read_idx + 1) % mb->size;
+		sem_post(&mb->sem_write);
+		mbox_changed(mb);
+	} while(i < count && sem_trywait(&mb->sem_read) == 0);
+	pthread_mutex_unlock(&mb->mutex_read);
+	
+	return i;
+}
@@ -3,12 +3,22 @@
 
 /* This is the linux implementation of ecos message boxes.
    It uses two counting semaphores and two mutexes to enable
-   synchronous access */
+   synchronous access.
+   
+   Alternatively, an mbox can be set up as a lock-free ring buffer
+   (see mbox_init_mode). Producers and consumers then synchronize via
+   atomic head and tail positions and only enter the kernel (futex)
+   when the mbox is full or empty. */
 
 #include <semaphore.h>
 #include <pthread.h>
+#include <time.h>
 #include "config.h"
 
+#define MBOX_MODE_LOCKED 0 // mutexes and semaphores, any number of producers and consumers
+#define MBOX_MODE_SPSC   1 // lock-free ring, exactly one producer and one consumer
+#define MBOX_MODE_MPMC   2 // lock-free ring, any number of producers and consumers
+
 struct mbox {
 	sem_t sem_read;
 	sem_t sem_write;
@@ -18,12 +28,45 @@ struct mbox {
 	int read_idx;
 	int write_idx;
 	int size;
+	
+	// lock-free ring modes only
+	int mode;
+	uint32 mask;               // size - 1 (size is a power of two)
+	uint32 *seq;               // MPMC: sequence number of each slot
+	volatile uint32 head;      // next position to write
+	volatile uint32 tail;      // next position to read
+	volatile int put_count;    // futex word, incremented after each put
+	volatile int get_count;    // futex word, incremented after each get
+	volatile int put_waiters;  // number of producers blocked on a full mbox
+	volatile int get_waiters;  // number of consumers blocked on an empty mbox
+	
+	// called after each message put into or taken out of the mbox, e.g. to
+	// wake up an event loop that waits for it. NULL after mbox_init.
+	void (*notify)(struct mbox * mb);
 };
 
 int mbox_init(struct mbox * mb, int size);
+int mbox_init_mode(struct mbox * mb, int size, int mode);
 void mbox_destroy(struct mbox * mb);
 void mbox_put(struct mbox * mb, uint32 msg);
 uint32 mbox_get(struct mbox * mb);
 
-#endif
+/* Non-blocking and timed variants. They return 0 on success and -1 if the
+   mbox is full (put) or empty (get), or if the absolute deadline abstime
+   (CLOCK_REALTIME, as for sem_timedwait) has passed. */
+int mbox_tryput(struct mbox * mb, uint32 msg);
+int mbox_tryget(struct mbox * mb, uint32 * msg);
+int mbox_timedput(struct mbox * mb, uint32 msg, const struct timespec * abstime);
+int mbox_timedget(struct mbox * mb, uint32 * msg, const struct timespec * abstime);
 
+/* Batch variants. mbox_put_many blocks until all count messages are stored.
+   mbox_get_many blocks until at least one message is available and returns
+   the number of messages read (at most count). In MBOX_MODE_LOCKED a batch
+   is stored without interleaving with other producers. In the lock-free ring
+   modes a batch is not atomic: it is stored as runs of the free slots
+   available at the time, each run costing one claim of the ring position,
+   and the runs of concurrent producers may interleave. */
+void mbox_put_many(struct mbox * mb, const uint32 * msgs, int count);
+int mbox_get_many(struct mbox * mb, uint32 * msgs, int count);
+
+#endif
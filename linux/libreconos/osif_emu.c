@@ -0,0 +1,191 @@
+#include "osif_emu.h"
+#include "fsl_emu.h"
+#include "reconos.h"
+
+// see osif_call_0, osif_call_1 and osif_call_2 in reconos_pkg.vhd: the
+// command word and its arguments are pushed in one go, then the result word
+// is pulled.
+static uint32 osif_call(int slot, const uint32 * req, int len)
+{
+	uint32 result;
+
+	fsl_emu_hw_write_n(slot, req, len);
+	fsl_emu_hw_read_n(slot, &result, 1);
+
+	return result;
+}
+
+static uint32 osif_call_1(int slot, uint32 cmd, uint32 arg0)
+{
+	uint32 req[2];
+
+	req[0] = cmd;
+	req[1] = arg0;
+
+	return osif_call(slot, req, 2);
+}
+
+static uint32 osif_call_2(int slot, uint32 cmd, uint32 arg0, uint32 arg1)
+{
+	uint32 req[3];
+
+	req[0] = cmd;
+	req[1] = arg0;
+	req[2] = arg1;
+
+	return osif_call(slot, req, 3);
+}
+
+uint32 osif_sem_post(int slot, uint32 handle)
+{
+	return osif_call_1(slot, RECONOS_CMD_SEM_POST, handle);
+}
+
+uint32 osif_sem_wait(int slot, uint32 handle)
+{
+	return osif_call_1(slot, RECONOS_CMD_SEM_WAIT, handle);
+}
+
+uint32 osif_mutex_lock(int slot, uint32 handle)
+{
+	return osif_call_1(slot, RECONOS_CMD_MUTEX_LOCK, handle);
+}
+
+uint32 osif_mutex_unlock(int slot, uint32 handle)
+{
+	return osif_call_1(slot, RECONOS_CMD_MUTEX_UNLOCK, handle);
+}
+
+uint32 osif_mutex_trylock(int slot, uint32 handle)
+{
+	return osif_call_1(slot, RECONOS_CMD_MUTEX_TRYLOCK, handle);
+}
+
+uint32 osif_cond_wait(int slot, uint32 cond_handle, uint32 mutex_handle)
+{
+	return osif_call_2(slot, RECONOS_CMD_COND_WAIT, cond_handle, mutex_handle);
+}
+
+uint32 osif_cond_signal(int slot, uint32 handle)
+{
+	return osif_call_1(slot, RECONOS_CMD_COND_SIGNAL, handle);
+}
+
+uint32 osif_cond_broadcast(int slot, uint32 handle)
+{
+	return osif_call_1(slot, RECONOS_CMD_COND_BROADCAST, handle);
+}
+
+uint32 osif_mbox_put(int slot, uint32 handle, uint32 word)
+{
+	return osif_call_2(slot, RECONOS_CMD_MBOX_PUT, handle, word);
+}
+
+uint32 osif_mbox_get(int slot, uint32 handle)
+{
+	return osif_call_1(slot, RECONOS_CMD_MBOX_GET, handle);
+}
+
+uint32 osif_mbox_tryput(int slot, uint32 handle, uint32 word)
+{
+	return osif_call_2(slot, RECONOS_CMD_MBOX_TRYPUT, handle, word);
+}
+
+uint32 osif_mbox_tryget(int slot, uint32 handle, uint32 * word)
+{
+	uint32 req[2];
+	uint32 reply[2];
+
+	req[0] = RECONOS_CMD_MBOX_TRYGET;
+	req[1] = handle;
+
+	// status word, always followed by a data word
+	fsl_emu_hw_write_n(slot, req, 2);
+	fsl_emu_hw_read_n(slot, reply, 2);
+	*word = reply[1];
+
+	return reply[0];
+}
+
+uint32 osif_rq_receive(int slot, uint32 handle, uint32 * buf, uint32 size)
+{
+	uint32 req[3];
+	uint32 result;
+
+	req[0] = RECONOS_CMD_RQ_RECEIVE;
+	req[1] = handle;
+	req[2] = size;
+
+	// the size of the message in bytes, followed by its words
+	fsl_emu_hw_write_n(slot, req, 3);
+	fsl_emu_hw_read_n(slot, &result, 1);
+	if(result > 0){
+		fsl_emu_hw_read_n(slot, buf, result/sizeof(uint32));
+	}
+
+	return result;
+}
+
+uint32 osif_rq_send(int slot, uint32 handle, const uint32 * buf, uint32 size)
+{
+	uint32 req[3];
+	uint32 result;
+
+	req[0] = RECONOS_CMD_RQ_SEND;
+	req[1] = handle;
+	req[2] = size;
+
+	fsl_emu_hw_write_n(slot, req, 3);
+	fsl_emu_hw_write_n(slot, buf, size/sizeof(uint32));
+	fsl_emu_hw_read_n(slot, &result, 1);
+
+	return result;
+}
+
+uint32 osif_get_init_data(int slot)
+{
+	uint32 cmd = RECONOS_CMD_THREAD_GET_INIT_DATA;
+
+	return osif_call(slot, &cmd, 1);
+}
+
+uint32 osif_thread_delay(int slot, uint32 delay_us)
+{
+	return osif_call_1(slot, RECONOS_CMD_THREAD_DELAY, delay_us);
+}
+
+uint32 osif_thread_yield(int slot)
+{
+	uint32 cmd = RECONOS_CMD_THREAD_YIELD;
+
+	return osif_call(slot, &cmd, 1);
+}
+
+uint32 osif_thread_resume(int slot)
+{
+	uint32 cmd = RECONOS_CMD_THREAD_RESUME;
+
+	return osif_call(slot, &cmd, 1);
+}
+
+uint32 osif_thread_store_state(int slot, uint32 size)
+{
+	return osif_call_1(slot, RECONOS_CMD_THREAD_STORE_STATE, size);
+}
+
+uint32 osif_thread_load_state(int slot, uint32 size)
+{
+	return osif_call_1(slot, RECONOS_CMD_THREAD_LOAD_STATE, size);
+}
+
+uint32 osif_thread_state_done(int slot, uint32 size)
+{
+	return osif_call(slot, &size, 1);
+}
+
+void osif_thread_exit(int slot)
+{
+	uint32 cmd = RECONOS_CMD_THREAD_EXIT;
+
+	fsl_emu_hw_write_n(slot, &cmd, 1);
+}
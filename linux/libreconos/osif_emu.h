@@ -0,0 +1,47 @@
+#ifndef OSIF_EMU_H
+#define OSIF_EMU_H
+
+#include "config.h"
+
+// C mirror of the osif_* procedures of reconos_pkg.vhd for software threads
+// standing in for hardware threads on the emulated fsl links (fsl_emu.h).
+// Each call transfers the same words in the same order as its VHDL
+// counterpart, so that the delegate threads of libreconos serve both alike.
+// 'slot' is the slot the thread has been created in with reconos_hwt_create.
+
+uint32 osif_sem_post(int slot, uint32 handle);
+uint32 osif_sem_wait(int slot, uint32 handle);
+
+uint32 osif_mutex_lock(int slot, uint32 handle);
+uint32 osif_mutex_unlock(int slot, uint32 handle);
+uint32 osif_mutex_trylock(int slot, uint32 handle);
+
+uint32 osif_cond_wait(int slot, uint32 cond_handle, uint32 mutex_handle);
+uint32 osif_cond_signal(int slot, uint32 handle);
+uint32 osif_cond_broadcast(int slot, uint32 handle);
+
+uint32 osif_mbox_put(int slot, uint32 handle, uint32 word);
+uint32 osif_mbox_get(int slot, uint32 handle);
+uint32 osif_mbox_tryput(int slot, uint32 handle, uint32 word);
+// returns the status word (RECONOS_SUCCESS if a word has been received)
+uint32 osif_mbox_tryget(int slot, uint32 handle, uint32 * word);
+
+// receives a message of at most 'size' bytes into buf and returns its size,
+// 0 on error
+uint32 osif_rq_receive(int slot, uint32 handle, uint32 * buf, uint32 size);
+uint32 osif_rq_send(int slot, uint32 handle, const uint32 * buf, uint32 size);
+
+uint32 osif_get_init_data(int slot);
+uint32 osif_thread_delay(int slot, uint32 delay_us);
+// returns RECONOS_SUCCESS if the slot has been handed over to another thread,
+// whose init data osif_thread_resume returns
+uint32 osif_thread_yield(int slot);
+uint32 osif_thread_resume(int slot);
+// return the address of the state buffer, 0 if there is none. The state is
+// copied from or to it before osif_thread_state_done (see reconos_pkg.vhd).
+uint32 osif_thread_store_state(int slot, uint32 size);
+uint32 osif_thread_load_state(int slot, uint32 size);
+uint32 osif_thread_state_done(int slot, uint32 size);
+void osif_thread_exit(int slot);
+
+#endif
@@ -4,6 +4,7 @@
 #include "config.h"
 
 #include <pthread.h>
+#include <stddef.h>
 
 #define RECONOS_TYPE_MBOX      0x00000001
 #define RECONOS_TYPE_SEM       0x00000002
@@ -12,12 +13,12 @@
 #define RECONOS_TYPE_RQ        0x00000010
 
 #define RECONOS_CMD_THREAD_GET_INIT_DATA 0x000000A0
-#define RECONOS_CMD_THREAD_DELAY         0x000000A1 // ToDo
+#define RECONOS_CMD_THREAD_DELAY         0x000000A1 // argument is the delay in microseconds
 #define RECONOS_CMD_THREAD_EXIT          0x000000A2
-#define RECONOS_CMD_THREAD_YIELD         0x000000A3 // ToDo
-#define RECONOS_CMD_THREAD_RESUME        0x000000A4 // ToDo
-#define RECONOS_CMD_THREAD_LOAD_STATE    0x000000A5 // ToDo
-#define RECONOS_CMD_THREAD_STORE_STATE   0x000000A6 // ToDo
+#define RECONOS_CMD_THREAD_YIELD         0x000000A3
+#define RECONOS_CMD_THREAD_RESUME        0x000000A4
+#define RECONOS_CMD_THREAD_LOAD_STATE    0x000000A5
+#define RECONOS_CMD_THREAD_STORE_STATE   0x000000A6
 
 #define RECONOS_CMD_SEM_POST       0x000000B0
 #define RECONOS_CMD_SEM_WAIT       0x000000B1
@@ -35,8 +36,14 @@
 
 #define RECONOS_CMD_MBOX_GET       0x000000F0
 #define RECONOS_CMD_MBOX_PUT       0x000000F1
-#define RECONOS_CMD_MBOX_TRYGET    0x000000F2 // ToDo
-#define RECONOS_CMD_MBOX_TRYPUT    0x000000F3 // ToDo
+#define RECONOS_CMD_MBOX_TRYGET    0x000000F2
+#define RECONOS_CMD_MBOX_TRYPUT    0x000000F3
+
+// status words, see C_RECONOS_SUCCESS and C_RECONOS_FAILURE in reconos_pkg.vhd
+#define RECONOS_FAILURE 0x00000000
+#define RECONOS_SUCCESS 0x00000001
+// reply to a rejected OS call, see C_RECONOS_ERROR and reconos_slot_status
+#define RECONOS_ERROR_REPLY 0xFFFFFFFF
 
 
 
@@ -52,18 +59,57 @@ struct reconos_hwt {
 	struct reconos_resource* resources;
 	int                      num_resources;
 	void *                   init_data;
+	int                      dispatched;  // served by the shared dispatcher instead of 'delegate'
+	int                      shared;      // multiplexed onto slot_mask by the scheduler
+	uint32                   slot_mask;   // slots holding the bitstream of a shared thread
+	int                      exited;      // a shared thread has exited
+	unsigned long            queued_us;   // time a shared thread has been queued
+	struct reconos_hwt *     next;        // queue of the scheduler
+	void *                   state;       // buffer for THREAD_STORE_STATE, see reconos_hwt_getstate
+	uint32                   state_size;
+	int                      state_valid; // the buffer holds a complete state
 };
 
 #define SLOT_FLAG_RESET 0x00000001
 
+// A hardware thread that issues an unknown command or passes an invalid
+// resource is quarantined: its delegate replies RECONOS_ERROR_REPLY, holds
+// the slot in reset and stops serving it, while all other slots carry on.
+// A page fault outside of any writable mapping quarantines the slot as well:
+// the slot is held in reset and the MMU drops the request. If proc_control
+// does not report the faulting slot (C_FAULT_SLOT = 0), such a fault ends the
+// process instead.
+#define RECONOS_SLOT_OK          0
+#define RECONOS_SLOT_ERR_COMMAND 1 // unknown command
+#define RECONOS_SLOT_ERR_HANDLE  2 // resource id out of range
+#define RECONOS_SLOT_ERR_TYPE    3 // resource of another type than the command expects
+#define RECONOS_SLOT_ERR_FAULT   4 // page fault outside of any writable mapping
+
+struct reconos_slot_status
+{
+	int error;  // RECONOS_SLOT_OK or RECONOS_SLOT_ERR_*
+	uint32 cmd; // command that has been rejected, the proc_control word for page faults
+	uint32 arg; // offending resource id, 0 for unknown commands, the address for page faults
+};
+
 struct reconos_process
 {
 	uint32 page_faults;
+	uint32 prefetched_pages; // pages touched in advance by fault-around
+	uint32 fault_flushes;
+	uint32 fault_time_us;    // time spent serving page faults
+	int fault_around;        // number of pages touched after a faulting page
+	unsigned long fault_vma_start; // last writable mapping found by fault-around
+	unsigned long fault_vma_end;
 	int proc_control_fsl_a; // proc_control initiates requests
 	int proc_control_fsl_b; // sw initiates requests
 	pthread_t proc_control_thread;
+	pthread_mutex_t proc_control_lock; // serializes requests on proc_control_fsl_b
 	int slot_flags[MAX_SLOTS];
+	struct reconos_slot_status slot_status[MAX_SLOTS];
+	uint32 bad_faults;       // page faults outside of any writable mapping
 	int fd_cache;
+	int fd_zero;             // source of the word written to a faulting address
 };
 
 extern struct reconos_process reconos_proc;
@@ -71,17 +117,209 @@ extern struct reconos_process reconos_proc;
 int reconos_init(int proc_ctrl_fsl_a, int proc_control_fsl_b);
 int reconos_init_autodetect();
 
+// attaches to an already initialized proc_control for reading statistics only,
+// e.g. from a monitoring process. Unlike reconos_init, nothing is reset.
+void reconos_monitor_init(int proc_control_fsl_a, int proc_control_fsl_b);
+
 void cache_flush(void);
 
+// writes back and invalidates only the data cache lines of [ptr, ptr + len),
+// together with the page table entries mapping it. Large ranges flush the
+// whole cache.
+void cache_flush_range(void * ptr, size_t len);
+
+// invalidates the data cache lines of [ptr, ptr + len) without writing them
+// back, e.g. before reading data written by a hardware thread. Partial lines at
+// the ends of the range are written back instead, which overwrites the data of
+// the hardware thread there, so the range should be cache line aligned. The
+// range must be mapped private and writable, the process exits otherwise.
+void cache_invalidate_range(void * ptr, size_t len);
+
 void proc_control_selftest();
 
+// holds the hardware thread in 'slot' in reset (reset = 1) or releases it (0)
+void reconos_slot_reset(int slot, int reset);
+
+// resets the hardware thread in 'slot' and starts it again from its initial
+// state. Words a quarantined slot has left on its fsl are discarded.
+void reconos_slot_restart(int slot);
+
+// returns the error of 'slot' (RECONOS_SLOT_OK if it is running normally) and
+// fills in 'status' if not NULL. A quarantined slot stays in reset until its
+// hardware thread is created again.
+int reconos_slot_status(int slot, struct reconos_slot_status * status);
+
 void reconos_mmu_stats(uint32 * tlb_hits, uint32 * tlb_misses, uint32 * page_faults);
 
+// MMU counters of the requests of one hardware thread slot
+struct reconos_mmu_slot_stats
+{
+	uint32 tlb_hits;
+	uint32 tlb_misses;
+	uint32 walk_cycles;  // cycles spent reading page table entries
+	uint32 page_faults;
+	uint32 stall_cycles; // cycles from reading an address until the request is issued
+};
+
+// reads the MMU counters of 'slot' and clears them afterwards if 'reset' is set.
+void reconos_mmu_stats_slot(int slot, struct reconos_mmu_slot_stats * stats, int reset);
+
+// configures port 'port' of the memory arbiter (fifo32_arbiter with
+// ARBITRATION_ALGO = 1): the port may transfer 'weight' packets (1..15) in a row,
+// ports with a higher 'prio' (0..3) are always served first, and at most 'cap'
+// packets (1..255) are accepted from the port per arbiter window, 0 = no limit.
+// The default of every port is weight 1, prio 0 and no cap.
+// Returns -1 if the arbiter ignores the configuration because it is round
+// robin (ARBITRATION_ALGO = 0) or not connected to proc_control, 0 otherwise.
+int reconos_arbiter_set(int port, int weight, int prio, int cap);
+
+// on a page fault, also touch the next 'pages' pages of the same mapping and
+// flush the cache once for all of them. 0 (the default) disables fault-around.
+// The default can also be set with the environment variable RECONOS_FAULT_AROUND.
+void reconos_mmu_fault_around(int pages);
+
+// statistics of the page fault handler. fault_time_us is the time from receiving
+// a fault until the page ready reply has been sent, summed over all faults.
+void reconos_mmu_fault_stats(uint32 * prefetched_pages, uint32 * flushes, uint32 * fault_time_us);
+
+// allocates a page aligned buffer for hardware threads and prepares it
+// with reconos_buffer_prepare. Returns NULL if out of memory.
+void * reconos_buffer_alloc(size_t len);
+
+// pre-faults and locks the pages of [ptr, ptr + len) and flushes the cache
+// once, so that hardware threads accessing the buffer do not cause page faults.
+// Returns -1 if the pages could not be locked (they are pre-faulted anyway).
+int reconos_buffer_prepare(void * ptr, size_t len);
+
+// unlocks and frees a buffer from reconos_buffer_alloc.
+void reconos_buffer_free(void * ptr, size_t len);
+
+// like reconos_buffer_alloc, but backs the buffer with 4 MB huge pages if the
+// kernel provides them, so that the MMU translates it with one large TLB entry
+// per 4 MB. This needs a kernel that maps huge pages as page directory sections
+// (_PMD_SIZE entries); the MicroBlaze kernels have no hugetlb support, there
+// MAP_HUGETLB fails and the buffer falls back to normal 4 kB pages. If huge is
+// not NULL it is set to 1 when huge pages were obtained and to 0 on the
+// fallback. len is rounded up to 4 MB.
+void * reconos_buffer_alloc_huge(size_t len, int * huge);
+
+// unlocks and frees a buffer from reconos_buffer_alloc_huge.
+void reconos_buffer_free_huge(void * ptr, size_t len);
+
+// statistics of the OS calls of one command issued by a hardware thread.
+// os_us is the time spent in the call itself, e.g. blocked in mbox_get or
+// sem_wait, fsl_us the time spent transferring arguments, payload and reply.
+// Bucket 0 of the histograms counts calls that took less than 1 us, bucket i
+// calls of [2^(i-1), 2^i) us, the last bucket all longer ones. For slots
+// served by the dispatcher, all time until the reply counts as os_us.
+#define RECONOS_STATS_BUCKETS 16
+
+struct reconos_cmd_stats
+{
+	uint32 cmd;
+	const char * name;
+	uint32 calls;
+	unsigned long long os_us;
+	unsigned long long fsl_us;
+	uint32 os_hist[RECONOS_STATS_BUCKETS];
+	uint32 fsl_hist[RECONOS_STATS_BUCKETS];
+};
+
+// copies the statistics of the commands 'slot' has issued so far into
+// 'stats', at most 'max' entries, and returns the number of entries. The
+// counters are updated by the delegate while they are read, so the result
+// is a snapshot that may be off by the call in progress.
+int reconos_cmd_stats(int slot, struct reconos_cmd_stats * stats, int max);
+
+void reconos_cmd_stats_reset(int slot);
+
+// prints the statistics of 'slot' to stderr
+void reconos_cmd_stats_print(int slot);
+
+// cost of saving (THREAD_STORE_STATE) and restoring (THREAD_LOAD_STATE) the
+// state of the hardware threads in a slot, by state size. Bucket 0 counts
+// states of less than 256 bytes, bucket i states of [2^(i+7), 2^(i+8))
+// bytes, the last bucket all larger ones. The time of a transfer is the time
+// from handing out the state buffer until the hardware thread has reported
+// it as complete.
+#define RECONOS_STATE_BUCKETS 12
+
+struct reconos_state_stats
+{
+	uint32 stores[RECONOS_STATE_BUCKETS];
+	unsigned long long store_bytes[RECONOS_STATE_BUCKETS];
+	unsigned long long store_us[RECONOS_STATE_BUCKETS];
+	uint32 loads[RECONOS_STATE_BUCKETS];
+	unsigned long long load_bytes[RECONOS_STATE_BUCKETS];
+	unsigned long long load_us[RECONOS_STATE_BUCKETS];
+};
+
+void reconos_state_stats(int slot, struct reconos_state_stats * stats);
+
+// prints the statistics of 'slot' to stderr
+void reconos_state_stats_print(int slot);
+
+// clears the descriptor. It does not look at the old contents, so the
+// descriptor may be uninitialized; release the state buffer of a descriptor
+// that is used again with reconos_hwt_destroy first.
+void reconos_hwt_init(struct reconos_hwt * hwt);
+
+// releases the state buffer of hwt once its thread has finished
+void reconos_hwt_destroy(struct reconos_hwt * hwt);
+
 void reconos_hwt_setresources(struct reconos_hwt * hwt, struct reconos_resource * res, int num_resources);
 
 void reconos_hwt_setinitdata(struct reconos_hwt * hwt, void * init_data);
 
+// returns the state the hardware thread has saved last with THREAD_STORE_STATE
+// and its size, e.g. to checkpoint it. NULL if it has not saved a complete
+// state. The buffer is owned by libreconos and overwritten by the next
+// THREAD_STORE_STATE of the thread.
+void * reconos_hwt_getstate(struct reconos_hwt * hwt, uint32 * size);
+
+// copies 'size' bytes of 'state', e.g. a checkpoint or the state of another
+// thread, into the state buffer of hwt. The hardware thread receives it on its
+// next THREAD_LOAD_STATE, so a thread can be continued in any slot. A size of
+// 0 frees the buffer. Returns -1 if out of memory.
+int reconos_hwt_setstate(struct reconos_hwt * hwt, const void * state, uint32 size);
+
 int reconos_hwt_create(struct reconos_hwt * hwt, int slot, void * arg);
 
+// like reconos_hwt_create, but instead of a delegate thread per slot a single
+// dispatcher thread serves all slots created this way (see dispatcher.h)
+int reconos_hwt_create_dispatched(struct reconos_hwt * hwt, int slot, void * arg);
+
+// Creates a hardware thread that shares the slots in slot_mask (bit i for
+// slot i), which must all hold its bitstream, with the other threads created
+// this way. The thread is queued until one of the slots is free, so more
+// threads than slots can be created. A running thread gives its slot to the
+// first queued thread that may use it when it yields (THREAD_YIELD) and is
+// queued again itself; the slot then continues with THREAD_RESUME, which
+// returns the init data of the thread it runs from now on. When a thread
+// exits, the slot is restarted for the next queued thread. hwt->slot is the
+// slot the thread runs (or has run) in, -1 while it waits for its first slot.
+int reconos_hwt_create_shared(struct reconos_hwt * hwt, uint32 slot_mask, void * arg);
+
+// waits until the hardware thread has exited, for all kinds of delegates
+void reconos_hwt_join(struct reconos_hwt * hwt);
+
+// scheduler statistics of a slot used by shared hardware threads. The
+// utilisation of the slot is busy_us/total_us, the mean queueing delay of
+// the threads it has been given wait_us/switches.
+struct reconos_sched_stats
+{
+	uint32 switches;             // threads the slot has been given
+	uint32 yields;               // switches at THREAD_YIELD
+	unsigned long long busy_us;  // time a thread has been assigned to the slot
+	unsigned long long total_us; // time since the slot has first been used
+	unsigned long long wait_us;  // time the threads have been queued for the slot
+	unsigned long max_wait_us;
+};
+
+void reconos_sched_stats(int slot, struct reconos_sched_stats * stats);
+
+// prints the statistics of all slots used by shared hardware threads to stderr
+void reconos_sched_stats_print(void);
+
 #endif
 
@@ -1,29 +1,124 @@
+
 #include "rq.h"
+#include "fsl.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
 
+// Messages are passed through the mboxes as 32 bit words. fsl_ptr_word maps
+// them like the pointers handed to hardware threads, so that this also works
+// with 64 bit pointers in the fsl emulation.
+
+// size of a slot in words, including the size header
+#define RQ_SLOT_WORDS(rq) (1 + ((rq)->slot_size + sizeof(uint32) - 1)/sizeof(uint32))
+
 //! initializes ReconOS message queue with maximum 'size' messages. internally it uses mboxes.
 int rq_init(rqueue * rq, int size)
 {
-	return mbox_init((struct mbox *) rq, size);
+	rq->slab = NULL;
+	rq->slot_size = 0;
+	return mbox_init(&rq->mb, size);
+}
+
+//! initializes ReconOS message queue with a slab of 'size' slots of 'slot_size' bytes each.
+int rq_init_slab(rqueue * rq, int size, uint32 slot_size)
+{
+	int i;
+	
+	rq->slot_size = slot_size;
+	rq->slab = malloc(size*RQ_SLOT_WORDS(rq)*sizeof(uint32));
+	if(!rq->slab){
+		perror("malloc: rq slab");
+		return -1;
+	}
+	
+	if(mbox_init(&rq->mb, size) || mbox_init(&rq->free, size)){
+		free(rq->slab);
+		return -1;
+	}
+	
+	for(i = 0; i < size; i++){
+		mbox_put(&rq->free, fsl_ptr_word(rq->slab + i*RQ_SLOT_WORDS(rq)));
+	}
+	
+	return 0;
 }
 
 //! destroys ReconOS message queue
 void rq_close(rqueue * rq)
 {
-	mbox_destroy((struct mbox *) rq);
+	mbox_destroy(&rq->mb);
+	if(rq->slab){
+		mbox_destroy(&rq->free);
+		free(rq->slab);
+	}
+}
+
+uint32 * rq_reserve(rqueue * rq)
+{
+	uint32 * slot;
+	
+	assert(rq->slab);
+	slot = fsl_word_ptr(mbox_get(&rq->free));
+	return &slot[1];
+}
+
+void rq_commit(rqueue * rq, uint32 * msg, uint32 msg_size)
+{
+	assert(rq->slab);
+	assert(msg_size <= rq->slot_size);
+	msg[-1] = msg_size;
+	mbox_put(&rq->mb, fsl_ptr_word(&msg[-1]));
+}
+
+uint32 * rq_peek(rqueue * rq, uint32 * msg_size)
+{
+	uint32 * slot;
+	
+	assert(rq->slab);
+	slot = fsl_word_ptr(mbox_get(&rq->mb));
+	*msg_size = slot[0];
+	return &slot[1];
+}
+
+uint32 * rq_trypeek(rqueue * rq, uint32 * msg_size)
+{
+	uint32 * slot;
+	uint32 word;
+	
+	assert(rq->slab);
+	if(mbox_tryget(&rq->mb, &word)) return NULL;
+	slot = fsl_word_ptr(word);
+	*msg_size = slot[0];
+	return &slot[1];
+}
+
+void rq_release(rqueue * rq, uint32 * msg)
+{
+	assert(rq->slab);
+	mbox_put(&rq->free, fsl_ptr_word(&msg[-1]));
 }
 
 //! send message to ReconOS message queue. The data array at address 'msg' with size 'msg_size' 
 //  is stored internally and forwared to the next calling thread.
-void rq_send(rqueue * rq, uint32* msg, uint32 msg_size)
+int rq_send(rqueue * rq, uint32* msg, uint32 msg_size)
 {
-	uint32* copy = malloc(msg_size+sizeof(uint32));
+	uint32* copy;
+	
+	if(rq->slab){
+		if(msg_size > rq->slot_size) return -1;
+		copy = rq_reserve(rq);
+		memcpy(copy,msg,msg_size);
+		rq_commit(rq,copy,msg_size);
+		return 0;
+	}
+	
+	copy = malloc(msg_size+sizeof(uint32));
 	copy[0] = msg_size;
 	memcpy(&copy[1],msg,msg_size);
-	mbox_put((struct mbox *) rq, (uint32)copy);
+	mbox_put(&rq->mb, fsl_ptr_word(copy));
+	return 0;
 }
 
 //! receive message from ReconOS message queue. The data array is written to address 'msg' 
@@ -33,12 +128,74 @@ int rq_receive(rqueue * rq, uint32* msg, uint32 msg_size)
 {
 	uint32* copy;
 	uint32 size;
-	copy = (uint32*) mbox_get((struct mbox *) rq);
+	int result;
+	
+	copy = fsl_word_ptr(mbox_get(&rq->mb));
 	size = copy[0];
 	// error: The message size does not fit
-	if (size == 0 || size > msg_size) return -1;
-	memcpy(msg,&copy[1],size);
-	free(copy);
-	return size;
+	if (size == 0 || size > msg_size) {
+		result = -1;
+	} else {
+		memcpy(msg,&copy[1],size);
+		result = size;
+	}
+	
+	if(rq->slab){
+		mbox_put(&rq->free, fsl_ptr_word(copy));
+	} else {
+		free(copy);
+	}
+	return result;
 }
 
+//! non-blocking rq_send. Returns -2 if the queue is full.
+int rq_trysend(rqueue * rq, uint32* msg, uint32 msg_size)
+{
+	uint32* copy;
+	uint32 slot;
+	
+	if(rq->slab){
+		if(msg_size > rq->slot_size) return -1;
+		if(mbox_tryget(&rq->free, &slot)) return -2;
+		copy = &((uint32*)fsl_word_ptr(slot))[1];
+		memcpy(copy,msg,msg_size);
+		rq_commit(rq,copy,msg_size);
+		return 0;
+	}
+	
+	copy = malloc(msg_size+sizeof(uint32));
+	copy[0] = msg_size;
+	memcpy(&copy[1],msg,msg_size);
+	if(mbox_tryput(&rq->mb, fsl_ptr_word(copy))){
+		free(copy);
+		return -2;
+	}
+	return 0;
+}
+
+//! non-blocking rq_receive. Returns -2 if the queue is empty.
+int rq_tryreceive(rqueue * rq, uint32* msg, uint32 msg_size)
+{
+	uint32* copy;
+	uint32 word;
+	uint32 size;
+	int result;
+	
+	if(mbox_tryget(&rq->mb, &word)) return -2;
+	copy = fsl_word_ptr(word);
+	size = copy[0];
+	// error: The message size does not fit
+	if (size == 0 || size > msg_size) {
+		result = -1;
+	} else {
+		memcpy(msg,&copy[1],size);
+		result = size;
+	}
+	
+	if(rq->slab){
+		mbox_put(&rq->free, fsl_ptr_word(copy));
+	} else {
+		free(copy);
+	}
+	return result;
+}
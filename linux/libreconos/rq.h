@@ -9,23 +9,56 @@
 #include "config.h"
 #include "mbox.h"
 
-//! ReconOS message queue internally uses mbox
-typedef struct mbox rqueue;
+//! ReconOS message queue. Messages are passed through the mbox 'mb' as pointers
+//  to a buffer whose first word holds the message size, followed by the data.
+//  In slab mode these buffers are preallocated slots that circulate through the
+//  mbox 'free', so that no heap calls are needed while the queue is in use.
+typedef struct rqueue {
+	struct mbox mb;     // filled messages
+	struct mbox free;   // unused slots (slab mode only)
+	uint32 *slab;       // preallocated slots (slab mode only)
+	uint32 slot_size;   // maximum message size in bytes, 0 if messages are malloc'd
+} rqueue;
 
 //! initializes ReconOS message queue with maximum 'size' messages.
 int  rq_init(rqueue * rq, int size);
 
+//! initializes ReconOS message queue with a slab of 'size' slots of 'slot_size' bytes each.
+int  rq_init_slab(rqueue * rq, int size, uint32 slot_size);
+
 //! destroys ReconOS message queue
 void rq_close(rqueue * rq);
 
 //! send message to ReconOS message queue. The data array at address 'msg' with size 'msg_size' 
-//  is stored internally and forwared to the next calling thread.
-int  rq_receive(rqueue * rq, uint32* msg, uint32 msg_size);
+//  is stored internally and forwared to the next calling thread. Returns -1 if the message
+//  does not fit into a slot.
+int  rq_send(rqueue * rq, uint32* msg, uint32 msg_size);
 
 //! receive message from ReconOS message queue. The data array is written to address 'msg' 
 //  with a maximum size of 'msg_size' bytes. If the received message size exceeds 'msg_size', 
 //  the function returns -1.
-void rq_send(rqueue * rq, uint32* msg, uint32 msg_size);
+int  rq_receive(rqueue * rq, uint32* msg, uint32 msg_size);
 
-#endif
+//! non-blocking variants of rq_send() and rq_receive(). They return -2 instead
+//  of blocking if the queue is full or empty.
+int  rq_trysend(rqueue * rq, uint32* msg, uint32 msg_size);
+int  rq_tryreceive(rqueue * rq, uint32* msg, uint32 msg_size);
+
+//! slab mode only: blocks until a slot is free and returns it. The caller may
+//  write up to 'slot_size' bytes into the slot and must publish it with rq_commit().
+uint32 * rq_reserve(rqueue * rq);
 
+//! slab mode only: publishes a slot obtained by rq_reserve() as a message of 'msg_size' bytes.
+void rq_commit(rqueue * rq, uint32 * msg, uint32 msg_size);
+
+//! slab mode only: blocks until a message is available and returns it in place.
+//  The message size is stored in 'msg_size'. The slot must be handed back with rq_release().
+uint32 * rq_peek(rqueue * rq, uint32 * msg_size);
+
+//! slab mode only: like rq_peek(), but returns NULL instead of blocking if the queue is empty.
+uint32 * rq_trypeek(rqueue * rq, uint32 * msg_size);
+
+//! slab mode only: returns a slot obtained by rq_peek() to the slab.
+void rq_release(rqueue * rq, uint32 * msg);
+
+#endif
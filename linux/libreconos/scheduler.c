@@ -0,0 +1,221 @@
+#include "scheduler.h"
+#include "delegate.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#if 0
+#define RECONOS_DEBUG(...) fprintf(stderr,__VA_ARGS__);
+#else
+#define RECONOS_DEBUG(...)
+#endif
+
+#define RECONOS_ERROR(...) fprintf(stderr,"ERROR:" __VA_ARGS__);
+
+#define SCHEDULER_ALL_SLOTS ((1 << MAX_SLOTS) - 1)
+
+struct scheduler_slot {
+	int started;                     // delegate thread of the slot is running
+	pthread_t delegate;
+	struct reconos_hwt * hwt;        // thread assigned to the slot, NULL if free
+	unsigned long start_us;          // time the delegate has been started
+	unsigned long busy_since;        // time hwt has been assigned
+	struct reconos_sched_stats stats;
+};
+
+// indexed by slot number. slots and the queue are protected by scheduler_mutex
+static struct scheduler_slot slots[MAX_SLOTS];
+static struct reconos_hwt * queue_head = NULL;
+static struct reconos_hwt * queue_tail = NULL;
+static pthread_mutex_t scheduler_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t scheduler_cond = PTHREAD_COND_INITIALIZER; // a thread has been queued or has exited
+
+static void queue_append(struct reconos_hwt * hwt)
+{
+	hwt->next = NULL;
+	hwt->queued_us = delegate_time_us();
+	if(queue_tail){
+		queue_tail->next = hwt;
+	} else {
+		queue_head = hwt;
+	}
+	queue_tail = hwt;
+}
+
+// removes the first queued thread that may run in 'slot' from the queue
+static struct reconos_hwt * queue_take(int slot)
+{
+	struct reconos_hwt * hwt;
+	struct reconos_hwt * prev = NULL;
+
+	for(hwt = queue_head; hwt; prev = hwt, hwt = hwt->next){
+		if(!(hwt->slot_mask & (1 << slot))) continue;
+
+		if(prev){
+			prev->next = hwt->next;
+		} else {
+			queue_head = hwt->next;
+		}
+		if(queue_tail == hwt) queue_tail = prev;
+		hwt->next = NULL;
+		return hwt;
+	}
+
+	return NULL;
+}
+
+static void slot_assign(int slot, struct reconos_hwt * hwt, unsigned long now)
+{
+	struct scheduler_slot * s = &slots[slot];
+	unsigned long wait = now - hwt->queued_us;
+
+	hwt->slot = slot;
+	s->hwt = hwt;
+	s->busy_since = now;
+	s->stats.switches++;
+	s->stats.wait_us += wait;
+	if(wait > s->stats.max_wait_us) s->stats.max_wait_us = wait;
+}
+
+static void slot_release(int slot, unsigned long now)
+{
+	struct scheduler_slot * s = &slots[slot];
+
+	s->stats.busy_us += now - s->busy_since;
+	s->hwt = NULL;
+}
+
+// delegate of a slot used by shared threads. The slot is restarted for every
+// thread taken from the queue, threads handed over at THREAD_YIELD are
+// switched to by delegate_serve itself.
+static void * scheduler_slot_entry(void * arg)
+{
+	int slot = (int)(long)arg;
+	struct reconos_hwt * hwt;
+
+	pthread_mutex_lock(&scheduler_mutex);
+	while(1){
+		while(!(hwt = queue_take(slot))){
+			pthread_cond_wait(&scheduler_cond, &scheduler_mutex);
+		}
+		slot_assign(slot, hwt, delegate_time_us());
+		pthread_mutex_unlock(&scheduler_mutex);
+
+		RECONOS_DEBUG("slot %d: starting shared thread %p\n", slot, hwt);
+		reconos_slot_restart(slot);
+		hwt = delegate_serve(hwt);
+
+		pthread_mutex_lock(&scheduler_mutex);
+		RECONOS_DEBUG("slot %d: shared thread %p has exited\n", slot, hwt);
+		slot_release(slot, delegate_time_us());
+		hwt->exited = 1;
+		pthread_cond_broadcast(&scheduler_cond);
+	}
+
+	return NULL;
+}
+
+int scheduler_add(struct reconos_hwt * hwt)
+{
+	struct scheduler_slot * s;
+	int i;
+
+	if(hwt->slot_mask == 0 || (hwt->slot_mask & ~SCHEDULER_ALL_SLOTS)){
+		RECONOS_ERROR("slot mask 0x%08X does not name any slot or slots beyond %d\n",
+			hwt->slot_mask, MAX_SLOTS - 1);
+		return -1;
+	}
+
+	pthread_mutex_lock(&scheduler_mutex);
+
+	hwt->exited = 0;
+	queue_append(hwt);
+
+	for(i = 0; i < MAX_SLOTS; i++){
+		s = &slots[i];
+		if(!(hwt->slot_mask & (1 << i)) || s->started) continue;
+
+		s->start_us = delegate_time_us();
+		if(pthread_create(&s->delegate, NULL, scheduler_slot_entry, (void *)(long)i)){
+			perror("pthread_create: scheduler slot");
+			exit(1);
+		}
+		s->started = 1;
+	}
+
+	pthread_cond_broadcast(&scheduler_cond);
+	pthread_mutex_unlock(&scheduler_mutex);
+
+	return 0;
+}
+
+void scheduler_join(struct reconos_hwt * hwt)
+{
+	pthread_mutex_lock(&scheduler_mutex);
+	while(!hwt->exited){
+		pthread_cond_wait(&scheduler_cond, &scheduler_mutex);
+	}
+	pthread_mutex_unlock(&scheduler_mutex);
+}
+
+struct reconos_hwt * scheduler_yield(struct reconos_hwt * hwt)
+{
+	struct reconos_hwt * next;
+	unsigned long now;
+	int slot = hwt->slot;
+
+	pthread_mutex_lock(&scheduler_mutex);
+
+	next = queue_take(slot);
+	if(next){
+		now = delegate_time_us();
+		slot_release(slot, now);
+		queue_append(hwt);
+		slot_assign(slot, next, now);
+		slots[slot].stats.yields++;
+
+		// another free slot may take hwt
+		pthread_cond_broadcast(&scheduler_cond);
+	}
+
+	pthread_mutex_unlock(&scheduler_mutex);
+
+	return next;
+}
+
+void reconos_sched_stats(int slot, struct reconos_sched_stats * stats)
+{
+	struct scheduler_slot * s;
+	unsigned long now;
+
+	memset(stats, 0, sizeof(*stats));
+	if(slot < 0 || slot >= MAX_SLOTS) return;
+	s = &slots[slot];
+
+	pthread_mutex_lock(&scheduler_mutex);
+	if(s->started){
+		now = delegate_time_us();
+		*stats = s->stats;
+		stats->total_us = now - s->start_us;
+		if(s->hwt) stats->busy_us += now - s->busy_since;
+	}
+	pthread_mutex_unlock(&scheduler_mutex);
+}
+
+void reconos_sched_stats_print(void)
+{
+	struct reconos_sched_stats stats;
+	int i;
+
+	fprintf(stderr, "slot   threads   yields  utilisation  mean wait us  max wait us\n");
+	for(i = 0; i < MAX_SLOTS; i++){
+		reconos_sched_stats(i, &stats);
+		if(stats.total_us == 0) continue;
+
+		fprintf(stderr, "%4d %9u %8u %11.1f%% %13llu %12lu\n", i, stats.switches, stats.yields,
+			100.0*stats.busy_us/stats.total_us,
+			stats.switches ? stats.wait_us/stats.switches : 0, stats.max_wait_us);
+	}
+}
@@ -0,0 +1,23 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+/* Multiplexes shared hardware threads (reconos_hwt_create_shared) onto the
+   slots holding their bitstream. Every slot in use has a delegate thread of
+   its own, which serves the hardware thread currently assigned to the slot.
+   Threads waiting for a slot are kept in one FIFO queue; a slot that becomes
+   free takes the first queued thread whose slot mask contains it. */
+
+#include "reconos.h"
+
+// queues a shared hardware thread, starting the delegates of its slots if necessary.
+int scheduler_add(struct reconos_hwt * hwt);
+
+// blocks until the shared hardware thread has issued THREAD_EXIT.
+void scheduler_join(struct reconos_hwt * hwt);
+
+// called by the delegate on THREAD_YIELD of the shared thread hwt. If a queued
+// thread may use the slot of hwt, it is assigned to the slot and returned,
+// while hwt is queued again. Returns NULL if hwt keeps the slot.
+struct reconos_hwt * scheduler_yield(struct reconos_hwt * hwt);
+
+#endif
@@ -0,0 +1,210 @@
+#include "timer_wheel.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/timerfd.h>
+
+#if 0
+#define RECONOS_DEBUG(...) fprintf(stderr,__VA_ARGS__);
+#else
+#define RECONOS_DEBUG(...)
+#endif
+
+#define RECONOS_ERROR(...) fprintf(stderr,"ERROR:" __VA_ARGS__);
+
+// buckets, position, pending and the state of the entries are protected by
+// wheel_mutex
+static struct timer_entry * buckets[TIMER_WHEEL_SIZE];
+static uint32 position = 0;  // bucket of the current tick
+static uint32 pending = 0;   // timers in the wheel
+static uint32 arm_gen = 0;   // bumped whenever wheel_fd is started or stopped
+static struct timespec arm_time; // when wheel_fd was last started
+static pthread_mutex_t wheel_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t expired_cond = PTHREAD_COND_INITIALIZER; // an 'expire' has returned
+static pthread_once_t wheel_once = PTHREAD_ONCE_INIT;
+static pthread_t wheel_thread;
+static int wheel_fd;
+
+// starts (tick = 1) or stops (tick = 0) the periodic ticks of wheel_fd.
+// Called with wheel_mutex held.
+static void wheel_arm(int tick)
+{
+	struct itimerspec its;
+
+	arm_gen++;
+
+	memset(&its, 0, sizeof(its));
+	if(tick){
+		its.it_interval.tv_nsec = TIMER_WHEEL_TICK_US*1000;
+		its.it_value.tv_nsec = TIMER_WHEEL_TICK_US*1000;
+	}
+
+	if(timerfd_settime(wheel_fd, 0, &its, NULL) < 0){
+		perror("timerfd_settime");
+		exit(1);
+	}
+
+	// taken after the timer has started, so that the ticks counted from
+	// here are never more than wheel_fd has produced
+	if(tick) clock_gettime(CLOCK_MONOTONIC, &arm_time);
+}
+
+// ticks of the current period of wheel_fd that have passed. Called with
+// wheel_mutex held.
+static uint64_t wheel_ticks_since_arm(void)
+{
+	struct timespec now;
+	int64_t us;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	us = (int64_t)(now.tv_sec - arm_time.tv_sec)*1000000
+	     + (now.tv_nsec - arm_time.tv_nsec)/1000;
+
+	return us < 0 ? 0 : us/TIMER_WHEEL_TICK_US;
+}
+
+static void * wheel_thread_entry(void * arg)
+{
+	struct timer_entry * expired;
+	struct timer_entry * t;
+	struct timer_entry ** p;
+	uint64_t ticks;
+	uint32 gen;
+
+	while(1){
+		pthread_mutex_lock(&wheel_mutex);
+		gen = arm_gen;
+		pthread_mutex_unlock(&wheel_mutex);
+
+		if(read(wheel_fd, &ticks, sizeof(ticks)) != sizeof(ticks)) continue;
+
+		// collect the expired timers of all ticks that have passed
+		expired = NULL;
+		pthread_mutex_lock(&wheel_mutex);
+
+		// the wheel was stopped or started while reading, so the ticks may
+		// belong to the old period and would expire a timer added since
+		// early. Drop those and keep only the ticks the current period can
+		// have produced.
+		if(gen != arm_gen && ticks > wheel_ticks_since_arm()){
+			ticks = wheel_ticks_since_arm();
+		}
+
+		while(ticks-- > 0){
+			position = (position + 1) % TIMER_WHEEL_SIZE;
+			p = &buckets[position];
+			while((t = *p)){
+				if(t->rounds > 0){
+					t->rounds--;
+					p = &t->next;
+				} else {
+					*p = t->next;
+					t->next = expired;
+					t->state = TIMER_EXPIRING;
+					expired = t;
+					pending--;
+				}
+			}
+		}
+		if(pending == 0) wheel_arm(0);
+		pthread_mutex_unlock(&wheel_mutex);
+
+		while((t = expired)){
+			expired = t->next;
+			t->expire(t);
+
+			pthread_mutex_lock(&wheel_mutex);
+			t->state = TIMER_IDLE;
+			pthread_cond_broadcast(&expired_cond);
+			pthread_mutex_unlock(&wheel_mutex);
+		}
+	}
+
+	return NULL;
+}
+
+static void wheel_init(void)
+{
+	wheel_fd = timerfd_create(CLOCK_MONOTONIC, 0);
+	if(wheel_fd < 0){
+		perror("timerfd_create");
+		exit(1);
+	}
+
+	if(pthread_create(&wheel_thread, NULL, wheel_thread_entry, NULL)){
+		perror("pthread_create: timer wheel");
+		exit(1);
+	}
+}
+
+int timer_wheel_add(struct timer_entry * t, uint32 delay_us)
+{
+	uint32 ticks = (delay_us + TIMER_WHEEL_TICK_US - 1)/TIMER_WHEEL_TICK_US;
+	uint32 bucket;
+
+	pthread_once(&wheel_once, wheel_init);
+
+	pthread_mutex_lock(&wheel_mutex);
+
+	// 'expire' may have replied to a hardware thread that already issues the
+	// next delay
+	while(t->state == TIMER_EXPIRING){
+		pthread_cond_wait(&expired_cond, &wheel_mutex);
+	}
+
+	// linking t twice would corrupt its bucket
+	if(t->state == TIMER_PENDING){
+		pthread_mutex_unlock(&wheel_mutex);
+		RECONOS_ERROR("timer %p is still running\n", t);
+		return -1;
+	}
+
+	// an idle wheel starts ticking now, otherwise the current tick has
+	// partly passed, hence one more
+	if(pending > 0 || ticks == 0) ticks++;
+
+	bucket = (position + ticks) % TIMER_WHEEL_SIZE;
+	t->rounds = (ticks - 1)/TIMER_WHEEL_SIZE;
+	t->bucket = bucket;
+	t->state = TIMER_PENDING;
+	t->next = buckets[bucket];
+	buckets[bucket] = t;
+
+	RECONOS_DEBUG("timer %p: %d us, bucket %d, %d rounds\n", t, (int)delay_us, (int)bucket, (int)t->rounds);
+
+	if(pending++ == 0) wheel_arm(1);
+
+	pthread_mutex_unlock(&wheel_mutex);
+
+	return 0;
+}
+
+int timer_wheel_cancel(struct timer_entry * t)
+{
+	struct timer_entry ** p;
+	int res = 0;
+
+	pthread_mutex_lock(&wheel_mutex);
+
+	if(t->state == TIMER_PENDING){
+		for(p = &buckets[t->bucket]; *p != t; p = &(*p)->next);
+		*p = t->next;
+		t->state = TIMER_IDLE;
+		if(--pending == 0) wheel_arm(0);
+		res = 1;
+	}
+	while(t->state == TIMER_EXPIRING){
+		pthread_cond_wait(&expired_cond, &wheel_mutex);
+	}
+
+	pthread_mutex_unlock(&wheel_mutex);
+
+	RECONOS_DEBUG("timer %p: cancelled (%d)\n", t, res);
+
+	return res;
+}
@@ -0,0 +1,40 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+/* Timers shared by all delegates, e.g. for THREAD_DELAY. The timers are
+   kept in a hashed wheel of TIMER_WHEEL_SIZE buckets that is advanced by
+   one bucket per tick of a single timerfd, served by one thread. The timerfd
+   only ticks while timers are pending. */
+
+#include "config.h"
+
+#define TIMER_WHEEL_TICK_US 1000
+#define TIMER_WHEEL_SIZE    256
+
+#define TIMER_IDLE     0 // not in the wheel
+#define TIMER_PENDING  1 // in the wheel
+#define TIMER_EXPIRING 2 // expired, 'expire' has not returned yet
+
+struct timer_entry {
+	void (*expire)(struct timer_entry * t); // called by the timer thread
+	void * arg;
+	uint32 rounds;                          // turns of the wheel left
+	uint32 bucket;
+	int state;                              // TIMER_*, 0 for a new entry
+	struct timer_entry * next;
+};
+
+// starts the timer t, which expires after delay_us microseconds rounded up to
+// the next tick, at most two ticks late. 'expire' and 'arg' have to be set
+// by the caller; t must not be touched until 'expire' has returned. If t is
+// expiring, timer_wheel_add waits until 'expire' has returned, so it must not
+// be called from 'expire'. Returns -1 without starting t if it is pending.
+int timer_wheel_add(struct timer_entry * t, uint32 delay_us);
+
+// stops the timer t. Returns 1 if t was pending, 0 if it was idle or has
+// expired. In the latter case, timer_wheel_cancel waits until 'expire' has
+// returned, so it must not be called from 'expire' or with a lock held that
+// 'expire' takes.
+int timer_wheel_cancel(struct timer_entry * t);
+
+#endif
@@ -13,181 +13,186 @@ use ieee.numeric_std.all;  --! For unsigned and signed types and conversion from
 library proc_common_v3_00_a;
 use proc_common_v3_00_a.proc_common_pkg.all;
 
+library reconos_v3_00_a;
+use reconos_v3_00_a.reconos_pkg.all;
+
 entity fifo32_arbiter is
   generic (
     FIFO32_PORTS     : integer := 16;   --! 1 to 16 allowed
-    ARBITRATION_ALGO : integer := 0  --! 0= Round Robin, others not available atm.
+    ARBITRATION_ALGO : integer := 0;  --! 0= Round Robin, 1= Weighted Round Robin with priorities and caps
+    CAP_WINDOW       : integer := 4096;  --! Cycles after which the bandwidth caps are renewed (ARBITRATION_ALGO=1)
+    FIFO32_DWIDTH    : integer := 32  --! 32, 64 or 128 bits per word, see fifo32_width_adapter
     );
   port (
     -- Multiple FIFO32 Inputs
     IN_FIFO32_S_Clk_A  : out std_logic;
-    IN_FIFO32_S_Data_A : in  std_logic_vector(31 downto 0);
+    IN_FIFO32_S_Data_A : in  std_logic_vector(FIFO32_DWIDTH-1 downto 0);
     IN_FIFO32_S_Fill_A : in  std_logic_vector(15 downto 0);
     IN_FIFO32_S_Rd_A   : out std_logic;
 
     IN_FIFO32_M_Clk_A  : out std_logic;
-    IN_FIFO32_M_Data_A : out std_logic_vector(31 downto 0);
+    IN_FIFO32_M_Data_A : out std_logic_vector(FIFO32_DWIDTH-1 downto 0);
     IN_FIFO32_M_Rem_A  : in  std_logic_vector(15 downto 0);
     IN_FIFO32_M_Wr_A   : out std_logic;
 
     IN_FIFO32_S_Clk_B  : out std_logic;
-    IN_FIFO32_S_Data_B : in  std_logic_vector(31 downto 0);
+    IN_FIFO32_S_Data_B : in  std_logic_vector(FIFO32_DWIDTH-1 downto 0);
     IN_FIFO32_S_Fill_B : in  std_logic_vector(15 downto 0);
     IN_FIFO32_S_Rd_B   : out std_logic;
 
     IN_FIFO32_M_Clk_B  : out std_logic;
-    IN_FIFO32_M_Data_B : out std_logic_vector(31 downto 0);
+    IN_FIFO32_M_Data_B : out std_logic_vector(FIFO32_DWIDTH-1 downto 0);
     IN_FIFO32_M_Rem_B  : in  std_logic_vector(15 downto 0);
     IN_FIFO32_M_Wr_B   : out std_logic;
 
     IN_FIFO32_S_Clk_C  : out std_logic;
-    IN_FIFO32_S_Data_C : in  std_logic_vector(31 downto 0);
+    IN_FIFO32_S_Data_C : in  std_logic_vector(FIFO32_DWIDTH-1 downto 0);
     IN_FIFO32_S_Fill_C : in  std_logic_vector(15 downto 0);
     IN_FIFO32_S_Rd_C   : out std_logic;
 
     IN_FIFO32_M_Clk_C  : out std_logic;
-    IN_FIFO32_M_Data_C : out std_logic_vector(31 downto 0);
+    IN_FIFO32_M_Data_C : out std_logic_vector(FIFO32_DWIDTH-1 downto 0);
     IN_FIFO32_M_Rem_C  : in  std_logic_vector(15 downto 0);
     IN_FIFO32_M_Wr_C   : out std_logic;
 
     IN_FIFO32_S_Clk_D  : out std_logic;
-    IN_FIFO32_S_Data_D : in  std_logic_vector(31 downto 0);
+    IN_FIFO32_S_Data_D : in  std_logic_vector(FIFO32_DWIDTH-1 downto 0);
     IN_FIFO32_S_Fill_D : in  std_logic_vector(15 downto 0);
     IN_FIFO32_S_Rd_D   : out std_logic;
 
     IN_FIFO32_M_Clk_D  : out std_logic;
-    IN_FIFO32_M_Data_D : out std_logic_vector(31 downto 0);
+    IN_FIFO32_M_Data_D : out std_logic_vector(FIFO32_DWIDTH-1 downto 0);
     IN_FIFO32_M_Rem_D  : in  std_logic_vector(15 downto 0);
     IN_FIFO32_M_Wr_D   : out std_logic;
 
     IN_FIFO32_S_Clk_E  : out std_logic;
-    IN_FIFO32_S_Data_E : in  std_logic_vector(31 downto 0);
+    IN_FIFO32_S_Data_E : in  std_logic_vector(FIFO32_DWIDTH-1 downto 0);
     IN_FIFO32_S_Fill_E : in  std_logic_vector(15 downto 0);
     IN_FIFO32_S_Rd_E   : out std_logic;
 
     IN_FIFO32_M_Clk_E  : out std_logic;
-    IN_FIFO32_M_Data_E : out std_logic_vector(31 downto 0);
+    IN_FIFO32_M_Data_E : out std_logic_vector(FIFO32_DWIDTH-1 downto 0);
     IN_FIFO32_M_Rem_E  : in  std_logic_vector(15 downto 0);
     IN_FIFO32_M_Wr_E   : out std_logic;
 
     IN_FIFO32_S_Clk_F  : out std_logic;
-    IN_FIFO32_S_Data_F : in  std_logic_vector(31 downto 0);
+    IN_FIFO32_S_Data_F : in  std_logic_vector(FIFO32_DWIDTH-1 downto 0);
     IN_FIFO32_S_Fill_F : in  std_logic_vector(15 downto 0);
     IN_FIFO32_S_Rd_F   : out std_logic;
 
     IN_FIFO32_M_Clk_F  : out std_logic;
-    IN_FIFO32_M_Data_F : out std_logic_vector(31 downto 0);
+    IN_FIFO32_M_Data_F : out std_logic_vector(FIFO32_DWIDTH-1 downto 0);
     IN_FIFO32_M_Rem_F  : in  std_logic_vector(15 downto 0);
     IN_FIFO32_M_Wr_F   : out std_logic;
 
     IN_FIFO32_S_Clk_G  : out std_logic;
-    IN_FIFO32_S_Data_G : in  std_logic_vector(31 downto 0);
+    IN_FIFO32_S_Data_G : in  std_logic_vector(FIFO32_DWIDTH-1 downto 0);
     IN_FIFO32_S_Fill_G : in  std_logic_vector(15 downto 0);
     IN_FIFO32_S_Rd_G   : out std_logic;
 
     IN_FIFO32_M_Clk_G  : out std_logic;
-    IN_FIFO32_M_Data_G : out std_logic_vector(31 downto 0);
+    IN_FIFO32_M_Data_G : out std_logic_vector(FIFO32_DWIDTH-1 downto 0);
     IN_FIFO32_M_Rem_G  : in  std_logic_vector(15 downto 0);
     IN_FIFO32_M_Wr_G   : out std_logic;
 
     IN_FIFO32_S_Clk_H  : out std_logic;
-    IN_FIFO32_S_Data_H : in  std_logic_vector(31 downto 0);
+    IN_FIFO32_S_Data_H : in  std_logic_vector(FIFO32_DWIDTH-1 downto 0);
     IN_FIFO32_S_Fill_H : in  std_logic_vector(15 downto 0);
     IN_FIFO32_S_Rd_H   : out std_logic;
 
     IN_FIFO32_M_Clk_H  : out std_logic;
-    IN_FIFO32_M_Data_H : out std_logic_vector(31 downto 0);
+    IN_FIFO32_M_Data_H : out std_logic_vector(FIFO32_DWIDTH-1 downto 0);
     IN_FIFO32_M_Rem_H  : in  std_logic_vector(15 downto 0);
     IN_FIFO32_M_Wr_H   : out std_logic;
 
     IN_FIFO32_S_Clk_I  : out std_logic;
-    IN_FIFO32_S_Data_I : in  std_logic_vector(31 downto 0);
+    IN_FIFO32_S_Data_I : in  std_logic_vector(FIFO32_DWIDTH-1 downto 0);
     IN_FIFO32_S_Fill_I : in  std_logic_vector(15 downto 0);
     IN_FIFO32_S_Rd_I   : out std_logic;
 
     IN_FIFO32_M_Clk_I  : out std_logic;
-    IN_FIFO32_M_Data_I : out std_logic_vector(31 downto 0);
+    IN_FIFO32_M_Data_I : out std_logic_vector(FIFO32_DWIDTH-1 downto 0);
     IN_FIFO32_M_Rem_I  : in  std_logic_vector(15 downto 0);
     IN_FIFO32_M_Wr_I   : out std_logic;
 
     IN_FIFO32_S_Clk_J  : out std_logic;
-    IN_FIFO32_S_Data_J : in  std_logic_vector(31 downto 0);
+    IN_FIFO32_S_Data_J : in  std_logic_vector(FIFO32_DWIDTH-1 downto 0);
     IN_FIFO32_S_Fill_J : in  std_logic_vector(15 downto 0);
     IN_FIFO32_S_Rd_J   : out std_logic;
 
     IN_FIFO32_M_Clk_J  : out std_logic;
-    IN_FIFO32_M_Data_J : out std_logic_vector(31 downto 0);
+    IN_FIFO32_M_Data_J : out std_logic_vector(FIFO32_DWIDTH-1 downto 0);
     IN_FIFO32_M_Rem_J  : in  std_logic_vector(15 downto 0);
     IN_FIFO32_M_Wr_J   : out std_logic;
 
     IN_FIFO32_S_Clk_K  : out std_logic;
-    IN_FIFO32_S_Data_K : in  std_logic_vector(31 downto 0);
+    IN_FIFO32_S_Data_K : in  std_logic_vector(FIFO32_DWIDTH-1 downto 0);
     IN_FIFO32_S_Fill_K : in  std_logic_vector(15 downto 0);
     IN_FIFO32_S_Rd_K   : out std_logic;
 
     IN_FIFO32_M_Clk_K  : out std_logic;
-    IN_FIFO32_M_Data_K : out std_logic_vector(31 downto 0);
+    IN_FIFO32_M_Data_K : out std_logic_vector(FIFO32_DWIDTH-1 downto 0);
     IN_FIFO32_M_Rem_K  : in  std_logic_vector(15 downto 0);
     IN_FIFO32_M_Wr_K   : out std_logic;
 
     IN_FIFO32_S_Clk_L  : out std_logic;
-    IN_FIFO32_S_Data_L : in  std_logic_vector(31 downto 0);
+    IN_FIFO32_S_Data_L : in  std_logic_vector(FIFO32_DWIDTH-1 downto 0);
     IN_FIFO32_S_Fill_L : in  std_logic_vector(15 downto 0);
     IN_FIFO32_S_Rd_L   : out std_logic;
 
     IN_FIFO32_M_Clk_L  : out std_logic;
-    IN_FIFO32_M_Data_L : out std_logic_vector(31 downto 0);
+    IN_FIFO32_M_Data_L : out std_logic_vector(FIFO32_DWIDTH-1 downto 0);
     IN_FIFO32_M_Rem_L  : in  std_logic_vector(15 downto 0);
     IN_FIFO32_M_Wr_L   : out std_logic;
 
     IN_FIFO32_S_Clk_M  : out std_logic;
-    IN_FIFO32_S_Data_M : in  std_logic_vector(31 downto 0);
+    IN_FIFO32_S_Data_M : in  std_logic_vector(FIFO32_DWIDTH-1 downto 0);
     IN_FIFO32_S_Fill_M : in  std_logic_vector(15 downto 0);
     IN_FIFO32_S_Rd_M   : out std_logic;
 
     IN_FIFO32_M_Clk_M  : out std_logic;
-    IN_FIFO32_M_Data_M : out std_logic_vector(31 downto 0);
+    IN_FIFO32_M_Data_M : out std_logic_vector(FIFO32_DWIDTH-1 downto 0);
     IN_FIFO32_M_Rem_M  : in  std_logic_vector(15 downto 0);
     IN_FIFO32_M_Wr_M   : out std_logic;
 
     IN_FIFO32_S_Clk_N  : out std_logic;
-    IN_FIFO32_S_Data_N : in  std_logic_vector(31 downto 0);
+    IN_FIFO32_S_Data_N : in  std_logic_vector(FIFO32_DWIDTH-1 downto 0);
     IN_FIFO32_S_Fill_N : in  std_logic_vector(15 downto 0);
     IN_FIFO32_S_Rd_N   : out std_logic;
 
     IN_FIFO32_M_Clk_N  : out std_logic;
-    IN_FIFO32_M_Data_N : out std_logic_vector(31 downto 0);
+    IN_FIFO32_M_Data_N : out std_logic_vector(FIFO32_DWIDTH-1 downto 0);
     IN_FIFO32_M_Rem_N  : in  std_logic_vector(15 downto 0);
     IN_FIFO32_M_Wr_N   : out std_logic;
 
     IN_FIFO32_S_Clk_O  : out std_logic;
-    IN_FIFO32_S_Data_O : in  std_logic_vector(31 downto 0);
+    IN_FIFO32_S_Data_O : in  std_logic_vector(FIFO32_DWIDTH-1 downto 0);
     IN_FIFO32_S_Fill_O : in  std_logic_vector(15 downto 0);
     IN_FIFO32_S_Rd_O   : out std_logic;
 
     IN_FIFO32_M_Clk_O  : out std_logic;
-    IN_FIFO32_M_Data_O : out std_logic_vector(31 downto 0);
+    IN_FIFO32_M_Data_O : out std_logic_vector(FIFO32_DWIDTH-1 downto 0);
     IN_FIFO32_M_Rem_O  : in  std_logic_vector(15 downto 0);
     IN_FIFO32_M_Wr_O   : out std_logic;
 
     IN_FIFO32_S_Clk_P  : out std_logic;
-    IN_FIFO32_S_Data_P : in  std_logic_vector(31 downto 0);
+    IN_FIFO32_S_Data_P : in  std_logic_vector(FIFO32_DWIDTH-1 downto 0);
     IN_FIFO32_S_Fill_P : in  std_logic_vector(15 downto 0);
     IN_FIFO32_S_Rd_P   : out std_logic;
     
     IN_FIFO32_M_Clk_P  : out std_logic;
-    IN_FIFO32_M_Data_P : out std_logic_vector(31 downto 0);
+    IN_FIFO32_M_Data_P : out std_logic_vector(FIFO32_DWIDTH-1 downto 0);
     IN_FIFO32_M_Rem_P  : in  std_logic_vector(15 downto 0);
     IN_FIFO32_M_Wr_P   : out std_logic;
     
     -- Single FIFO32 Output
     OUT_FIFO32_S_Clk  : in  std_logic;
-    OUT_FIFO32_S_Data : out std_logic_vector(31 downto 0);
+    OUT_FIFO32_S_Data : out std_logic_vector(FIFO32_DWIDTH-1 downto 0);
     OUT_FIFO32_S_Fill : out std_logic_vector(15 downto 0);
     OUT_FIFO32_S_Rd   : in  std_logic;
 
     OUT_FIFO32_M_Clk  : in  std_logic;
-    OUT_FIFO32_M_Data : in  std_logic_vector(31 downto 0);
+    OUT_FIFO32_M_Data : in  std_logic_vector(FIFO32_DWIDTH-1 downto 0);
     OUT_FIFO32_M_Rem  : out std_logic_vector(15 downto 0);
     OUT_FIFO32_M_Wr   : in  std_logic;
 
@@ -195,6 +200,27 @@ entity fifo32_arbiter is
     Rst : in std_logic;
     clk : in std_logic;                  -- separate clock for control logic
 
+    -- Port that is currently connected to the output, e.g. for per thread
+    -- statistics in the mmu
+    SEL : out std_logic_vector(3 downto 0);
+
+    -- Configuration of the weighted arbiter (ARBITRATION_ALGO=1), see
+    -- wrr_arbiter.vhd for the layout of ARB_CONFIG
+    ARB_PORT   : in std_logic_vector(3 downto 0);
+    ARB_CONFIG : in std_logic_vector(31 downto 0);
+    ARB_WE     : in std_logic;
+    -- '1' if the configuration is used, i.e. ARBITRATION_ALGO=1
+    ARB_ACTIVE : out std_logic;
+    -- Page faults parked by the mmu (C_PARK_FAULTS=1). PARK puts the packet
+    -- of the selected port aside after its header and address were read,
+    -- the port is then skipped. RESUME is set once the fault is handled: no
+    -- new packet is started any more, and as soon as the arbiter is idle it
+    -- selects the parked packet again and pulses RESUMED to the burst
+    -- converter and the mmu. Tie PARK and RESUME to '0' without such an mmu.
+    PARK    : in std_logic;
+    RESUME  : in std_logic;
+    RESUMED : out std_logic;
+
     -- Debug signals to ILA
     ila_signals : out std_logic_vector(130 downto 0)
     );
@@ -221,6 +247,24 @@ architecture behavioural of fifo32_arbiter is
       sel      : out std_logic_vector (clog2(request_width)-1 downto 0));  --! Who of the requesters will be served?
   end component;
 
+  component wrr_arbiter
+    generic(
+      request_width : positive := 16;  --! How many request inputs do you want?
+      cap_window    : positive := 4096  --! Cycles after which the bandwidth caps are renewed
+      );
+    port (
+      clk         : in  std_logic;      --! Clock signal
+      reset       : in  std_logic;      --! Reset signal
+      requests    : in  std_logic_vector (request_width-1 downto 0);  --! Input lines from the requestors.
+      packet_done : in  std_logic;      --! A packet has been transferred completely.
+      done_sel    : in  std_logic_vector (clog2(request_width)-1 downto 0);  --! Whose packet has been transferred?
+      cfg_port    : in  std_logic_vector (3 downto 0);  --! Requestor to configure
+      cfg_data    : in  std_logic_vector (31 downto 0);  --! Configuration word
+      cfg_we      : in  std_logic;      --! Write cfg_data to the configuration of cfg_port
+      sel         : out std_logic_vector (clog2(request_width)-1 downto 0);  --! Who of the requesters will be served?
+      blocked     : out std_logic_vector (request_width-1 downto 0));  --! Requestors that have used up their cap
+  end component;
+
   component mux
     generic (
       element_width : positive := 32;  --! Width in bits of the input and output ports
@@ -251,12 +295,12 @@ architecture behavioural of fifo32_arbiter is
 --------------------------------------------------------------------------------
   -- Internal signal vectors to unify all 16 FIFO32 ports
   signal IN_FIFO32_S_Clk  : std_logic_vector(FIFO32_PORTS-1 downto 0);
-  signal IN_FIFO32_S_Data : std_logic_vector((32*FIFO32_PORTS)-1 downto 0);
+  signal IN_FIFO32_S_Data : std_logic_vector((FIFO32_DWIDTH*FIFO32_PORTS)-1 downto 0);
   signal IN_FIFO32_S_Fill : std_logic_vector((16*FIFO32_PORTS)-1 downto 0);
   signal IN_FIFO32_S_Rd   : std_logic_vector(FIFO32_PORTS-1 downto 0);
 
   signal IN_FIFO32_M_Clk  : std_logic_vector(FIFO32_PORTS-1 downto 0);
-  signal IN_FIFO32_M_Data : std_logic_vector((32*FIFO32_PORTS)-1 downto 0);
+  signal IN_FIFO32_M_Data : std_logic_vector((FIFO32_DWIDTH*FIFO32_PORTS)-1 downto 0);
   signal IN_FIFO32_M_Rem  : std_logic_vector((16*FIFO32_PORTS)-1 downto 0);
   signal IN_FIFO32_M_Wr   : std_logic_vector(FIFO32_PORTS-1 downto 0);
 
@@ -269,9 +313,22 @@ architecture behavioural of fifo32_arbiter is
   --! 
   signal requests : std_logic_vector(FIFO32_PORTS-1 downto 0);
 
+  --! Requestors that must not start a packet, because they are over their cap.
+  signal blocked : std_logic_vector(FIFO32_PORTS-1 downto 0);
+
+  --! The fsm waits for the first word of a packet.
+  signal fsm_idle : std_logic;
+
+  --! The fsm has transferred the last word of a packet from sel2mux.
+  signal packet_done : std_logic;
+  --! The packet of park_sel is parked, see PARK.
+  signal park_valid : std_logic;
+  signal park_sel   : std_logic_vector(clog2(FIFO32_PORTS)-1 downto 0);
+
   --! Tap slave data output to memory controller
-  signal INT_OUT_FIFO32_S_Data : std_logic_vector(31 downto 0);
+  signal INT_OUT_FIFO32_S_Data : std_logic_vector(FIFO32_DWIDTH-1 downto 0);
   signal INT_OUT_FIFO32_S_Fill : std_logic_vector(15 downto 0);
+  signal MUX_OUT_FIFO32_S_Fill : std_logic_vector(15 downto 0);
   signal INT_OUT_FIFO32_M_Rem  : std_logic_vector(15 downto 0);
 
 begin  -- of architecture -------------------------------------------------------
@@ -279,192 +336,192 @@ begin  -- of architecture ------------------------------------------------------
   -- connect separate entity ports to internal signal vectors
   A: if FIFO32_PORTS > 0 generate
     IN_FIFO32_S_Clk_A  <= IN_FIFO32_S_Clk(0);
-    IN_FIFO32_S_Data((32 * (1 + 0))-1 downto 32 * 0) <= IN_FIFO32_S_Data_A;
+    IN_FIFO32_S_Data((FIFO32_DWIDTH * (1 + 0))-1 downto FIFO32_DWIDTH * 0) <= IN_FIFO32_S_Data_A;
     IN_FIFO32_S_Fill((16 * (1 + 0))-1 downto 16 * 0) <= IN_FIFO32_S_Fill_A;
     IN_FIFO32_S_Rd_A  <= IN_FIFO32_S_Rd(0);
 
     IN_FIFO32_M_Clk_A  <= IN_FIFO32_M_Clk(0);
-    IN_FIFO32_M_Data_A <= IN_FIFO32_M_Data((32 * (1 + 0))-1 downto 32 * 0);
+    IN_FIFO32_M_Data_A <= IN_FIFO32_M_Data((FIFO32_DWIDTH * (1 + 0))-1 downto FIFO32_DWIDTH * 0);
     IN_FIFO32_M_Rem((16 * (1 + 0))-1 downto 16 * 0)  <= IN_FIFO32_M_Rem_A;
     IN_FIFO32_M_Wr_A   <= IN_FIFO32_M_Wr(0);
   end generate;
 
   B: if FIFO32_PORTS > 1 generate
   IN_FIFO32_S_Clk_B  <= IN_FIFO32_S_Clk(1);
-  IN_FIFO32_S_Data((32 * (1 + 1))-1 downto 32 * 1) <= IN_FIFO32_S_Data_B;
+  IN_FIFO32_S_Data((FIFO32_DWIDTH * (1 + 1))-1 downto FIFO32_DWIDTH * 1) <= IN_FIFO32_S_Data_B;
   IN_FIFO32_S_Fill((16 * (1 + 1))-1 downto 16 * 1) <= IN_FIFO32_S_Fill_B;
   IN_FIFO32_S_Rd_B  <= IN_FIFO32_S_Rd(1);
 
   IN_FIFO32_M_Clk_B  <= IN_FIFO32_M_Clk(1);
-  IN_FIFO32_M_Data_B <= IN_FIFO32_M_Data((32 * (1 + 1))-1 downto 32 * 1);
+  IN_FIFO32_M_Data_B <= IN_FIFO32_M_Data((FIFO32_DWIDTH * (1 + 1))-1 downto FIFO32_DWIDTH * 1);
   IN_FIFO32_M_Rem((16 * (1 + 1))-1 downto 16 * 1)  <= IN_FIFO32_M_Rem_B;
   IN_FIFO32_M_Wr_B   <= IN_FIFO32_M_Wr(1);
   end generate;
 
   C: if FIFO32_PORTS > 2 generate
   IN_FIFO32_S_Clk_C  <= IN_FIFO32_S_Clk(2);
-  IN_FIFO32_S_Data((32 * (1 + 2))-1 downto 32 * 2) <= IN_FIFO32_S_Data_C;
+  IN_FIFO32_S_Data((FIFO32_DWIDTH * (1 + 2))-1 downto FIFO32_DWIDTH * 2) <= IN_FIFO32_S_Data_C;
   IN_FIFO32_S_Fill((16 * (1 + 2))-1 downto 16 * 2) <= IN_FIFO32_S_Fill_C;
   IN_FIFO32_S_Rd_C  <= IN_FIFO32_S_Rd(2);
 
   IN_FIFO32_M_Clk_C  <= IN_FIFO32_M_Clk(2);
-  IN_FIFO32_M_Data_C <= IN_FIFO32_M_Data((32 * (1 + 2))-1 downto 32 * 2);
+  IN_FIFO32_M_Data_C <= IN_FIFO32_M_Data((FIFO32_DWIDTH * (1 + 2))-1 downto FIFO32_DWIDTH * 2);
   IN_FIFO32_M_Rem((16 * (1 + 2))-1 downto 16 * 2)  <= IN_FIFO32_M_Rem_C;
   IN_FIFO32_M_Wr_C   <= IN_FIFO32_M_Wr(2);
   end generate;
 
   D: if FIFO32_PORTS > 3 generate
   IN_FIFO32_S_Clk_D  <= IN_FIFO32_S_Clk(3);
-  IN_FIFO32_S_Data((32 * (1 + 3))-1 downto 32 * 3) <= IN_FIFO32_S_Data_D;
+  IN_FIFO32_S_Data((FIFO32_DWIDTH * (1 + 3))-1 downto FIFO32_DWIDTH * 3) <= IN_FIFO32_S_Data_D;
   IN_FIFO32_S_Fill((16 * (1 + 3))-1 downto 16 * 3) <= IN_FIFO32_S_Fill_D;
   IN_FIFO32_S_Rd_D  <= IN_FIFO32_S_Rd(3);
 
   IN_FIFO32_M_Clk_D  <= IN_FIFO32_M_Clk(2);
-  IN_FIFO32_M_Data_D <= IN_FIFO32_M_Data((32 * (1 + 3))-1 downto 32 * 3);
+  IN_FIFO32_M_Data_D <= IN_FIFO32_M_Data((FIFO32_DWIDTH * (1 + 3))-1 downto FIFO32_DWIDTH * 3);
   IN_FIFO32_M_Rem((16 * (1 + 3))-1 downto 16 * 3)  <= IN_FIFO32_M_Rem_D;
   IN_FIFO32_M_Wr_D   <= IN_FIFO32_M_Wr(3);
   end generate;
 
   E: if FIFO32_PORTS > 4 generate
   IN_FIFO32_S_Clk_E  <= IN_FIFO32_S_Clk(4);
-  IN_FIFO32_S_Data((32 * (1 + 4))-1 downto 32 * 4) <= IN_FIFO32_S_Data_E;
+  IN_FIFO32_S_Data((FIFO32_DWIDTH * (1 + 4))-1 downto FIFO32_DWIDTH * 4) <= IN_FIFO32_S_Data_E;
   IN_FIFO32_S_Fill((16 * (1 + 4))-1 downto 16 * 4) <= IN_FIFO32_S_Fill_E;
   IN_FIFO32_S_Rd_E  <= IN_FIFO32_S_Rd(4);
 
   IN_FIFO32_M_Clk_E  <= IN_FIFO32_M_Clk(4);
-  IN_FIFO32_M_Data_E <= IN_FIFO32_M_Data((32 * (1 + 4))-1 downto 32 * 4);
+  IN_FIFO32_M_Data_E <= IN_FIFO32_M_Data((FIFO32_DWIDTH * (1 + 4))-1 downto FIFO32_DWIDTH * 4);
   IN_FIFO32_M_Rem((16 * (1 + 4))-1 downto 16 * 4)  <= IN_FIFO32_M_Rem_E;
   IN_FIFO32_M_Wr_E   <= IN_FIFO32_M_Wr(4);
   end generate;
 
   F: if FIFO32_PORTS > 5 generate
   IN_FIFO32_S_Clk_F  <= IN_FIFO32_S_Clk(5);
-  IN_FIFO32_S_Data((32 * (1 + 5))-1 downto 32 * 5) <= IN_FIFO32_S_Data_F;
+  IN_FIFO32_S_Data((FIFO32_DWIDTH * (1 + 5))-1 downto FIFO32_DWIDTH * 5) <= IN_FIFO32_S_Data_F;
   IN_FIFO32_S_Fill((16 * (1 + 5))-1 downto 16 * 5) <= IN_FIFO32_S_Fill_F;
   IN_FIFO32_S_Rd_F  <= IN_FIFO32_S_Rd(5);
 
   IN_FIFO32_M_Clk_F  <= IN_FIFO32_M_Clk(5);
-  IN_FIFO32_M_Data_F <= IN_FIFO32_M_Data((32 * (1 + 5))-1 downto 32 * 5);
+  IN_FIFO32_M_Data_F <= IN_FIFO32_M_Data((FIFO32_DWIDTH * (1 + 5))-1 downto FIFO32_DWIDTH * 5);
   IN_FIFO32_M_Rem((16 * (1 + 5))-1 downto 16 * 5)  <= IN_FIFO32_M_Rem_F;
   IN_FIFO32_M_Wr_F   <= IN_FIFO32_M_Wr(5);
   end generate;
 
   G: if FIFO32_PORTS > 6 generate
   IN_FIFO32_S_Clk_G  <= IN_FIFO32_S_Clk(6);
-  IN_FIFO32_S_Data((32 * (1 + 6))-1 downto 32 * 6) <= IN_FIFO32_S_Data_G;
+  IN_FIFO32_S_Data((FIFO32_DWIDTH * (1 + 6))-1 downto FIFO32_DWIDTH * 6) <= IN_FIFO32_S_Data_G;
   IN_FIFO32_S_Fill((16 * (1 + 6))-1 downto 16 * 6) <= IN_FIFO32_S_Fill_G;
   IN_FIFO32_S_Rd_G  <= IN_FIFO32_S_Rd(6);
 
   IN_FIFO32_M_Clk_G  <= IN_FIFO32_M_Clk(6);
-  IN_FIFO32_M_Data_G <= IN_FIFO32_M_Data((32 * (1 + 6))-1 downto 32 * 6);
+  IN_FIFO32_M_Data_G <= IN_FIFO32_M_Data((FIFO32_DWIDTH * (1 + 6))-1 downto FIFO32_DWIDTH * 6);
   IN_FIFO32_M_Rem((16 * (1 + 6))-1 downto 16 * 6)  <= IN_FIFO32_M_Rem_G;
   IN_FIFO32_M_Wr_G   <= IN_FIFO32_M_Wr(6);
   end generate;
 
   H: if FIFO32_PORTS > 7 generate
   IN_FIFO32_S_Clk_H  <= IN_FIFO32_S_Clk(7);
-  IN_FIFO32_S_Data((32 * (1 + 7))-1 downto 32 * 7) <= IN_FIFO32_S_Data_H;
+  IN_FIFO32_S_Data((FIFO32_DWIDTH * (1 + 7))-1 downto FIFO32_DWIDTH * 7) <= IN_FIFO32_S_Data_H;
   IN_FIFO32_S_Fill((16 * (1 + 7))-1 downto 16 * 7) <= IN_FIFO32_S_Fill_H;
   IN_FIFO32_S_Rd_H  <= IN_FIFO32_S_Rd(7);
 
   IN_FIFO32_M_Clk_H  <= IN_FIFO32_M_Clk(7);
-  IN_FIFO32_M_Data_H <= IN_FIFO32_M_Data((32 * (1 + 7))-1 downto 32 * 7);
+  IN_FIFO32_M_Data_H <= IN_FIFO32_M_Data((FIFO32_DWIDTH * (1 + 7))-1 downto FIFO32_DWIDTH * 7);
   IN_FIFO32_M_Rem((16 * (1 + 7))-1 downto 16 * 7)  <= IN_FIFO32_M_Rem_H;
   IN_FIFO32_M_Wr_H   <= IN_FIFO32_M_Wr(7);
   end generate;
 
   I: if FIFO32_PORTS > 8 generate
   IN_FIFO32_S_Clk_I  <= IN_FIFO32_S_Clk(8);
-  IN_FIFO32_S_Data((32 * (1 + 8))-1 downto 32 * 8) <= IN_FIFO32_S_Data_I;
+  IN_FIFO32_S_Data((FIFO32_DWIDTH * (1 + 8))-1 downto FIFO32_DWIDTH * 8) <= IN_FIFO32_S_Data_I;
   IN_FIFO32_S_Fill((16 * (1 + 8))-1 downto 16 * 8) <= IN_FIFO32_S_Fill_I;
   IN_FIFO32_S_Rd_I  <= IN_FIFO32_S_Rd(8);
 
   IN_FIFO32_M_Clk_I  <= IN_FIFO32_M_Clk(8);
-  IN_FIFO32_M_Data_I <= IN_FIFO32_M_Data((32 * (1 + 8))-1 downto 32 * 8);
+  IN_FIFO32_M_Data_I <= IN_FIFO32_M_Data((FIFO32_DWIDTH * (1 + 8))-1 downto FIFO32_DWIDTH * 8);
   IN_FIFO32_M_Rem((16 * (1 + 8))-1 downto 16 * 8)  <= IN_FIFO32_M_Rem_I;
   IN_FIFO32_M_Wr_I   <= IN_FIFO32_M_Wr(8);
   end generate;
 
   J: if FIFO32_PORTS > 9 generate
   IN_FIFO32_S_Clk_J  <= IN_FIFO32_S_Clk(9);
-  IN_FIFO32_S_Data((32 * (1 + 9))-1 downto 32 * 9) <= IN_FIFO32_S_Data_J;
+  IN_FIFO32_S_Data((FIFO32_DWIDTH * (1 + 9))-1 downto FIFO32_DWIDTH * 9) <= IN_FIFO32_S_Data_J;
   IN_FIFO32_S_Fill((16 * (1 + 9))-1 downto 16 * 9) <= IN_FIFO32_S_Fill_J;
   IN_FIFO32_S_Rd_J  <= IN_FIFO32_S_Rd(9);
 
   IN_FIFO32_M_Clk_J  <= IN_FIFO32_M_Clk(9);
-  IN_FIFO32_M_Data_J <= IN_FIFO32_M_Data((32 * (1 + 9))-1 downto 32 * 9);
+  IN_FIFO32_M_Data_J <= IN_FIFO32_M_Data((FIFO32_DWIDTH * (1 + 9))-1 downto FIFO32_DWIDTH * 9);
   IN_FIFO32_M_Rem((16 * (1 + 9))-1 downto 16 * 9)  <= IN_FIFO32_M_Rem_J;
   IN_FIFO32_M_Wr_J   <= IN_FIFO32_M_Wr(9);
   end generate;
 
   K: if FIFO32_PORTS > 10 generate
   IN_FIFO32_S_Clk_K  <= IN_FIFO32_S_Clk(10);
-  IN_FIFO32_S_Data((32 * (1 + 10))-1 downto 32 * 10) <= IN_FIFO32_S_Data_K;
+  IN_FIFO32_S_Data((FIFO32_DWIDTH * (1 + 10))-1 downto FIFO32_DWIDTH * 10) <= IN_FIFO32_S_Data_K;
   IN_FIFO32_S_Fill((16 * (1 + 10))-1 downto 16 * 10) <= IN_FIFO32_S_Fill_K;
   IN_FIFO32_S_Rd_K  <= IN_FIFO32_S_Rd(10);
 
   IN_FIFO32_M_Clk_K  <= IN_FIFO32_M_Clk(10);
-  IN_FIFO32_M_Data_K <= IN_FIFO32_M_Data((32 * (1 + 10))-1 downto 32 * 10);
+  IN_FIFO32_M_Data_K <= IN_FIFO32_M_Data((FIFO32_DWIDTH * (1 + 10))-1 downto FIFO32_DWIDTH * 10);
   IN_FIFO32_M_Rem((16 * (1 + 10))-1 downto 16 * 10)  <= IN_FIFO32_M_Rem_K;
   IN_FIFO32_M_Wr_K   <= IN_FIFO32_M_Wr(10);
   end generate;
 
   L: if FIFO32_PORTS > 11 generate
   IN_FIFO32_S_Clk_L  <= IN_FIFO32_S_Clk(11);
-  IN_FIFO32_S_Data((32 * (1 + 11))-1 downto 32 * 11) <= IN_FIFO32_S_Data_L;
+  IN_FIFO32_S_Data((FIFO32_DWIDTH * (1 + 11))-1 downto FIFO32_DWIDTH * 11) <= IN_FIFO32_S_Data_L;
   IN_FIFO32_S_Fill((16 * (1 + 11))-1 downto 16 * 11) <= IN_FIFO32_S_Fill_L;
   IN_FIFO32_S_Rd_L  <= IN_FIFO32_S_Rd(11);
 
   IN_FIFO32_M_Clk_L  <= IN_FIFO32_M_Clk(11);
-  IN_FIFO32_M_Data_L <= IN_FIFO32_M_Data((32 * (1 + 11))-1 downto 32 * 11);
+  IN_FIFO32_M_Data_L <= IN_FIFO32_M_Data((FIFO32_DWIDTH * (1 + 11))-1 downto FIFO32_DWIDTH * 11);
   IN_FIFO32_M_Rem((16 * (1 + 11))-1 downto 16 * 11)  <= IN_FIFO32_M_Rem_L;
   IN_FIFO32_M_Wr_L   <= IN_FIFO32_M_Wr(11);
   end generate;
 
   M: if FIFO32_PORTS > 12 generate
   IN_FIFO32_S_Clk_M  <= IN_FIFO32_S_Clk(12);
-  IN_FIFO32_S_Data((32 * (1 + 12))-1 downto 32 * 12) <= IN_FIFO32_S_Data_M;
+  IN_FIFO32_S_Data((FIFO32_DWIDTH * (1 + 12))-1 downto FIFO32_DWIDTH * 12) <= IN_FIFO32_S_Data_M;
   IN_FIFO32_S_Fill((16 * (1 + 12))-1 downto 16 * 12) <= IN_FIFO32_S_Fill_M;
   IN_FIFO32_S_Rd_M  <= IN_FIFO32_S_Rd(12);
 
   IN_FIFO32_M_Clk_M  <= IN_FIFO32_M_Clk(12);
-  IN_FIFO32_M_Data_M <= IN_FIFO32_M_Data((32 * (1 + 12))-1 downto 32 * 12);
+  IN_FIFO32_M_Data_M <= IN_FIFO32_M_Data((FIFO32_DWIDTH * (1 + 12))-1 downto FIFO32_DWIDTH * 12);
   IN_FIFO32_M_Rem((16 * (1 + 12))-1 downto 16 * 12)  <= IN_FIFO32_M_Rem_M;
   IN_FIFO32_M_Wr_M   <= IN_FIFO32_M_Wr(12);
   end generate;
   
   N: if FIFO32_PORTS > 13 generate
   IN_FIFO32_S_Clk_N  <= IN_FIFO32_S_Clk(13);
-  IN_FIFO32_S_Data((32 * (1 + 13))-1 downto 32 * 13) <= IN_FIFO32_S_Data_N;
+  IN_FIFO32_S_Data((FIFO32_DWIDTH * (1 + 13))-1 downto FIFO32_DWIDTH * 13) <= IN_FIFO32_S_Data_N;
   IN_FIFO32_S_Fill((16 * (1 + 13))-1 downto 16 * 13) <= IN_FIFO32_S_Fill_N;
   IN_FIFO32_S_Rd_N  <= IN_FIFO32_S_Rd(13);
 
   IN_FIFO32_M_Clk_N  <= IN_FIFO32_M_Clk(13);
-  IN_FIFO32_M_Data_N <= IN_FIFO32_M_Data((32 * (1 + 13))-1 downto 32 * 13);
+  IN_FIFO32_M_Data_N <= IN_FIFO32_M_Data((FIFO32_DWIDTH * (1 + 13))-1 downto FIFO32_DWIDTH * 13);
   IN_FIFO32_M_Rem((16 * (1 + 13))-1 downto 16 * 13)  <= IN_FIFO32_M_Rem_N;
   IN_FIFO32_M_Wr_N   <= IN_FIFO32_M_Wr(13);
   end generate;
 
   O: if FIFO32_PORTS > 14 generate
   IN_FIFO32_S_Clk_O  <= IN_FIFO32_S_Clk(14);
-  IN_FIFO32_S_Data((32 * (1 + 14))-1 downto 32 * 14) <= IN_FIFO32_S_Data_O;
+  IN_FIFO32_S_Data((FIFO32_DWIDTH * (1 + 14))-1 downto FIFO32_DWIDTH * 14) <= IN_FIFO32_S_Data_O;
   IN_FIFO32_S_Fill((16 * (1 + 14))-1 downto 16 * 14) <= IN_FIFO32_S_Fill_O;
   IN_FIFO32_S_Rd_O  <= IN_FIFO32_S_Rd(14);
 
   IN_FIFO32_M_Clk_O  <= IN_FIFO32_M_Clk(14);
-  IN_FIFO32_M_Data_O <= IN_FIFO32_M_Data((32 * (1 + 14))-1 downto 32 * 14);
+  IN_FIFO32_M_Data_O <= IN_FIFO32_M_Data((FIFO32_DWIDTH * (1 + 14))-1 downto FIFO32_DWIDTH * 14);
   IN_FIFO32_M_Rem((16 * (1 + 14))-1 downto 16 * 14)  <= IN_FIFO32_M_Rem_O;
   IN_FIFO32_M_Wr_O   <= IN_FIFO32_M_Wr(14);
   end generate;
 
   P: if FIFO32_PORTS > 15 generate
   IN_FIFO32_S_Clk_P  <= IN_FIFO32_S_Clk(15);
-  IN_FIFO32_S_Data((32 * (1 + 15))-1 downto 32 * 15) <= IN_FIFO32_S_Data_P;
+  IN_FIFO32_S_Data((FIFO32_DWIDTH * (1 + 15))-1 downto FIFO32_DWIDTH * 15) <= IN_FIFO32_S_Data_P;
   IN_FIFO32_S_Fill((16 * (1 + 15))-1 downto 16 * 15) <= IN_FIFO32_S_Fill_P;
   IN_FIFO32_S_Rd_P  <= IN_FIFO32_S_Rd(15);
 
   IN_FIFO32_M_Clk_P  <= IN_FIFO32_M_Clk(15);
-  IN_FIFO32_M_Data_P <= IN_FIFO32_M_Data((32 * (1 + 15))-1 downto 32 * 15);
+  IN_FIFO32_M_Data_P <= IN_FIFO32_M_Data((FIFO32_DWIDTH * (1 + 15))-1 downto FIFO32_DWIDTH * 15);
   IN_FIFO32_M_Rem((16 * (1 + 15))-1 downto 16 * 15)  <= IN_FIFO32_M_Rem_P;
   IN_FIFO32_M_Wr_P   <= IN_FIFO32_M_Wr(15);
   end generate;
@@ -476,7 +533,7 @@ begin  -- of architecture ------------------------------------------------------
 
   mux_S_DATA : mux
     generic map (
-      element_width => 32,
+      element_width => FIFO32_DWIDTH,
       element_count => FIFO32_PORTS
       )
     port map (
@@ -493,9 +550,16 @@ begin  -- of architecture ------------------------------------------------------
     port map (
       input  => IN_FIFO32_S_FILL,
       sel    => sel2mux,
-      output => INT_OUT_FIFO32_S_Fill
+      output => MUX_OUT_FIFO32_S_Fill
       );   
 
+  -- A blocked requestor may finish its packet, but must not start a new one.
+  -- A parked one must not be read from at all until it is resumed, and
+  -- nobody starts a packet while it waits for that.
+  INT_OUT_FIFO32_S_Fill <= (others => '0') when fsm_idle = '1' and (blocked(to_integer(unsigned(sel2mux))) = '1'
+                                                                    or (park_valid = '1' and (sel2mux = park_sel or RESUME = '1')))
+                           else MUX_OUT_FIFO32_S_Fill;
+
   demux_S_Rd : demux
     generic map (
       element_width => 1,
@@ -513,7 +577,7 @@ begin  -- of architecture ------------------------------------------------------
 
   demux_M_Data : demux
     generic map (
-      element_width => 32,
+      element_width => FIFO32_DWIDTH,
       element_count => FIFO32_PORTS
       )
     port map (
@@ -546,19 +610,47 @@ begin  -- of architecture ------------------------------------------------------
 
   IN_FIFO32_M_Clk <= (others => OUT_FIFO32_M_Clk);
 
+  SEL <= std_logic_vector(resize(unsigned(sel2mux), 4));
+
   -- Arbiter controls sel signal
-  rr_arbiter_i : rr_arbiter
-    generic map(
-      request_width => FIFO32_PORTS
-      )
-    port map(
-      clk      => clk,
-      reset    => Rst,
-      requests => requests,
-      sel      => sel2fsm
-      );
+  rr_arbiter_gen : if ARBITRATION_ALGO = 0 generate
+    rr_arbiter_i : rr_arbiter
+      generic map(
+        request_width => FIFO32_PORTS
+        )
+      port map(
+        clk      => clk,
+        reset    => Rst,
+        requests => requests,
+        sel      => sel2fsm
+        );
+
+    blocked <= (others => '0');
+    ARB_ACTIVE <= '0';
+  end generate;
+
+  wrr_arbiter_gen : if ARBITRATION_ALGO = 1 generate
+    wrr_arbiter_i : wrr_arbiter
+      generic map(
+        request_width => FIFO32_PORTS,
+        cap_window    => CAP_WINDOW
+        )
+      port map(
+        clk         => clk,
+        reset       => Rst,
+        requests    => requests,
+        packet_done => packet_done,
+        done_sel    => sel2mux,
+        cfg_port    => ARB_PORT,
+        cfg_data    => ARB_CONFIG,
+        cfg_we      => ARB_WE,
+        sel         => sel2fsm,
+        blocked     => blocked
+        );
+    ARB_ACTIVE <= '1';
+  end generate;
 
-  request_p : process (clk, rst, in_fifo32_s_fill)
+  request_p : process (clk, rst, in_fifo32_s_fill, park_valid, park_sel)
     is
 
   begin
@@ -566,7 +658,8 @@ begin  -- of architecture ------------------------------------------------------
     --    requests <= (others => '0');
     --else --if clk'event and clk = '1' then
     for i in 0 to FIFO32_PORTS-1 loop
-      if to_integer(unsigned(IN_FIFO32_S_Fill((16*(i+1))-1 downto 16*i))) > 1 then
+      if to_integer(unsigned(IN_FIFO32_S_Fill((16*(i+1))-1 downto 16*i))) > 1
+        and not (park_valid = '1' and to_integer(unsigned(park_sel)) = i) then
         requests(i) <= '1';
       else
         requests(i) <= '0';
@@ -587,11 +680,20 @@ begin  -- of architecture ------------------------------------------------------
     variable transfer_mode : TRANSFER_MODE_T;
     variable transfer_size : natural range 0 to 2**24;
 
+    -- the packet put aside by PARK
+    variable park_mode : TRANSFER_MODE_T;
+    variable park_size : natural range 0 to 2**24;
+
   begin
     if rst = '1' then
       state         := MODE_LENGTH;
       selection     := (others => '0');
       transfer_mode := READ;
+      fsm_idle      <= '1';
+      packet_done   <= '0';
+      park_valid    <= '0';
+      park_sel      <= (others => '0');
+      RESUMED       <= '0';
     elsif clk'event and clk = '1' then
       -- for ILA debug
 
@@ -618,11 +720,11 @@ begin  -- of architecture ------------------------------------------------------
       ila_signals(FIFO32_PORTS-1+16 downto 16) <= requests;
       ila_signals(32 downto FIFO32_PORTS+16) <= (others => '0');
       
-      ila_signals(64 downto 33 ) <= INT_OUT_FIFO32_S_Data;
+      ila_signals(64 downto 33 ) <= INT_OUT_FIFO32_S_Data(31 downto 0);
       ila_signals(80 downto 65) <= INT_OUT_FIFO32_S_Fill;
       ila_signals(81) <= OUT_FIFO32_S_Rd;
 
-      ila_signals(113 downto 82) <= OUT_FIFO32_M_Data;
+      ila_signals(113 downto 82) <= OUT_FIFO32_M_Data(31 downto 0);
       ila_signals(129 downto 114) <= INT_OUT_FIFO32_M_Rem;
       ila_signals(130) <= OUT_FIFO32_M_Wr;
       
@@ -632,13 +734,18 @@ begin  -- of architecture ------------------------------------------------------
       sel2mux       <= sel2mux;
       transfer_mode := transfer_mode;
       transfer_size := transfer_size;
+      packet_done   <= '0';
+      RESUMED       <= '0';
       case state is
         when MODE_LENGTH =>
+          -- only switch while no word is read, so that the header belongs to
+          -- the port that is selected for the rest of the packet
           if OUT_FIFO32_S_Rd = '1' then
             state := ADDRESS;
+          else
+            selection := sel2fsm;
+            sel2mux   <= selection;
           end if;
-          selection := sel2fsm;
-          sel2mux   <= selection;
           case INT_OUT_FIFO32_S_DATA(31) is
             when '0'    => transfer_mode := READ;
             when others => transfer_mode := WRITE;
@@ -648,29 +755,71 @@ begin  -- of architecture ------------------------------------------------------
           -- of the transfer.
           transfer_size := to_integer(unsigned(INT_OUT_FIFO32_S_DATA(23 downto 0)));
         when ADDRESS =>
+          -- 32 bit words are counted in bytes as they always were. Wider
+          -- words are counted in words of FIFO32_DWIDTH bits from now on;
+          -- the address is at the head of the fifo while in this state.
+          if FIFO32_DWIDTH /= 32 then
+            transfer_size := to_integer(unsigned(memif_beats(
+              INT_OUT_FIFO32_S_DATA(31 downto 0),
+              std_logic_vector(to_unsigned(transfer_size, 24)), FIFO32_DWIDTH)));
+          end if;
           case transfer_mode is
             when READ  => state := DATA_READ;
             when WRITE => state := DATA_WRITE;
           end case;
         when DATA_READ =>
-          if OUT_FIFO32_M_Wr = '1' then
+          if OUT_FIFO32_M_Wr = '1' and FIFO32_DWIDTH = 32 then
             transfer_size := transfer_size-4;
+          elsif OUT_FIFO32_M_Wr = '1' then
+            transfer_size := transfer_size-1;
           end if;
           if transfer_size = 0 then
-            state := MODE_LENGTH;
+            state       := MODE_LENGTH;
+            packet_done <= '1';
           end if;
         when DATA_WRITE =>
-          if OUT_FIFO32_S_Rd = '1' then
+          if OUT_FIFO32_S_Rd = '1' and FIFO32_DWIDTH = 32 then
             transfer_size := transfer_size-4;
+          elsif OUT_FIFO32_S_Rd = '1' then
+            transfer_size := transfer_size-1;
           end if;
           if transfer_size = 0 then
-            state := MODE_LENGTH;
+            state       := MODE_LENGTH;
+            packet_done <= '1';
           end if;
         when others =>
           state     := MODE_LENGTH;
           selection := selection;
           sel2mux   <= sel2mux;
       end case;
+
+      -- No words are transferred while the mmu parks a packet, the fsm is
+      -- still in its data state. It is resumed after the fsm was idle for a
+      -- cycle, by then the burst converter and the mmu are idle as well.
+      if PARK = '1' and (state = DATA_READ or state = DATA_WRITE) then
+        park_valid <= '1';
+        park_sel   <= sel2mux;
+        park_mode  := transfer_mode;
+        park_size  := transfer_size;
+        state      := MODE_LENGTH;
+      elsif RESUME = '1' and park_valid = '1' and fsm_idle = '1' and state = MODE_LENGTH then
+        park_valid    <= '0';
+        RESUMED       <= '1';
+        selection     := park_sel;
+        sel2mux       <= park_sel;
+        transfer_mode := park_mode;
+        transfer_size := park_size;
+        case park_mode is
+          when READ  => state := DATA_READ;
+          when WRITE => state := DATA_WRITE;
+        end case;
+      end if;
+
+      if state = MODE_LENGTH then
+        fsm_idle <= '1';
+      else
+        fsm_idle <= '0';
+      end if;
     end if;
   end process;
 
@@ -9,7 +9,27 @@ use proc_common_v3_00_a.proc_common_pkg.all;
 library reconos_v3_00_a;
 use reconos_v3_00_a.reconos_pkg.all;
 
+--! @brief Measures the latency of every FIFO32 port of the arbiter under contention.
+--! @details Each hardware thread writes a random word and reads it back, the
+--!          memory controller answers reads with the address. Ports 1 and up
+--!          issue their requests back-to-back, port 0 stands for a latency
+--!          sensitive thread and waits C_THINK_CYCLES between its requests.
+--!          With C_ARBITRATION_ALGO = 1, port 0 is put into a higher priority
+--!          class and the upper half of the ports is capped to C_BULK_CAP
+--!          packets per C_CAP_WINDOW cycles (0 = no cap).
+--!          The latency of a request is counted from starting memif_write_word
+--!          or memif_read_word until it is done. After C_SAMPLES requests of
+--!          every port, the percentiles of each port are reported. Compare e.g.:
+--!            ghdl -r tb_fifo32_arbiter -gC_ARBITRATION_ALGO=0
+--!            ghdl -r tb_fifo32_arbiter -gC_ARBITRATION_ALGO=1
 entity tb_fifo32_arbiter is
+  generic (
+    C_ARBITRATION_ALGO : integer := 1;
+    C_THINK_CYCLES     : integer := 32;
+    C_BULK_CAP         : integer := 0;
+    C_CAP_WINDOW       : integer := 1024;
+    C_SAMPLES          : integer := 200
+    );
 end entity;
 
 architecture testbench of tb_fifo32_arbiter is
@@ -36,7 +56,8 @@ architecture testbench of tb_fifo32_arbiter is
   component fifo32_arbiter
     generic (
       FIFO32_PORTS     : integer := 16;  --! 1 to 16 allowed
-      ARBITRATION_ALGO : integer := 0  --! 0= Round Robin, others not available atm.
+      ARBITRATION_ALGO : integer := 0;  --! 0= Round Robin, 1= Weighted Round Robin with priorities and caps
+      CAP_WINDOW       : integer := 4096  --! Cycles after which the bandwidth caps are renewed
       );
     port (
       -- Multiple FIFO32 Inputs
@@ -215,8 +236,20 @@ architecture testbench of tb_fifo32_arbiter is
       Rst : in std_logic;
       clk : in std_logic;               -- separate clock for control logic
 
+      -- Port that is currently connected to the output
+      SEL : out std_logic_vector(3 downto 0);
+
+      -- Configuration of the weighted arbiter
+      ARB_PORT   : in std_logic_vector(3 downto 0);
+      ARB_CONFIG : in std_logic_vector(31 downto 0);
+      ARB_WE     : in std_logic;
+      ARB_ACTIVE : out std_logic;
+      PARK       : in std_logic;
+      RESUME     : in std_logic;
+      RESUMED    : out std_logic;
+
       -- Debug signals to ILA
-      ila_signals : out std_logic_vector(3 downto 0)
+      ila_signals : out std_logic_vector(130 downto 0)
       );
   end component;
 
@@ -266,16 +299,32 @@ architecture testbench of tb_fifo32_arbiter is
   signal A2M_FIFO32_M_Wr   : std_logic;
 
   -- memif interface signals
-  type memif_out_array_t is array(natural range <>) of memif_out_t;
-  type memif_in_array_t is array(natural range <>) of memif_in_t;
-  signal H2F_MEMIF_OUT : memif_out_array_t(0 to HWT_COUNT-1);
-  signal H2F_MEMIF_IN  : memif_in_array_t(0 to HWT_COUNT-1);
+  type o_memif_array_t is array(natural range <>) of o_memif_t;
+  type i_memif_array_t is array(natural range <>) of i_memif_t;
+  signal H2F_O_MEMIF : o_memif_array_t(0 to HWT_COUNT-1);
+  signal H2F_I_MEMIF : i_memif_array_t(0 to HWT_COUNT-1);
+
+  signal A2M_O_MEMIF : o_memif_t;
+  signal A2M_I_MEMIF : i_memif_t;
+
+  -- arbiter configuration
+  signal ARB_PORT   : std_logic_vector(3 downto 0);
+  signal ARB_CONFIG : std_logic_vector(31 downto 0);
+  signal ARB_WE     : std_logic;
+  signal ARB_ACTIVE : std_logic;
+
+  -- latency of every request in cycles, per port
+  type latency_samples_t is array (0 to C_SAMPLES-1) of natural;
+  type latency_array_t is array (0 to HWT_COUNT-1) of latency_samples_t;
+  type count_array_t is array (0 to HWT_COUNT-1) of natural;
+  signal latencies : latency_array_t;
+  signal samples   : count_array_t;
+  signal cycle     : natural;
 
-  signal A2M_MEMIF_OUT : memif_out_t;
-  signal A2M_MEMIF_IN  : memif_in_t;
   -- Misc
   signal Rst           : std_logic;
   signal clk           : std_logic;
+  signal finished      : boolean := false;
 
 
 
@@ -289,8 +338,8 @@ begin  -- of architecture ------------------------------------------------------
   begin
 
     memif_setup (
-      H2F_MEMIF_OUT(i),
-      H2F_MEMIF_IN(i),
+      H2F_I_MEMIF(i),
+      H2F_O_MEMIF(i),
       clk,
       H2F_FIFO32_S_Clk(i),
       H2F_FIFO32_S_Data(32*(i+1)-1 downto 32*i),
@@ -335,7 +384,7 @@ begin  -- of architecture ------------------------------------------------------
         );
 
 
-    hwt_process : process(clk, H2F_MEMIF_IN)
+    hwt_process : process(clk, H2F_I_MEMIF)
       is
       --! @brief First of two global variables needed for random number functions,
       --!        e.g. get_rand_unsigned      
@@ -367,48 +416,84 @@ begin  -- of architecture ------------------------------------------------------
         return to_unsigned(rand_int, bitwidth);
       end function;
 
-      type state_t is (GEN_DATA, WRITE_DATA, READ_DATA, COMP_ADDRESS, ERROR_STATE);
+      --! Records the latency of a finished request.
+      procedure record_latency(start : in natural; count : inout natural) is
+      begin
+        if count < C_SAMPLES then
+          latencies(i)(count) <= cycle - start;
+          count := count + 1;
+          samples(i) <= count;
+        end if;
+      end procedure;
+
+      type state_t is (GEN_DATA, WRITE_DATA, READ_DATA, COMP_ADDRESS, THINK, ERROR_STATE);
       variable state : state_t;
       variable done  : boolean := false;
       variable rnd   : unsigned(31 downto 0);
+      variable start : natural;
+      variable count : natural;
+      variable think : natural;
       
     begin
       if rst = '1' then
         state := GEN_DATA;
         -- init interface 
-        memif_reset(H2F_MEMIF_OUT(i), H2F_MEMIF_IN(i));
+        memif_reset(H2F_O_MEMIF(i));
         done  := false;
+        count := 0;
+        samples(i) <= 0;
       elsif rising_edge(clk) then
         case state is
           when GEN_DATA =>
             rnd   := get_rand_unsigned(0, 2**30, 32);
+            start := cycle;
             state := WRITE_DATA;
           when WRITE_DATA =>
-            memif_write (
-              H2F_MEMIF_OUT(i),
-              H2F_MEMIF_IN(i),
+            memif_write_word (
+              H2F_I_MEMIF(i),
+              H2F_O_MEMIF(i),
               std_logic_vector(to_unsigned(i, 32)),  -- address
               std_logic_vector(rnd),                 -- data
               done
               );
-            if done then state := READ_DATA; end if;
+            if done then
+              record_latency(start, count);
+              start := cycle;
+              state := READ_DATA;
+            end if;
           when READ_DATA =>
-            memif_read (
-              H2F_MEMIF_OUT(i),
-              H2F_MEMIF_IN(i),
+            memif_read_word (
+              H2F_I_MEMIF(i),
+              H2F_O_MEMIF(i),
               --std_logic_vector(to_unsigned(i, 32)),  -- address
               std_logic_vector(rnd),                 -- address
               data,                                  -- data
               done
               );
-            if done then state := COMP_ADDRESS; end if;
+            if done then
+              record_latency(start, count);
+              state := COMP_ADDRESS;
+            end if;
           when COMP_ADDRESS =>
             -- we expect to read back the address in the data word, we asked for.
             if data = std_logic_vector(rnd) then
-              state := GEN_DATA;
+              -- port 0 is the latency sensitive one, all others stream
+              if i = 0 then
+                think := C_THINK_CYCLES;
+                state := THINK;
+              else
+                state := GEN_DATA;
+              end if;
             else
+              report "port " & integer'image(i) & " read back wrong data" severity error;
               state := ERROR_STATE;
             end if;
+          when THINK =>
+            if think = 0 then
+              state := GEN_DATA;
+            else
+              think := think - 1;
+            end if;
           when ERROR_STATE =>
             null;                                    -- should not happen
           when others => null;
@@ -429,7 +514,8 @@ begin  -- of architecture ------------------------------------------------------
   fifo32_arbiter_i : fifo32_arbiter
     generic map(
       FIFO32_PORTS     => HWT_COUNT,
-      ARBITRATION_ALGO => 0
+      ARBITRATION_ALGO => C_ARBITRATION_ALGO,
+      CAP_WINDOW       => C_CAP_WINDOW
       )
     port map(
       -- Multiple FIFO32 Inputs
@@ -608,13 +694,23 @@ begin  -- of architecture ------------------------------------------------------
       Rst => rst,
       clk => clk,
 
+      SEL => open,
+
+      ARB_PORT   => ARB_PORT,
+      ARB_CONFIG => ARB_CONFIG,
+      ARB_WE     => ARB_WE,
+      ARB_ACTIVE => ARB_ACTIVE,
+      PARK       => '0',
+      RESUME     => '0',
+      RESUMED    => open,
+
       -- Debug signals to ILA
       ila_signals => open
       );
 
   memif_setup (
-    A2M_MEMIF_OUT,
-    A2M_MEMIF_IN,
+    A2M_I_MEMIF,
+    A2M_O_MEMIF,
     clk,
     A2M_FIFO32_S_Clk,
     A2M_FIFO32_S_Data,
@@ -626,7 +722,7 @@ begin  -- of architecture ------------------------------------------------------
     A2M_FIFO32_M_Wr
     );
 
-  mem_ctrl : process(clk, rst, a2m_memif_in)
+  mem_ctrl : process(clk, rst, A2M_I_MEMIF)
     is
     type FSM_STATE_T is (IDLE, MODE_LENGTH, ADDRESS, DATA_READ, DATA_WRITE);
     variable state : FSM_STATE_T;
@@ -639,41 +735,41 @@ begin  -- of architecture ------------------------------------------------------
     if rst = '1' then
       state                := IDLE;
       transfer_mode        := READ;
-      a2m_memif_out.s_rd   <= '0';
-      a2m_memif_out.s_rd   <= '0';
-      a2m_memif_out.m_data <= X"00000000";
+      A2M_O_MEMIF.s_rd   <= '0';
+      A2M_O_MEMIF.s_rd   <= '0';
+      A2M_O_MEMIF.m_data <= X"00000000";
     elsif rising_edge(clk) then
       -- default is to hold all outputs.
       state              := state;
-      a2m_memif_out.s_rd <= a2m_memif_out.s_rd;
-      a2m_memif_out.m_wr <= a2m_memif_out.m_wr;
+      A2M_O_MEMIF.s_rd <= A2M_O_MEMIF.s_rd;
+      A2M_O_MEMIF.m_wr <= A2M_O_MEMIF.m_wr;
       transfer_mode      := transfer_mode;
       transfer_size      := transfer_size;
       case state is
         when IDLE =>
-          a2m_memif_out.s_rd <= '0';
-          a2m_memif_out.m_wr <= '0';
-          if to_integer(unsigned(a2m_memif_in.s_fill)) > 1 then
+          A2M_O_MEMIF.s_rd <= '0';
+          A2M_O_MEMIF.m_wr <= '0';
+          if to_integer(unsigned(A2M_I_MEMIF.s_fill)) > 1 then
             state              := MODE_LENGTH;
-            a2m_memif_out.s_rd <= '1';
+            A2M_O_MEMIF.s_rd <= '1';
           end if;
           
           
         when MODE_LENGTH =>
           state := ADDRESS;
-          case a2m_memif_in.s_data(31) is
+          case A2M_I_MEMIF.s_data(31) is
             when '0'    => transfer_mode := READ;
             when others => transfer_mode := WRITE;
           end case;
-          transfer_size := to_integer(unsigned(a2m_memif_in.s_data(23 downto 0)));
+          transfer_size := to_integer(unsigned(A2M_I_MEMIF.s_data(23 downto 0)));
         when ADDRESS =>
-          transfer_address := a2m_memif_in.s_data;
+          transfer_address := A2M_I_MEMIF.s_data;
           case transfer_mode is
             when READ =>
               state                := DATA_READ;
-              a2m_memif_out.s_rd   <= '0';
-              a2m_memif_out.m_wr   <= '1';
-              a2m_memif_out.m_data <= transfer_address;
+              A2M_O_MEMIF.s_rd   <= '0';
+              A2M_O_MEMIF.m_wr   <= '1';
+              A2M_O_MEMIF.m_data <= transfer_address;
             when WRITE =>
               state := DATA_WRITE;
             when others => null;
@@ -682,15 +778,15 @@ begin  -- of architecture ------------------------------------------------------
           transfer_size := transfer_size - 4;
           if transfer_size = 0 then
             state              := IDLE;
-            a2m_memif_out.s_rd <= '0';
+            A2M_O_MEMIF.s_rd <= '0';
           end if;
         when DATA_READ =>
-          a2m_memif_out.m_data <= transfer_address;
+          A2M_O_MEMIF.m_data <= transfer_address;
           transfer_size        := transfer_size - 4;
           if transfer_size = 0 then
             state                := IDLE;
-            a2m_memif_out.m_wr   <= '0';
-            a2m_memif_out.m_data <= X"00000000";
+            A2M_O_MEMIF.m_wr   <= '0';
+            A2M_O_MEMIF.m_data <= X"00000000";
           end if;
         when others =>
           state := IDLE;
@@ -706,13 +802,92 @@ begin  -- of architecture ------------------------------------------------------
     wait;
   end process;
 
+  cycle_process : process(clk) is
+  begin
+    if rising_edge(clk) then
+      if rst = '1' then
+        cycle <= 0;
+      else
+        cycle <= cycle + 1;
+      end if;
+    end if;
+  end process;
+
+  -- Port 0 gets the highest priority class, the upper half of the ports the
+  -- bandwidth cap. Only used with C_ARBITRATION_ALGO = 1.
+  config_process : process is
+  begin
+    ARB_PORT   <= (others => '0');
+    ARB_CONFIG <= (others => '0');
+    ARB_WE     <= '0';
+    wait until rst = '0';
+    wait until rising_edge(clk);
+    assert (ARB_ACTIVE = '1') = (C_ARBITRATION_ALGO = 1)
+      report "ARB_ACTIVE does not match ARBITRATION_ALGO" severity error;
+    for i in 0 to HWT_COUNT-1 loop
+      ARB_PORT <= std_logic_vector(to_unsigned(i, 4));
+      if i = 0 then
+        ARB_CONFIG <= X"00000101";                   -- weight 1, class 1
+      elsif i >= HWT_COUNT/2 then
+        ARB_CONFIG <= X"00" & std_logic_vector(to_unsigned(C_BULK_CAP, 8)) & X"0001";
+      else
+        ARB_CONFIG <= X"00000001";
+      end if;
+      ARB_WE <= '1';
+      wait until rising_edge(clk);
+    end loop;
+    ARB_WE <= '0';
+    wait;
+  end process;
+
+  report_process : process is
+    variable sorted  : latency_samples_t;
+    variable tmp     : natural;
+    variable waiting : boolean;
+  begin
+    waiting := true;
+    while waiting loop
+      wait until rising_edge(clk);
+      waiting := false;
+      for i in 0 to HWT_COUNT-1 loop
+        if samples(i) < C_SAMPLES then
+          waiting := true;
+        end if;
+      end loop;
+    end loop;
+
+    for i in 0 to HWT_COUNT-1 loop
+      -- insertion sort of the samples of port i
+      sorted := latencies(i);
+      for j in 1 to C_SAMPLES-1 loop
+        tmp := sorted(j);
+        for k in j-1 downto 0 loop
+          exit when sorted(k) <= tmp;
+          sorted(k+1) := sorted(k);
+          sorted(k)   := tmp;
+        end loop;
+      end loop;
+
+      report "port " & integer'image(i) & " latency p50 " & integer'image(sorted(C_SAMPLES/2))
+        & ", p90 " & integer'image(sorted((C_SAMPLES*90)/100))
+        & ", p99 " & integer'image(sorted((C_SAMPLES*99)/100))
+        & ", max " & integer'image(sorted(C_SAMPLES-1)) & " cycles";
+    end loop;
+    report "arbitration algorithm " & integer'image(C_ARBITRATION_ALGO) & ": done";
+    finished <= true;
+    wait;
+  end process;
+
 -- All clocks are the same.
   clock : process is
   begin
-    clk <= '1';
-    wait for half_cycle;
-    clk <= '0';
-    wait for half_cycle;
+    while not finished loop
+      clk <= '1';
+      wait for half_cycle;
+      clk <= '0';
+      wait for half_cycle;
+    end loop;
+    wait;
   end process;
 
 
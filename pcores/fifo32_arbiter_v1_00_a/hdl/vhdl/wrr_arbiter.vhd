@@ -0,0 +1,184 @@
+--Doxygen
+--! @file wrr_arbiter.vhd
+--! @brief This file contains the entity and architecture of an arbiter that
+--!        selects requestors by priority class and weighted round-robin and
+--!        limits the bandwidth of every requestor.
+
+
+library IEEE; --! Use the standard IEEE libraries for logic
+use IEEE.STD_LOGIC_1164.all; --! For logic
+use ieee.numeric_std.all; --! For signed and unsigned arithmetic.
+
+library proc_common_v3_00_a;
+use proc_common_v3_00_a.proc_common_pkg.all;
+
+--! @brief Entity declaration of an arbiter with per requestor weights,
+--!        priority classes and bandwidth caps.
+--! @details Every requestor has a configuration word, written through
+--!          cfg_port, cfg_data and cfg_we:
+--!            - cfg_data(3 downto 0):   weight, the number of packets the
+--!                                      requestor may transfer before the
+--!                                      arbiter moves on (0 counts as 1)
+--!            - cfg_data(9 downto 8):   priority class, higher classes are
+--!                                      always served first
+--!            - cfg_data(23 downto 16): bandwidth cap, the number of packets
+--!                                      the requestor may transfer every
+--!                                      cap_window cycles (0 = unlimited)
+--!          After reset all requestors have weight 1, class 0 and no cap,
+--!          which gives plain round-robin by packets.
+--!          Packets are counted by packet_done, which has to be pulsed with
+--!          the index of the finished requestor on done_sel. A requestor that
+--!          has used up its cap is shown on 'blocked' until the next window
+--!          starts; its packets must not be started in the meantime.
+entity wrr_arbiter is
+  generic(
+    request_width : positive := 16;  --! How many request inputs do you want?
+    cap_window    : positive := 4096  --! Cycles after which the bandwidth caps are renewed
+    );
+  port (
+    clk         : in  std_logic;        --! Clock signal
+    reset       : in  std_logic;        --! Reset signal
+    requests    : in  std_logic_vector (request_width-1 downto 0);  --! Input lines from the requestors.
+    packet_done : in  std_logic;        --! A packet has been transferred completely.
+    done_sel    : in  std_logic_vector (clog2(request_width)-1 downto 0);  --! Whose packet has been transferred?
+    cfg_port    : in  std_logic_vector (3 downto 0);  --! Requestor to configure
+    cfg_data    : in  std_logic_vector (31 downto 0);  --! Configuration word, see above
+    cfg_we      : in  std_logic;        --! Write cfg_data to the configuration of cfg_port
+    sel         : out std_logic_vector (clog2(request_width)-1 downto 0);  --! Who of the requesters will be served?
+    blocked     : out std_logic_vector (request_width-1 downto 0));  --! Requestors that have used up their cap
+end wrr_arbiter;
+
+--! @brief Architecture of an arbiter with weights, priority classes and caps.
+architecture Behavioral of wrr_arbiter is
+  --! @brief See rr_arbiter: the search wraps around with a modulo operation,
+  --!        which the Xilinx synthesizer only supports for powers of two.
+  constant upper_bound : positive := 2**(clog2(request_width));
+
+  type weight_array_t is array (0 to request_width-1) of unsigned(3 downto 0);
+  type prio_array_t is array (0 to request_width-1) of unsigned(1 downto 0);
+  type count_array_t is array (0 to request_width-1) of unsigned(7 downto 0);
+
+  --! Configuration registers
+  signal weight : weight_array_t;
+  signal prio   : prio_array_t;
+  signal cap    : count_array_t;
+
+  --! Packets transferred by every requestor in the current window.
+  signal used   : count_array_t;
+  signal window : natural range 0 to cap_window-1;
+
+  --! Requestors that may be served now.
+  signal eligible : std_logic_vector (upper_bound-1 downto 0);
+
+  --! The requestor currently served and the packets it has left.
+  signal current : natural range 0 to upper_bound-1 := 0;
+  signal credit  : unsigned(3 downto 0);
+
+  --! Result of the search for the next requestor.
+  signal next_served : natural range 0 to upper_bound-1;
+  signal found       : boolean;
+  signal preempt     : boolean;
+
+begin -- of architecture -------------------------------------------------------
+
+  eligible_proc : process (requests, cap, used)
+  begin
+    eligible <= (others => '0');
+    blocked  <= (others => '0');
+    for i in 0 to request_width-1 loop
+      if cap(i) /= 0 and used(i) >= cap(i) then
+        blocked(i) <= requests(i);
+      else
+        eligible(i) <= requests(i);
+      end if;
+    end loop;
+  end process;
+
+  --! @brief Determines the next requestor to be served.
+  --! @details Takes the eligible requestor of the highest priority class.
+  --!          Within a class, the search starts behind the current requestor,
+  --!          which is considered last, so that the class is served
+  --!          round-robin. preempt tells whether the result belongs to a
+  --!          higher class than the current requestor.
+  arbiter : process (eligible, prio, current)
+    variable idx       : natural range 0 to upper_bound-1;
+    variable best      : natural range 0 to upper_bound-1;
+    variable best_prio : integer range -1 to 3;
+  begin
+    best      := current;
+    best_prio := -1;
+    for offset in 1 to upper_bound loop
+      idx := (current+offset) mod upper_bound;
+      if eligible(idx) = '1' then
+        if to_integer(prio(idx)) > best_prio then
+          best      := idx;
+          best_prio := to_integer(prio(idx));
+        end if;
+      end if;
+    end loop;
+    next_served <= best;
+    found       <= best_prio >= 0;
+    preempt     <= best_prio > to_integer(prio(current));
+  end process arbiter;
+
+  --! @brief This process cares about the configuration, the packet counters
+  --!        and the register storing the current requestor.
+  --! @details The arbiter moves on when the current requestor has used up
+  --!          its weight, stops requesting or becomes blocked, or when a
+  --!          requestor of a higher class is waiting.
+  registers : process(clk)
+    variable done_idx : natural range 0 to upper_bound-1;
+  begin
+    if clk'event and clk = '1' then
+      if reset = '1' then
+        current <= 0;
+        credit  <= to_unsigned(1, 4);
+        window  <= 0;
+        for i in 0 to request_width-1 loop
+          weight(i) <= to_unsigned(1, 4);
+          prio(i)   <= (others => '0');
+          cap(i)    <= (others => '0');
+          used(i)   <= (others => '0');
+        end loop;
+      else
+        if cfg_we = '1' and to_integer(unsigned(cfg_port)) < request_width then
+          weight(to_integer(unsigned(cfg_port))) <= unsigned(cfg_data(3 downto 0));
+          prio(to_integer(unsigned(cfg_port)))   <= unsigned(cfg_data(9 downto 8));
+          cap(to_integer(unsigned(cfg_port)))    <= unsigned(cfg_data(23 downto 16));
+        end if;
+
+        done_idx := to_integer(unsigned(done_sel));
+        if window = cap_window-1 then
+          window <= 0;
+          for i in 0 to request_width-1 loop
+            used(i) <= (others => '0');
+          end loop;
+        else
+          window <= window + 1;
+          if packet_done = '1' and done_idx < request_width then
+            if used(done_idx) /= 255 then
+              used(done_idx) <= used(done_idx) + 1;
+            end if;
+          end if;
+        end if;
+
+        if packet_done = '1' and done_idx = current and credit > 1 then
+          credit <= credit - 1;
+        end if;
+
+        if found and (eligible(current) = '0' or preempt or
+                      (packet_done = '1' and done_idx = current and credit <= 1)) then
+          current <= next_served;
+          if weight(next_served) = 0 then
+            credit <= to_unsigned(1, 4);
+          else
+            credit <= weight(next_served);
+          end if;
+        end if;
+      end if;
+    end if;
+  end process;
+
+  sel <= std_logic_vector(to_unsigned(current, sel'length));
+
+end Behavioral;
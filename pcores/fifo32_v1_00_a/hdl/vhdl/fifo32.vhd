@@ -8,14 +8,15 @@ use proc_common_v3_00_a.proc_common_pkg.all;
 
 entity fifo32 is
 	generic (
-		C_FIFO32_DEPTH  : integer := 16
+		C_FIFO32_DEPTH  : integer := 16;
+		C_FIFO32_DWIDTH : integer := 32 -- 32, 64 or 128, see fifo32_width_adapter
 	);
 	port (
 		Rst : in std_logic;
 		FIFO32_S_Clk : in std_logic;
 		FIFO32_M_Clk : in std_logic;
-		FIFO32_S_Data : out std_logic_vector(31 downto 0);
-		FIFO32_M_Data : in std_logic_vector(31 downto 0);
+		FIFO32_S_Data : out std_logic_vector(C_FIFO32_DWIDTH-1 downto 0);
+		FIFO32_M_Data : in std_logic_vector(C_FIFO32_DWIDTH-1 downto 0);
 		FIFO32_S_Fill : out std_logic_vector(15 downto 0);
 		FIFO32_M_Rem : out std_logic_vector(15 downto 0);
 		FIFO32_S_Rd : in std_logic;
@@ -24,7 +25,7 @@ entity fifo32 is
 end entity;
 
 architecture implementation of fifo32 is
-	type MEM_T is array (0 to C_FIFO32_DEPTH-1) of std_logic_vector(31 downto 0);
+	type MEM_T is array (0 to C_FIFO32_DEPTH-1) of std_logic_vector(C_FIFO32_DWIDTH-1 downto 0);
 	signal mem : MEM_T;
 	signal wrptr : std_logic_vector(clog2(C_FIFO32_DEPTH)-1 downto 0);
 	signal rdptr : std_logic_vector(clog2(C_FIFO32_DEPTH)-1 downto 0);
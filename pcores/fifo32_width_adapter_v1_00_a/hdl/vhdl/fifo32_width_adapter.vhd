@@ -0,0 +1,266 @@
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.std_logic_arith.all;
+use ieee.std_logic_unsigned.all;
+
+library proc_common_v3_00_a;
+use proc_common_v3_00_a.proc_common_pkg.all;
+
+-- Connects the 32 bit FIFO32 links of a hardware thread to a memory path
+-- whose words are C_FIFO32_DWIDTH (64 or 128) bits wide.
+--
+-- Wide words are aligned to their size in memory and hold the lowest address
+-- in their upper bits: the 32 bit word at byte offset 4k of a wide word is
+-- bits C_FIFO32_DWIDTH-1-32k downto C_FIFO32_DWIDTH-32-32k. On the wide side,
+-- the header and the address of a request are single words with the value in
+-- the lower 32 bits; the length stays in bytes. The data of a request takes
+-- memif_beats(addr,len,C_FIFO32_DWIDTH) words, the first and the last of which
+-- may be partial.
+--
+-- Requests: header and address are passed on, write data is packed into wide
+-- words at the lanes given by the address. Replies: for every read request the
+-- first lane and the number of 32 bit words are queued, and the wide reply
+-- words are unpacked accordingly, one 32 bit word per cycle.
+--
+-- All four links are read or written by the adapter, i.e. it sits between
+-- fifo32 instances of either width:
+--
+--   HWT -> fifo32 (32) -> adapter -> fifo32 (W) -> fifo32_arbiter
+--   HWT <- fifo32 (32) <- adapter <- fifo32 (W) <- fifo32_arbiter
+
+entity fifo32_width_adapter is
+	generic (
+		C_FIFO32_DWIDTH : integer := 64; -- 64 or 128
+		C_QUEUE_DEPTH   : integer := 16  -- read requests waiting for their data
+	);
+	port (
+		Rst : in std_logic;
+		Clk : in std_logic;
+
+		-- requests of the hardware thread
+		NARROW_FIFO32_S_Clk : out std_logic;
+		NARROW_FIFO32_S_Data : in std_logic_vector(31 downto 0);
+		NARROW_FIFO32_S_Fill : in std_logic_vector(15 downto 0);
+		NARROW_FIFO32_S_Rd : out std_logic;
+
+		-- replies to the hardware thread
+		NARROW_FIFO32_M_Clk : out std_logic;
+		NARROW_FIFO32_M_Data : out std_logic_vector(31 downto 0);
+		NARROW_FIFO32_M_Rem : in std_logic_vector(15 downto 0);
+		NARROW_FIFO32_M_Wr : out std_logic;
+
+		-- replies from memory
+		WIDE_FIFO32_S_Clk : out std_logic;
+		WIDE_FIFO32_S_Data : in std_logic_vector(C_FIFO32_DWIDTH-1 downto 0);
+		WIDE_FIFO32_S_Fill : in std_logic_vector(15 downto 0);
+		WIDE_FIFO32_S_Rd : out std_logic;
+
+		-- requests to memory
+		WIDE_FIFO32_M_Clk : out std_logic;
+		WIDE_FIFO32_M_Data : out std_logic_vector(C_FIFO32_DWIDTH-1 downto 0);
+		WIDE_FIFO32_M_Rem : in std_logic_vector(15 downto 0);
+		WIDE_FIFO32_M_Wr : out std_logic
+	);
+end entity;
+
+architecture implementation of fifo32_width_adapter is
+
+	constant C_LANES : integer := C_FIFO32_DWIDTH/32;
+
+	function lane_of(addr : std_logic_vector(31 downto 0)) return integer is
+	begin
+		return conv_integer(addr(6 downto 2)) mod C_LANES;
+	end;
+
+	type LANE_QUEUE_T is array (0 to C_QUEUE_DEPTH-1) of integer range 0 to C_LANES-1;
+	type WORDS_QUEUE_T is array (0 to C_QUEUE_DEPTH-1) of std_logic_vector(21 downto 0);
+
+	signal q_lane  : LANE_QUEUE_T;
+	signal q_words : WORDS_QUEUE_T;
+	signal q_head  : integer range 0 to C_QUEUE_DEPTH-1;
+	signal q_tail  : integer range 0 to C_QUEUE_DEPTH-1;
+	signal q_count : integer range 0 to C_QUEUE_DEPTH;
+	signal q_push  : std_logic;
+	signal q_pop   : std_logic;
+
+	-- requests
+	type REQ_STATE_T is (REQ_HEADER, REQ_ADDR, REQ_DATA);
+	signal req_state : REQ_STATE_T;
+	signal req_rd    : std_logic;
+	signal req_cmd   : std_logic_vector(31 downto 0);
+	signal req_lane  : integer range 0 to C_LANES-1;
+	signal req_words : std_logic_vector(21 downto 0);
+	signal req_buf   : std_logic_vector(C_FIFO32_DWIDTH-1 downto 0);
+
+	-- replies
+	type RPL_STATE_T is (RPL_IDLE, RPL_DATA);
+	signal rpl_state : RPL_STATE_T;
+	signal rpl_rd    : std_logic;
+	signal rpl_wr    : std_logic;
+	signal rpl_lane  : integer range 0 to C_LANES-1;
+	signal rpl_words : std_logic_vector(21 downto 0);
+	signal rpl_word  : std_logic_vector(31 downto 0);
+
+begin
+
+	NARROW_FIFO32_S_Clk <= Clk;
+	NARROW_FIFO32_M_Clk <= Clk;
+	WIDE_FIFO32_S_Clk   <= Clk;
+	WIDE_FIFO32_M_Clk   <= Clk;
+
+	-- a word is taken from the thread whenever the wide fifo can hold it,
+	-- and, for the address of a read request, the queue has room
+	req_rd <= '1' when NARROW_FIFO32_S_Fill > 0 and WIDE_FIFO32_M_Rem > 1 and
+	                   (req_state /= REQ_ADDR or req_cmd(31) = '1' or q_count < C_QUEUE_DEPTH) else '0';
+
+	NARROW_FIFO32_S_Rd <= req_rd;
+
+	q_push <= '1' when req_rd = '1' and req_state = REQ_ADDR and req_cmd(31) = '0' else '0';
+
+	req_proc : process(Clk, Rst) is
+		variable buf : std_logic_vector(C_FIFO32_DWIDTH-1 downto 0);
+	begin
+		if Rst = '1' then
+			req_state <= REQ_HEADER;
+			req_cmd <= (others => '0');
+			req_lane <= 0;
+			req_words <= (others => '0');
+			req_buf <= (others => '0');
+			WIDE_FIFO32_M_Wr <= '0';
+		elsif rising_edge(Clk) then
+			WIDE_FIFO32_M_Wr <= '0';
+			if req_rd = '1' then
+				case req_state is
+					when REQ_HEADER =>
+						req_cmd <= NARROW_FIFO32_S_Data;
+						WIDE_FIFO32_M_Data <= EXT(NARROW_FIFO32_S_Data, C_FIFO32_DWIDTH);
+						WIDE_FIFO32_M_Wr <= '1';
+						req_state <= REQ_ADDR;
+
+					when REQ_ADDR =>
+						WIDE_FIFO32_M_Data <= EXT(NARROW_FIFO32_S_Data, C_FIFO32_DWIDTH);
+						WIDE_FIFO32_M_Wr <= '1';
+						req_lane  <= lane_of(NARROW_FIFO32_S_Data);
+						req_words <= req_cmd(23 downto 2);
+						req_buf   <= (others => '0');
+						if req_cmd(31) = '1' and req_cmd(23 downto 2) /= 0 then
+							req_state <= REQ_DATA;
+						else
+							req_state <= REQ_HEADER;
+						end if;
+
+					when REQ_DATA =>
+						buf := req_buf;
+						for i in 0 to C_LANES-1 loop
+							if req_lane = i then
+								buf(C_FIFO32_DWIDTH-1-32*i downto C_FIFO32_DWIDTH-32-32*i) := NARROW_FIFO32_S_Data;
+							end if;
+						end loop;
+						req_words <= req_words - 1;
+						-- a wide word is complete at its last lane or at the end of the data
+						if req_lane = C_LANES-1 or req_words = 1 then
+							WIDE_FIFO32_M_Data <= buf;
+							WIDE_FIFO32_M_Wr <= '1';
+							req_buf  <= (others => '0');
+							req_lane <= 0;
+						else
+							req_buf  <= buf;
+							req_lane <= req_lane + 1;
+						end if;
+						if req_words = 1 then
+							req_state <= REQ_HEADER;
+						end if;
+				end case;
+			end if;
+		end if;
+	end process;
+
+	-- first lane and number of 32 bit words of the read requests in flight
+	queue_proc : process(Clk, Rst) is
+	begin
+		if Rst = '1' then
+			q_head <= 0;
+			q_tail <= 0;
+			q_count <= 0;
+		elsif rising_edge(Clk) then
+			if q_push = '1' then
+				q_lane(q_tail)  <= lane_of(NARROW_FIFO32_S_Data);
+				q_words(q_tail) <= req_cmd(23 downto 2);
+				if q_tail = C_QUEUE_DEPTH-1 then
+					q_tail <= 0;
+				else
+					q_tail <= q_tail + 1;
+				end if;
+			end if;
+			if q_pop = '1' then
+				if q_head = C_QUEUE_DEPTH-1 then
+					q_head <= 0;
+				else
+					q_head <= q_head + 1;
+				end if;
+			end if;
+			if q_push = '1' and q_pop = '0' then
+				q_count <= q_count + 1;
+			elsif q_push = '0' and q_pop = '1' then
+				q_count <= q_count - 1;
+			end if;
+		end if;
+	end process;
+
+	q_pop <= '1' when rpl_state = RPL_IDLE and q_count > 0 else '0';
+
+	-- a reply word is passed on whenever the thread's fifo can take it; the
+	-- wide word is released with its last lane or the last word of the reply
+	rpl_wr <= '1' when rpl_state = RPL_DATA and WIDE_FIFO32_S_Fill > 0 and NARROW_FIFO32_M_Rem > 1 else '0';
+	rpl_rd <= rpl_wr when rpl_lane = C_LANES-1 or rpl_words = 1 else '0';
+
+	WIDE_FIFO32_S_Rd <= rpl_rd;
+
+	rpl_word_proc : process(WIDE_FIFO32_S_Data, rpl_lane) is
+	begin
+		rpl_word <= (others => '0');
+		for i in 0 to C_LANES-1 loop
+			if rpl_lane = i then
+				rpl_word <= WIDE_FIFO32_S_Data(C_FIFO32_DWIDTH-1-32*i downto C_FIFO32_DWIDTH-32-32*i);
+			end if;
+		end loop;
+	end process;
+
+	rpl_proc : process(Clk, Rst) is
+	begin
+		if Rst = '1' then
+			rpl_state <= RPL_IDLE;
+			rpl_lane <= 0;
+			rpl_words <= (others => '0');
+			NARROW_FIFO32_M_Wr <= '0';
+		elsif rising_edge(Clk) then
+			NARROW_FIFO32_M_Wr <= '0';
+			case rpl_state is
+				when RPL_IDLE =>
+					if q_pop = '1' then
+						rpl_lane  <= q_lane(q_head);
+						rpl_words <= q_words(q_head);
+						if q_words(q_head) /= 0 then
+							rpl_state <= RPL_DATA;
+						end if;
+					end if;
+
+				when RPL_DATA =>
+					if rpl_wr = '1' then
+						NARROW_FIFO32_M_Data <= rpl_word;
+						NARROW_FIFO32_M_Wr <= '1';
+						rpl_words <= rpl_words - 1;
+						if rpl_rd = '1' then
+							rpl_lane <= 0;
+						else
+							rpl_lane <= rpl_lane + 1;
+						end if;
+						if rpl_words = 1 then
+							rpl_state <= RPL_IDLE;
+						end if;
+					end if;
+			end case;
+		end if;
+	end process;
+
+end architecture;
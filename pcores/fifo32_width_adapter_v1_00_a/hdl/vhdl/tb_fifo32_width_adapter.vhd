@@ -0,0 +1,485 @@
+library ieee;            --! Use the standard ieee libraries for logic
+use ieee.std_logic_1164.all;            --! For logic
+use ieee.numeric_std.all;  --! For unsigned and signed types and conversion from/to std_logic_vector
+
+library fifo32_v1_00_a;
+library fifo32_width_adapter_v1_00_a;
+library fifo32_arbiter_v1_00_a;
+library fifo32_burst_converter_v1_00_a;
+
+--! @brief Measures the read throughput of the memory path at a data width of
+--!        C_FIFO32_DWIDTH bits.
+--! @details C_THREADS hardware threads (at most 4) each read C_REQUESTS blocks
+--!          of C_LEN bytes, keeping up to C_OUTSTANDING requests in flight.
+--!          The threads use 32 bit FIFO32 links. For wider data paths, every
+--!          thread is connected to the arbiter through a fifo32_width_adapter
+--!          and fifos of the full width; the arbiter, the burst converter and
+--!          the memory model work on C_FIFO32_DWIDTH bit words. The memory
+--!          answers a read C_MEM_LATENCY cycles after its address and then
+--!          returns one word per cycle, every 32 bit word holding its own
+--!          address, which the threads check. Compare e.g.:
+--!            ghdl -r tb_fifo32_width_adapter -gC_FIFO32_DWIDTH=32
+--!            ghdl -r tb_fifo32_width_adapter -gC_FIFO32_DWIDTH=64
+--!            ghdl -r tb_fifo32_width_adapter -gC_FIFO32_DWIDTH=128
+entity tb_fifo32_width_adapter is
+  generic (
+    C_FIFO32_DWIDTH : integer := 32;
+    C_THREADS       : integer := 4;
+    C_LEN           : integer := 1024;  -- bytes, multiple of C_FIFO32_DWIDTH/8
+    C_REQUESTS      : integer := 32;
+    C_OUTSTANDING   : integer := 4;
+    C_MEM_LATENCY   : integer := 32
+    );
+end entity;
+
+architecture testbench of tb_fifo32_width_adapter is
+--------------------------------------------------------------------------------
+-- Constants
+--------------------------------------------------------------------------------
+  constant half_cycle : time := 5 ns;
+  constant full_cycle : time := 2 * half_cycle;
+
+  constant W       : integer := C_FIFO32_DWIDTH;
+  constant PORTS   : integer := 4;
+  constant C_LANES : integer := W/32;
+
+  constant ALL_DONE : std_logic_vector(PORTS-1 downto 0) := (others => '1');
+
+  --! first address read by thread i
+  function thread_base(i : integer) return unsigned is
+  begin
+    return to_unsigned(16#100000# * (i+1), 32);
+  end;
+
+--------------------------------------------------------------------------------
+-- Signals
+--------------------------------------------------------------------------------
+  signal clk      : std_logic := '0';
+  signal rst      : std_logic;
+  signal finished : boolean := false;
+
+  -- 32 bit FIFO32 links of the threads: requests (M) and replies (S)
+  signal T_M_Data : std_logic_vector(32*PORTS-1 downto 0);
+  signal T_M_Rem  : std_logic_vector(16*PORTS-1 downto 0);
+  signal T_M_Wr   : std_logic_vector(PORTS-1 downto 0);
+  signal T_S_Data : std_logic_vector(32*PORTS-1 downto 0);
+  signal T_S_Fill : std_logic_vector(16*PORTS-1 downto 0);
+  signal T_S_Rd   : std_logic_vector(PORTS-1 downto 0);
+
+  -- FIFO32 links of the arbiter ports, C_FIFO32_DWIDTH bits wide
+  signal A_S_Data : std_logic_vector(W*PORTS-1 downto 0);
+  signal A_S_Fill : std_logic_vector(16*PORTS-1 downto 0);
+  signal A_S_Rd   : std_logic_vector(PORTS-1 downto 0);
+  signal A_M_Data : std_logic_vector(W*PORTS-1 downto 0);
+  signal A_M_Rem  : std_logic_vector(16*PORTS-1 downto 0);
+  signal A_M_Wr   : std_logic_vector(PORTS-1 downto 0);
+
+  -- arbiter to burst converter
+  signal A2B_S_Clk  : std_logic;
+  signal A2B_S_Data : std_logic_vector(W-1 downto 0);
+  signal A2B_S_Fill : std_logic_vector(15 downto 0);
+  signal A2B_S_Rd   : std_logic;
+  signal A2B_M_Clk  : std_logic;
+  signal A2B_M_Data : std_logic_vector(W-1 downto 0);
+  signal A2B_M_Rem  : std_logic_vector(15 downto 0);
+  signal A2B_M_Wr   : std_logic;
+
+  -- burst converter to memory
+  signal B2M_S_Data : std_logic_vector(W-1 downto 0);
+  signal B2M_S_Fill : std_logic_vector(15 downto 0);
+  signal B2M_S_Rd   : std_logic;
+  signal B2M_M_Data : std_logic_vector(W-1 downto 0);
+  signal B2M_M_Rem  : std_logic_vector(15 downto 0);
+  signal B2M_M_Wr   : std_logic;
+
+  signal zero_data : std_logic_vector(W-1 downto 0) := (others => '0');
+  signal zero_fill : std_logic_vector(15 downto 0) := (others => '0');
+
+  type MEM_STATE_T is (M_IDLE, M_HEADER, M_ADDR, M_LATENCY, M_DATA);
+  signal mem_state : MEM_STATE_T;
+  signal mem_cmd   : std_logic_vector(31 downto 0);
+  signal mem_addr  : unsigned(31 downto 0);
+  signal mem_beats : natural;
+  signal mem_wait  : natural;
+
+  type count_array_t is array (0 to PORTS-1) of natural;
+  signal done   : std_logic_vector(PORTS-1 downto 0);
+  signal errors : count_array_t;
+  signal cycle  : natural;
+  signal stop   : natural;
+
+begin  -- of architecture -------------------------------------------------------
+
+  clk <= not clk after half_cycle when not finished else '0';
+  rst <= '1', '0' after 4*full_cycle;
+
+  threads : for i in 0 to PORTS-1 generate
+    signal issued    : natural;
+    signal received  : natural;     -- 32 bit words
+    signal addr_next : std_logic;   -- the next word written is an address
+  begin
+
+    -- reply words are consumed as soon as they arrive
+    T_S_Rd(i) <= '1' when unsigned(T_S_Fill(16*(i+1)-1 downto 16*i)) > 0 else '0';
+
+    hwt_process : process(clk) is
+      variable outstanding : integer;
+    begin
+      if rising_edge(clk) then
+        T_M_Wr(i) <= '0';
+        if rst = '1' then
+          issued    <= 0;
+          received  <= 0;
+          addr_next <= '0';
+          errors(i) <= 0;
+          done(i)   <= '0';
+        else
+          -- issue: header and address of a read request, one word per cycle
+          outstanding := issued - received/(C_LEN/4);
+          if addr_next = '1' then
+            if unsigned(T_M_Rem(16*(i+1)-1 downto 16*i)) > 1 then
+              T_M_Data(32*(i+1)-1 downto 32*i) <= std_logic_vector(thread_base(i) + issued*C_LEN);
+              T_M_Wr(i) <= '1';
+              addr_next <= '0';
+              issued    <= issued + 1;
+            end if;
+          elsif i < C_THREADS and issued < C_REQUESTS and outstanding < C_OUTSTANDING then
+            if unsigned(T_M_Rem(16*(i+1)-1 downto 16*i)) > 1 then
+              T_M_Data(32*(i+1)-1 downto 32*i) <= X"00" & std_logic_vector(to_unsigned(C_LEN, 24));
+              T_M_Wr(i) <= '1';
+              addr_next <= '1';
+            end if;
+          end if;
+
+          -- receive: every word holds its own address
+          if T_S_Rd(i) = '1' then
+            if unsigned(T_S_Data(32*(i+1)-1 downto 32*i)) /= thread_base(i) + received*4 then
+              errors(i) <= errors(i) + 1;
+            end if;
+            received <= received + 1;
+          end if;
+
+          if i >= C_THREADS or received = C_REQUESTS*C_LEN/4 then
+            done(i) <= '1';
+          end if;
+        end if;
+      end if;
+    end process;
+
+    narrow_gen : if W = 32 generate
+      req_fifo_i : entity fifo32_v1_00_a.fifo32
+        generic map (C_FIFO32_DEPTH => 16)
+        port map (
+          Rst           => rst,
+          FIFO32_S_Clk  => clk,
+          FIFO32_M_Clk  => clk,
+          FIFO32_S_Data => A_S_Data(W*(i+1)-1 downto W*i),
+          FIFO32_M_Data => T_M_Data(32*(i+1)-1 downto 32*i),
+          FIFO32_S_Fill => A_S_Fill(16*(i+1)-1 downto 16*i),
+          FIFO32_M_Rem  => T_M_Rem(16*(i+1)-1 downto 16*i),
+          FIFO32_S_Rd   => A_S_Rd(i),
+          FIFO32_M_Wr   => T_M_Wr(i)
+          );
+
+      rpl_fifo_i : entity fifo32_v1_00_a.fifo32
+        generic map (C_FIFO32_DEPTH => 128)
+        port map (
+          Rst           => rst,
+          FIFO32_S_Clk  => clk,
+          FIFO32_M_Clk  => clk,
+          FIFO32_S_Data => T_S_Data(32*(i+1)-1 downto 32*i),
+          FIFO32_M_Data => A_M_Data(W*(i+1)-1 downto W*i),
+          FIFO32_S_Fill => T_S_Fill(16*(i+1)-1 downto 16*i),
+          FIFO32_M_Rem  => A_M_Rem(16*(i+1)-1 downto 16*i),
+          FIFO32_S_Rd   => T_S_Rd(i),
+          FIFO32_M_Wr   => A_M_Wr(i)
+          );
+    end generate;
+
+    wide_gen : if W > 32 generate
+      -- narrow and wide side of the adapter
+      signal N_S_Data : std_logic_vector(31 downto 0);
+      signal N_S_Fill : std_logic_vector(15 downto 0);
+      signal N_S_Rd   : std_logic;
+      signal N_M_Data : std_logic_vector(31 downto 0);
+      signal N_M_Rem  : std_logic_vector(15 downto 0);
+      signal N_M_Wr   : std_logic;
+      signal W_S_Data : std_logic_vector(W-1 downto 0);
+      signal W_S_Fill : std_logic_vector(15 downto 0);
+      signal W_S_Rd   : std_logic;
+      signal W_M_Data : std_logic_vector(W-1 downto 0);
+      signal W_M_Rem  : std_logic_vector(15 downto 0);
+      signal W_M_Wr   : std_logic;
+    begin
+      req_narrow_fifo_i : entity fifo32_v1_00_a.fifo32
+        generic map (C_FIFO32_DEPTH => 16)
+        port map (
+          Rst           => rst,
+          FIFO32_S_Clk  => clk,
+          FIFO32_M_Clk  => clk,
+          FIFO32_S_Data => N_S_Data,
+          FIFO32_M_Data => T_M_Data(32*(i+1)-1 downto 32*i),
+          FIFO32_S_Fill => N_S_Fill,
+          FIFO32_M_Rem  => T_M_Rem(16*(i+1)-1 downto 16*i),
+          FIFO32_S_Rd   => N_S_Rd,
+          FIFO32_M_Wr   => T_M_Wr(i)
+          );
+
+      req_wide_fifo_i : entity fifo32_v1_00_a.fifo32
+        generic map (C_FIFO32_DEPTH => 16, C_FIFO32_DWIDTH => W)
+        port map (
+          Rst           => rst,
+          FIFO32_S_Clk  => clk,
+          FIFO32_M_Clk  => clk,
+          FIFO32_S_Data => A_S_Data(W*(i+1)-1 downto W*i),
+          FIFO32_M_Data => W_M_Data,
+          FIFO32_S_Fill => A_S_Fill(16*(i+1)-1 downto 16*i),
+          FIFO32_M_Rem  => W_M_Rem,
+          FIFO32_S_Rd   => A_S_Rd(i),
+          FIFO32_M_Wr   => W_M_Wr
+          );
+
+      rpl_wide_fifo_i : entity fifo32_v1_00_a.fifo32
+        generic map (C_FIFO32_DEPTH => 128, C_FIFO32_DWIDTH => W)
+        port map (
+          Rst           => rst,
+          FIFO32_S_Clk  => clk,
+          FIFO32_M_Clk  => clk,
+          FIFO32_S_Data => W_S_Data,
+          FIFO32_M_Data => A_M_Data(W*(i+1)-1 downto W*i),
+          FIFO32_S_Fill => W_S_Fill,
+          FIFO32_M_Rem  => A_M_Rem(16*(i+1)-1 downto 16*i),
+          FIFO32_S_Rd   => W_S_Rd,
+          FIFO32_M_Wr   => A_M_Wr(i)
+          );
+
+      rpl_narrow_fifo_i : entity fifo32_v1_00_a.fifo32
+        generic map (C_FIFO32_DEPTH => 16)
+        port map (
+          Rst           => rst,
+          FIFO32_S_Clk  => clk,
+          FIFO32_M_Clk  => clk,
+          FIFO32_S_Data => T_S_Data(32*(i+1)-1 downto 32*i),
+          FIFO32_M_Data => N_M_Data,
+          FIFO32_S_Fill => T_S_Fill(16*(i+1)-1 downto 16*i),
+          FIFO32_M_Rem  => N_M_Rem,
+          FIFO32_S_Rd   => T_S_Rd(i),
+          FIFO32_M_Wr   => N_M_Wr
+          );
+
+      adapter_i : entity fifo32_width_adapter_v1_00_a.fifo32_width_adapter
+        generic map (C_FIFO32_DWIDTH => W)
+        port map (
+          Rst                  => rst,
+          Clk                  => clk,
+          NARROW_FIFO32_S_Clk  => open,
+          NARROW_FIFO32_S_Data => N_S_Data,
+          NARROW_FIFO32_S_Fill => N_S_Fill,
+          NARROW_FIFO32_S_Rd   => N_S_Rd,
+          NARROW_FIFO32_M_Clk  => open,
+          NARROW_FIFO32_M_Data => N_M_Data,
+          NARROW_FIFO32_M_Rem  => N_M_Rem,
+          NARROW_FIFO32_M_Wr   => N_M_Wr,
+          WIDE_FIFO32_S_Clk    => open,
+          WIDE_FIFO32_S_Data   => W_S_Data,
+          WIDE_FIFO32_S_Fill   => W_S_Fill,
+          WIDE_FIFO32_S_Rd     => W_S_Rd,
+          WIDE_FIFO32_M_Clk    => open,
+          WIDE_FIFO32_M_Data   => W_M_Data,
+          WIDE_FIFO32_M_Rem    => W_M_Rem,
+          WIDE_FIFO32_M_Wr     => W_M_Wr
+          );
+    end generate;
+  end generate;
+
+  arbiter_i : entity fifo32_arbiter_v1_00_a.fifo32_arbiter
+    generic map (
+      FIFO32_PORTS  => PORTS,
+      FIFO32_DWIDTH => W
+      )
+    port map (
+      IN_FIFO32_S_Data_A => A_S_Data(W*1-1 downto W*0),
+      IN_FIFO32_S_Fill_A => A_S_Fill(15 downto 0),
+      IN_FIFO32_S_Rd_A   => A_S_Rd(0),
+      IN_FIFO32_M_Data_A => A_M_Data(W*1-1 downto W*0),
+      IN_FIFO32_M_Rem_A  => A_M_Rem(15 downto 0),
+      IN_FIFO32_M_Wr_A   => A_M_Wr(0),
+
+      IN_FIFO32_S_Data_B => A_S_Data(W*2-1 downto W*1),
+      IN_FIFO32_S_Fill_B => A_S_Fill(31 downto 16),
+      IN_FIFO32_S_Rd_B   => A_S_Rd(1),
+      IN_FIFO32_M_Data_B => A_M_Data(W*2-1 downto W*1),
+      IN_FIFO32_M_Rem_B  => A_M_Rem(31 downto 16),
+      IN_FIFO32_M_Wr_B   => A_M_Wr(1),
+
+      IN_FIFO32_S_Data_C => A_S_Data(W*3-1 downto W*2),
+      IN_FIFO32_S_Fill_C => A_S_Fill(47 downto 32),
+      IN_FIFO32_S_Rd_C   => A_S_Rd(2),
+      IN_FIFO32_M_Data_C => A_M_Data(W*3-1 downto W*2),
+      IN_FIFO32_M_Rem_C  => A_M_Rem(47 downto 32),
+      IN_FIFO32_M_Wr_C   => A_M_Wr(2),
+
+      IN_FIFO32_S_Data_D => A_S_Data(W*4-1 downto W*3),
+      IN_FIFO32_S_Fill_D => A_S_Fill(63 downto 48),
+      IN_FIFO32_S_Rd_D   => A_S_Rd(3),
+      IN_FIFO32_M_Data_D => A_M_Data(W*4-1 downto W*3),
+      IN_FIFO32_M_Rem_D  => A_M_Rem(63 downto 48),
+      IN_FIFO32_M_Wr_D   => A_M_Wr(3),
+
+      IN_FIFO32_S_Data_E => zero_data, IN_FIFO32_S_Fill_E => zero_fill, IN_FIFO32_M_Rem_E => zero_fill,
+      IN_FIFO32_S_Data_F => zero_data, IN_FIFO32_S_Fill_F => zero_fill, IN_FIFO32_M_Rem_F => zero_fill,
+      IN_FIFO32_S_Data_G => zero_data, IN_FIFO32_S_Fill_G => zero_fill, IN_FIFO32_M_Rem_G => zero_fill,
+      IN_FIFO32_S_Data_H => zero_data, IN_FIFO32_S_Fill_H => zero_fill, IN_FIFO32_M_Rem_H => zero_fill,
+      IN_FIFO32_S_Data_I => zero_data, IN_FIFO32_S_Fill_I => zero_fill, IN_FIFO32_M_Rem_I => zero_fill,
+      IN_FIFO32_S_Data_J => zero_data, IN_FIFO32_S_Fill_J => zero_fill, IN_FIFO32_M_Rem_J => zero_fill,
+      IN_FIFO32_S_Data_K => zero_data, IN_FIFO32_S_Fill_K => zero_fill, IN_FIFO32_M_Rem_K => zero_fill,
+      IN_FIFO32_S_Data_L => zero_data, IN_FIFO32_S_Fill_L => zero_fill, IN_FIFO32_M_Rem_L => zero_fill,
+      IN_FIFO32_S_Data_M => zero_data, IN_FIFO32_S_Fill_M => zero_fill, IN_FIFO32_M_Rem_M => zero_fill,
+      IN_FIFO32_S_Data_N => zero_data, IN_FIFO32_S_Fill_N => zero_fill, IN_FIFO32_M_Rem_N => zero_fill,
+      IN_FIFO32_S_Data_O => zero_data, IN_FIFO32_S_Fill_O => zero_fill, IN_FIFO32_M_Rem_O => zero_fill,
+      IN_FIFO32_S_Data_P => zero_data, IN_FIFO32_S_Fill_P => zero_fill, IN_FIFO32_M_Rem_P => zero_fill,
+
+      OUT_FIFO32_S_Clk  => A2B_S_Clk,
+      OUT_FIFO32_S_Data => A2B_S_Data,
+      OUT_FIFO32_S_Fill => A2B_S_Fill,
+      OUT_FIFO32_S_Rd   => A2B_S_Rd,
+      OUT_FIFO32_M_Clk  => A2B_M_Clk,
+      OUT_FIFO32_M_Data => A2B_M_Data,
+      OUT_FIFO32_M_Rem  => A2B_M_Rem,
+      OUT_FIFO32_M_Wr   => A2B_M_Wr,
+
+      Rst         => rst,
+      clk         => clk,
+      SEL         => open,
+      ARB_PORT    => "0000",
+      ARB_CONFIG  => X"00000000",
+      ARB_WE      => '0',
+      PARK        => '0',
+      RESUME      => '0',
+      ila_signals => open
+      );
+
+  burst_converter_i : entity fifo32_burst_converter_v1_00_a.fifo32_burst_converter
+    generic map (
+      C_FIFO32_DWIDTH => W
+      )
+    port map (
+      IN_FIFO32_S_Clk  => A2B_S_Clk,
+      IN_FIFO32_S_Data => A2B_S_Data,
+      IN_FIFO32_S_Fill => A2B_S_Fill,
+      IN_FIFO32_S_Rd   => A2B_S_Rd,
+      IN_FIFO32_M_Clk  => A2B_M_Clk,
+      IN_FIFO32_M_Data => A2B_M_Data,
+      IN_FIFO32_M_Rem  => A2B_M_Rem,
+      IN_FIFO32_M_Wr   => A2B_M_Wr,
+
+      OUT_FIFO32_S_Clk  => clk,
+      OUT_FIFO32_S_Data => B2M_S_Data,
+      OUT_FIFO32_S_Fill => B2M_S_Fill,
+      OUT_FIFO32_S_Rd   => B2M_S_Rd,
+      OUT_FIFO32_M_Clk  => clk,
+      OUT_FIFO32_M_Data => B2M_M_Data,
+      OUT_FIFO32_M_Rem  => B2M_M_Rem,
+      OUT_FIFO32_M_Wr   => B2M_M_Wr,
+
+      Rst         => rst,
+      clk         => clk,
+      ila_signals => open
+      );
+
+  -- memory: reads the header and the address of a request and returns the
+  -- data after C_MEM_LATENCY cycles, one word per cycle.
+  mem_process : process(clk) is
+    variable word : std_logic_vector(W-1 downto 0);
+  begin
+    if rising_edge(clk) then
+      B2M_M_Wr <= '0';
+      if rst = '1' then
+        B2M_S_Rd  <= '0';
+        mem_state <= M_IDLE;
+      else
+        case mem_state is
+          when M_IDLE =>
+            if unsigned(B2M_S_Fill) > 1 then
+              B2M_S_Rd  <= '1';
+              mem_state <= M_HEADER;
+            end if;
+
+          when M_HEADER =>
+            mem_cmd   <= B2M_S_Data(31 downto 0);
+            mem_state <= M_ADDR;
+
+          when M_ADDR =>
+            B2M_S_Rd  <= '0';
+            assert mem_cmd(31) = '0' report "unexpected write request" severity error;
+            assert unsigned(B2M_S_Data(31 downto 0)) mod (W/8) = 0
+              report "unaligned request" severity error;
+            mem_addr  <= unsigned(B2M_S_Data(31 downto 0));
+            mem_beats <= to_integer(unsigned(mem_cmd(23 downto 0))) / (W/8);
+            mem_wait  <= C_MEM_LATENCY;
+            mem_state <= M_LATENCY;
+
+          when M_LATENCY =>
+            if mem_wait = 0 then
+              mem_state <= M_DATA;
+            else
+              mem_wait <= mem_wait - 1;
+            end if;
+
+          when M_DATA =>
+            if unsigned(B2M_M_Rem) > 1 then
+              for k in 0 to C_LANES-1 loop
+                word(W-1-32*k downto W-32-32*k) := std_logic_vector(mem_addr + 4*k);
+              end loop;
+              B2M_M_Data <= word;
+              B2M_M_Wr   <= '1';
+              mem_addr   <= mem_addr + W/8;
+              mem_beats  <= mem_beats - 1;
+              if mem_beats = 1 then
+                mem_state <= M_IDLE;
+              end if;
+            end if;
+        end case;
+      end if;
+    end if;
+  end process;
+
+  cycle_process : process(clk) is
+  begin
+    if rising_edge(clk) then
+      if rst = '1' then
+        cycle <= 0;
+      else
+        cycle <= cycle + 1;
+      end if;
+    end if;
+  end process;
+
+  report_process : process is
+    variable total  : natural;
+    variable bpc    : natural;
+    variable errs   : natural;
+  begin
+    wait until rst = '0';
+    wait until done = ALL_DONE;
+    stop <= cycle;
+    wait for full_cycle;
+
+    errs := 0;
+    for i in 0 to PORTS-1 loop
+      errs := errs + errors(i);
+    end loop;
+    assert errs = 0 report integer'image(errs) & " words read wrong" severity error;
+
+    total := C_THREADS * C_REQUESTS * C_LEN;
+    bpc   := (total*100)/stop;
+    report integer'image(W) & " bit data path, " & integer'image(C_THREADS) & " threads, latency "
+      & integer'image(C_MEM_LATENCY) & ": " & integer'image(total) & " bytes in "
+      & integer'image(stop) & " cycles, "
+      & integer'image(bpc/100) & "." & integer'image((bpc mod 100)/10) & integer'image(bpc mod 10)
+      & " bytes per cycle";
+    finished <= true;
+    wait;
+  end process;
+
+end architecture;
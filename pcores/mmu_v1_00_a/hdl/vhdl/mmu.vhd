@@ -15,14 +15,20 @@ use proc_common_v3_00_a.proc_common_pkg.all;
 entity mmu is
 	generic (
 		C_ENABLE_ILA : integer := 0;
-		C_TLB_SIZE   : integer := 32
+		C_TLB_SIZE   : integer := 32;
+		C_TLB_WAYS   : integer := 0; -- set-associative TLB with this many ways, 0 for the fully associative one
+		C_PGDE_CACHE_SIZE : integer := 0; -- cached page directory entries, power of 2, 0 disables
+		C_LARGE_TLB_SIZE  : integer := 4; -- TLB entries for 4 MB sections, 0 disables
+		C_NUM_SLOTS       : integer := 16; -- hardware thread slots with their own statistics
+		C_FIFO32_DWIDTH   : integer := 32; -- 32, 64 or 128 bits per word, see fifo32_width_adapter
+		C_PARK_FAULTS     : integer := 0   -- 1 to park faulting requests, see park below
 	);
 	port (
 		-- FIFO Interface to HWT
 		HWT_FIFO32_S_Clk : out std_logic;
 		HWT_FIFO32_M_Clk : out std_logic;
-		HWT_FIFO32_S_Data : in std_logic_vector(31 downto 0);
-		HWT_FIFO32_M_Data : out std_logic_vector(31 downto 0);
+		HWT_FIFO32_S_Data : in std_logic_vector(C_FIFO32_DWIDTH-1 downto 0);
+		HWT_FIFO32_M_Data : out std_logic_vector(C_FIFO32_DWIDTH-1 downto 0);
 		HWT_FIFO32_S_Fill : in std_logic_vector(15 downto 0);
 		HWT_FIFO32_M_Rem : in std_logic_vector(15 downto 0);
 		HWT_FIFO32_S_Rd : out std_logic;
@@ -31,8 +37,8 @@ entity mmu is
 		-- FIFO interface to memory
 		MEM_FIFO32_S_Clk : in std_logic;
 		MEM_FIFO32_M_Clk : in std_logic;
-		MEM_FIFO32_S_Data : out std_logic_vector(31 downto 0);
-		MEM_FIFO32_M_Data : in std_logic_vector(31 downto 0);
+		MEM_FIFO32_S_Data : out std_logic_vector(C_FIFO32_DWIDTH-1 downto 0);
+		MEM_FIFO32_M_Data : in std_logic_vector(C_FIFO32_DWIDTH-1 downto 0);
 		MEM_FIFO32_S_Fill : out std_logic_vector(15 downto 0);
 		MEM_FIFO32_M_Rem : out std_logic_vector(15 downto 0);
 		MEM_FIFO32_S_Rd : in std_logic;
@@ -41,9 +47,35 @@ entity mmu is
 		retry         : in std_logic;
 		page_fault    : out std_logic;
 		fault_addr    : out std_logic_vector(31 downto 0);
+		fault_slot    : out std_logic_vector(3 downto 0);
+		-- with abort set together with retry, the faulting request is dropped
+		-- instead of being translated again. Its data words are discarded or
+		-- answered with zeros, so that the arbiter completes the packet. The
+		-- slot in fault_slot has to be held in reset meanwhile.
+		abort         : in std_logic;
+		-- with C_PARK_FAULTS = 1, a request that faults is put aside instead of
+		-- blocking the memory interface until retry: park tells the arbiter
+		-- and the burst converter to skip the slot, so that the requests of the
+		-- other slots are translated while the fault is handled. After retry,
+		-- resume asks the arbiter to continue the request, it answers with
+		-- resumed once it is idle. A fault of another slot meanwhile blocks
+		-- until the parked one is handled.
+		park          : out std_logic;
+		resume        : out std_logic;
+		resumed       : in std_logic;
 		tlb_hits      : out std_logic_vector(31 downto 0);
 		tlb_misses    : out std_logic_vector(31 downto 0);
 		pgd           : in std_logic_vector(31 downto 0);
+
+		-- per slot statistics. slot is the hardware thread currently connected
+		-- (SEL of fifo32_arbiter), stats_data is the counter selected by
+		-- stats_slot and stats_sel (see C_STATS_* below).
+		slot          : in std_logic_vector(3 downto 0);
+		stats_slot    : in std_logic_vector(3 downto 0);
+		stats_sel     : in std_logic_vector(2 downto 0);
+		stats_clear   : in std_logic;
+		stats_data    : out std_logic_vector(31 downto 0);
+
 		rst           : in std_logic;
 		clk           : in std_logic
 	);
@@ -74,8 +106,8 @@ architecture implementation of mmu is
 	signal DATA    : STD_LOGIC_VECTOR(524 DOWNTO 0);
 	signal TRIG    : STD_LOGIC_VECTOR(15 DOWNTO 0);
 	
-	signal HWT_FIFO32_M_Data_dup : std_logic_vector(31 downto 0);
-	signal MEM_FIFO32_S_Data_dup : std_logic_vector(31 downto 0);
+	signal HWT_FIFO32_M_Data_dup : std_logic_vector(C_FIFO32_DWIDTH-1 downto 0);
+	signal MEM_FIFO32_S_Data_dup : std_logic_vector(C_FIFO32_DWIDTH-1 downto 0);
 	signal HWT_FIFO32_S_Rd_dup   : std_logic;
 	signal HWT_FIFO32_M_Wr_dup   : std_logic;
 	signal MEM_FIFO32_S_Fill_dup : std_logic_vector(15 downto 0);
@@ -83,14 +115,14 @@ architecture implementation of mmu is
 	signal page_fault_dup        : std_logic;
 	signal fault_addr_dup        : std_logic_vector(31 downto 0);
 
-	type STATE_TYPE is (STATE_WAIT_HEADER, STATE_READ_CMD, STATE_READ_ADDR, STATE_READ_PGDE_0, STATE_READ_PGDE_1, STATE_READ_PGDE_2,
+	type STATE_TYPE is (STATE_WAIT_HEADER, STATE_READ_CMD, STATE_READ_ADDR, STATE_TLB_LOOKUP, STATE_READ_PGDE_0, STATE_READ_PGDE_1, STATE_READ_PGDE_2,
 	                    STATE_READ_PTE_0,STATE_READ_PTE_1,STATE_READ_PTE_2, STATE_WRITE_HEADER_0, STATE_WRITE_HEADER_1, STATE_COPY,
-							  STATE_PAGE_FAULT);
+							  STATE_PAGE_FAULT, STATE_PARK, STATE_ABORT);
 	
 	signal state     : STATE_TYPE;
 	
-	signal HWT_M_Data     : std_logic_vector(31 downto 0);
-	signal MEM_S_Data     : std_logic_vector(31 downto 0);
+	signal HWT_M_Data     : std_logic_vector(C_FIFO32_DWIDTH-1 downto 0);
+	signal MEM_S_Data     : std_logic_vector(C_FIFO32_DWIDTH-1 downto 0);
 	signal HWT_S_Rd       : std_logic;
 	signal HWT_M_Wr       : std_logic;
 	signal MEM_S_Fill     : std_logic_vector(15 downto 0);
@@ -107,6 +139,8 @@ architecture implementation of mmu is
 	
 	signal len       : std_logic_vector(23 downto 0);
 	signal counter   : std_logic_vector(23 downto 0);
+	signal beats     : std_logic_vector(23 downto 0);
+	signal abort_beats : std_logic_vector(23 downto 0);
 	signal cmd       : std_logic_vector(7 downto 0);
 	signal copy      : std_logic;
 
@@ -118,6 +152,82 @@ architecture implementation of mmu is
 
 	signal tlb_hits_dup   : std_logic_vector(31 downto 0);
 	signal tlb_misses_dup : std_logic_vector(31 downto 0);
+
+	signal fault_slot_dup : integer range 0 to C_NUM_SLOTS-1;
+
+	-- the parked request (C_PARK_FAULTS = 1). park_ready is set by the retry
+	-- for it, the request continues with resumed.
+	signal park_dup   : std_logic;
+	signal park_valid : std_logic;
+	signal park_ready : std_logic;
+	signal park_abort : std_logic;
+	signal park_cmd   : std_logic_vector(7 downto 0);
+	signal park_len   : std_logic_vector(23 downto 0);
+	signal park_vaddr : std_logic_vector(31 downto 0);
+	signal park_slot  : integer range 0 to C_NUM_SLOTS-1;
+	signal resuming   : std_logic;
+
+	-- direct mapped cache of page directory entries, indexed by the lowest bits
+	-- of the page directory index. A hit saves the first memory read of a walk.
+	constant C_PGDC_SIZE    : integer := max2(C_PGDE_CACHE_SIZE,1);
+	constant C_PGDC_LOGSIZE : integer := clog2(C_PGDC_SIZE);
+
+	type PGDC_DATA_T is array (0 to C_PGDC_SIZE-1) of std_logic_vector(31 downto 0);
+	type PGDC_TAG_T is array (0 to C_PGDC_SIZE-1) of std_logic_vector(9 downto 0);
+
+	signal pgdc_data  : PGDC_DATA_T;
+	signal pgdc_tag   : PGDC_TAG_T;
+	signal pgdc_valid : std_logic_vector(C_PGDC_SIZE-1 downto 0);
+	signal pgdc_index : integer range 0 to C_PGDC_SIZE-1;
+	signal pgdc_hit   : std_logic;
+	signal pgd_last   : std_logic_vector(31 downto 0);
+
+	-- per slot counters
+	constant C_STATS_HITS        : std_logic_vector(2 downto 0) := "000";
+	constant C_STATS_MISSES      : std_logic_vector(2 downto 0) := "001";
+	constant C_STATS_WALK_CYCLES : std_logic_vector(2 downto 0) := "010";
+	constant C_STATS_PAGE_FAULTS : std_logic_vector(2 downto 0) := "011";
+	constant C_STATS_STALLS      : std_logic_vector(2 downto 0) := "100";
+
+	type SLOT_COUNTER_T is array (0 to C_NUM_SLOTS-1) of std_logic_vector(31 downto 0);
+
+	signal stats_hits        : SLOT_COUNTER_T;
+	signal stats_misses      : SLOT_COUNTER_T;
+	signal stats_walk_cycles : SLOT_COUNTER_T; -- cycles spent reading page table entries
+	signal stats_page_faults : SLOT_COUNTER_T;
+	signal stats_stalls      : SLOT_COUNTER_T; -- cycles between reading an address and issuing the request
+	signal cur_slot          : integer range 0 to C_NUM_SLOTS-1;
+	signal hit               : std_logic;
+	signal walking           : std_logic;
+
+	-- fully associative TLB for large page directory entries (see _PMD_SIZE
+	-- below). Each entry maps a 4 MB section, a 16 MB page takes one entry per
+	-- section. Entries are replaced round robin.
+	constant C_LTLB_SIZE : integer := max2(C_LARGE_TLB_SIZE,1);
+
+	type LTLB_T is array (0 to C_LTLB_SIZE-1) of std_logic_vector(9 downto 0);
+
+	signal ltlb_tag   : LTLB_T;                -- vaddr(31 downto 22)
+	signal ltlb_data  : LTLB_T;                -- paddr(31 downto 22)
+	signal ltlb_valid : std_logic_vector(C_LTLB_SIZE-1 downto 0);
+	signal ltlb_wptr  : integer range 0 to C_LTLB_SIZE-1;
+	signal ltlb_hit   : std_logic;
+	signal ltlb_do    : std_logic_vector(9 downto 0);
+	signal pgde_large : std_logic;
+	signal pgde_frame : std_logic_vector(9 downto 0);
+
+	-- the 32 bit word of a memory word that holds the page directory or page
+	-- table entry being read. Memory words wider than 32 bits are aligned to
+	-- their size and hold the lowest address in their upper bits.
+	constant C_LANES : integer := C_FIFO32_DWIDTH/32;
+
+	function lane_of(addr : std_logic_vector(31 downto 0)) return integer is
+	begin
+		return conv_integer(addr(6 downto 2)) mod C_LANES;
+	end;
+
+	signal mem_lane : integer range 0 to C_LANES-1;
+	signal mem_word : std_logic_vector(31 downto 0);
 	
 
 begin
@@ -141,15 +251,15 @@ begin
 
 	end generate;
 	
-	DATA(31 downto 0)  <= HWT_FIFO32_S_Data;
-	DATA(63 downto 32) <= HWT_FIFO32_M_Data_dup;
+	DATA(31 downto 0)  <= HWT_FIFO32_S_Data(31 downto 0);
+	DATA(63 downto 32) <= HWT_FIFO32_M_Data_dup(31 downto 0);
 	DATA(79 downto 64) <= HWT_FIFO32_S_Fill;
 	DATA(95 downto 80) <= HWT_FIFO32_M_Rem;
 	DATA(96) <= HWT_FIFO32_S_Rd_dup;
 	DATA(97) <= HWT_FIFO32_M_Wr_dup;
 	
-	DATA(129 downto 98) <= MEM_FIFO32_S_Data_dup;
-	DATA(161 downto 130) <= MEM_FIFO32_M_Data;
+	DATA(129 downto 98) <= MEM_FIFO32_S_Data_dup(31 downto 0);
+	DATA(161 downto 130) <= mem_word;
 	DATA(177 downto 162) <= MEM_FIFO32_S_Fill_dup;
 	DATA(193 downto 178) <= MEM_FIFO32_M_Rem_dup;
 	DATA(194) <= MEM_FIFO32_S_Rd;
@@ -205,6 +315,9 @@ begin
 	MEM_FIFO32_M_Rem  <= MEM_FIFO32_M_Rem_dup;
 	fault_addr        <= fault_addr_dup;
 	page_fault        <= page_fault_dup;
+	fault_slot        <= conv_std_logic_vector(fault_slot_dup, 4);
+	park              <= park_dup;
+	resume            <= park_ready;
 	
 	pgde_addr <= "00" &  pgd(29 downto 12) & vaddr(31 downto 22) & "00";
 	pte_addr  <= "00" & pgde(29 downto 12) & vaddr(21 downto 12) & "00";
@@ -213,6 +326,143 @@ begin
 	tlb_hits   <= tlb_hits_dup;
 	tlb_misses <= tlb_misses_dup;
 
+	pgdc_gen : if C_PGDE_CACHE_SIZE > 1 generate
+		pgdc_index <= conv_integer(vaddr(22 + C_PGDC_LOGSIZE - 1 downto 22));
+	end generate;
+
+	pgdc_single_gen : if C_PGDE_CACHE_SIZE <= 1 generate
+		pgdc_index <= 0;
+	end generate;
+
+	ltlb_proc : process(ltlb_tag, ltlb_data, ltlb_valid, vaddr) is
+		variable h : std_logic;
+		variable d : std_logic_vector(9 downto 0);
+	begin
+		h := '0';
+		d := (others => '0');
+		if C_LARGE_TLB_SIZE > 0 then
+			for i in 0 to C_LTLB_SIZE-1 loop
+				if ltlb_valid(i) = '1' and ltlb_tag(i) = vaddr(31 downto 22) then
+					h := '1';
+					d := ltlb_data(i);
+				end if;
+			end loop;
+		end if;
+		ltlb_hit <= h;
+		ltlb_do  <= d;
+	end process;
+
+	mem_word_32_gen : if C_FIFO32_DWIDTH = 32 generate
+		mem_lane <= 0;
+		mem_word <= MEM_FIFO32_M_Data;
+	end generate;
+
+	mem_word_wide_gen : if C_FIFO32_DWIDTH /= 32 generate
+		mem_lane <= lane_of(pte_addr) when state = STATE_READ_PTE_2 else lane_of(pgde_addr);
+
+		mem_word_proc : process(MEM_FIFO32_M_Data, mem_lane) is
+		begin
+			mem_word <= (others => '0');
+			for i in 0 to C_LANES-1 loop
+				if mem_lane = i then
+					mem_word <= MEM_FIFO32_M_Data(C_FIFO32_DWIDTH-1-32*i downto C_FIFO32_DWIDTH-32-32*i);
+				end if;
+			end loop;
+		end process;
+	end generate;
+
+	-- a page directory entry with a non-zero size field maps a large page
+	-- directly instead of pointing to a page table
+	pgde_large <= '1' when C_LARGE_TLB_SIZE > 0 and mem_word(7 downto 5) /= "000" else '0';
+	pgde_frame <= mem_word(31 downto 24) & vaddr(23 downto 22) when mem_word(7 downto 5) = "111"
+	              else mem_word(31 downto 22);
+
+	-- data words of the translated request. 32 bit requests are whole
+	-- words, the lower two bits of the length are ignored as they always
+	-- were.
+	beats_32_gen : if C_FIFO32_DWIDTH = 32 generate
+		beats       <= "00" & len(23 downto 2);
+		abort_beats <= "00" & len(23 downto 2);
+	end generate;
+
+	beats_wide_gen : if C_FIFO32_DWIDTH /= 32 generate
+		beats <= memif_beats(paddr, len, C_FIFO32_DWIDTH);
+		-- same as beats, the page offset is not translated
+		abort_beats <= memif_beats(vaddr, len, C_FIFO32_DWIDTH);
+	end generate;
+
+	resuming <= '1' when state = STATE_WAIT_HEADER and resumed = '1' else '0';
+
+	hit <= '1' when state = STATE_READ_PGDE_0 and (tlb_match = '1' or ltlb_hit = '1') else '0';
+
+	walking <= '1' when (state = STATE_READ_PGDE_0 and hit = '0') or state = STATE_READ_PGDE_1 or state = STATE_READ_PGDE_2
+	                 or state = STATE_READ_PTE_0 or state = STATE_READ_PTE_1 or state = STATE_READ_PTE_2 else '0';
+
+	stats_proc : process(clk, rst) is
+	begin
+		if rst = '1' then
+			cur_slot <= 0;
+			stats_hits <= (others => (others => '0'));
+			stats_misses <= (others => (others => '0'));
+			stats_walk_cycles <= (others => (others => '0'));
+			stats_page_faults <= (others => (others => '0'));
+			stats_stalls <= (others => (others => '0'));
+		elsif rising_edge(clk) then
+			if resuming = '1' then
+				cur_slot <= park_slot;
+			elsif state = STATE_READ_CMD and conv_integer(slot) < C_NUM_SLOTS then
+				cur_slot <= conv_integer(slot);
+			end if;
+
+			if hit = '1' then
+				stats_hits(cur_slot) <= stats_hits(cur_slot) + 1;
+			end if;
+			-- same condition as for tlb_misses
+			if state = STATE_READ_PGDE_0 and hit = '0' and (pgdc_hit = '1' or MEM_FIFO32_S_Rd = '1') then
+				stats_misses(cur_slot) <= stats_misses(cur_slot) + 1;
+			end if;
+			if walking = '1' then
+				stats_walk_cycles(cur_slot) <= stats_walk_cycles(cur_slot) + 1;
+			end if;
+			if state = STATE_PAGE_FAULT and page_fault_dup = '0' then
+				stats_page_faults(cur_slot) <= stats_page_faults(cur_slot) + 1;
+			end if;
+			if walking = '1' or state = STATE_TLB_LOOKUP or state = STATE_PAGE_FAULT then
+				stats_stalls(cur_slot) <= stats_stalls(cur_slot) + 1;
+			end if;
+
+			if stats_clear = '1' and conv_integer(stats_slot) < C_NUM_SLOTS then
+				stats_hits(conv_integer(stats_slot)) <= (others => '0');
+				stats_misses(conv_integer(stats_slot)) <= (others => '0');
+				stats_walk_cycles(conv_integer(stats_slot)) <= (others => '0');
+				stats_page_faults(conv_integer(stats_slot)) <= (others => '0');
+				stats_stalls(conv_integer(stats_slot)) <= (others => '0');
+			end if;
+		end if;
+	end process;
+
+	stats_mux : process(stats_slot, stats_sel, stats_hits, stats_misses, stats_walk_cycles, stats_page_faults, stats_stalls) is
+		variable i : integer range 0 to 15;
+	begin
+		i := conv_integer(stats_slot);
+		stats_data <= (others => '0');
+		if i < C_NUM_SLOTS then
+			case stats_sel is
+				when C_STATS_HITS        => stats_data <= stats_hits(i);
+				when C_STATS_MISSES      => stats_data <= stats_misses(i);
+				when C_STATS_WALK_CYCLES => stats_data <= stats_walk_cycles(i);
+				when C_STATS_PAGE_FAULTS => stats_data <= stats_page_faults(i);
+				when C_STATS_STALLS      => stats_data <= stats_stalls(i);
+				when others              => null;
+			end case;
+		end if;
+	end process;
+
+	pgdc_hit <= pgdc_valid(pgdc_index) when C_PGDE_CACHE_SIZE > 0 and pgdc_tag(pgdc_index) = vaddr(31 downto 22) else '0';
+
+	-- only written while aborting a read
+	HWT_M_Data <= (others => '0');
+
 	HWT_FIFO32_S_Clk <= clk;
 	HWT_FIFO32_M_Clk <= clk;
 	
@@ -261,10 +511,55 @@ begin
 			tlb_hits_dup <= (others => '0');
 			tlb_misses_dup <= (others => '0');
 			fault_addr_dup <= (others => '0');
+			fault_slot_dup <= 0;
+			park_dup <= '0';
+			park_valid <= '0';
+			park_ready <= '0';
+			park_abort <= '0';
+			park_cmd <= (others => '0');
+			park_len <= (others => '0');
+			park_vaddr <= (others => '0');
+			park_slot <= 0;
+			pgdc_valid <= (others => '0');
+			pgd_last <= (others => '0');
+			ltlb_valid <= (others => '0');
+			ltlb_wptr <= 0;
 		elsif rising_edge(clk) then
+			-- the cached entries belong to the old page directory
+			pgd_last <= pgd;
+			if pgd /= pgd_last then
+				pgdc_valid <= (others => '0');
+				ltlb_valid <= (others => '0');
+			end if;
+
+			park_dup <= '0';
+
+			-- the retry for the parked request, whatever the mmu does meanwhile
+			if park_valid = '1' and park_ready = '0' and page_fault_dup = '1' and retry = '1' then
+				page_fault_dup <= '0';
+				park_ready <= '1';
+				park_abort <= abort;
+			end if;
+
 			case state is
 				when STATE_WAIT_HEADER =>
-					if HWT_FIFO32_S_Fill > 1 then
+					if resuming = '1' then
+						-- the arbiter has selected the slot of the parked
+						-- request again
+						park_valid <= '0';
+						park_ready <= '0';
+						cmd <= park_cmd;
+						len <= park_len;
+						vaddr <= park_vaddr;
+						if park_abort = '1' then
+							counter <= (others => '0');
+							state <= STATE_ABORT;
+						elsif C_TLB_WAYS > 0 then
+							state <= STATE_TLB_LOOKUP;
+						else
+							state <= STATE_READ_PGDE_0;
+						end if;
+					elsif HWT_FIFO32_S_Fill > 1 then
 						HWT_S_Rd <= '1';
 						state <= STATE_READ_CMD;
 					end if;
@@ -275,8 +570,16 @@ begin
 					state <= STATE_READ_ADDR;
 					
 				when STATE_READ_ADDR =>
-					vaddr <= HWT_FIFO32_S_Data;
+					vaddr <= HWT_FIFO32_S_Data(31 downto 0);
 					HWT_S_Rd <= '0';
+					if C_TLB_WAYS > 0 then
+						state <= STATE_TLB_LOOKUP;
+					else
+						state <= STATE_READ_PGDE_0;
+					end if;
+
+				when STATE_TLB_LOOKUP =>
+					-- the TLB needs one cycle to read the set of vaddr
 					state <= STATE_READ_PGDE_0;
 					
 				when STATE_READ_PGDE_0 =>
@@ -284,12 +587,20 @@ begin
 						tlb_hits_dup <= tlb_hits_dup + 1;
 						pte(31 downto 12) <= tlb_do;
 						state <= STATE_WRITE_HEADER_0;
+					elsif ltlb_hit = '1' then
+						tlb_hits_dup <= tlb_hits_dup + 1;
+						pte(31 downto 12) <= ltlb_do & vaddr(21 downto 12);
+						state <= STATE_WRITE_HEADER_0;
+					elsif pgdc_hit = '1' then
+						tlb_misses_dup <= tlb_misses_dup + 1;
+						pgde <= pgdc_data(pgdc_index);
+						state <= STATE_READ_PTE_0;
 					else
 						MEM_S_Fill <= x"0002";
-						MEM_S_Data <= x"00000004";
+						MEM_S_Data <= EXT(x"00000004", C_FIFO32_DWIDTH);
 						if MEM_FIFO32_S_Rd = '1' then
 							MEM_S_Fill <= x"0001";
-							MEM_S_Data <= pgde_addr;
+							MEM_S_Data <= EXT(pgde_addr, C_FIFO32_DWIDTH);
 							tlb_misses_dup <= tlb_misses_dup + 1;
 							state <= STATE_READ_PGDE_1;
 						end if;
@@ -303,20 +614,35 @@ begin
 					
 				when STATE_READ_PGDE_2 =>
 					if MEM_FIFO32_M_Wr = '1' then
-						pgde <= MEM_FIFO32_M_Data;
-						if MEM_FIFO32_M_DATA = x"00000000" then
+						pgde <= mem_word;
+						if mem_word = x"00000000" then
 							state <= STATE_PAGE_FAULT;
+						elsif pgde_large = '1' then
+							-- large page: the entry already holds the translation
+							ltlb_tag(ltlb_wptr)   <= vaddr(31 downto 22);
+							ltlb_data(ltlb_wptr)  <= pgde_frame;
+							ltlb_valid(ltlb_wptr) <= '1';
+							if ltlb_wptr = C_LTLB_SIZE-1 then
+								ltlb_wptr <= 0;
+							else
+								ltlb_wptr <= ltlb_wptr + 1;
+							end if;
+							pte(31 downto 12) <= pgde_frame & vaddr(21 downto 12);
+							state <= STATE_WRITE_HEADER_0;
 						else
+							pgdc_data(pgdc_index)  <= mem_word;
+							pgdc_tag(pgdc_index)   <= vaddr(31 downto 22);
+							pgdc_valid(pgdc_index) <= '1';
 							state <= STATE_READ_PTE_0;
 						end if;
 					end if;
 
 				when STATE_READ_PTE_0 =>
 					MEM_S_Fill <= x"0002";
-					MEM_S_Data <= x"00000004";
+					MEM_S_Data <= EXT(x"00000004", C_FIFO32_DWIDTH);
 					if MEM_FIFO32_S_Rd = '1' then
 						MEM_S_Fill <= x"0001";
-						MEM_S_Data <= pte_addr;
+						MEM_S_Data <= EXT(pte_addr, C_FIFO32_DWIDTH);
 						state <= STATE_READ_PTE_1;
 					end if;
 				
@@ -328,8 +654,8 @@ begin
 					
 				when STATE_READ_PTE_2 =>
 					if MEM_FIFO32_M_Wr = '1' then
-						pte <= MEM_FIFO32_M_Data;
-						if MEM_FIFO32_M_Data(1) = '0' then
+						pte <= mem_word;
+						if mem_word(1) = '0' then
 							state <= STATE_PAGE_FAULT;
 						else
 							tlb_we <= '1';
@@ -340,10 +666,10 @@ begin
 				when STATE_WRITE_HEADER_0 =>
 					tlb_we <= '0';
 					MEM_S_Fill <= x"0002";
-					MEM_S_Data <= cmd & len;
+					MEM_S_Data <= EXT(cmd & len, C_FIFO32_DWIDTH);
 					if MEM_FIFO32_S_Rd = '1' then
 						MEM_S_Fill <= x"0001";
-						MEM_S_Data <= paddr;
+						MEM_S_Data <= EXT(paddr, C_FIFO32_DWIDTH);
 						state <= STATE_WRITE_HEADER_1;
 					end if;
 				
@@ -357,19 +683,59 @@ begin
 					
 				when STATE_COPY =>
 					if MEM_FIFO32_M_Wr = '1' or MEM_FIFO32_S_Rd = '1' then
-						counter <= counter + 4;
+						counter <= counter + 1;
 					end if;
-					if counter(23 downto 2) = len(23 downto 2) then
+					if counter = beats then
 						copy <= '0';
 						state <= STATE_WAIT_HEADER;
 					end if;
 	
 				when STATE_PAGE_FAULT =>
-					page_fault_dup <= '1';
-					fault_addr_dup <= vaddr;
-					if retry = '1' then
-						page_fault_dup <= '0';
-						state <= STATE_READ_PGDE_0;
+					if C_PARK_FAULTS = 1 and park_valid = '0' then
+						page_fault_dup <= '1';
+						fault_addr_dup <= vaddr;
+						fault_slot_dup <= cur_slot;
+						park_valid <= '1';
+						park_cmd <= cmd;
+						park_len <= len;
+						park_vaddr <= vaddr;
+						park_slot <= cur_slot;
+						park_dup <= '1';
+						state <= STATE_PARK;
+					elsif park_valid = '1' and park_ready = '0' then
+						-- only one fault is reported at a time
+						null;
+					else
+						page_fault_dup <= '1';
+						fault_addr_dup <= vaddr;
+						fault_slot_dup <= cur_slot;
+						-- a retry while page_fault is still low belongs to the
+						-- parked request
+						if page_fault_dup = '1' and retry = '1' and abort = '1' then
+							page_fault_dup <= '0';
+							counter <= (others => '0');
+							state <= STATE_ABORT;
+						elsif page_fault_dup = '1' and retry = '1' then
+							page_fault_dup <= '0';
+							state <= STATE_READ_PGDE_0;
+						end if;
+					end if;
+
+				when STATE_PARK =>
+					-- the arbiter puts the packet aside with this cycle
+					state <= STATE_WAIT_HEADER;
+
+				when STATE_ABORT =>
+					-- one data word per cycle without looking at the fifo of the
+					-- slot, which ignores the strobes while in reset
+					if counter = abort_beats then
+						HWT_S_Rd <= '0';
+						HWT_M_Wr <= '0';
+						state <= STATE_WAIT_HEADER;
+					else
+						HWT_S_Rd <= cmd(7);
+						HWT_M_Wr <= not cmd(7);
+						counter <= counter + 1;
 					end if;
 					
 			end case;
@@ -379,8 +745,27 @@ begin
 	tlb_tag <= vaddr(31 downto 12);
 	tlb_di  <= paddr(31 downto 12);
 
-	tlb_gen : if C_TLB_SIZE > 0 generate
+	tlb_gen : if C_TLB_SIZE > 0 and C_TLB_WAYS > 0 generate
 		tlb_i : entity mmu_v1_00_a.tlb
+		generic map (
+			C_TLB_LOGSIZE => clog2(C_TLB_SIZE),
+			C_TLB_LOGWAYS => clog2(C_TLB_WAYS),
+			C_TAG_SIZE => 20,
+			C_DATA_SIZE => 20
+		)
+		port map (
+			clk        => clk,
+			rst        => rst,
+			tag        => tlb_tag,
+			di         => tlb_di,
+			do         => tlb_do,
+			we         => tlb_we,
+			match      => tlb_match
+		);
+	end generate;
+
+	tlb_cam_gen : if C_TLB_SIZE > 0 and C_TLB_WAYS = 0 generate
+		tlb_i : entity mmu_v1_00_a.tlb_cam
 		generic map (
 			C_TLB_LOGSIZE => clog2(C_TLB_SIZE),
 			C_TAG_SIZE => 20,
@@ -399,6 +784,14 @@ begin
 
 end architecture;
 
+-- These are the PMD (page directory entry) flags as defined in arch/microblaze/include/asm/pgtable.h
+--
+-- #define _PMD_PRESENT    0x400   /* PMD points to page of PTEs */
+-- #define _PMD_BAD        0x802
+-- #define _PMD_SIZE       0x0e0   /* size field, != 0 for large-page PMD entry */
+-- #define _PMD_SIZE_4M    0x0c0
+-- #define _PMD_SIZE_16M   0x0e0
+
 -- These are the PTE flags as defined in arch/microblaze/include/asm/pgtable.h
 --
 -- /* Definitions for MicroBlaze. */
@@ -0,0 +1,286 @@
+library ieee;            --! Use the standard ieee libraries for logic
+use ieee.std_logic_1164.all;            --! For logic
+use ieee.numeric_std.all;  --! For unsigned and signed types and conversion from/to std_logic_vector
+
+library mmu_v1_00_a;
+
+--! @brief Measures the cycles per TLB miss of the MMU page table walker.
+--! @details The testbench issues single word reads to consecutive pages, so
+--!          that every request misses in the TLB, and reports the average
+--!          number of cycles from offering a request until its data word
+--!          arrives. The memory model answers every read after
+--!          C_MEM_LATENCY cycles and serves a page directory at C_PGD whose
+--!          entries all point to present pages.
+--!          Compare the walker with and without the page directory entry
+--!          cache, e.g.:
+--!            ghdl -r tb_mmu -gC_PGDE_CACHE_SIZE=0
+--!            ghdl -r tb_mmu -gC_PGDE_CACHE_SIZE=4
+--!          and with the set-associative TLB, e.g.:
+--!            ghdl -r tb_mmu -gC_TLB_WAYS=4
+--!          With C_LARGE_PAGES = 1 the page directory holds 4 MB section
+--!          entries (_PMD_SIZE_4M) instead, the requests step by 4 MB and
+--!          every one of them is translated by the page directory entry
+--!          alone:
+--!            ghdl -r tb_mmu -gC_LARGE_PAGES=1
+--!          Every data word is checked against the expected physical address.
+entity tb_mmu is
+  generic (
+    C_TLB_WAYS        : integer := 0;
+    C_PGDE_CACHE_SIZE : integer := 0;
+    C_LARGE_PAGES     : integer := 0;
+    C_MEM_LATENCY     : integer := 16;
+    C_REQUESTS        : integer := 512
+    );
+end entity;
+
+architecture testbench of tb_mmu is
+--------------------------------------------------------------------------------
+-- Constants
+--------------------------------------------------------------------------------
+  constant half_cycle : time := 5 ns;
+  constant full_cycle : time := 2 * half_cycle;
+
+  constant C_PGD        : unsigned(31 downto 0) := X"00100000";  -- page directory
+  constant C_PT_BASE    : unsigned(31 downto 0) := X"00200000";  -- page tables
+  constant C_VADDR_BASE : unsigned(31 downto 0) := X"10000000";  -- first page read
+  constant C_PMD_SIZE_4M : unsigned(31 downto 0) := X"000000C0";  -- section entry
+
+  --! @brief Physical address of vaddr under the simulated page tables.
+  function translate(vaddr : unsigned(31 downto 0)) return unsigned is
+  begin
+    if C_LARGE_PAGES = 1 then
+      return vaddr + X"04000000";
+    else
+      return vaddr + X"01000000";
+    end if;
+  end;
+
+  --! @brief Contents of the simulated memory.
+  --! @details Page directory entries point to the page tables, or are 4 MB
+  --!          sections with C_LARGE_PAGES = 1, page table entries are
+  --!          present, everything else reads as its own address.
+  function mem_read(addr : unsigned(31 downto 0)) return std_logic_vector is
+  begin
+    if addr >= C_PGD and addr < C_PGD + 4096 and C_LARGE_PAGES = 1 then
+      -- entry n maps section n to section n + 16
+      return std_logic_vector(shift_left(addr - C_PGD, 20) + X"04000000" + C_PMD_SIZE_4M);
+    elsif addr >= C_PGD and addr < C_PGD + 4096 then
+      -- entry n points to the page table at C_PT_BASE + n*4096
+      return std_logic_vector(C_PT_BASE + shift_left(addr - C_PGD, 10));
+    elsif addr >= C_PT_BASE and addr < C_PT_BASE + 1024*4096 then
+      -- entry n maps to page n + 4096, with the present bit set
+      return std_logic_vector(shift_left(addr - C_PT_BASE, 10) + X"01000002");
+    else
+      return std_logic_vector(addr);
+    end if;
+  end;
+--------------------------------------------------------------------------------
+-- Signals
+--------------------------------------------------------------------------------
+  signal clk : std_logic := '0';
+  signal rst : std_logic;
+
+  -- FIFO32 interface between testbench (hardware thread) and mmu
+  signal HWT_FIFO32_S_Data : std_logic_vector(31 downto 0);
+  signal HWT_FIFO32_M_Data : std_logic_vector(31 downto 0);
+  signal HWT_FIFO32_S_Fill : std_logic_vector(15 downto 0);
+  signal HWT_FIFO32_M_Rem  : std_logic_vector(15 downto 0);
+  signal HWT_FIFO32_S_Rd   : std_logic;
+  signal HWT_FIFO32_M_Wr   : std_logic;
+
+  -- FIFO32 interface between mmu and memory model
+  signal MEM_FIFO32_S_Data : std_logic_vector(31 downto 0);
+  signal MEM_FIFO32_M_Data : std_logic_vector(31 downto 0);
+  signal MEM_FIFO32_S_Fill : std_logic_vector(15 downto 0);
+  signal MEM_FIFO32_M_Rem  : std_logic_vector(15 downto 0);
+  signal MEM_FIFO32_S_Rd   : std_logic;
+  signal MEM_FIFO32_M_Wr   : std_logic;
+
+  signal page_fault : std_logic;
+  signal fault_addr : std_logic_vector(31 downto 0);
+  signal tlb_hits   : std_logic_vector(31 downto 0);
+  signal tlb_misses : std_logic_vector(31 downto 0);
+
+  type MEM_STATE_T is (M_HEADER, M_ADDR, M_LATENCY, M_DATA);
+  signal mem_state : MEM_STATE_T;
+  signal mem_addr  : unsigned(31 downto 0);
+  signal mem_words : natural;
+  signal mem_wait  : natural;
+
+  type HWT_STATE_T is (H_ISSUE, H_WAIT, H_DONE);
+  signal hwt_state : HWT_STATE_T;
+  signal hwt_idx   : natural range 0 to 2;  -- words of the request already read
+  signal hwt_vaddr : unsigned(31 downto 0);
+  signal requests  : natural;
+  signal cycle     : natural;
+  signal start     : natural;
+  signal total     : natural;
+
+begin  -- of architecture -------------------------------------------------------
+
+  mmu_i : entity mmu_v1_00_a.mmu
+    generic map (
+      C_ENABLE_ILA      => 0,
+      C_TLB_SIZE        => 32,
+      C_TLB_WAYS        => C_TLB_WAYS,
+      C_PGDE_CACHE_SIZE => C_PGDE_CACHE_SIZE
+      )
+    port map (
+      HWT_FIFO32_S_Clk  => open,
+      HWT_FIFO32_M_Clk  => open,
+      HWT_FIFO32_S_Data => HWT_FIFO32_S_Data,
+      HWT_FIFO32_M_Data => HWT_FIFO32_M_Data,
+      HWT_FIFO32_S_Fill => HWT_FIFO32_S_Fill,
+      HWT_FIFO32_M_Rem  => HWT_FIFO32_M_Rem,
+      HWT_FIFO32_S_Rd   => HWT_FIFO32_S_Rd,
+      HWT_FIFO32_M_Wr   => HWT_FIFO32_M_Wr,
+
+      MEM_FIFO32_S_Clk  => clk,
+      MEM_FIFO32_M_Clk  => clk,
+      MEM_FIFO32_S_Data => MEM_FIFO32_S_Data,
+      MEM_FIFO32_M_Data => MEM_FIFO32_M_Data,
+      MEM_FIFO32_S_Fill => MEM_FIFO32_S_Fill,
+      MEM_FIFO32_M_Rem  => MEM_FIFO32_M_Rem,
+      MEM_FIFO32_S_Rd   => MEM_FIFO32_S_Rd,
+      MEM_FIFO32_M_Wr   => MEM_FIFO32_M_Wr,
+
+      retry      => '0',
+      page_fault => page_fault,
+      fault_addr => fault_addr,
+      fault_slot => open,
+      abort      => '0',
+      park       => open,
+      resume     => open,
+      resumed    => '0',
+      tlb_hits   => tlb_hits,
+      tlb_misses => tlb_misses,
+      pgd        => std_logic_vector(C_PGD),
+
+      slot        => X"0",
+      stats_slot  => X"0",
+      stats_sel   => "000",
+      stats_clear => '0',
+      stats_data  => open,
+
+      rst        => rst,
+      clk        => clk
+      );
+
+  clk <= not clk after half_cycle when hwt_state /= H_DONE else '0';
+  rst <= '1', '0' after 4*full_cycle;
+
+  -- the hardware thread offers one request (header and address) at a time
+  HWT_FIFO32_S_Fill <= std_logic_vector(to_unsigned(2 - hwt_idx, 16));
+  HWT_FIFO32_S_Data <= X"00000004" when hwt_idx = 0 else std_logic_vector(hwt_vaddr);
+  HWT_FIFO32_M_Rem  <= X"0010";
+
+  hwt_process : process(clk) is
+  begin
+    if rising_edge(clk) then
+      cycle <= cycle + 1;
+      if rst = '1' then
+        hwt_state <= H_ISSUE;
+        hwt_idx   <= 2;
+        hwt_vaddr <= C_VADDR_BASE;
+        requests  <= 0;
+        cycle     <= 0;
+        total     <= 0;
+      else
+        case hwt_state is
+          when H_ISSUE =>
+            hwt_idx   <= 0;
+            start     <= cycle;
+            hwt_state <= H_WAIT;
+
+          when H_WAIT =>
+            if HWT_FIFO32_S_Rd = '1' and hwt_idx < 2 then
+              hwt_idx <= hwt_idx + 1;
+            end if;
+            if HWT_FIFO32_M_Wr = '1' then
+              assert unsigned(HWT_FIFO32_M_Data) = translate(hwt_vaddr)
+                report "wrong translation" severity error;
+              total     <= total + cycle - start;
+              requests  <= requests + 1;
+              if C_LARGE_PAGES = 1 then
+                hwt_vaddr <= hwt_vaddr + X"00400000";
+              else
+                hwt_vaddr <= hwt_vaddr + 4096;
+              end if;
+              if requests = C_REQUESTS-1 then
+                hwt_state <= H_DONE;
+              else
+                hwt_state <= H_ISSUE;
+              end if;
+            end if;
+
+          when H_DONE =>
+            null;
+        end case;
+      end if;
+    end if;
+  end process;
+
+  -- memory: reads the header and the address of a request, one word every
+  -- other cycle, and returns the data after C_MEM_LATENCY cycles.
+  mem_process : process(clk) is
+  begin
+    if rising_edge(clk) then
+      MEM_FIFO32_M_Wr <= '0';
+      if rst = '1' then
+        MEM_FIFO32_S_Rd <= '0';
+        mem_state <= M_HEADER;
+      else
+        case mem_state is
+          when M_HEADER =>
+            if MEM_FIFO32_S_Rd = '1' then
+              MEM_FIFO32_S_Rd <= '0';
+              assert MEM_FIFO32_S_Data(31) = '0' report "unexpected write request" severity error;
+              mem_words <= to_integer(unsigned(MEM_FIFO32_S_Data(23 downto 2)));
+              mem_state <= M_ADDR;
+            elsif unsigned(MEM_FIFO32_S_Fill) > 0 then
+              MEM_FIFO32_S_Rd <= '1';
+            end if;
+
+          when M_ADDR =>
+            if MEM_FIFO32_S_Rd = '1' then
+              MEM_FIFO32_S_Rd <= '0';
+              mem_addr  <= unsigned(MEM_FIFO32_S_Data);
+              mem_wait  <= C_MEM_LATENCY;
+              mem_state <= M_LATENCY;
+            elsif unsigned(MEM_FIFO32_S_Fill) > 0 then
+              MEM_FIFO32_S_Rd <= '1';
+            end if;
+
+          when M_LATENCY =>
+            if mem_wait = 0 then
+              mem_state <= M_DATA;
+            else
+              mem_wait <= mem_wait - 1;
+            end if;
+
+          when M_DATA =>
+            MEM_FIFO32_M_Wr   <= '1';
+            MEM_FIFO32_M_Data <= mem_read(mem_addr);
+            mem_addr  <= mem_addr + 4;
+            mem_words <= mem_words - 1;
+            if mem_words = 1 then
+              mem_state <= M_HEADER;
+            end if;
+        end case;
+      end if;
+    end if;
+  end process;
+
+  report_process : process is
+  begin
+    wait until hwt_state = H_DONE;
+    assert page_fault = '0' report "unexpected page fault" severity error;
+    report "PGDE cache size " & integer'image(C_PGDE_CACHE_SIZE)
+      & ", large pages " & integer'image(C_LARGE_PAGES) & ": "
+      & integer'image(C_REQUESTS) & " TLB misses, "
+      & integer'image(total / C_REQUESTS) & " cycles per miss ("
+      & integer'image(total) & " cycles total)";
+    wait;
+  end process;
+
+end architecture;
@@ -0,0 +1,144 @@
+library ieee;            --! Use the standard ieee libraries for logic
+use ieee.std_logic_1164.all;            --! For logic
+use ieee.numeric_std.all;  --! For unsigned and signed types and conversion from/to std_logic_vector
+
+library mmu_v1_00_a;
+
+--! @brief Measures the hit rate of the TLB on sequential and strided traces.
+--! @details Every access looks up a page number, and on a miss fills the TLB
+--!          the same way the MMU does after a page table walk. The data stored
+--!          for a page is its page number inverted, which is checked on every
+--!          hit. The hit rate of each trace is reported at the end.
+--!          Run e.g. with: ghdl -r tb_tlb --stop-time=10ms
+entity tb_tlb is
+  generic (
+    C_TLB_LOGSIZE : integer := 8;
+    C_TLB_LOGWAYS : integer := 2
+    );
+end entity;
+
+architecture testbench of tb_tlb is
+--------------------------------------------------------------------------------
+-- Constants
+--------------------------------------------------------------------------------
+  constant half_cycle : time := 5 ns;
+  constant full_cycle : time := 2 * half_cycle;
+
+  constant C_TLB_SIZE : integer := 2**C_TLB_LOGSIZE;
+
+  type trace_t is record
+    name   : string(1 to 16);
+    first  : natural;                   -- first page number
+    pages  : natural;                   -- number of pages touched per pass
+    stride : natural;                   -- distance between two pages
+    passes : natural;                   -- number of walks through the pages
+  end record;
+  type trace_array_t is array (natural range <>) of trace_t;
+
+  constant traces : trace_array_t := (
+    ("sequential, fits", 16#10000#, C_TLB_SIZE/2,   1,  4),
+    ("sequential, 2x  ", 16#20000#, C_TLB_SIZE*2,   1,  4),
+    ("stride 2        ", 16#30000#, C_TLB_SIZE/2,   2,  4),
+    ("stride 16       ", 16#40000#, C_TLB_SIZE/4,   16, 4),
+    ("stride 64       ", 16#50000#, C_TLB_SIZE/4,   64, 4)
+    );
+--------------------------------------------------------------------------------
+-- Signals
+--------------------------------------------------------------------------------
+  signal clk   : std_logic := '0';
+  signal rst   : std_logic;
+  signal tag   : std_logic_vector(19 downto 0);
+  signal di    : std_logic_vector(19 downto 0);
+  signal do    : std_logic_vector(19 downto 0);
+  signal we    : std_logic;
+  signal match : std_logic;
+
+  signal finished : boolean := false;
+
+begin  -- of architecture -------------------------------------------------------
+
+  tlb_i : entity mmu_v1_00_a.tlb
+    generic map (
+      C_TLB_LOGSIZE => C_TLB_LOGSIZE,
+      C_TLB_LOGWAYS => C_TLB_LOGWAYS,
+      C_TAG_SIZE    => 20,
+      C_DATA_SIZE   => 20
+      )
+    port map (
+      clk   => clk,
+      rst   => rst,
+      tag   => tag,
+      di    => di,
+      do    => do,
+      we    => we,
+      match => match
+      );
+
+  clk_process : process is
+  begin
+    while not finished loop
+      clk <= '0';
+      wait for half_cycle;
+      clk <= '1';
+      wait for half_cycle;
+    end loop;
+    wait;
+  end process;
+
+  stimulus_process : process is
+    variable page     : natural;
+    variable hits     : natural;
+    variable accesses : natural;
+  begin
+    rst <= '1';
+    we  <= '0';
+    tag <= (others => '0');
+    di  <= (others => '0');
+    wait for 4*full_cycle;
+
+    for t in traces'range loop
+      -- start every trace with an empty TLB
+      rst <= '1';
+      wait until rising_edge(clk);
+      rst <= '0';
+      wait for (C_TLB_SIZE + 2)*full_cycle;
+      wait until rising_edge(clk);
+
+      hits     := 0;
+      accesses := 0;
+      for p in 0 to traces(t).passes-1 loop
+        for i in 0 to traces(t).pages-1 loop
+          page := traces(t).first + i*traces(t).stride;
+          tag  <= std_logic_vector(to_unsigned(page, 20));
+          di   <= not std_logic_vector(to_unsigned(page, 20));
+
+          -- lookup: match and do are valid one cycle after the tag
+          wait until rising_edge(clk);
+          wait for 1 ns;
+          accesses := accesses + 1;
+          if match = '1' then
+            assert do = not std_logic_vector(to_unsigned(page, 20))
+              report "wrong translation for page " & integer'image(page)
+              severity error;
+            hits := hits + 1;
+          else
+            we <= '1';
+          end if;
+          -- hold the tag for the replacement update, like the MMU does
+          wait until rising_edge(clk);
+          we <= '0';
+        end loop;
+      end loop;
+
+      report traces(t).name & ": " & integer'image(hits) & " hits / "
+        & integer'image(accesses) & " accesses ("
+        & integer'image((hits*100)/accesses) & "%)";
+    end loop;
+
+    report "TLB with " & integer'image(C_TLB_SIZE) & " entries, "
+      & integer'image(2**C_TLB_LOGWAYS) & " ways: done";
+    finished <= true;
+    wait;
+  end process;
+
+end architecture;
@@ -1,18 +1,23 @@
 library IEEE;
 use IEEE.STD_LOGIC_1164.ALL;
+use IEEE.STD_LOGIC_ARITH.ALL;
+use IEEE.STD_LOGIC_UNSIGNED.ALL;
 
--- Uncomment the following library declaration if using
--- arithmetic functions with Signed or Unsigned values
---use IEEE.NUMERIC_STD.ALL;
-
--- Uncomment the following library declaration if instantiating
--- any Xilinx primitives in this code.
---library UNISIM;
---use UNISIM.VComponents.all;
+-- N-way set-associative TLB.
+--
+-- Every way is a block RAM indexed by the low bits of the tag, so the number
+-- of entries can grow without widening the compare logic, which only spans
+-- the ways of one set. Lookups take one clock cycle: match and do refer to the
+-- tag that was applied in the previous cycle, and the tag has to be held until
+-- then. A write fills the set of the current tag (which must have missed) with
+-- an invalid way if there is one, otherwise with the way selected by a tree
+-- pseudo-LRU. On reset, the TLB invalidates one set per cycle and reports no
+-- matches until it is done.
 
 entity tlb is
 	generic (
-		C_TLB_LOGSIZE : integer := 5;
+		C_TLB_LOGSIZE : integer := 5;   -- log2 of the number of entries
+		C_TLB_LOGWAYS : integer := 2;   -- log2 of the associativity, at most C_TLB_LOGSIZE
 		C_TAG_SIZE    : integer := 20;
 		C_DATA_SIZE   : integer := 20
 	);
@@ -29,69 +34,144 @@ end tlb;
 
 architecture Behavioral of tlb is
 
-	function or_vec(v : std_logic_vector) return std_logic is
-		variable result : std_logic;
+	constant C_WAYS        : integer := 2**C_TLB_LOGWAYS;
+	constant C_SET_LOGSIZE : integer := C_TLB_LOGSIZE - C_TLB_LOGWAYS;
+	constant C_SETS        : integer := 2**C_SET_LOGSIZE;
+	constant C_ENTRY_SIZE  : integer := 1 + C_TAG_SIZE + C_DATA_SIZE; -- valid & tag & data
+
+	type ENTRY_MEM_T is array (0 to C_SETS-1) of std_logic_vector(C_ENTRY_SIZE-1 downto 0);
+	type ENTRY_T is array (0 to C_WAYS-1) of std_logic_vector(C_ENTRY_SIZE-1 downto 0);
+
+	-- the pseudo-LRU tree of a set: node n has the children 2n and 2n+1, the
+	-- leaves C_WAYS to 2*C_WAYS-1 are the ways. Bit 0 is unused. A node bit of
+	-- '0' points to the left subtree as the next victim.
+	type PLRU_MEM_T is array (0 to C_SETS-1) of std_logic_vector(C_WAYS-1 downto 0);
+
+	function plru_victim(bits : std_logic_vector(C_WAYS-1 downto 0)) return integer is
+		variable node : integer;
 	begin
-		result := '0';
-		for i in v'high downto v'low loop
-			result := result or v(i);
+		node := 1;
+		for l in 0 to C_TLB_LOGWAYS-1 loop
+			if bits(node) = '0' then
+				node := 2*node;
+			else
+				node := 2*node + 1;
+			end if;
 		end loop;
-		return result;
+		return node - C_WAYS;
 	end;
 
-	constant C_TLB_SIZE : integer := 2**C_TLB_LOGSIZE;
-	
-	type TAG_T is array (0 to C_TLB_SIZE-1) of std_logic_vector(C_TAG_SIZE-1 downto 0);
-	type DATA_T is array (0 to C_TLB_SIZE-1) of std_logic_vector(C_DATA_SIZE-1 downto 0);
-
-	function or_data(d : DATA_T; m : std_logic_vector(C_TLB_SIZE-1 downto 0)) return std_logic_vector is
-		variable result : std_logic_vector(C_DATA_SIZE-1 downto 0);
-		variable tmp : std_logic_Vector(C_DATA_SIZE-1 downto 0);
+	function plru_touch(bits : std_logic_vector(C_WAYS-1 downto 0); way : integer) return std_logic_vector is
+		variable result : std_logic_vector(C_WAYS-1 downto 0);
+		variable node   : integer;
 	begin
-		result := (others => '0');
-		for i in 0 to C_TLB_SIZE-1 loop
-			tmp := (others => m(i));
-			result := result or (tmp and d(i));
+		result := bits;
+		node := way + C_WAYS;
+		for l in 0 to C_TLB_LOGWAYS-1 loop
+			-- let the parent point away from the way just used
+			if node mod 2 = 0 then
+				result(node/2) := '1';
+			else
+				result(node/2) := '0';
+			end if;
+			node := node/2;
 		end loop;
 		return result;
 	end;
-	
-	signal tag_mem  : TAG_T;
-	signal data_mem : DATA_T;
-	signal valid : std_logic_vector(C_TLB_SIZE-1 downto 0);
-	signal single_match : std_logic_vector(C_TLB_SIZE-1 downto 0);
-	signal multi_match  : std_logic_Vector(C_TLB_SIZE-1 downto 0);
-	signal wptr : integer range 0 to C_TLB_SIZE;
+
+	function set_of(t : std_logic_vector(C_TAG_SIZE-1 downto 0)) return integer is
+	begin
+		if C_SET_LOGSIZE = 0 then
+			return 0;
+		end if;
+		return conv_integer(t(C_SET_LOGSIZE-1 downto 0));
+	end;
+
+	signal entry       : ENTRY_T;  -- the ways of the set looked up in the last cycle
+	signal way_match   : std_logic_vector(C_WAYS-1 downto 0);
+	signal way_valid   : std_logic_vector(C_WAYS-1 downto 0);
+	signal plru_mem    : PLRU_MEM_T;
+	signal set_index   : integer range 0 to C_SETS-1;
+	signal flush_index : integer range 0 to C_SETS-1;
+	signal flushing    : std_logic;
+	signal hit         : std_logic;
+	signal hit_way     : integer range 0 to C_WAYS-1;
+	signal victim      : integer range 0 to C_WAYS-1;
 begin
 
-	write_proc : process(clk,rst,we) is
+	set_index <= set_of(tag);
+
+	-- one block RAM per way
+	way_gen : for w in 0 to C_WAYS-1 generate
+		signal mem : ENTRY_MEM_T;
+	begin
+		way_proc : process(clk) is
+		begin
+			if rising_edge(clk) then
+				if flushing = '1' then
+					mem(flush_index) <= (others => '0');
+				elsif we = '1' and victim = w then
+					mem(set_index) <= '1' & tag & di;
+				end if;
+				entry(w) <= mem(set_index);
+			end if;
+		end process;
+
+		way_valid(w) <= entry(w)(C_ENTRY_SIZE-1);
+		way_match(w) <= way_valid(w) when entry(w)(C_ENTRY_SIZE-2 downto C_DATA_SIZE) = tag else '0';
+	end generate;
+
+	hit_proc : process(way_match, way_valid, entry, plru_mem, set_index) is
+		variable h : std_logic;
+		variable w : integer range 0 to C_WAYS-1;
+		variable v : integer range 0 to C_WAYS-1;
+		variable d : std_logic_vector(C_DATA_SIZE-1 downto 0);
+	begin
+		h := '0';
+		w := 0;
+		d := (others => '0');
+		for i in 0 to C_WAYS-1 loop
+			if way_match(i) = '1' then
+				h := '1';
+				w := i;
+				d := entry(i)(C_DATA_SIZE-1 downto 0);
+			end if;
+		end loop;
+
+		v := plru_victim(plru_mem(set_index));
+		for i in C_WAYS-1 downto 0 loop
+			if way_valid(i) = '0' then
+				v := i;
+			end if;
+		end loop;
+
+		hit     <= h;
+		hit_way <= w;
+		do      <= d;
+		victim  <= v;
+	end process;
+
+	match <= hit and not flushing;
+
+	plru_proc : process(clk) is
 	begin
-		if rst = '1' then
-			valid <= (others => '0');
-		elsif rising_edge(clk) then
-			if we = '1' then
-				tag_mem(wptr)   <= tag;
-				data_mem(wptr)  <= di;
-				valid(wptr) <= '1';
-				if wptr = C_TLB_SIZE-1 then
-					wptr <= 0;
+		if rising_edge(clk) then
+			if rst = '1' then
+				flushing    <= '1';
+				flush_index <= 0;
+			elsif flushing = '1' then
+				plru_mem(flush_index) <= (others => '0');
+				if flush_index = C_SETS-1 then
+					flushing <= '0';
 				else
-					wptr <= wptr + 1;
+					flush_index <= flush_index + 1;
 				end if;
+			elsif we = '1' then
+				plru_mem(set_index) <= plru_touch(plru_mem(set_index),victim);
+			elsif hit = '1' then
+				plru_mem(set_index) <= plru_touch(plru_mem(set_index),hit_way);
 			end if;
 		end if;
 	end process;
-	
-	
-	-- asynchronous read logic
-	
-	mm_gen : for i in 0 to C_TLB_SIZE-1 generate
-		multi_match(i) <= valid(i) when tag_mem(i) = tag else '0';
-	end generate;
-	single_match <= multi_match; -- TODO: actually implement this
-	do <= or_data(data_mem,single_match);
-	match <= or_vec(multi_match);
-	
 
 end Behavioral;
-
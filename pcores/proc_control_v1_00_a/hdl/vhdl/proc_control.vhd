@@ -8,7 +8,9 @@ use reconos_v3_00_a.reconos_pkg.all;
 
 entity proc_control is
 	generic (
-		C_ENABLE_ILA : integer := 0
+		C_ENABLE_ILA : integer := 0;
+		C_FAULT_SLOT : integer := 1  -- 1 if fault_slot is connected to the mmu, whose SLOT is connected to the arbiter.
+		                             -- With 0, libreconos cannot quarantine a slot and exits on an invalid page fault.
 	);
 	port (
 		clk : in std_logic;
@@ -64,10 +66,22 @@ entity proc_control is
 		-- MMU related ports
 		page_fault     : in std_logic;
 		fault_addr     : in std_logic_vector(31 downto 0);
+		fault_slot     : in std_logic_vector(3 downto 0);
 		retry          : out std_logic;
+		abort          : out std_logic;
 		pgd            : out std_logic_vector(31 downto 0);
 		tlb_hits       : in std_logic_vector(31 downto 0);
 		tlb_misses     : in std_logic_vector(31 downto 0);
+		stats_slot     : out std_logic_vector(3 downto 0);
+		stats_sel      : out std_logic_vector(2 downto 0);
+		stats_clear    : out std_logic;
+		stats_data     : in std_logic_vector(31 downto 0);
+
+		-- Memory arbiter configuration
+		arb_port       : out std_logic_vector(3 downto 0);
+		arb_config     : out std_logic_vector(31 downto 0);
+		arb_we         : out std_logic;
+		arb_active     : in std_logic;  -- '1' if the arbiter takes the configuration
 
 		-- ReconOS reset
 		reconos_reset  : out std_logic
@@ -81,12 +95,17 @@ architecture implementation of proc_control is
 	constant C_RECONOS_RESET  : std_logic_vector(7 downto 0) := x"04";
 	constant C_GET_TLB_STATS  : std_logic_vector(7 downto 0) := x"05";
 	constant C_SELFTEST       : std_logic_vector(7 downto 0) := x"06";
+	constant C_GET_SLOT_STATS : std_logic_vector(7 downto 0) := x"07"; -- slot in bits 3..0, clear after read in bit 8
+	constant C_SET_ARBITER    : std_logic_vector(7 downto 0) := x"08"; -- port in bits 3..0, followed by the config word,
+	                                                                     -- answered with 1 if the arbiter took it, else 0
 
-	constant C_RETURN_ADDR       : std_logic_vector(31 downto 0) := x"00000001";
+	constant C_RETURN_ADDR       : std_logic_vector(31 downto 0) := x"00000001"; -- slot in bits 11..8 if bit 12 is set
 	constant C_RETURN_SELFTEST   : std_logic_Vector(31 downto 0) := x"00000002";
+
+	constant C_SLOT_STATS_LAST   : std_logic_vector(2 downto 0) := "100"; -- number of per slot counters - 1
 	
 	type ASTATE_TYPE is (A_WAIT, A_SELFTEST, A_PAGE_FAULT_0, A_PAGE_FAULT_1, A_WAIT_PAGE_READY_0, A_WAIT_PAGE_READY_1);
-	type BSTATE_TYPE is (B_WAIT, B_BRANCH, B_SELFTEST, B_SELFTEST_REQ, B_RESET, B_TLB_HITS, B_TLB_MISSES, B_PGD, B_RECONOS_RESET);
+	type BSTATE_TYPE is (B_WAIT, B_BRANCH, B_SELFTEST, B_SELFTEST_REQ, B_RESET, B_TLB_HITS, B_TLB_MISSES, B_PGD, B_RECONOS_RESET, B_SLOT_STATS, B_SLOT_STATS_CLEAR, B_ARBITER, B_ARBITER_WE, B_ARBITER_STATUS);
 
 	
 	constant C_ILA_WIDTH : integer := 200;
@@ -113,8 +132,10 @@ architecture implementation of proc_control is
 	signal hwt_reset : std_logic_vector(15 downto 0);
 	signal reset_counter : std_logic_vector(11 downto 0);
 	signal reconos_reset_dup : std_logic;
+	signal stats_sel_dup : std_logic_vector(2 downto 0);
 	signal data   : std_logic_Vector(C_FSL_WIDTH-1 downto 0);
-	signal ignore : std_logic_Vector(C_FSL_WIDTH-1 downto 0);
+	signal page_reply : std_logic_Vector(C_FSL_WIDTH-1 downto 0); -- bit 0 aborts the faulting request
+	signal fault_cmd  : std_logic_vector(31 downto 0);
 	signal selftest_initiate_req  : std_logic;
 	signal selftest_req_initiated : std_logic;
 	signal astate  : ASTATE_TYPE;
@@ -161,6 +182,11 @@ begin
 	CSDATA(22) <= '1' when bstate = B_TLB_MISSES else '0';
 	CSDATA(23) <= '1' when bstate = B_PGD else '0';
 	CSDATA(24) <= '1' when bstate = B_RECONOS_RESET else '0';
+	CSDATA(25) <= '1' when bstate = B_SLOT_STATS else '0';
+	CSDATA(26) <= '1' when bstate = B_SLOT_STATS_CLEAR else '0';
+	CSDATA(27) <= '1' when bstate = B_ARBITER else '0';
+	CSDATA(28) <= '1' when bstate = B_ARBITER_WE else '0';
+	CSDATA(29) <= '1' when bstate = B_ARBITER_STATUS else '0';
 	
 	CSDATA(63 downto 32) <= FSLA_S_Data;
 	CSDATA(64) <= Rst;
@@ -172,7 +198,7 @@ begin
 	CSDATA(101) <= FSLB_M_Full;
 	
 	CSDATA(133 downto 102) <= data;
-	CSDATA(165 downto 134) <= ignore;
+	CSDATA(165 downto 134) <= page_reply;
 	CSDATA(181 downto 166) <= hwt_reset;
 	CSDATA(193 downto 182) <= reset_counter;
 	CSDATA(194) <= page_fault;
@@ -223,6 +249,19 @@ begin
 
 	reconos_reset <= reconos_reset_dup;
 
+	stats_slot  <= data(3 downto 0);
+	stats_sel   <= stats_sel_dup;
+	stats_clear <= '1' when bstate = B_SLOT_STATS_CLEAR else '0';
+
+	arb_port <= data(3 downto 0);
+	arb_we   <= '1' when bstate = B_ARBITER_WE else '0';
+
+	-- the software quarantines the faulting slot only if it knows the slot
+	fault_cmd <= x"0000" & "0001" & fault_slot & C_RETURN_ADDR(7 downto 0) when C_FAULT_SLOT = 1 else C_RETURN_ADDR;
+
+	-- valid together with retry
+	abort <= page_reply(0) when astate = A_WAIT_PAGE_READY_1 else '0';
+
 	reset0 <= hwt_reset( 0); reset1 <= hwt_reset( 1); reset2 <= hwt_reset( 2); reset3 <= hwt_reset(3);
 	reset4 <= hwt_reset( 4); reset5 <= hwt_reset( 5); reset6 <= hwt_reset( 6); reset7 <= hwt_reset(7);
 	reset8 <= hwt_reset( 8); reset9 <= hwt_reset( 9); resetA <= hwt_reset(10); resetB <= hwt_reset(11);
@@ -235,7 +274,7 @@ begin
 		if rst = '1' or reconos_reset_dup = '1' then
 			fsl_reset(o_fsla);
 			astate <= A_WAIT;
-			ignore <= (others => '0');
+			page_reply <= (others => '0');
 			done := False;
 			retry <= '0';
 			selftest_req_initiated <= '0';
@@ -255,7 +294,7 @@ begin
 					if done then astate <= A_WAIT; end if;
 				
 				when A_PAGE_FAULT_0 =>
-					fsl_write_word(i_fsla,o_fsla,C_RETURN_ADDR,done);
+					fsl_write_word(i_fsla,o_fsla,fault_cmd,done);
 					if done then astate <= A_PAGE_FAULT_1; end if;
 				
 				when A_PAGE_FAULT_1 =>
@@ -263,7 +302,7 @@ begin
 					if done then astate <= A_WAIT_PAGE_READY_0; end if;
 					
 				when A_WAIT_PAGE_READY_0 =>
-					fsl_read_word(i_fsla,o_fsla,ignore,done);
+					fsl_read_word(i_fsla,o_fsla,page_reply,done);
 					if done then
 						retry <= '1';
 						astate <= A_WAIT_PAGE_READY_1;
@@ -291,7 +330,9 @@ begin
 			pgd <= (others => '0');
 			reset_counter <= (others => '0');
 			reconos_reset_dup <= '1';
-			selftest_initiate_req <= '0'; 
+			selftest_initiate_req <= '0';
+			stats_sel_dup <= (others => '0');
+			arb_config <= (others => '0');
 		elsif rising_edge(i_fslb.clk) then
 			reconos_reset_dup <= '0';
 			case bstate is
@@ -311,6 +352,11 @@ begin
 							bstate <= B_TLB_HITS;
 						when C_SELFTEST =>
 							bstate <= B_SELFTEST;
+						when C_GET_SLOT_STATS =>
+							stats_sel_dup <= (others => '0');
+							bstate <= B_SLOT_STATS;
+						when C_SET_ARBITER =>
+							bstate <= B_ARBITER;
 						when others =>
 							bstate <= B_WAIT; -- ignore everything else
 					end case;
@@ -342,6 +388,35 @@ begin
 					fsl_write_word(i_fslb,o_fslb,tlb_misses,done);
 					if done then bstate <= B_WAIT; end if;
 
+				when B_SLOT_STATS =>
+					fsl_write_word(i_fslb,o_fslb,stats_data,done);
+					if done then
+						if stats_sel_dup /= C_SLOT_STATS_LAST then
+							stats_sel_dup <= stats_sel_dup + 1;
+						elsif data(8) = '1' then
+							bstate <= B_SLOT_STATS_CLEAR;
+						else
+							bstate <= B_WAIT;
+						end if;
+					end if;
+
+				when B_SLOT_STATS_CLEAR =>
+					-- stats_clear is asserted for this cycle
+					bstate <= B_WAIT;
+
+				when B_ARBITER =>
+					fsl_read_word(i_fslb,o_fslb,arb_config,done);
+					if done then bstate <= B_ARBITER_WE; end if;
+
+				when B_ARBITER_WE =>
+					-- arb_we is asserted for this cycle
+					bstate <= B_ARBITER_STATUS;
+
+				when B_ARBITER_STATUS =>
+					-- a round robin arbiter, or none at all, ignores the write
+					fsl_write_word(i_fslb,o_fslb,x"0000000" & "000" & arb_active,done);
+					if done then bstate <= B_WAIT; end if;
+
 				when B_RECONOS_RESET =>
 					data <= (others => '0');
 					done := False;
@@ -67,6 +67,8 @@ package reconos_pkg is
 	-- common constants
 	constant C_RECONOS_FAILURE : std_logic_vector(0 to C_FSL_WIDTH-1) := X"00000000";
 	constant C_RECONOS_SUCCESS : std_logic_vector(0 to C_FSL_WIDTH-1) := X"00000001";
+	-- reply to a rejected OS call; the slot is held in reset right after it
+	constant C_RECONOS_ERROR   : std_logic_vector(0 to C_FSL_WIDTH-1) := X"FFFFFFFF";
 	
 	---------------------------------------------------
 	-- task2os commands
@@ -88,12 +90,32 @@ package reconos_pkg is
 	
 	constant OSIF_CMD_MBOX_PUT : std_logic_vector(0 to C_FSL_WIDTH-1) := X"000000F1";
 	constant OSIF_CMD_MBOX_GET : std_logic_vector(0 to C_FSL_WIDTH-1) := X"000000F0";
+	constant OSIF_CMD_MBOX_TRYGET : std_logic_vector(0 to C_FSL_WIDTH-1) := X"000000F2";
+	constant OSIF_CMD_MBOX_TRYPUT : std_logic_vector(0 to C_FSL_WIDTH-1) := X"000000F3";
 
 	constant OSIF_CMD_THREAD_GET_INIT_DATA : std_logic_vector(0 to C_FSL_WIDTH-1) := X"000000A0";
+	constant OSIF_CMD_THREAD_DELAY         : std_logic_vector(0 to C_FSL_WIDTH-1) := X"000000A1";
 	constant OSIF_CMD_THREAD_EXIT          : std_logic_vector(0 to C_FSL_WIDTH-1) := X"000000A2";	
+	constant OSIF_CMD_THREAD_YIELD         : std_logic_vector(0 to C_FSL_WIDTH-1) := X"000000A3";
+	constant OSIF_CMD_THREAD_RESUME        : std_logic_vector(0 to C_FSL_WIDTH-1) := X"000000A4";
+	constant OSIF_CMD_THREAD_LOAD_STATE    : std_logic_vector(0 to C_FSL_WIDTH-1) := X"000000A5";
+	constant OSIF_CMD_THREAD_STORE_STATE   : std_logic_vector(0 to C_FSL_WIDTH-1) := X"000000A6";
 	
 	constant MEMIF_CMD_READ    : std_logic_vector(7 downto 0) := X"00";
 	constant MEMIF_CMD_WRITE   : std_logic_vector(7 downto 0) := X"80";
+
+	-- block requests to keep in flight when memif_read is pipelined, see memif_read
+	constant C_MEMIF_MAX_OUTSTANDING : natural := 4;
+
+	-- Number of data words of a request of len bytes at addr on a memory path
+	-- whose words are dwidth (32, 64 or 128) bits wide. Wide words are aligned
+	-- to their size in memory, so an unaligned request covers a partial word at
+	-- either end. For dwidth = 32 this is len/4. See fifo32_width_adapter.
+	function memif_beats (
+		addr   : std_logic_vector(31 downto 0);
+		len    : std_logic_vector(23 downto 0);
+		dwidth : integer
+	) return std_logic_vector;
 	
 	-- generic OSIF (and FSL) interface procedures and functions
 	
@@ -123,6 +145,7 @@ package reconos_pkg is
 		s_data : std_logic_vector(31 downto 0);
 		s_fill : std_logic_vector(15 downto 0);
 		m_remainder : std_logic_vector(15 downto 0);
+		s_reading : std_logic; -- s_data is read in this cycle
 		step : integer range 0 to 15;
 	end record;
 	
@@ -139,6 +162,7 @@ package reconos_pkg is
 		remainder : std_logic_vector(23 downto 0);
 		count : integer range 0 to C_BLOCK_SIZE;
 		remote_addr : std_logic_vector(29 downto 0);
+		pending : std_logic_vector(23 downto 0);
 	end record;
 	
 	type o_ram_t is record
@@ -148,6 +172,7 @@ package reconos_pkg is
 		remainder : std_logic_vector(23 downto 0);
 		count : integer range 0 to C_BLOCK_SIZE;
 		remote_addr : std_logic_vector(29 downto 0);
+		pending : std_logic_vector(23 downto 0); -- words requested by memif_read but not yet received
 	end record;
 	
 	-- set up OSIF interface. must be called in architecture body.
@@ -338,6 +363,28 @@ package reconos_pkg is
 		signal result : out std_logic_vector(C_FSL_WIDTH-1 downto 0);
 		variable done : out boolean
 	);
+	
+	-- put word into mbox without blocking. result is C_RECONOS_SUCCESS if
+	-- the word was stored, C_RECONOS_FAILURE if the mbox was full
+	procedure osif_mbox_tryput (
+		signal i_osif : in  i_osif_t;
+		signal o_osif : out o_osif_t;
+		handle        : in  std_logic_vector(C_FSL_WIDTH-1 downto 0);
+		word          : in  std_logic_vector(C_FSL_WIDTH-1 downto 0);
+		signal result : out std_logic_vector(C_FSL_WIDTH-1 downto 0);
+		variable done : out boolean
+	);
+	
+	-- read word from mbox without blocking. success is C_RECONOS_SUCCESS if
+	-- a word was read into result, C_RECONOS_FAILURE if the mbox was empty
+	procedure osif_mbox_tryget (
+		signal i_osif  : in  i_osif_t;
+		signal o_osif  : out o_osif_t;
+		handle         : in  std_logic_vector(C_FSL_WIDTH-1 downto 0);
+		signal result  : out std_logic_vector(C_FSL_WIDTH-1 downto 0);
+		signal success : out std_logic_vector(C_FSL_WIDTH-1 downto 0);
+		variable done  : out boolean
+	);
 
 	-- receive message from ReconOS message queue and store it into local memory
 	procedure osif_rq_receive (
@@ -379,6 +426,69 @@ package reconos_pkg is
 		signal o_osif : out o_osif_t
 	);
 	
+	-- thread_delay: returns after at least 'delay' microseconds. Nothing is
+	-- computed by the operating system meanwhile, so waiting costs nothing.
+	procedure osif_thread_delay (
+		signal i_osif : in  i_osif_t;
+		signal o_osif : out o_osif_t;
+		delay         : in  std_logic_vector(C_FSL_WIDTH-1 downto 0);
+		signal result : out std_logic_vector(C_FSL_WIDTH-1 downto 0);
+		variable done : out boolean
+	);
+	
+	-- thread_yield: offers the slot to another thread using the same bitstream.
+	-- result is C_RECONOS_FAILURE if the thread keeps the slot. If it is
+	-- C_RECONOS_SUCCESS, the slot has been handed over and the next call must
+	-- be osif_thread_resume.
+	procedure osif_thread_yield (
+		signal i_osif : in  i_osif_t;
+		signal o_osif : out o_osif_t;
+		signal result : out std_logic_vector(C_FSL_WIDTH-1 downto 0);
+		variable done : out boolean
+	);
+	
+	-- thread_resume: result is the init data of the thread the slot runs from
+	-- now on. Its context has to be restored from there.
+	procedure osif_thread_resume (
+		signal i_osif : in  i_osif_t;
+		signal o_osif : out o_osif_t;
+		signal result : out std_logic_vector(C_FSL_WIDTH-1 downto 0);
+		variable done : out boolean
+	);
+	
+	-- Saving and restoring the state of a thread, e.g. around osif_thread_yield:
+	-- osif_thread_store_state returns the address of a buffer of 'size' bytes
+	-- that libreconos keeps for the thread (0 if there is none). The state is
+	-- then written to it with memif_write, and the transfer is concluded with
+	-- osif_thread_state_done, passing the number of bytes written. Likewise,
+	-- osif_thread_load_state returns the address of the state saved last
+	-- (0 if the thread has not saved a state of 'size' bytes), which is read
+	-- with memif_read and concluded with osif_thread_state_done. No call to
+	-- osif_thread_state_done follows if the address is 0.
+	procedure osif_thread_store_state (
+		signal i_osif : in  i_osif_t;
+		signal o_osif : out o_osif_t;
+		size          : in  std_logic_vector(C_FSL_WIDTH-1 downto 0);
+		signal result : out std_logic_vector(C_FSL_WIDTH-1 downto 0);
+		variable done : out boolean
+	);
+	
+	procedure osif_thread_load_state (
+		signal i_osif : in  i_osif_t;
+		signal o_osif : out o_osif_t;
+		size          : in  std_logic_vector(C_FSL_WIDTH-1 downto 0);
+		signal result : out std_logic_vector(C_FSL_WIDTH-1 downto 0);
+		variable done : out boolean
+	);
+	
+	procedure osif_thread_state_done (
+		signal i_osif : in  i_osif_t;
+		signal o_osif : out o_osif_t;
+		size          : in  std_logic_vector(C_FSL_WIDTH-1 downto 0);
+		signal result : out std_logic_vector(C_FSL_WIDTH-1 downto 0);
+		variable done : out boolean
+	);
+	
 	-- see fsl_reset()
 	procedure osif_reset(
 		signal o_osif : out o_osif_t
@@ -485,7 +595,13 @@ package reconos_pkg is
 		variable done : out boolean  
 	);	
 	
-	-- local ram: read from main memory to local memory
+	-- local ram: read from main memory to local memory. By default, each block
+	-- is requested once the previous one has been received. With 'outstanding'
+	-- > 1, e.g. C_MEMIF_MAX_OUTSTANDING, up to that many blocks are requested
+	-- ahead of the data being received, so that the memory latency is paid
+	-- once and not per block. Requests carry no tag: the memory path
+	-- completes them strictly in request order, and the data is stored in
+	-- the order it arrives.
 	procedure memif_read(
 		signal i_ram   : in  i_ram_t;
 		signal o_ram   : out o_ram_t;
@@ -494,12 +610,27 @@ package reconos_pkg is
 		src_addr : in std_logic_vector(31 downto 0);
 		dst_addr : in std_logic_vector(31 downto 0);
 		len      : in std_logic_vector(23 downto 0);
-		variable done     : out boolean  
+		variable done     : out boolean;
+		outstanding : in integer := 1
 	);	
 
 end reconos_pkg;
 
 package body reconos_pkg is
+
+	function memif_beats (
+		addr   : std_logic_vector(31 downto 0);
+		len    : std_logic_vector(23 downto 0);
+		dwidth : integer
+	) return std_logic_vector is
+		variable offset : integer;
+	begin
+		if len = 0 then
+			return CONV_STD_LOGIC_VECTOR(0,24);
+		end if;
+		offset := CONV_INTEGER(addr(6 downto 0)) mod (dwidth/8);
+		return CONV_STD_LOGIC_VECTOR((offset + CONV_INTEGER(len) + dwidth/8 - 1)/(dwidth/8),24);
+	end function;
 	
 	procedure osif_setup (
 		signal i_osif : out  i_osif_t;
@@ -838,6 +969,45 @@ package body reconos_pkg is
 	) is begin
 		osif_call_1(i_osif, o_osif,OSIF_CMD_MBOX_GET,handle,result,done);
 	end procedure;
+	
+	procedure osif_mbox_tryput (
+		signal i_osif : in  i_osif_t;
+		signal o_osif : out o_osif_t;
+		handle        : in  std_logic_vector(C_FSL_WIDTH-1 downto 0);
+		word          : in  std_logic_vector(C_FSL_WIDTH-1 downto 0);
+		signal result : out std_logic_vector(C_FSL_WIDTH-1 downto 0);
+		variable done : out boolean
+	) is begin
+		osif_call_2(i_osif, o_osif,OSIF_CMD_MBOX_TRYPUT,handle,word,result,done);
+	end procedure;
+	
+	procedure osif_mbox_tryget (
+		signal i_osif  : in  i_osif_t;
+		signal o_osif  : out o_osif_t;
+		handle         : in  std_logic_vector(C_FSL_WIDTH-1 downto 0);
+		signal result  : out std_logic_vector(C_FSL_WIDTH-1 downto 0);
+		signal success : out std_logic_vector(C_FSL_WIDTH-1 downto 0);
+		variable done  : out boolean
+	) is begin
+		done := False;
+		fsl_default(o_osif);
+		case i_osif.step is
+			when 0 =>
+				fsl_push(i_osif,o_osif,OSIF_CMD_MBOX_TRYGET,0,1);
+			when 1 =>
+				fsl_push(i_osif,o_osif,handle,0,2);
+			when 2 =>
+				fsl_push_finish(i_osif,o_osif,3);
+			when 3 =>
+				-- status word, always followed by a data word
+				fsl_pull(i_osif,o_osif,success,4,False);
+			when 4 =>
+				fsl_pull(i_osif,o_osif,result,5,False);
+			when others =>
+				done := True;
+				o_osif.step <= 0;
+		end case;
+	end procedure;
 
 
 	-- receive message from ReconOS message queue and store it into local memory
@@ -977,6 +1147,71 @@ package body reconos_pkg is
 		end case;
 	end procedure;
 	
+	-- thread_delay
+	procedure osif_thread_delay (
+		signal i_osif : in  i_osif_t;
+		signal o_osif : out o_osif_t;
+		delay         : in  std_logic_vector(C_FSL_WIDTH-1 downto 0);
+		signal result : out std_logic_vector(C_FSL_WIDTH-1 downto 0);
+		variable done : out boolean
+	) is begin
+		osif_call_1(i_osif, o_osif,OSIF_CMD_THREAD_DELAY,delay,result,done);
+	end procedure;
+	
+	-- thread_yield
+	procedure osif_thread_yield (
+		signal i_osif : in  i_osif_t;
+		signal o_osif : out o_osif_t;
+		signal result : out std_logic_vector(C_FSL_WIDTH-1 downto 0);
+		variable done : out boolean
+	) is begin
+		osif_call_0(i_osif, o_osif,OSIF_CMD_THREAD_YIELD,result,done);
+	end procedure;
+	
+	-- thread_resume
+	procedure osif_thread_resume (
+		signal i_osif : in  i_osif_t;
+		signal o_osif : out o_osif_t;
+		signal result : out std_logic_vector(C_FSL_WIDTH-1 downto 0);
+		variable done : out boolean
+	) is begin
+		osif_call_0(i_osif, o_osif,OSIF_CMD_THREAD_RESUME,result,done);
+	end procedure;
+	
+	-- thread_store_state
+	procedure osif_thread_store_state (
+		signal i_osif : in  i_osif_t;
+		signal o_osif : out o_osif_t;
+		size          : in  std_logic_vector(C_FSL_WIDTH-1 downto 0);
+		signal result : out std_logic_vector(C_FSL_WIDTH-1 downto 0);
+		variable done : out boolean
+	) is begin
+		osif_call_1(i_osif, o_osif,OSIF_CMD_THREAD_STORE_STATE,size,result,done);
+	end procedure;
+	
+	-- thread_load_state
+	procedure osif_thread_load_state (
+		signal i_osif : in  i_osif_t;
+		signal o_osif : out o_osif_t;
+		size          : in  std_logic_vector(C_FSL_WIDTH-1 downto 0);
+		signal result : out std_logic_vector(C_FSL_WIDTH-1 downto 0);
+		variable done : out boolean
+	) is begin
+		osif_call_1(i_osif, o_osif,OSIF_CMD_THREAD_LOAD_STATE,size,result,done);
+	end procedure;
+	
+	-- thread_state_done: the byte count is the only word of this call,
+	-- the result is C_RECONOS_SUCCESS
+	procedure osif_thread_state_done (
+		signal i_osif : in  i_osif_t;
+		signal o_osif : out o_osif_t;
+		size          : in  std_logic_vector(C_FSL_WIDTH-1 downto 0);
+		signal result : out std_logic_vector(C_FSL_WIDTH-1 downto 0);
+		variable done : out boolean
+	) is begin
+		osif_call_0(i_osif, o_osif,size,result,done);
+	end procedure;
+	
 	procedure memif_setup (
 		signal i_memif : out i_memif_t;
 		signal o_memif : in  o_memif_t;
@@ -1002,6 +1237,8 @@ package body reconos_pkg is
 		i_memif.m_remainder <= m_remainder;
 		m_wr <= o_memif.m_wr;
 		
+		i_memif.s_reading <= o_memif.s_rd;
+		
 		i_memif.step <= o_memif.step;
 	end procedure;
 	
@@ -1255,6 +1492,7 @@ package body reconos_pkg is
 		i_ram.remainder <= o_ram.remainder;
 		i_ram.count <= o_ram.count;
 		i_ram.remote_addr <= o_ram.remote_addr;
+		i_ram.pending <= o_ram.pending;
 	end procedure;
 	
 	procedure ram_reset(
@@ -1264,6 +1502,7 @@ package body reconos_pkg is
 		o_ram.addr      <= (others=>'0');
 		o_ram.data      <= (others=>'0');
 		o_ram.remainder <= (others=>'0');
+		o_ram.pending   <= (others=>'0');
 	end procedure;
 	
 	-- local ram: write from local memory to main memory
@@ -1337,8 +1576,9 @@ package body reconos_pkg is
 		end case;
 	end procedure;	
 	
-	-- local ram: read from main memory to local memory
-	procedure memif_read(
+	-- one block at a time: all data of a block is received before the next
+	-- block is requested
+	procedure memif_read_serial(
 		signal i_ram   : in  i_ram_t;
 		signal o_ram   : out o_ram_t;
 		signal i_memif : in  i_memif_t;
@@ -1423,5 +1663,111 @@ package body reconos_pkg is
 				o_memif.step <= 0;
 		end case;
 	end procedure;
+
+	-- up to 'outstanding' blocks in flight: the data is stored as it arrives
+	-- while further blocks are requested
+	procedure memif_read_pipelined(
+		signal i_ram   : in  i_ram_t;
+		signal o_ram   : out o_ram_t;
+		signal i_memif : in  i_memif_t;
+		signal o_memif : out o_memif_t;
+		src_addr : in std_logic_vector(31 downto 0);
+		dst_addr : in std_logic_vector(31 downto 0);
+		len      : in std_logic_vector(23 downto 0);
+		variable done     : out boolean;
+		outstanding : in integer
+	) is
+		variable count : integer range 0 to C_BLOCK_SIZE;
+	begin
+		o_ram.we     <= '0';
+		o_memif.m_wr <= '0';
+		o_memif.s_rd <= '0';
+		done         := False;
+
+		if i_ram.remainder > C_BLOCK_SIZE then
+			count := C_BLOCK_SIZE;
+		else
+			count := CONV_INTEGER(i_ram.remainder);
+		end if;
+
+		-- requests: remainder counts the words not yet requested
+		case i_memif.step is
+
+			when 0 =>
+				o_ram.remainder <= "00" & len(23 downto 2);
+				o_ram.pending <= "00" & len(23 downto 2);
+				o_ram.addr <= dst_addr - 1; -- incremented before every write
+				o_ram.remote_addr <= src_addr(31 downto 2);
+				o_memif.step <= 1;
+
+			-- divide into blocks, issue the next one if not too many are in flight
+			when 1 =>
+				o_ram.count <= count;
+				if i_ram.remainder = 0 then
+					o_memif.step <= 4;
+				elsif i_memif.m_remainder > 1 and
+				      i_ram.pending - i_ram.remainder + count <= outstanding*C_BLOCK_SIZE then
+					o_memif.step <= 2;
+				end if;
+
+			-- write header
+			when 2 =>
+				o_memif.m_wr <= '1';
+				o_memif.m_data <= MEMIF_CMD_READ & CONV_STD_LOGIC_VECTOR(i_ram.count,22) & "00";
+				o_memif.step <= 3;
+			when 3 =>
+				o_memif.m_wr      <= '1';
+				o_memif.m_data    <= i_ram.remote_addr & "00";
+				o_ram.remote_addr <= i_ram.remote_addr + i_ram.count;
+				o_ram.remainder   <= i_ram.remainder - i_ram.count;
+				o_memif.step <= 1;
+
+			-- all blocks requested, wait for the remaining data
+			when 4 =>
+				if i_ram.pending = 0 then
+					o_memif.step <= 15;
+				end if;
+
+			when others =>
+				done := True;
+				o_memif.step <= 0;
+		end case;
+
+		-- data: pending counts the words not yet received. Replies arrive in
+		-- request order and are stored into the local memory one word per
+		-- cycle, independently of issuing further requests.
+		if i_memif.step /= 0 and i_memif.step /= 15 then
+			if i_memif.s_reading = '1' then
+				o_ram.we      <= '1';
+				o_ram.data    <= i_memif.s_data;
+				o_ram.addr    <= i_ram.addr + 1;
+				o_ram.pending <= i_ram.pending - 1;
+				if i_memif.s_fill > 1 and i_ram.pending > 1 then
+					o_memif.s_rd <= '1';
+				end if;
+			elsif i_memif.s_fill > 0 and i_ram.pending > 0 then
+				o_memif.s_rd <= '1';
+			end if;
+		end if;
+	end procedure;
+
+	-- local ram: read from main memory to local memory
+	procedure memif_read(
+		signal i_ram   : in  i_ram_t;
+		signal o_ram   : out o_ram_t;
+		signal i_memif : in  i_memif_t;
+		signal o_memif : out o_memif_t;
+		src_addr : in std_logic_vector(31 downto 0);
+		dst_addr : in std_logic_vector(31 downto 0);
+		len      : in std_logic_vector(23 downto 0);
+		variable done     : out boolean;
+		outstanding : in integer := 1
+	) is begin
+		if outstanding > 1 then
+			memif_read_pipelined(i_ram,o_ram,i_memif,o_memif,src_addr,dst_addr,len,done,outstanding);
+		else
+			memif_read_serial(i_ram,o_ram,i_memif,o_memif,src_addr,dst_addr,len,done);
+		end if;
+	end procedure;
 	
 end reconos_pkg;
@@ -33,7 +33,7 @@ entity user_logic is
 	(
 		C_ENABLE_ILA                   : integer              := 0;
 		C_MST_AWIDTH                   : integer              := 32;-- Master interface address bus width
-		C_MST_DWIDTH                   : integer              := 32;-- Master interface data bus width
+		C_MST_DWIDTH                   : integer              := 32;-- Master interface data bus width, also the width of the FIFO32 words
 		C_NUM_REG                      : integer              := 4-- Number of software accessible registers
 	);
 	port
@@ -76,12 +76,12 @@ entity user_logic is
 		
 		-- FIFO Interface
 		FIFO32_S_Clk : out std_logic;
-		FIFO32_S_Data : in std_logic_vector(31 downto 0);
+		FIFO32_S_Data : in std_logic_vector(C_MST_DWIDTH-1 downto 0);
 		FIFO32_S_Fill : in std_logic_vector(15 downto 0);
 		FIFO32_S_Rd : out std_logic;
 		
 		FIFO32_M_Clk : out std_logic;
-		FIFO32_M_Data : out std_logic_vector(31 downto 0);
+		FIFO32_M_Data : out std_logic_vector(C_MST_DWIDTH-1 downto 0);
 		FIFO32_M_Rem : in std_logic_vector(15 downto 0);
 		FIFO32_M_Wr : out std_logic
 	);
@@ -109,6 +109,17 @@ architecture IMP of user_logic is
 	signal out_counter : std_logic_vector(11 downto 0);
 	signal in_counter : std_logic_vector(11 downto 0);
 	signal header_read : std_logic;
+
+	-- Requests are either bursts of whole words that start at a word
+	-- boundary, or single transfers within one word (see
+	-- fifo32_burst_converter). A single transfer only enables the bytes
+	-- of the request.
+	constant C_WORD_BYTES : integer := C_MST_DWIDTH/8;
+	constant C_WORD_BITS  : integer := clog2(C_WORD_BYTES);
+
+	signal offset : integer range 0 to C_WORD_BYTES-1;
+	signal single : std_logic;
+	signal beats  : std_logic_vector(11 downto 0);
 	
 -- begin chipscope
 
@@ -140,14 +151,14 @@ architecture IMP of user_logic is
 	signal IP2Bus_MstWr_Req_cs : std_logic;
 	signal IP2Bus_Mst_Type_cs : std_logic;
 	signal IP2Bus_Mst_Addr_cs : std_logic_vector(31 downto 0);
-	signal IP2Bus_Mst_BE_cs : std_logic_vector(3 downto 0);
+	signal IP2Bus_Mst_BE_cs : std_logic_vector(C_WORD_BYTES-1 downto 0);
 	signal IP2Bus_Mst_Length_cs : std_logic_vector(11 downto 0);
 	signal IP2Bus_Mst_Lock_cs : std_logic;
 	signal IP2Bus_Mst_Reset_cs : std_logic;
 	signal IP2Bus_MstRd_dst_rdy_n_cs : std_logic;
 	signal IP2Bus_MstRd_dst_dsc_n_cs : std_logic;
-	signal IP2Bus_MstWr_d_cs : std_logic_vector(31 downto 0);
-	signal IP2Bus_MstWr_REM_cs : std_logic_vector(3 downto 0);
+	signal IP2Bus_MstWr_d_cs : std_logic_vector(C_MST_DWIDTH-1 downto 0);
+	signal IP2Bus_MstWr_REM_cs : std_logic_vector(C_WORD_BYTES-1 downto 0);
 	signal IP2Bus_MstWr_sof_n_cs : std_logic;
 	signal IP2Bus_MstWr_eof_n_cs : std_logic;
 	signal IP2Bus_MstWr_src_rdy_n_cs : std_logic;
@@ -155,7 +166,7 @@ architecture IMP of user_logic is
 	
 	signal FIFO32_S_Rd_cs    : std_logic;
 	signal FIFO32_M_Wr_cs   : std_logic;
-	signal FIFO32_M_Data_cs    : std_logic_vector(31 downto 0);
+	signal FIFO32_M_Data_cs    : std_logic_vector(C_MST_DWIDTH-1 downto 0);
 	
 -- end chipscope
 	
@@ -189,7 +200,7 @@ begin
 	DATA(1) <= IP2Bus_MstWr_Req_cs;
 	DATA(2) <= IP2Bus_Mst_Type_cs;
 	DATA(34 downto 3) <= IP2Bus_Mst_Addr_cs;
-	DATA(38 downto 35) <= IP2Bus_Mst_BE_cs;
+	DATA(38 downto 35) <= IP2Bus_Mst_BE_cs(C_WORD_BYTES-1 downto C_WORD_BYTES-4);
 	DATA(50 downto 39) <= IP2Bus_Mst_Length_cs;
 	DATA(51) <= IP2Bus_Mst_Lock_cs;
 	DATA(52) <= IP2Bus_Mst_Reset_cs;	
@@ -200,8 +211,8 @@ begin
 	DATA(57) <= Bus2IP_Mst_Cmd_Timeout;
 	
 	-- Master Read Local Link 
-	DATA(89 downto 58) <= Bus2IP_MstRd_d;
-	DATA(93 downto 90) <= Bus2IP_MstRd_REM;
+	DATA(89 downto 58) <= Bus2IP_MstRd_d(0 to 31);
+	DATA(93 downto 90) <= Bus2IP_MstRd_REM(0 to 3);
 	DATA(94) <= Bus2IP_MstRd_sof_n;
 	DATA(95) <= Bus2IP_MstRd_eof_n;
 	DATA(96) <= Bus2IP_MstRd_src_rdy_n;
@@ -210,8 +221,8 @@ begin
 	DATA(99) <= IP2Bus_MstRd_dst_dsc_n_cs;
 	
 	-- Master Write Local Link
-	DATA(131 downto 100) <= IP2Bus_MstWr_d_cs;
-	DATA(135 downto 132) <= IP2Bus_MstWr_REM_cs;
+	DATA(131 downto 100) <= IP2Bus_MstWr_d_cs(C_MST_DWIDTH-1 downto C_MST_DWIDTH-32);
+	DATA(135 downto 132) <= IP2Bus_MstWr_REM_cs(C_WORD_BYTES-1 downto C_WORD_BYTES-4);
 	DATA(136) <= IP2Bus_MstWr_sof_n_cs;
 	DATA(137) <= IP2Bus_MstWr_eof_n_cs;
 	DATA(138) <= IP2Bus_MstWr_src_rdy_n_cs;
@@ -225,12 +236,12 @@ begin
 	
 	-- FSL
 	DATA(166) <= FIFO32_S_Rd_cs;
-	DATA(198 downto 167) <= FIFO32_S_Data;
+	DATA(198 downto 167) <= FIFO32_S_Data(31 downto 0);
 	DATA(214 downto 199) <= FIFO32_S_Fill;
 	
 	
 	DATA(215) <= FIFO32_M_Wr_cs;
-	DATA(247 downto 216) <= FIFO32_M_Data_cs;
+	DATA(247 downto 216) <= FIFO32_M_Data_cs(31 downto 0);
 	DATA(263 downto 248) <= FIFO32_M_Rem;
 	DATA(271 downto 264)  <= TRIG;
 	DATA(272) <= fifo_burst;
@@ -262,18 +273,44 @@ begin
 	
 -- end chipscope
 
-	IP2Bus_Mst_Type_cs <= '1'; -- burst
-	IP2Bus_Mst_BE_cs <= "1111";
+	offset <= conv_integer(IP2Bus_Mst_Addr_cs(C_WORD_BITS-1 downto 0));
+	-- 32 bit requests are always bursts of whole words, as they were
+	-- before the wide datapath
+	single_32_gen : if C_MST_DWIDTH = 32 generate
+		single <= '0';
+	end generate;
+
+	single_wide_gen : if C_MST_DWIDTH /= 32 generate
+		single <= '1' when offset /= 0 or cmd(23 downto 0) < C_WORD_BYTES else '0';
+	end generate;
+
+	beats  <= x"001" when single = '1' else EXT(cmd(11 downto C_WORD_BITS), 12);
+
+	IP2Bus_Mst_Type_cs <= not single; -- burst
+
+	-- byte lane i of the bus (counted from the upper bits) holds the byte at
+	-- offset i of the word
+	be_proc : process(single, offset, cmd)
+	begin
+		for i in 0 to C_WORD_BYTES-1 loop
+			if single = '0' or (i >= offset and i < offset + conv_integer(cmd(4 downto 0))) then
+				IP2Bus_Mst_BE_cs(C_WORD_BYTES-1-i) <= '1';
+			else
+				IP2Bus_Mst_BE_cs(C_WORD_BYTES-1-i) <= '0';
+			end if;
+		end loop;
+	end process;
 	IP2Bus_MstWr_src_dsc_n_cs <= '1';
 	IP2Bus_MstRd_dst_dsc_n_cs <= '1';
 	--IP2Bus_MstWr_d_cs <= x"AFFE1234";--mem(CONV_INTEGER(out_counter));
 	--IP2Bus_MstRd_dst_rdy_n_cs <= '0';
 	
-	IP2Bus_Mst_Length_cs <=  cmd(11 downto 2) & "00";
+	IP2Bus_Mst_Length_cs(11 downto C_WORD_BITS) <= cmd(11 downto C_WORD_BITS);
+	IP2Bus_Mst_Length_cs(C_WORD_BITS-1 downto 0) <= (others => '0');
 	IP2Bus_Error <= '0';
 	
 	IP2Bus_MstWr_sof_n_cs <= '0' when out_counter = 0 else '1';
-	IP2Bus_MstWr_eof_n_cs <= '0' when (out_counter = (IP2Bus_Mst_Length_cs(11 downto 2) - 1)) and (IP2Bus_MstWr_src_rdy_n_cs = '0') else '1';
+	IP2Bus_MstWr_eof_n_cs <= '0' when (out_counter = (beats - 1)) and (IP2Bus_MstWr_src_rdy_n_cs = '0') else '1';
 	
 	-- since the Bus2IP_MstWr_dst_rdy_n signal stays low(active) for one cycle too long we
 	-- we deassert ready for this cycle.
@@ -338,13 +375,13 @@ begin
 				when STATE_READ_CMD =>
 					DATA(281) <= '1';
 					FIFO32_S_Rd_alt <= '1';
-					cmd <= FIFO32_S_Data;
+					cmd <= FIFO32_S_Data(31 downto 0);
 					state <= STATE_READ_ADDR;
 					
 				when STATE_READ_ADDR =>
 					DATA(282) <= '1';
 					FIFO32_S_Rd_alt <= '0';
-					IP2Bus_Mst_Addr_cs <= FIFO32_S_Data;
+					IP2Bus_Mst_Addr_cs <= FIFO32_S_Data(31 downto 0);
 					if cmd(31) = '0' then -- burst read
 						state <= STATE_WAIT_FIFO_REM;
 					else -- burst write
@@ -353,13 +390,13 @@ begin
 
 				when STATE_WAIT_FIFO_REM =>
 					DATA(283) <= '1';
-					if FIFO32_M_Rem >= cmd(11 downto 2) then
+					if FIFO32_M_Rem >= beats then
 						state <= STATE_READ_REQ;
 					end if;
 					
 				when STATE_WAIT_FIFO_FILL =>
 					DATA(284) <= '1';
-					if FIFO32_S_Fill >= cmd(11 downto 2) then
+					if FIFO32_S_Fill >= beats then
 						state <= STATE_WRITE_REQ;
 					end if;
 					
@@ -377,7 +414,7 @@ begin
 					if Bus2IP_MstRd_src_rdy_n = '0' then
 						
 						FIFO32_M_Wr_cs <= '1';
-						if in_counter = IP2Bus_Mst_Length_cs(11 downto 2) - 1 then
+						if in_counter = beats - 1 then
 							IP2Bus_MstRd_dst_rdy_n_cs <= '1';
 							--FSL_M_Write_cs <= '0';
 							in_counter <= (others => '0');
@@ -401,7 +438,7 @@ begin
 					IP2Bus_MstWr_src_rdy_n_cs <= '0';
 					if Bus2IP_MstWr_dst_rdy_n = '0' then
 						--FIFO32_S_Rd_cs <= '1';
-						if out_counter = IP2Bus_Mst_Length_cs(11 downto 2) - 1 then
+						if out_counter = beats - 1 then
 							out_counter <= (others => '0');
 							IP2Bus_MstWr_src_rdy_n_cs <= '1';
 							state <= STATE_WAIT_COMPLETE;
@@ -44,7 +44,8 @@ use xps_mem_v1_00_a.user_logic;
 --   C_FAMILY                     -- Xilinx FPGA family
 --   C_MPLB_AWIDTH                -- PLBv46 master: address bus width
 --   C_MPLB_DWIDTH                -- PLBv46 master: data bus width
---   C_MPLB_NATIVE_DWIDTH         -- PLBv46 master: internal native data width
+--   C_MPLB_NATIVE_DWIDTH         -- PLBv46 master: internal native data width, also the
+--                                   width of the FIFO32 words (see fifo32_width_adapter)
 --   C_MPLB_P2P                   -- PLBv46 master: point to point interconnect scheme
 --   C_MPLB_SMALLEST_SLAVE        -- PLBv46 master: width of the smallest slave
 --   C_MPLB_CLK_PERIOD_PS         -- PLBv46 master: bus clock in picoseconds
@@ -189,8 +190,8 @@ entity xps_mem is
 		-- FIFO Interface
 		FIFO32_S_Clk : out std_logic;
 		FIFO32_M_Clk : out std_logic;
-		FIFO32_S_Data : in std_logic_vector(31 downto 0);
-		FIFO32_M_Data : out std_logic_vector(31 downto 0);
+		FIFO32_S_Data : in std_logic_vector(C_MPLB_NATIVE_DWIDTH-1 downto 0);
+		FIFO32_M_Data : out std_logic_vector(C_MPLB_NATIVE_DWIDTH-1 downto 0);
 		FIFO32_S_Fill : in std_logic_vector(15 downto 0);
 		FIFO32_M_Rem : in std_logic_vector(15 downto 0);
 		FIFO32_S_Rd : out std_logic;